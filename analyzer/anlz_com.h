@@ -0,0 +1,214 @@
+/*
+ *****************************************************************************
+ *
+ * 簡易信号アナライザー Analyzer 内部共通ヘッダ
+ *
+ *   anlzモジュール内でのみ使用する。
+ *
+ *****************************************************************************
+ */
+
+#pragma once
+
+
+
+////////// anlz_stat.c モジュール内公開I/F ///////////////////////////////////
+//
+// 統計モード(--stat)で使用する集計処理。
+// 解析済みの信号スタックをプロトコル階層ごとに集計し、最後に一覧表示する。
+// デコード出力も入力待ちもしないため、キャプチャファイルの読込速度で
+// 処理が進むことを狙っている。
+
+void anlz_startStat( void );
+
+void anlz_countStat( com_sigInf_t *iSignal, com_off iFrameLen, BOOL iResult );
+
+void anlz_printStat( void );
+
+
+
+////////// anlz_flow.c モジュール内公開I/F ///////////////////////////////////
+//
+// 会話(フロー)集計処理。
+// TCP/UDP/SCTPの 5-tuple ごとに、時刻・方向別のパケット数/バイト数・
+// TCPハンドシェイクRTT・TCP再送数を集計し、最後にファイル出力する。
+// 出力ファイル名の拡張子が .json なら JSON、それ以外は CSV で出力する。
+
+BOOL anlz_setFlowFile( const char *iFile );
+
+void anlz_countFlow( com_sigInf_t *iSignal, com_off iFrameLen );
+
+void anlz_exportFlow( void );
+
+
+////////// anlz_track.c モジュール内公開I/F ///////////////////////////////////
+//
+// 信号追跡処理(--track)の共通処理。
+// 追跡処理は anlz_track.c の gTrackFunc[]に登録し、起動オプションで指定された
+// ものだけが、ファイル読込開始時/信号解析後/ファイル読込終了時に呼ばれる。
+
+BOOL anlz_useTrack( const char *iLabel );
+
+void anlz_startTrack( void );
+
+void anlz_countTrack( com_sigInf_t *iSignal );
+
+void anlz_endTrack( void );
+
+// 解析済み信号から iType のプロトコルのスタックを全て探し、iFuncを呼ぶ
+typedef void (*anlz_seekStack_t)( com_sigInf_t *iTarget );
+
+void anlz_seekStack( com_sigInf_t *iHead, long iType, anlz_seekStack_t iFunc );
+
+// 応答時間ヒストグラム (マイクロ秒単位で保持)
+enum {
+    ANLZ_HIST_SUB = 4,                        // 1オクターブあたりの分割数
+    ANLZ_HIST_SIZE = 32 * ANLZ_HIST_SUB       // バケット数 (約72分まで)
+};
+
+typedef struct {
+    ulong   count;                    // 件数
+    ulong   sum;                      // 合計
+    ulong   min;                      // 最小値
+    ulong   max;                      // 最大値
+    ulong   bucket[ANLZ_HIST_SIZE];   // バケットごとの件数
+} anlz_hist_t;
+
+void anlz_addHist( anlz_hist_t *ioHist, const struct timeval *iTime );
+
+ulong anlz_getHistPercentile( const anlz_hist_t *iHist, long iPercent );
+
+void anlz_printHist( const char *iLabel, const anlz_hist_t *iHist );
+
+// 応答待ちトランザクション管理
+//   要求をキーで登録し、応答のキーで検索して経過時間を得る。
+//   .timeout秒を過ぎたものや、.max件を超えて追い出したものは
+//   .expireで通知した上で破棄する。キーは先頭 .keyMaxオクテットのみ使用する。
+//   各トランザクションで ANLZ_TRDATA_MAXまでの任意データを持てる。
+//   管理データは .keyMaxに合わせた固定長で連続領域に確保し、ハッシュも
+//   管理データ内でつなぐため、登録/削除ごとのメモリ捕捉/解放は発生しない。
+enum {
+    ANLZ_TRKEY_MAX = 256,     // 可変長キーを使う場合の目安
+    ANLZ_TRDATA_MAX = 64
+};
+
+typedef enum {
+    ANLZ_TREXP_TIMEOUT = 0,   // タイムアウト
+    ANLZ_TREXP_OVERFLOW,      // 件数上限による追い出し
+    ANLZ_TREXP_REMAIN         // ファイル終了時点で応答なし
+} ANLZ_TREXP_t;
+
+typedef void (*anlz_expireTrans_t)( void *ioData, ANLZ_TREXP_t iCause );
+
+typedef struct {
+    struct timeval  stamp;       // 登録時刻
+    long            older;       // 1つ古いデータ (未使用時は次の未使用データ)
+    long            newer;       // 1つ新しいデータ
+    long            chain;       // 同じハッシュ値の次のデータ
+    ulong           hashVal;     // キーのハッシュ値
+    size_t          keySize;
+    ulong           data[ANLZ_TRDATA_MAX / sizeof(ulong)];
+    com_bin         key[];       // .keyMaxオクテット
+} anlz_trEntry_t;
+
+typedef struct {
+    com_bin*            entry;       // 管理データテーブル (.stride単位)
+    size_t              stride;      // 管理データ1つのサイズ
+    size_t              keyMax;      // キーの最大サイズ
+    long                cnt;         // 管理データ確保数
+    long                max;         // 管理データ確保上限
+    long                use;         // 使用中の管理データ数
+    long                oldest;      // 使用中で最も古い管理データ
+    long                newest;      // 使用中で最も新しい管理データ
+    long                empty;       // 未使用の管理データ
+    long                timeout;     // タイムアウト秒数
+    anlz_expireTrans_t  expire;      // 破棄時の通知関数
+    long*               bucket;      // ハッシュ値 → 管理データ位置
+    ulong               mask;        // ハッシュ値 → bucket位置
+    ulong               timeoutCnt;  // タイムアウト数
+    ulong               overflowCnt; // 件数上限による追い出し数
+} anlz_trans_t;
+
+void anlz_initTrans(
+        anlz_trans_t *oTrans, long iTimeout, long iMax, size_t iKeyMax,
+        anlz_expireTrans_t iFunc );
+
+// 登録済みだった場合は *oExistを trueにし、既存データを返す
+void *anlz_addTrans(
+        anlz_trans_t *ioTrans, const void *iKey, size_t iKeySize,
+        BOOL *oExist );
+
+void *anlz_searchTrans(
+        anlz_trans_t *ioTrans, const void *iKey, size_t iKeySize,
+        struct timeval *oLatency );
+
+void anlz_deleteTrans(
+        anlz_trans_t *ioTrans, const void *iKey, size_t iKeySize );
+
+// タイムアウト判定後、残ったものを全て ANLZ_TREXP_REMAINで破棄する
+void anlz_flushTrans( anlz_trans_t *ioTrans );
+
+void anlz_freeTrans( anlz_trans_t *ioTrans );
+
+// キーのハッシュ値計算 (FNV-1a)
+ulong anlz_calcHash( const void *iKey, size_t iKeySize );
+
+
+
+////////// anlz_sip.c モジュール内公開I/F ////////////////////////////////////
+//
+// SIPトランザクション/ダイアログ追跡 (--track sip)
+
+void anlz_startSip( void );
+
+void anlz_trackSip( com_sigInf_t *iSignal );
+
+void anlz_reportSip( void );
+
+
+
+////////// anlz_diameter.c モジュール内公開I/F ///////////////////////////////
+//
+// Diameter要求/応答追跡 (--track diameter)
+
+void anlz_startDiameter( void );
+
+void anlz_trackDiameter( com_sigInf_t *iSignal );
+
+void anlz_reportDiameter( void );
+
+
+
+////////// anlz_dns.c モジュール内公開I/F ////////////////////////////////////
+//
+// DNSクエリ/応答追跡 (--track dns)
+
+void anlz_startDns( void );
+
+void anlz_trackDns( com_sigInf_t *iSignal );
+
+void anlz_reportDns( void );
+
+
+
+////////// anlz_rtp.c モジュール内公開I/F ////////////////////////////////////
+//
+// RTPストリーム品質分析 (--track rtp)
+
+void anlz_startRtp( void );
+
+void anlz_trackRtp( com_sigInf_t *iSignal );
+
+void anlz_reportRtp( void );
+
+
+
+////////// anlz_tcap.c モジュール内公開I/F ///////////////////////////////////
+//
+// TCAPダイアログ/オペレーション追跡 (--track tcap)
+
+void anlz_startTcap( void );
+
+void anlz_trackTcap( com_sigInf_t *iSignal );
+
+void anlz_reportTcap( void );
@@ -0,0 +1,237 @@
+/*
+ *****************************************************************************
+ *
+ * 簡易信号アナライザー Analyzer Diameter追跡モジュールソース
+ *
+ *****************************************************************************
+ */
+
+#include "anlz_if.h"
+#include "anlz_com.h"
+
+// トランザクションは (Hop-by-Hop ID, End-to-End ID, 要求側から見たノード情報)
+// をキーにする。応答はノード情報を反転して同じキーを作って検索する。
+// 集計は Command-Codeと Application-IDの組み合わせごとに行う。
+
+enum {
+    DIAM_TRANS_TIMEOUT = 30,      // 応答なしと判断するまでの時間(秒)
+    DIAM_TRANS_MAX = 262144,      // 保持する最大トランザクション数
+    DIAM_RESULT_CLASS = 6,        // Result-Codeの千の位(1～5)
+    DIAM_LOST_LIST = 16,          // 応答なしの詳細を表示する件数
+    DIAM_CMD_BLOCK = 16           // 集計テーブル拡張単位
+};
+
+// Result-Code を持つ AVP
+enum {
+    DIAM_AVP_RESULT_CODE = 268,
+    DIAM_AVP_EXPERIMENTAL_RESULT_CODE = 298
+};
+
+// Command-Code/Application-IDごとの集計
+typedef struct {
+    ulong         cmdCode;                     // Command-Code
+    ulong         appId;                       // Application-ID
+    char          label[16];                   // コマンド名 (要求側)
+    ulong         requests;                    // 要求数 (再送を除く)
+    ulong         retrans;                     // 要求再送数
+    ulong         answers;                     // 応答数
+    ulong         errors;                      // Eビット付き応答数
+    ulong         result[DIAM_RESULT_CLASS];   // Result-Code (千の位ごと)
+    ulong         timeout;                     // 応答なしで破棄した数
+    anlz_hist_t   latency;                     // 要求→応答 の時間
+} diamCmd_t;
+
+static diamCmd_t*  gDiamCmd = NULL;
+static long  gDiamCmdCnt = 0;     // 使用中の集計数
+static long  gDiamCmdMax = 0;     // 確保済みの集計数
+static ulong  gDiamUnmatched = 0;  // 対応する要求が無かった応答数
+
+// トランザクションのキー
+typedef struct {
+    com_nodeInf_t  node;          // 要求の送信元→送信先
+    uint32_t       hopByHop;
+    uint32_t       endToEnd;
+} diamKey_t;
+
+// トランザクションで保持するデータ
+typedef struct {
+    long            cmd;          // gDiamCmd[]の位置
+    ulong           hopByHop;
+    ulong           endToEnd;
+    struct timeval  stamp;        // 要求の時刻
+} diamTrans_t;
+
+static anlz_trans_t  gDiamTrans;
+
+// 応答なしで破棄した要求の詳細 (先頭 DIAM_LOST_LIST件のみ)
+static diamTrans_t  gDiamLost[DIAM_LOST_LIST];
+static long  gDiamLostCnt = 0;
+
+static void expireDiamTrans( void *ioData, ANLZ_TREXP_t iCause )
+{
+    diamTrans_t*  trans = ioData;
+    if( iCause == ANLZ_TREXP_OVERFLOW ) {return;}
+    gDiamCmd[trans->cmd].timeout++;
+    if( gDiamLostCnt < DIAM_LOST_LIST ) {gDiamLost[gDiamLostCnt++] = *trans;}
+}
+
+void anlz_startDiameter( void )
+{
+    com_free( gDiamCmd );
+    gDiamCmdCnt = gDiamCmdMax = 0;
+    gDiamUnmatched = 0;
+    gDiamLostCnt = 0;
+    anlz_initTrans( &gDiamTrans, DIAM_TRANS_TIMEOUT, DIAM_TRANS_MAX,
+                    sizeof(diamKey_t), expireDiamTrans );
+}
+
+static long addDiamCmd(
+        com_sigDiamHdr_t *iDiam, ulong iCmdCode, ulong iAppId )
+{
+    if( gDiamCmdCnt == gDiamCmdMax ) {
+        if( !com_realloct( &gDiamCmd, sizeof(*gDiamCmd), &gDiamCmdMax,
+                           DIAM_CMD_BLOCK, "diameter command(%ld)",
+                           gDiamCmdMax ) ) {return COM_TABLEEND;}
+    }
+    diamCmd_t*  cmd = &(gDiamCmd[gDiamCmdCnt]);
+    *cmd = (diamCmd_t){ .cmdCode = iCmdCode, .appId = iAppId };
+    // コマンド名の後ろに付くコード値は別に出すので落とす
+    (void)com_strcpy( cmd->label, com_getDiameterCmdName( iDiam ) );
+    char*  space = strchr( cmd->label, ' ' );
+    if( space ) {*space = '\0';}
+    return gDiamCmdCnt++;
+}
+
+// 組み合わせの数はたかが知れているので、線形に探す
+static long getDiamCmd( com_sigDiamHdr_t *iDiam )
+{
+    ulong  cmdCode = com_calcValue( iDiam->cmdCode, sizeof(iDiam->cmdCode) );
+    ulong  appId = com_calcValue( &iDiam->AppliID, sizeof(iDiam->AppliID) );
+    for( long i = 0;  i < gDiamCmdCnt;  i++ ) {
+        if( gDiamCmd[i].cmdCode == cmdCode && gDiamCmd[i].appId == appId ) {
+            return i;
+        }
+    }
+    return addDiamCmd( iDiam, cmdCode, appId );
+}
+
+// Result-Code または Experimental-Result-Code の値を返す (無ければ 0)
+static ulong getResultCode( com_sigPrm_t *iPrm )
+{
+    for( long i = 0;  i < iPrm->cnt;  i++ ) {
+        com_sigTlv_t*  avp = &(iPrm->list[i]);
+        if( avp->tag != DIAM_AVP_RESULT_CODE &&
+            avp->tag != DIAM_AVP_EXPERIMENTAL_RESULT_CODE ) {continue;}
+        if( avp->value && avp->len == COM_32BIT_SIZE ) {
+            return com_calcValue( avp->value, avp->len );
+        }
+    }
+    return 0;
+}
+
+static BOOL makeDiamKey(
+        diamKey_t *oKey, com_sigInf_t *iDiam, com_sigDiamHdr_t *iHdr,
+        BOOL iRequest )
+{
+    memset( oKey, 0, sizeof(*oKey) );
+    if( !com_getNodeInf( iDiam, &oKey->node ) ) {return false;}
+    if( !iRequest ) {com_reverseNodeInf( &oKey->node );}
+    oKey->hopByHop = iHdr->HopByHopID;
+    oKey->endToEnd = iHdr->EndToEndID;
+    return true;
+}
+
+static void procDiamRequest( com_sigDiamHdr_t *iHdr, diamKey_t *iKey )
+{
+    long  cmdIdx = getDiamCmd( iHdr );
+    if( cmdIdx == COM_TABLEEND ) {return;}
+    diamCmd_t*  cmd = &(gDiamCmd[cmdIdx]);
+    BOOL  exist = false;
+    diamTrans_t*  trans =
+        anlz_addTrans( &gDiamTrans, iKey, sizeof(*iKey), &exist );
+    if( !trans ) {return;}
+    if( exist ) {cmd->retrans++;  return;}
+    *trans = (diamTrans_t){
+        .cmd = cmdIdx,
+        .hopByHop = com_calcValue( &iHdr->HopByHopID, COM_32BIT_SIZE ),
+        .endToEnd = com_calcValue( &iHdr->EndToEndID, COM_32BIT_SIZE )
+    };
+    (void)com_getSignalTime( &trans->stamp );
+    cmd->requests++;
+}
+
+static void procDiamAnswer(
+        com_sigInf_t *iDiam, com_sigDiamHdr_t *iHdr, diamKey_t *iKey )
+{
+    struct timeval  latency;
+    diamTrans_t*  trans =
+        anlz_searchTrans( &gDiamTrans, iKey, sizeof(*iKey), &latency );
+    if( !trans ) {gDiamUnmatched++;  return;}
+    diamCmd_t*  cmd = &(gDiamCmd[trans->cmd]);
+    cmd->answers++;
+    anlz_addHist( &cmd->latency, &latency );
+    if( COM_CHECKBIT( iHdr->cmdFlags, COM_CAP_DIAMHDR_EBIT ) ) {
+        cmd->errors++;
+    }
+    ulong  result = getResultCode( &iDiam->prm ) / 1000;
+    if( result && result < DIAM_RESULT_CLASS ) {cmd->result[result]++;}
+    anlz_deleteTrans( &gDiamTrans, iKey, sizeof(*iKey) );
+}
+
+static void trackDiameter( com_sigInf_t *iDiam )
+{
+    com_sigDiamHdr_t*  hdr = (com_sigDiamHdr_t*)iDiam->sig.top;
+    BOOL  isRequest = COM_CHECKBIT( hdr->cmdFlags, COM_CAP_DIAMHDR_RBIT );
+    diamKey_t  key;
+    if( !makeDiamKey( &key, iDiam, hdr, isRequest ) ) {return;}
+    if( isRequest ) {procDiamRequest( hdr, &key );}
+    else {procDiamAnswer( iDiam, hdr, &key );}
+}
+
+void anlz_trackDiameter( com_sigInf_t *iSignal )
+{
+    anlz_seekStack( iSignal, COM_SIG_DIAMETER, trackDiameter );
+}
+
+static void printDiamCmd( diamCmd_t *iCmd )
+{
+    com_printf( "  %s (%lu) App-ID=%lu  requests=%lu retrans=%lu "
+                "answers=%lu timeout=%lu\n",
+                iCmd->label, iCmd->cmdCode, iCmd->appId, iCmd->requests,
+                iCmd->retrans, iCmd->answers, iCmd->timeout );
+    com_printf( "    E-bit=%lu  Result-Code:", iCmd->errors );
+    for( long i = 1;  i < DIAM_RESULT_CLASS;  i++ ) {
+        com_printf( " %ldxxx=%lu", i, iCmd->result[i] );
+    }
+    com_printLf();
+    anlz_printHist( "request -> answer", &iCmd->latency );
+}
+
+static void printDiamLost( void )
+{
+    if( !gDiamLostCnt ) {return;}
+    com_printf( "  unanswered requests (first %ld):\n", gDiamLostCnt );
+    for( long i = 0;  i < gDiamLostCnt;  i++ ) {
+        diamTrans_t*  lost = &(gDiamLost[i]);
+        com_printf( "    %ld.%06ld  %s  Hop-by-Hop=0x%08lx "
+                    "End-to-End=0x%08lx\n",
+                    (long)lost->stamp.tv_sec, (long)lost->stamp.tv_usec,
+                    gDiamCmd[lost->cmd].label,
+                    lost->hopByHop, lost->endToEnd );
+    }
+}
+
+void anlz_reportDiameter( void )
+{
+    anlz_flushTrans( &gDiamTrans );
+    com_printTag( "=", 79, COM_PTAG_LEFT, "Diameter transactions" );
+    for( long i = 0;  i < gDiamCmdCnt;  i++ ) {printDiamCmd( &gDiamCmd[i] );}
+    com_printf( "  unmatched answers=%lu  dropped transactions=%lu\n",
+                gDiamUnmatched, gDiamTrans.overflowCnt );
+    printDiamLost();
+    com_printLf();
+    anlz_freeTrans( &gDiamTrans );
+    com_free( gDiamCmd );
+    gDiamCmdCnt = gDiamCmdMax = 0;
+}
+
@@ -0,0 +1,228 @@
+/*
+ *****************************************************************************
+ *
+ * 簡易信号アナライザー Analyzer DNS追跡モジュールソース
+ *
+ *****************************************************************************
+ */
+
+#include <arpa/inet.h>
+#include "anlz_if.h"
+#include "anlz_com.h"
+
+// トランザクションは (ID, クライアントのアドレス/ポート, QTYPE, QNAME) を
+// キーにする。QNAMEは小文字化した上でハッシュ値にしてキーに入れるので、
+// キーは固定長で小さく、大量のクエリでも管理データが膨らまない。
+// 集計はサーバー(クエリの送信先アドレス)ごとに行う。
+
+enum {
+    DNS_TRANS_TIMEOUT = 5,         // 応答なしと判断するまでの時間(秒)
+    DNS_TRANS_MAX = 1048576,       // 保持する最大トランザクション数
+    DNS_RCODE_MAX = 16,            // RCODEは 4bit
+    DNS_SERVER_BLOCK = 64,         // サーバー集計テーブル拡張単位
+    DNSHASH_SIZE = 4093            // サーバー検索用ハッシュサイズ (素数)
+};
+
+// サーバーごとの集計
+typedef struct {
+    long          ptype;                  // COM_SIG_IPV4 or COM_SIG_IPV6
+    com_bin       addr[COM_NODEADDR_SIZE];
+    ulong         queries;                // クエリ数 (再送を除く)
+    ulong         retrans;                // クエリ再送数
+    ulong         answers;                // 応答数
+    ulong         timeout;                // 応答なしで破棄した数
+    ulong         rcode[DNS_RCODE_MAX];   // RCODEごとの応答数
+    anlz_hist_t   latency;                // クエリ→応答 の時間
+} dnsServer_t;
+
+static dnsServer_t*  gDnsServer = NULL;
+static long  gDnsServerCnt = 0;     // 使用中の集計数
+static long  gDnsServerMax = 0;     // 確保済みの集計数
+static com_hashId_t  gDnsServerHash = COM_HASHID_NOTREG;
+static anlz_hist_t  gDnsTotal;      // 全サーバー合計の応答時間
+static ulong  gDnsUnmatched = 0;    // 対応するクエリが無かった応答数
+
+// トランザクションのキー
+typedef struct {
+    com_bin    addr[COM_NODEADDR_SIZE];   // クライアントアドレス
+    com_bin    port[COM_NODEPORT_SIZE];   // クライアントポート
+    uint16_t   id;                        // DNS ID
+    uint16_t   qtype;                     // QTYPE
+    uint32_t   qnameLen;                  // QNAME長
+    ulong      qnameHash;                 // QNAMEのハッシュ値
+} dnsKey_t;
+
+// トランザクションで保持するデータ
+typedef struct {
+    long   server;      // gDnsServer[]の位置
+} dnsTrans_t;
+
+static anlz_trans_t  gDnsTrans;
+
+static void expireDnsTrans( void *ioData, ANLZ_TREXP_t iCause )
+{
+    dnsTrans_t*  trans = ioData;
+    if( iCause == ANLZ_TREXP_OVERFLOW ) {return;}
+    gDnsServer[trans->server].timeout++;
+}
+
+void anlz_startDns( void )
+{
+    com_free( gDnsServer );
+    gDnsServerCnt = gDnsServerMax = 0;
+    gDnsServerHash = com_registerHash( DNSHASH_SIZE, NULL );
+    memset( &gDnsTotal, 0, sizeof(gDnsTotal) );
+    gDnsUnmatched = 0;
+    anlz_initTrans( &gDnsTrans, DNS_TRANS_TIMEOUT, DNS_TRANS_MAX,
+                    sizeof(dnsKey_t), expireDnsTrans );
+}
+
+static long addDnsServer( long iType, const com_bin *iAddr )
+{
+    if( gDnsServerCnt == gDnsServerMax ) {
+        if( !com_realloct( &gDnsServer, sizeof(*gDnsServer), &gDnsServerMax,
+                           DNS_SERVER_BLOCK, "dns server(%ld)",
+                           gDnsServerMax ) ) {return COM_TABLEEND;}
+    }
+    long  idx = gDnsServerCnt;
+    if( COM_HASH_OK != com_addHash( gDnsServerHash, false,
+                                    iAddr, COM_NODEADDR_SIZE,
+                                    &idx, sizeof(idx) ) ) {return COM_TABLEEND;}
+    dnsServer_t*  server = &(gDnsServer[gDnsServerCnt++]);
+    *server = (dnsServer_t){ .ptype = iType };
+    memcpy( server->addr, iAddr, COM_NODEADDR_SIZE );
+    return idx;
+}
+
+static long getDnsServer( long iType, const com_bin *iAddr )
+{
+    const void*  data = NULL;
+    if( com_searchHash( gDnsServerHash, iAddr, COM_NODEADDR_SIZE,
+                        &data, NULL ) ) {return *(const long*)data;}
+    return addDnsServer( iType, iAddr );
+}
+
+// 先頭の questionから QTYPEと QNAME(小文字化してハッシュ値)を得る
+static BOOL getQuestion( com_sigInf_t *iDns, dnsKey_t *oKey )
+{
+    com_sigDnsData_t*  dns = iDns->ext;
+    if( !dns ) {return false;}
+    for( long i = 0;  i < dns->rcnt;  i++ ) {
+        com_sigDnsRecord_t*  rd = &(dns->rd[i]);
+        if( rd->recSec != COM_CAP_DNS_QD ) {continue;}
+        char  qname[COM_LINEBUF_SIZE];
+        com_off  len = com_getDomain( iDns, rd->rname.top,
+                                      qname, sizeof(qname) );
+        for( com_off j = 0;  j < len;  j++ ) {
+            qname[j] = (char)tolower( (uchar)qname[j] );
+        }
+        oKey->qtype = (uint16_t)rd->rtype;
+        oKey->qnameLen = (uint32_t)len;
+        oKey->qnameHash = anlz_calcHash( qname, len );
+        return true;
+    }
+    return false;
+}
+
+// クエリなら送信元、応答なら送信先をクライアントとしてキーを作る
+static BOOL makeDnsKey(
+        dnsKey_t *oKey, com_sigInf_t *iDns, BOOL iQuery,
+        com_nodeInf_t *oNode )
+{
+    memset( oKey, 0, sizeof(*oKey) );
+    if( !com_getNodeInf( iDns, oNode ) ) {return false;}
+    if( !iQuery ) {com_reverseNodeInf( oNode );}
+    memcpy( oKey->addr, oNode->srcAddr, sizeof(oKey->addr) );
+    memcpy( oKey->port, oNode->srcPort, sizeof(oKey->port) );
+    com_sigDnsHdr_t*  hdr = (com_sigDnsHdr_t*)iDns->sig.top;
+    oKey->id = hdr->id;
+    return getQuestion( iDns, oKey );
+}
+
+static void procDnsQuery( dnsKey_t *iKey, com_nodeInf_t *iNode )
+{
+    long  serverIdx = getDnsServer( iNode->ptype, iNode->dstAddr );
+    if( serverIdx == COM_TABLEEND ) {return;}
+    dnsServer_t*  server = &(gDnsServer[serverIdx]);
+    BOOL  exist = false;
+    dnsTrans_t*  trans =
+        anlz_addTrans( &gDnsTrans, iKey, sizeof(*iKey), &exist );
+    if( !trans ) {return;}
+    if( exist ) {server->retrans++;  return;}
+    trans->server = serverIdx;
+    server->queries++;
+}
+
+static void procDnsResponse( com_sigInf_t *iDns, dnsKey_t *iKey )
+{
+    struct timeval  latency;
+    dnsTrans_t*  trans =
+        anlz_searchTrans( &gDnsTrans, iKey, sizeof(*iKey), &latency );
+    if( !trans ) {gDnsUnmatched++;  return;}
+    dnsServer_t*  server = &(gDnsServer[trans->server]);
+    server->answers++;
+    server->rcode[com_getDnsFlagsField( iDns, COM_CAP_DNSBIT_RCODE )]++;
+    anlz_addHist( &server->latency, &latency );
+    anlz_addHist( &gDnsTotal, &latency );
+    anlz_deleteTrans( &gDnsTrans, iKey, sizeof(*iKey) );
+}
+
+static void trackDns( com_sigInf_t *iDns )
+{
+    BOOL  isQuery = (COM_CAP_DNS_QR_QUERY ==
+                     com_getDnsFlagsField( iDns, COM_CAP_DNSBIT_QR ));
+    dnsKey_t  key;
+    com_nodeInf_t  node;
+    if( !makeDnsKey( &key, iDns, isQuery, &node ) ) {return;}
+    if( isQuery ) {procDnsQuery( &key, &node );}
+    else {procDnsResponse( iDns, &key );}
+}
+
+void anlz_trackDns( com_sigInf_t *iSignal )
+{
+    anlz_seekStack( iSignal, COM_SIG_DNS, trackDns );
+}
+
+static void printRcode( const dnsServer_t *iServer )
+{
+    for( ulong i = 0;  i < DNS_RCODE_MAX;  i++ ) {
+        if( !iServer->rcode[i] ) {continue;}
+        char  code[COM_WORDBUF_SIZE];
+        const char*  name = code;
+        if( i <= COM_CAP_DNS_RCODE_REFUSED ) {name = com_getDnsRcodeName( i );}
+        else {snprintf( code, sizeof(code), "%lu", i );}
+        com_printf( "    rcode %-32s %lu\n", name, iServer->rcode[i] );
+    }
+}
+
+static void printDnsServer( const dnsServer_t *iServer )
+{
+    char  addr[INET6_ADDRSTRLEN];
+    int  af = (iServer->ptype == COM_SIG_IPV6) ? AF_INET6 : AF_INET;
+    if( !inet_ntop( af, iServer->addr, addr, sizeof(addr) ) ) {*addr = '\0';}
+    com_printf( "  server %s  queries=%lu retrans=%lu answers=%lu "
+                "timeout=%lu\n",
+                addr, iServer->queries, iServer->retrans, iServer->answers,
+                iServer->timeout );
+    printRcode( iServer );
+    anlz_printHist( "query -> response", &iServer->latency );
+}
+
+void anlz_reportDns( void )
+{
+    anlz_flushTrans( &gDnsTrans );
+    com_printTag( "=", 79, COM_PTAG_LEFT, "DNS transactions" );
+    anlz_printHist( "all servers", &gDnsTotal );
+    for( long i = 0;  i < gDnsServerCnt;  i++ ) {
+        printDnsServer( &gDnsServer[i] );
+    }
+    com_printf( "  unmatched responses=%lu  dropped queries=%lu\n",
+                gDnsUnmatched, gDnsTrans.overflowCnt );
+    com_printLf();
+    anlz_freeTrans( &gDnsTrans );
+    com_free( gDnsServer );
+    gDnsServerCnt = gDnsServerMax = 0;
+    com_cancelHash( gDnsServerHash );
+    gDnsServerHash = COM_HASHID_NOTREG;
+}
+
@@ -0,0 +1,349 @@
+/*
+ *****************************************************************************
+ *
+ * 簡易信号アナライザー Analyzer 会話(フロー)集計モジュールソース
+ *
+ *****************************************************************************
+ */
+
+#include <arpa/inet.h>
+#include "anlz_if.h"
+#include "anlz_com.h"
+
+// フローのキー (トランスポート層種別 + 正規化したノード情報)
+//   ノード情報は 送信元/送信先 の小さい方を src側に揃えて正規化するので、
+//   どちらの方向の信号でも同じキーになる。
+typedef struct {
+    long           l4type;     // トランスポート層プロトコル種別
+    com_nodeInf_t  node;       // 正規化したノード情報
+} flowKey_t;
+
+// フローの方向別情報
+typedef struct {
+    ulong   packets;           // パケット数
+    ulong   bytes;             // バイト数 (フレーム長の合計)
+    ulong   retrans;           // TCP再送と判断した数
+    ulong   nextSeq;           // 次に期待する TCPシーケンス番号
+    BOOL    seqValid;          // nextSeqが有効かどうか
+} flowDir_t;
+
+// TCPハンドシェイク進行度
+typedef enum {
+    FLOW_HS_NONE = 0,          // SYN未検出
+    FLOW_HS_SYN,               // SYN検出
+    FLOW_HS_SYNACK,            // SYN+ACK検出
+    FLOW_HS_DONE               // ハンドシェイク完了 (RTT算出済)
+} FLOW_HS_t;
+
+// フロー情報
+//   .dir[0]は最初に検出した信号の 送信元→送信先 方向、.dir[1]はその逆方向。
+//   .reverseは .dir[0]の方向が キーの dst→src の向きかどうかを示す。
+typedef struct {
+    flowKey_t       key;
+    BOOL            reverse;
+    struct timeval  first;     // 最初の信号の時刻
+    struct timeval  last;      // 最後の信号の時刻
+    flowDir_t       dir[2];
+    long            handshake; // FLOW_HS_t型の値を格納
+    struct timeval  synTime;   // SYN検出時刻
+    struct timeval  rtt;       // SYN～ハンドシェイク完了(ACK)までの時間
+} flowInf_t;
+
+// フロー一覧
+//   件数が膨大になり得るので、テーブルはブロック単位で拡張する。
+//   ハッシュにはテーブルのインデックスを登録し、拡張による移動に備える。
+enum {
+    FLOW_BLOCK = 4096,          // テーブル拡張単位
+    FLOWHASH_SIZE = 1048573     // ハッシュテーブルサイズ (素数)
+};
+
+static flowInf_t*  gFlow = NULL;
+static long  gFlowCnt = 0;      // 使用中のフロー数
+static long  gFlowMax = 0;      // 確保済みのフロー数
+static com_hashId_t  gFlowHash = COM_HASHID_NOTREG;
+
+// 出力先ファイル名 (NULLなら集計しない)
+static char*  gFlowFile = NULL;
+
+BOOL anlz_setFlowFile( const char *iFile )
+{
+    com_free( gFlowFile );
+    if( !(gFlowFile = com_strdup( iFile, NULL )) ) {return false;}
+    if( gFlowHash == COM_HASHID_NOTREG ) {
+        gFlowHash = com_registerHash( FLOWHASH_SIZE, NULL );
+    }
+    return true;
+}
+
+static BOOL isTransport( long iType )
+{
+    return (iType == COM_SIG_TCP || iType == COM_SIG_UDP ||
+            iType == COM_SIG_SCTP);
+}
+
+// フラグメント断片はポート番号が取れないので対象外とする
+static com_sigInf_t *searchTransport( com_sigInf_t *iHead )
+{
+    while( iHead ) {
+        long  ptype = com_getSigType( iHead );
+        if( isTransport( ptype ) ) {return iHead;}
+        if( ptype == COM_SIG_FRAGMENT || !iHead->next.cnt ) {break;}
+        iHead = iHead->next.stack;
+    }
+    return NULL;
+}
+
+static BOOL isReverseNode( com_nodeInf_t *iNode )
+{
+    int  diff = memcmp( iNode->srcAddr, iNode->dstAddr, COM_NODEADDR_SIZE );
+    if( !diff ) {
+        diff = memcmp( iNode->srcPort, iNode->dstPort, COM_NODEPORT_SIZE );
+    }
+    return (diff > 0);
+}
+
+static BOOL makeFlowKey(
+        flowKey_t *oKey, com_sigInf_t *iTrans, BOOL *oReverse )
+{
+    memset( oKey, 0, sizeof(*oKey) );
+    if( !com_getNodeInf( iTrans, &oKey->node ) ) {return false;}
+    oKey->l4type = iTrans->sig.ptype;
+    *oReverse = isReverseNode( &oKey->node );
+    if( *oReverse ) {com_reverseNodeInf( &oKey->node );}
+    return true;
+}
+
+static flowInf_t *addFlow( const flowKey_t *iKey, BOOL iReverse )
+{
+    if( gFlowCnt == gFlowMax ) {
+        if( !com_realloct( &gFlow, sizeof(*gFlow), &gFlowMax, FLOW_BLOCK,
+                           "flow table(%ld)", gFlowMax ) ) {return NULL;}
+    }
+    long  idx = gFlowCnt;
+    if( COM_HASH_OK != com_addHash( gFlowHash, false, iKey, sizeof(*iKey),
+                                    &idx, sizeof(idx) ) ) {return NULL;}
+    flowInf_t*  flow = &(gFlow[gFlowCnt++]);
+    *flow = (flowInf_t){ .key = *iKey, .reverse = iReverse };
+    (void)com_getSignalTime( &flow->first );
+    return flow;
+}
+
+static flowInf_t *getFlow( const flowKey_t *iKey, BOOL iReverse )
+{
+    const void*  data = NULL;
+    if( com_searchHash( gFlowHash, iKey, sizeof(*iKey), &data, NULL ) ) {
+        return &(gFlow[*(const long*)data]);
+    }
+    return addFlow( iKey, iReverse );
+}
+
+// TCPシーケンス番号の前後判定 (32bitの周回を考慮する)
+static BOOL isSeqBefore( ulong iSeq1, ulong iSeq2 )
+{
+    return ((int32_t)(uint32_t)(iSeq1 - iSeq2) < 0);
+}
+
+static void checkRetrans( flowDir_t *ioDir, ulong iSeq, ulong iSegLen )
+{
+    if( !iSegLen ) {return;}
+    ulong  seqEnd = (iSeq + iSegLen) & UINT32_MAX;
+    if( ioDir->seqValid ) {
+        // 既に送信済みの範囲で終わるセグメントは再送とみなす
+        if( !isSeqBefore( ioDir->nextSeq, seqEnd ) ) {
+            ioDir->retrans++;
+            return;
+        }
+    }
+    ioDir->nextSeq = seqEnd;
+    ioDir->seqValid = true;
+}
+
+static void checkHandshake(
+        flowInf_t *ioFlow, long iDir, struct tcphdr *tcp,
+        const struct timeval *iTime )
+{
+    long*  hs = &ioFlow->handshake;
+    if( COM_IS_TCP_SYN && !COM_IS_TCP_ACK ) {
+        if( iDir == 0 ) {*hs = FLOW_HS_SYN;  ioFlow->synTime = *iTime;}
+        return;
+    }
+    if( COM_IS_TCP_SYN && COM_IS_TCP_ACK ) {
+        if( *hs == FLOW_HS_SYN && iDir == 1 ) {*hs = FLOW_HS_SYNACK;}
+        return;
+    }
+    if( *hs == FLOW_HS_SYNACK && iDir == 0 && COM_IS_TCP_ACK ) {
+        timersub( iTime, &ioFlow->synTime, &ioFlow->rtt );
+        *hs = FLOW_HS_DONE;
+    }
+}
+
+static void countTcp(
+        flowInf_t *ioFlow, long iDir, com_sigInf_t *iTrans,
+        const struct timeval *iTime )
+{
+    COM_CAST_HEAD( struct tcphdr, tcp, iTrans->sig.top );
+    ulong  segLen = 0;
+    if( iTrans->next.cnt ) {segLen = iTrans->next.stack[0].sig.len;}
+    if( COM_IS_TCP_SYN ) {segLen++;}
+    if( COM_IS_TCP_FIN ) {segLen++;}
+    ulong  seq = com_getVal32( tcp->th_seq, iTrans->order );
+    checkRetrans( &ioFlow->dir[iDir], seq, segLen );
+    checkHandshake( ioFlow, iDir, tcp, iTime );
+}
+
+void anlz_countFlow( com_sigInf_t *iSignal, com_off iFrameLen )
+{
+    if( !gFlowFile ) {return;}
+    com_sigInf_t*  trans = searchTransport( iSignal );
+    if( !trans ) {return;}
+    flowKey_t  key;
+    BOOL  reverse = false;
+    if( !makeFlowKey( &key, trans, &reverse ) ) {return;}
+    flowInf_t*  flow = getFlow( &key, reverse );
+    if( !flow ) {return;}
+    long  dir = (reverse != flow->reverse);
+    struct timeval  now = {0};
+    (void)com_getSignalTime( &now );
+    flow->last = now;
+    flow->dir[dir].packets++;
+    flow->dir[dir].bytes += iFrameLen;
+    if( key.l4type == COM_SIG_TCP ) {countTcp( flow, dir, trans, &now );}
+}
+
+///// フロー一覧出力 /////
+
+enum { FLOW_ADDR_SIZE = 48 };   // INET6_ADDRSTRLEN以上で 8の倍数
+
+// 送信元側(.dir[0]の送信元)と送信先側のアドレス/ポート番号を文字列化する
+typedef struct {
+    char   srcAddr[FLOW_ADDR_SIZE];
+    char   dstAddr[FLOW_ADDR_SIZE];
+    ulong  srcPort;
+    ulong  dstPort;
+} flowText_t;
+
+static void setAddrText( char *oText, long iType, const com_bin *iAddr )
+{
+    int  af = (iType == COM_SIG_IPV6) ? AF_INET6 : AF_INET;
+    if( !inet_ntop( af, iAddr, oText, FLOW_ADDR_SIZE ) ) {*oText = '\0';}
+}
+
+static ulong getPortValue( const com_bin *iPort )
+{
+    uint16_t  port;
+    memcpy( &port, iPort, sizeof(port) );
+    return com_getVal16( port, true );
+}
+
+static void setFlowText( flowText_t *oText, const flowInf_t *iFlow )
+{
+    com_nodeInf_t  node = iFlow->key.node;
+    if( iFlow->reverse ) {com_reverseNodeInf( &node );}
+    setAddrText( oText->srcAddr, node.ptype, node.srcAddr );
+    setAddrText( oText->dstAddr, node.ptype, node.dstAddr );
+    oText->srcPort = getPortValue( node.srcPort );
+    oText->dstPort = getPortValue( node.dstPort );
+}
+
+static const char *getL4Label( long iType )
+{
+    const char*  label = com_searchSigProtocol( iType );
+    if( !label ) {return "";}
+    return label;
+}
+
+#define TIMEVAL( TV )  (long)(TV).tv_sec, (long)(TV).tv_usec
+
+// RTTが算出できていない場合は iNoneの文字列を出力する
+static void writeRtt( FILE *iFp, const flowInf_t *iFlow, const char *iNone )
+{
+    if( iFlow->handshake != FLOW_HS_DONE ) {
+        fprintf( iFp, "%s", iNone );
+        return;
+    }
+    fprintf( iFp, "%.3f", (double)iFlow->rtt.tv_sec * 1000.0 +
+                          (double)iFlow->rtt.tv_usec / 1000.0 );
+}
+
+static void writeFlowCsv( FILE *iFp )
+{
+    fprintf( iFp, "proto,srcAddr,srcPort,dstAddr,dstPort,first,last,"
+                  "packetsSrcToDst,bytesSrcToDst,packetsDstToSrc,"
+                  "bytesDstToSrc,handshakeRttMsec,"
+                  "retransSrcToDst,retransDstToSrc\n" );
+    for( long i = 0;  i < gFlowCnt;  i++ ) {
+        const flowInf_t*  flow = &(gFlow[i]);
+        flowText_t  txt;
+        setFlowText( &txt, flow );
+        fprintf( iFp, "%s,%s,%lu,%s,%lu,%ld.%06ld,%ld.%06ld,"
+                      "%lu,%lu,%lu,%lu,",
+                 getL4Label( flow->key.l4type ),
+                 txt.srcAddr, txt.srcPort, txt.dstAddr, txt.dstPort,
+                 TIMEVAL( flow->first ), TIMEVAL( flow->last ),
+                 flow->dir[0].packets, flow->dir[0].bytes,
+                 flow->dir[1].packets, flow->dir[1].bytes );
+        writeRtt( iFp, flow, "" );
+        fprintf( iFp, ",%lu,%lu\n",
+                 flow->dir[0].retrans, flow->dir[1].retrans );
+    }
+}
+
+static void writeFlowJson( FILE *iFp )
+{
+    fprintf( iFp, "[\n" );
+    for( long i = 0;  i < gFlowCnt;  i++ ) {
+        const flowInf_t*  flow = &(gFlow[i]);
+        flowText_t  txt;
+        setFlowText( &txt, flow );
+        fprintf( iFp, "  {\"proto\":\"%s\","
+                      "\"src\":{\"addr\":\"%s\",\"port\":%lu},"
+                      "\"dst\":{\"addr\":\"%s\",\"port\":%lu},"
+                      "\"first\":%ld.%06ld,\"last\":%ld.%06ld,"
+                      "\"srcToDst\":{\"packets\":%lu,\"bytes\":%lu,"
+                      "\"retrans\":%lu},"
+                      "\"dstToSrc\":{\"packets\":%lu,\"bytes\":%lu,"
+                      "\"retrans\":%lu},"
+                      "\"handshakeRttMsec\":",
+                 getL4Label( flow->key.l4type ),
+                 txt.srcAddr, txt.srcPort, txt.dstAddr, txt.dstPort,
+                 TIMEVAL( flow->first ), TIMEVAL( flow->last ),
+                 flow->dir[0].packets, flow->dir[0].bytes,
+                 flow->dir[0].retrans,
+                 flow->dir[1].packets, flow->dir[1].bytes,
+                 flow->dir[1].retrans );
+        writeRtt( iFp, flow, "null" );
+        fprintf( iFp, "}%s\n", (i + 1 < gFlowCnt) ? "," : "" );
+    }
+    fprintf( iFp, "]\n" );
+}
+
+static BOOL isJsonFile( const char *iFile )
+{
+    const char*  ext = strrchr( iFile, '.' );
+    if( !ext ) {return false;}
+    return !strcasecmp( ext, ".json" );
+}
+
+static void freeFlow( void )
+{
+    com_free( gFlow );
+    gFlowCnt = gFlowMax = 0;
+    if( gFlowHash != COM_HASHID_NOTREG ) {com_cancelHash( gFlowHash );}
+    gFlowHash = COM_HASHID_NOTREG;
+    com_free( gFlowFile );
+}
+
+void anlz_exportFlow( void )
+{
+    if( !gFlowFile ) {return;}
+    FILE*  fp = com_fopen( gFlowFile, "w" );
+    if( fp ) {
+        if( isJsonFile( gFlowFile ) ) {writeFlowJson( fp );}
+        else {writeFlowCsv( fp );}
+        (void)com_fclose( fp );
+        com_printf( "--- %ld flows exported to %s ---\n",
+                    gFlowCnt, gFlowFile );
+    }
+    freeFlow();
+}
+
@@ -8,6 +8,7 @@
 
 #include <assert.h>
 #include "anlz_if.h"
+#include "anlz_com.h"
 
 #ifdef ANLZ_DECODE
 static BOOL  gDecode = true;
@@ -21,6 +22,12 @@ static long  gSetProto = COM_SIG_UNKNOWN;
 // 起動オプションのフィルタリング指定
 static long  gPickProto = COM_SIG_UNKNOWN;
 
+// 起動オプションの統計モード指定
+static BOOL  gStatMode = false;
+
+// 起動オプションのデコード出力ファイル指定
+static BOOL  gDecodeOut = false;
+
 // フィルタリング対象チェック
 static BOOL isPickupStack( com_sigInf_t *iSignal )
 {
@@ -32,14 +39,33 @@ static BOOL isPickupStack( com_sigInf_t *iSignal )
 static long  gFrameNo = 0;    // 現在のフレーム番号
 static long  gJumpNo = 0;     // ジャンプ先フレーム番号
 
+// 統計モード/デコード出力ファイル指定時の解析 (画面へのデコード出力も
+// 入力待ちもしない。デコード出力ファイル指定時はそのファイルに出力する)
+static BOOL execStatistics( com_sigInf_t *ioSignal )
+{
+    com_off  frameLen = ioSignal->sig.len;
+    if( gSetProto ) {ioSignal->sig.ptype = gSetProto;}
+    BOOL  result = com_analyzeSignalToLast( ioSignal, gDecodeOut );
+    anlz_countFlow( ioSignal, frameLen );
+    anlz_countTrack( ioSignal );
+    if( gStatMode && isPickupStack( ioSignal ) ) {
+        anlz_countStat( ioSignal, frameLen, result );
+    }
+    return true;
+}
+
 // 信号データ読込後に呼ばれる共通の解析起点関数
 static BOOL execAnalyze( com_sigInf_t *ioSignal )
 {
+    if( gStatMode || gDecodeOut ) {return execStatistics( ioSignal );}
     com_printf( "Frame:%5ld\n", ++gFrameNo );
+    com_off  frameLen = ioSignal->sig.len;
     if( gSetProto ) {ioSignal->sig.ptype = gSetProto;}
     if( !com_analyzeSignalToLast( ioSignal, gDecode ) ) {
         com_printf( "<< fail to analyze >>\n" );
     }
+    anlz_countFlow( ioSignal, frameLen );
+    anlz_countTrack( ioSignal );
     if( (gJumpNo > gFrameNo) || (!isPickupStack( ioSignal )) ) {return true;}
     char*  frame = NULL;
     if( com_input( &frame, NULL, &(com_actFlag_t){false, true},
@@ -137,6 +163,45 @@ static BOOL setFilter( com_getOptInf_t *iOptInf )
     return setProtoConfig( iOptInf->argv[0], &gPickProto, "pickup" );
 }
 
+static BOOL setStatMode( com_getOptInf_t *iOptInf )
+{
+    COM_UNUSED( iOptInf );
+    gStatMode = true;
+    return true;
+}
+
+static BOOL setFlowFile( com_getOptInf_t *iOptInf )
+{
+    return anlz_setFlowFile( iOptInf->argv[0] );
+}
+
+static BOOL setDecodeOut( com_getOptInf_t *iOptInf )
+{
+    char*  path = iOptInf->argv[0];
+    char*  ext = strrchr( path, '.' );
+    COM_DECSINK_t  type = COM_DECSINK_CSV;
+    if( ext && !strcasecmp( ext, ".json" ) ) {type = COM_DECSINK_JSON;}
+    gDecodeOut = com_openDecodeSink( type, path );
+    return gDecodeOut;
+}
+
+static BOOL setTrack( com_getOptInf_t *iOptInf )
+{
+    return anlz_useTrack( iOptInf->argv[0] );
+}
+
+static BOOL  gAllocProf = false;
+
+static BOOL setAllocProf( com_getOptInf_t *iOptInf )
+{
+    COM_UNUSED( iOptInf );
+    char  path[COM_WORDBUF_SIZE];
+    snprintf( path, sizeof(path), ".%s.allocprof", com_getAplName() );
+    if( !com_setAllocProfile( true ) ) {return false;}
+    gAllocProf = true;
+    return com_setAllocProfileSignal( SIGUSR1, path );
+}
+
 static BOOL addPrtclPort( ulong iPort, char *iPrtcl, long iType )
 {
     long  nextType = getProtoCode( iPrtcl );
@@ -179,6 +244,42 @@ static char  gHelpOption[] =
     "      指定プロトコルのスタックがあるときのみ停止する。\n"
     "      プロトコル名に指定する文字列は前述した。\n"
     "\n"
+    "    --stat\n"
+    "    -s\n"
+    "      統計モードで動作する。デコード出力と入力待ちは一切行わず、\n"
+    "      全フレームを解析してプロトコル階層ごとのフレーム数・バイト数と\n"
+    "      スループットをファイルごとに最後にまとめて表示する。\n"
+    "      --filter 指定時は、そのプロトコルを含むフレームのみ集計する。\n"
+    "\n"
+    "    --flow (出力ファイル名)\n"
+    "      会話(フロー)ごとの集計結果を指定ファイルに出力する。\n"
+    "      TCP/UDP/SCTPの 5-tuple ごとに 最初/最後の時刻、方向別の\n"
+    "      パケット数/バイト数、TCPハンドシェイクRTT、TCP再送数を出す。\n"
+    "      ファイル名の拡張子が .json なら JSON、それ以外は CSVで出力する。\n"
+    "\n"
+    "    --decodeout (出力ファイル名)\n"
+    "      全フレームのデコード結果を指定ファイルに出力する。画面への\n"
+    "      デコード出力と入力待ちはしない。ファイル名の拡張子が .json なら\n"
+    "      1フレーム 1行の JSON、それ以外は 1項目 1行の CSVで出力する。\n"
+    "\n"
+    "    --track (プロトコル名)\n"
+    "      要求と応答を対応付けて、応答時間の分布などをファイルごとに\n"
+    "      最後に表示する。複数のプロトコルを指定する時は、\n"
+    "      このオプションを繰り返し記述する。現在対応しているのは\n"
+    "        sip      : トランザクション(Call-ID+CSeq)とダイアログ(Call-ID)\n"
+    "        diameter : Hop-by-Hop ID+End-to-End ID+ノード情報\n"
+    "                   Command-Code/Application-IDごとに集計する\n"
+    "        dns      : ID+クライアントアドレス/ポート+QTYPE+QNAME\n"
+    "                   サーバーごとに集計する\n"
+    "        rtp      : SSRC+5-tuple ごとに 損失/重複/順序逆転/ジッタ\n"
+    "                   (RFC3550)/到着間隔 を集計する\n"
+    "        tcap     : OTID/DTID+SCCPアドレスで Begin～End/Abortを対応付け\n"
+    "                   INAP/GSM MAPのオペコードごとに応答時間を集計する\n"
+    "\n"
+    "    --allocprof\n"
+    "      メモリ捕捉を呼び元ごとに集計し、終了時に表示する。実行中でも\n"
+    "      SIGUSR1を送ると .Analyzer.allocprof にその時点の集計を追記する。\n"
+    "\n"
     "    -ipport (ポート番号) (プロトコル名)\n"
     "      UDP/TCP/SCTPのポート番号とプロトコルの対応を指定する。\n"
     "      SCTPのポート番号は、SCTPの次プロトコル値が 0 のときのみ見る。\n"
@@ -249,6 +350,11 @@ static com_getOpt_t  gAnlzOpts[] = {
     { 'c', "clearlog", 0, 0,            false, clearLogs },
     { 'p', "proto",    1, 0,            false, setProto },
     { 'f', "filter",   1, 0,            false, setFilter },
+    { 's', "stat",     0, 0,            false, setStatMode },
+    {   0, "flow",     1, 0,            false, setFlowFile },
+    {   0, "decodeout", 1, 0,           false, setDecodeOut },
+    {   0, "track",    1, 0,            false, setTrack },
+    {   0, "allocprof", 0, 0,           false, setAllocProf },
     { 'h', "help",     0, 0,            false, showHelp },
     {   0, "ipport",   2, COM_IPPORT,   false, addPort },
     {   0, "sctpnext", 2, COM_SCTPNEXT, false, addPort },
@@ -270,6 +376,8 @@ static char  gPasteBuff[COM_DATABUF_SIZE];
 static void directMode( void )
 {
     gJumpNo = LONG_MAX;
+    if( gStatMode ) {anlz_startStat();}
+    anlz_startTrack();
     while(1) {
         size_t  inRet = com_inputMultiLine( gPasteBuff, sizeof(gPasteBuff),
                                        "<<paste signal data directly>>\n" );
@@ -284,8 +392,10 @@ static void directMode( void )
         com_makeSigInf( &data, result, length );
         execAnalyze( &data );
         com_freeSigInf( &data, true );
-        com_printLf();
+        if( !gStatMode ) {com_printLf();}
     }
+    if( gStatMode ) {anlz_printStat();}
+    anlz_endTrack();
 }
 
 // 解析起点関数
@@ -297,9 +407,16 @@ void anlz_start( int iArgc, char **iArgv )
         com_printLf();
         com_printTag( "-", 79, COM_PTAG_LEFT, "%s", gFileList[i] );
         com_printLf();
+        if( gStatMode ) {anlz_startStat();}
+        anlz_startTrack();
         if( !strstr( gFileList[i], ".log" ) ) {readCapFile( gFileList[i] );}
         else {readCapLog( gFileList[i] );}
+        if( gStatMode ) {anlz_printStat();}
+        anlz_endTrack();
     }
+    anlz_exportFlow();
+    com_closeDecodeSink();
+    if( gAllocProf ) {com_dumpAllocProfile( NULL );}
 }
 
 #ifndef ANLZ_DEBUG
@@ -324,5 +441,7 @@ void anlz_initialize( void )
     com_hookError( skipAnalyzeError );
 #endif
     (void)addPrtclPort( 5070, "SIP", COM_IPPORT );
+    // デコード出力は大量になるので、1行ごとに書き込まないようにする
+    com_setBufferedOutput( true, 0, 0 );
 }
 
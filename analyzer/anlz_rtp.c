@@ -0,0 +1,310 @@
+/*
+ *****************************************************************************
+ *
+ * 簡易信号アナライザー Analyzer RTP品質分析モジュールソース
+ *
+ *****************************************************************************
+ */
+
+#include <arpa/inet.h>
+#include "anlz_if.h"
+#include "anlz_com.h"
+
+// ストリームは (SSRC, 5-tuple) ごとに集計し、ファイル終了時に一覧表示する。
+// RTPはパケットの大半を占めるので、1パケットあたりの処理はハッシュ検索と
+// 固定サイズの状態更新だけとし、メモリ捕捉は新しいストリームの時のみ行う。
+//
+// シーケンス番号は RFC3550 Appendix A.1 と同様に周回を数えて拡張し、
+// 期待数と受信数の差を損失とする。最大シーケンス番号から遡った
+// RTP_SEQ_WINDOW個分は受信済みビットマップを持ち、遅れて届いたものが
+// 重複か順序逆転かを判定する。
+// ジッタは RFC3550 6.4.1 の推定式 J += (|D| - J) / 16 で計算する。
+
+enum {
+    RTP_MAX_DROPOUT = 3000,       // これ以内の前進は正常とみなす
+    RTP_MAX_MISORDER = 100,       // これ以内の後退は順序逆転とみなす
+    RTP_SEQ_MOD = 65536,
+    RTP_SEQ_WINDOW = 128,         // 受信済みビットマップのサイズ
+    RTP_DEFAULT_CLOCK = 8000,     // クロックレート不明時の仮定値
+    RTP_STREAM_BLOCK = 256,       // ストリームテーブル拡張単位
+    RTPHASH_SIZE = 65521          // ハッシュテーブルサイズ (素数)
+};
+
+#define RTP_WINDOW_BITS  (sizeof(ulong) * CHAR_BIT)
+#define RTP_WINDOW_CNT   (RTP_SEQ_WINDOW / RTP_WINDOW_BITS)
+
+// 静的ペイロードタイプのクロックレート (RFC3551)
+typedef struct {
+    ulong   pt;
+    ulong   clock;
+} rtpClock_t;
+
+static rtpClock_t  gRtpClock[] = {
+    {  0,  8000 }, {  3,  8000 }, {  4,  8000 }, {  5,  8000 },
+    {  6, 16000 }, {  7,  8000 }, {  8,  8000 }, {  9,  8000 },
+    { 10, 44100 }, { 11, 44100 }, { 12,  8000 }, { 13,  8000 },
+    { 14, 90000 }, { 15,  8000 }, { 16, 11025 }, { 17, 22050 },
+    { 18,  8000 }, { 25, 90000 }, { 26, 90000 }, { 28, 90000 },
+    { 31, 90000 }, { 32, 90000 }, { 33, 90000 }, { 34, 90000 },
+    { 0, 0 }  // 最後は必ずこれで
+};
+
+// ストリームのキー
+typedef struct {
+    com_nodeInf_t  node;
+    ulong          ssrc;
+} rtpKey_t;
+
+// ストリームごとの状態と集計
+typedef struct {
+    rtpKey_t        key;
+    ulong           pt;             // 最初のパケットのペイロードタイプ
+    ulong           clock;          // クロックレート
+    BOOL            clockKnown;     // クロックレートが既知かどうか
+    ulong           packets;        // 受信数 (重複含む)
+    ulong           dups;           // 重複数
+    ulong           reordered;      // 順序逆転数
+    ulong           jumps;          // シーケンス番号の飛び(再同期)数
+    ulong           baseSeq;        // 現在の同期区間の最初の番号
+    ulong           maxSeq;         // 最大シーケンス番号 (16bit)
+    ulong           cycles;         // 周回数 × RTP_SEQ_MOD
+    ulong           expectedPrior;  // 再同期前の区間での期待数
+    ulong           window[RTP_WINDOW_CNT];   // 受信済みビットマップ
+    ulong           prevTs;         // 直前パケットの RTPタイムスタンプ
+    struct timeval  prevArrival;    // 直前パケットの到着時刻
+    double          jitter;         // ジッタ (タイムスタンプ単位)
+    double          maxJitter;      // ジッタの最大値
+    anlz_hist_t     interArrival;   // 到着間隔
+} rtpStream_t;
+
+static rtpStream_t*  gRtpStream = NULL;
+static long  gRtpStreamCnt = 0;     // 使用中のストリーム数
+static long  gRtpStreamMax = 0;     // 確保済みのストリーム数
+static com_hashId_t  gRtpHash = COM_HASHID_NOTREG;
+
+void anlz_startRtp( void )
+{
+    com_free( gRtpStream );
+    gRtpStreamCnt = gRtpStreamMax = 0;
+    gRtpHash = com_registerHash( RTPHASH_SIZE, NULL );
+}
+
+static void setClock( rtpStream_t *ioStream )
+{
+    ioStream->clock = RTP_DEFAULT_CLOCK;
+    for( rtpClock_t* tmp = gRtpClock;  tmp->clock;  tmp++ ) {
+        if( tmp->pt == ioStream->pt ) {
+            ioStream->clock = tmp->clock;
+            ioStream->clockKnown = true;
+            break;
+        }
+    }
+}
+
+static rtpStream_t *addRtpStream(
+        const rtpKey_t *iKey, const com_sigRtpHdr_t *iRtp )
+{
+    if( gRtpStreamCnt == gRtpStreamMax ) {
+        if( !com_realloct( &gRtpStream, sizeof(*gRtpStream), &gRtpStreamMax,
+                           RTP_STREAM_BLOCK, "rtp stream(%ld)",
+                           gRtpStreamMax ) ) {return NULL;}
+    }
+    long  idx = gRtpStreamCnt;
+    if( COM_HASH_OK != com_addHash( gRtpHash, false, iKey, sizeof(*iKey),
+                                    &idx, sizeof(idx) ) ) {return NULL;}
+    rtpStream_t*  stream = &(gRtpStream[gRtpStreamCnt++]);
+    ulong  seq = com_getVal16( iRtp->seq, true );
+    *stream = (rtpStream_t){
+        .key = *iKey,
+        .pt = iRtp->pt & COM_CAP_RTP_PTBIT,
+        .baseSeq = seq, .maxSeq = seq, .window = { 1 }
+    };
+    setClock( stream );
+    return stream;
+}
+
+static rtpStream_t *getRtpStream( com_sigInf_t *iRtp )
+{
+    const com_sigRtpHdr_t*  rtp = (com_sigRtpHdr_t*)iRtp->sig.top;
+    rtpKey_t  key;
+    memset( &key, 0, sizeof(key) );
+    if( !com_getNodeInf( iRtp, &key.node ) ) {return NULL;}
+    key.ssrc = com_getVal32( rtp->ssrc, true );
+    const void*  data = NULL;
+    if( com_searchHash( gRtpHash, &key, sizeof(key), &data, NULL ) ) {
+        return &(gRtpStream[*(const long*)data]);
+    }
+    return addRtpStream( &key, rtp );
+}
+
+static void shiftWindow( rtpStream_t *ioStream, ulong iShift )
+{
+    ulong*  win = ioStream->window;
+    if( iShift >= RTP_SEQ_WINDOW ) {
+        memset( win, 0, sizeof(ioStream->window) );
+    }
+    else {
+        ulong  words = iShift / RTP_WINDOW_BITS;
+        ulong  bits = iShift % RTP_WINDOW_BITS;
+        for( long i = RTP_WINDOW_CNT - 1;  i >= 0;  i-- ) {
+            ulong  src = (ulong)i - words;
+            ulong  val = 0;
+            if( (ulong)i >= words ) {
+                val = win[src] << bits;
+                if( bits && src > 0 ) {
+                    val |= win[src - 1] >> (RTP_WINDOW_BITS - bits);
+                }
+            }
+            win[i] = val;
+        }
+    }
+    win[0] |= 1;
+}
+
+// 最大番号から iBack遡った番号の受信済みビットを立て、元から立っていたか返す
+static BOOL markWindow( rtpStream_t *ioStream, ulong iBack )
+{
+    ulong*  word = &(ioStream->window[iBack / RTP_WINDOW_BITS]);
+    ulong  bit = 1UL << (iBack % RTP_WINDOW_BITS);
+    BOOL  marked = COM_CHECKBIT( *word, bit );
+    *word |= bit;
+    return marked;
+}
+
+// シーケンス番号の更新 (重複なら falseを返す)
+static BOOL updateSeq( rtpStream_t *ioStream, ulong iSeq )
+{
+    ulong  delta = (iSeq - ioStream->maxSeq) % RTP_SEQ_MOD;
+    if( delta == 0 ) {ioStream->dups++;  return false;}
+    if( delta < RTP_MAX_DROPOUT ) {
+        if( iSeq < ioStream->maxSeq ) {ioStream->cycles += RTP_SEQ_MOD;}
+        ioStream->maxSeq = iSeq;
+        shiftWindow( ioStream, delta );
+        return true;
+    }
+    if( delta <= RTP_SEQ_MOD - RTP_MAX_MISORDER ) {
+        // 大きな飛びは送信元の再起動等とみなし、ここから数え直す
+        ioStream->jumps++;
+        ioStream->expectedPrior += ioStream->cycles + ioStream->maxSeq
+                                   - ioStream->baseSeq + 1;
+        ioStream->baseSeq = ioStream->maxSeq = iSeq;
+        ioStream->cycles = 0;
+        shiftWindow( ioStream, RTP_SEQ_WINDOW );
+        return true;
+    }
+    ulong  back = RTP_SEQ_MOD - delta;
+    if( back < RTP_SEQ_WINDOW && markWindow( ioStream, back ) ) {
+        ioStream->dups++;
+        return false;
+    }
+    ioStream->reordered++;
+    return true;
+}
+
+static double toSec( const struct timeval *iTime )
+{
+    return (double)iTime->tv_sec + (double)iTime->tv_usec / 1000000.0;
+}
+
+static double toMsec( ulong iUsec )
+{
+    return (double)iUsec / 1000.0;
+}
+
+static void updateTiming( rtpStream_t *ioStream, ulong iTs )
+{
+    struct timeval  now;
+    if( !com_getSignalTime( &now ) ) {return;}
+    if( ioStream->prevArrival.tv_sec || ioStream->prevArrival.tv_usec ) {
+        struct timeval  gap;
+        timersub( &now, &ioStream->prevArrival, &gap );
+        anlz_addHist( &ioStream->interArrival, &gap );
+        // 到着間隔とタイムスタンプ間隔の差 (タイムスタンプ単位)
+        double  arrival = toSec( &gap ) * (double)ioStream->clock;
+        int32_t  tsGap = (int32_t)(uint32_t)(iTs - ioStream->prevTs);
+        double  d = arrival - (double)tsGap;
+        if( d < 0 ) {d = -d;}
+        ioStream->jitter += (d - ioStream->jitter) / 16.0;
+        if( ioStream->jitter > ioStream->maxJitter ) {
+            ioStream->maxJitter = ioStream->jitter;
+        }
+    }
+    ioStream->prevArrival = now;
+    ioStream->prevTs = iTs;
+}
+
+static void trackRtp( com_sigInf_t *iRtp )
+{
+    rtpStream_t*  stream = getRtpStream( iRtp );
+    if( !stream ) {return;}
+    const com_sigRtpHdr_t*  rtp = (com_sigRtpHdr_t*)iRtp->sig.top;
+    // 最初のパケットは addRtpStream()でシーケンス番号を設定済み
+    if( stream->packets++ ) {
+        if( !updateSeq( stream, com_getVal16( rtp->seq, true ) ) ) {return;}
+    }
+    updateTiming( stream, com_getVal32( rtp->ts, true ) );
+}
+
+void anlz_trackRtp( com_sigInf_t *iSignal )
+{
+    anlz_seekStack( iSignal, COM_SIG_RTP, trackRtp );
+}
+
+static void setNodeText(
+        char *oText, size_t iSize, long iType,
+        const com_bin *iAddr, const com_bin *iPort )
+{
+    char  addr[INET6_ADDRSTRLEN];
+    int  af = (iType == COM_SIG_IPV6) ? AF_INET6 : AF_INET;
+    if( !inet_ntop( af, iAddr, addr, sizeof(addr) ) ) {*addr = '\0';}
+    uint16_t  port;
+    memcpy( &port, iPort, sizeof(port) );
+    snprintf( oText, iSize, "%s:%u", addr, com_getVal16( port, true ) );
+}
+
+#define MSEC( TS, CLOCK )  ((TS) * 1000.0 / (double)(CLOCK))
+
+static void printRtpStream( const rtpStream_t *iStream )
+{
+    const com_nodeInf_t*  node = &(iStream->key.node);
+    char  src[COM_WORDBUF_SIZE];
+    char  dst[COM_WORDBUF_SIZE];
+    setNodeText( src, sizeof(src), node->ptype, node->srcAddr, node->srcPort );
+    setNodeText( dst, sizeof(dst), node->ptype, node->dstAddr, node->dstPort );
+    com_printf( "  %s -> %s  SSRC=0x%08lx PT=%lu (%lu Hz%s)\n",
+                src, dst, iStream->key.ssrc, iStream->pt, iStream->clock,
+                iStream->clockKnown ? "" : " assumed" );
+    ulong  expected = iStream->expectedPrior + iStream->cycles
+                      + iStream->maxSeq - iStream->baseSeq + 1;
+    long  lost = (long)expected - (long)(iStream->packets - iStream->dups);
+    com_printf( "    packets=%lu expected=%lu lost=%ld (%.2f%%) dup=%lu "
+                "reordered=%lu seq-jump=%lu\n",
+                iStream->packets, expected, lost,
+                expected ? (double)lost * 100.0 / (double)expected : 0.0,
+                iStream->dups, iStream->reordered, iStream->jumps );
+    const anlz_hist_t*  iat = &(iStream->interArrival);
+    if( !iat->count ) {return;}
+    com_printf( "    jitter=%.3f max=%.3f  inter-arrival avg=%.3f "
+                "p50=%.3f p99=%.3f max=%.3f (ms)\n",
+                MSEC( iStream->jitter, iStream->clock ),
+                MSEC( iStream->maxJitter, iStream->clock ),
+                toMsec( iat->sum / iat->count ),
+                toMsec( anlz_getHistPercentile( iat, 50 ) ),
+                toMsec( anlz_getHistPercentile( iat, 99 ) ),
+                toMsec( iat->max ) );
+}
+
+void anlz_reportRtp( void )
+{
+    com_printTag( "=", 79, COM_PTAG_LEFT, "RTP streams" );
+    for( long i = 0;  i < gRtpStreamCnt;  i++ ) {
+        printRtpStream( &gRtpStream[i] );
+    }
+    com_printf( "  streams=%ld\n", gRtpStreamCnt );
+    com_printLf();
+    com_free( gRtpStream );
+    gRtpStreamCnt = gRtpStreamMax = 0;
+    com_cancelHash( gRtpHash );
+    gRtpHash = COM_HASHID_NOTREG;
+}
+
@@ -0,0 +1,246 @@
+/*
+ *****************************************************************************
+ *
+ * 簡易信号アナライザー Analyzer SIP追跡モジュールソース
+ *
+ *****************************************************************************
+ */
+
+#include "anlz_if.h"
+#include "anlz_com.h"
+
+// トランザクションは Call-ID + CSeq(番号とメソッド) をキーにする。
+// ダイアログは Call-ID をキーにし、INVITEの 2xx応答で確立、BYEで終了とする。
+// どちらも件数上限とタイムアウトで破棄するため、長時間のキャプチャでも
+// メモリ使用量は上限内に収まる。
+
+enum {
+    SIP_TRANS_TIMEOUT = 32,           // トランザクションタイムアウト(秒)
+    SIP_TRANS_MAX = 65536,            // 保持する最大トランザクション数
+    SIP_DIALOG_TIMEOUT = 4 * 3600,    // ダイアログタイムアウト(秒)
+    SIP_DIALOG_MAX = 65536,           // 保持する最大ダイアログ数
+    SIP_STATUS_CLASS = 7              // ステータスコードの百の位(1～6)
+};
+
+// メソッドごとの集計
+typedef struct {
+    const char*   label;                       // メソッド名
+    ulong         requests;                    // 要求数 (再送を除く)
+    ulong         retrans;                     // 要求再送数
+    ulong         status[SIP_STATUS_CLASS];    // 最終応答数 (百の位ごと)
+    ulong         timeout;                     // 応答なしで破棄した数
+    anlz_hist_t   provisional;                 // INVITE→18x の時間
+    anlz_hist_t   final;                       // 要求→最終応答 の時間
+} sipMethod_t;
+
+static sipMethod_t  gSipMethod[COM_SIG_SIP_RESPONSE];
+
+// トランザクションで保持するデータ
+typedef struct {
+    long   method;      // メソッド (COM_SIG_SIP_NAME_t型の値)
+    BOOL   ringing;     // 18x応答を検出済みかどうか
+} sipTrans_t;
+
+// ダイアログ集計
+typedef struct {
+    ulong         established;     // 確立数
+    ulong         terminated;      // BYEで終了した数
+    ulong         timeout;         // 終了を見ずに破棄した数
+    anlz_hist_t   duration;        // 確立→BYE の時間
+} sipDialog_t;
+
+static sipDialog_t  gSipDialog;
+static ulong  gSipUnmatched = 0;   // 対応する要求が無かった応答数
+
+static anlz_trans_t  gSipTrans;
+static anlz_trans_t  gSipDlg;
+
+static void expireSipTrans( void *ioData, ANLZ_TREXP_t iCause )
+{
+    sipTrans_t*  trans = ioData;
+    if( iCause == ANLZ_TREXP_OVERFLOW ) {return;}
+    gSipMethod[trans->method].timeout++;
+}
+
+static void expireSipDialog( void *ioData, ANLZ_TREXP_t iCause )
+{
+    COM_UNUSED( ioData );
+    if( iCause == ANLZ_TREXP_OVERFLOW ) {return;}
+    gSipDialog.timeout++;
+}
+
+void anlz_startSip( void )
+{
+    memset( gSipMethod, 0, sizeof(gSipMethod) );
+    memset( &gSipDialog, 0, sizeof(gSipDialog) );
+    gSipUnmatched = 0;
+    anlz_initTrans( &gSipTrans, SIP_TRANS_TIMEOUT, SIP_TRANS_MAX,
+                    ANLZ_TRKEY_MAX, expireSipTrans );
+    anlz_initTrans( &gSipDlg, SIP_DIALOG_TIMEOUT, SIP_DIALOG_MAX,
+                    COM_LINEBUF_SIZE, expireSipDialog );
+}
+
+// SIP信号から追跡に必要な情報を取り出したもの
+typedef struct {
+    long   type;                       // メソッド種別 or ステータスコード
+    long   method;                     // CSeqのメソッド種別
+    char   callId[COM_LINEBUF_SIZE];   // Call-ID
+    char   cseq[COM_WORDBUF_SIZE];     // CSeq
+} sipInf_t;
+
+// Call-IDは短縮形(i)も見る
+static BOOL getCallId( com_sigPrm_t *iPrm, sipInf_t *oInf )
+{
+    char*  callId = com_getTxtHeaderVal( iPrm, COM_CAP_SIPHDR_CALLID );
+    if( !callId ) {callId = com_getTxtHeaderVal( iPrm, "i" );}
+    if( !callId ) {return false;}
+    (void)com_strcpy( oInf->callId, callId );
+    return true;
+}
+
+// CSeqの値 "番号 メソッド名" から メソッド種別を得る
+static BOOL getCSeq( com_sigPrm_t *iPrm, sipInf_t *oInf )
+{
+    char*  cseq = com_getTxtHeaderVal( iPrm, COM_CAP_SIPHDR_CSEQ );
+    if( !cseq ) {return false;}
+    (void)com_strcpy( oInf->cseq, cseq );
+    char*  method = strchr( cseq, ' ' );
+    if( !method ) {return false;}
+    // com_getSipName()はメソッド名の後に空白があることを期待している
+    char  tmp[COM_WORDBUF_SIZE];
+    snprintf( tmp, sizeof(tmp), "%s ", com_topString( method, false ) );
+    const char*  label = NULL;
+    if( !com_getSipName( tmp, &label, &oInf->method ) ) {return false;}
+    if( oInf->method >= COM_SIG_SIP_RESPONSE ) {return false;}
+    if( !gSipMethod[oInf->method].label ) {
+        gSipMethod[oInf->method].label = label;
+    }
+    return true;
+}
+
+static BOOL getSipInf( com_sigInf_t *iSip, sipInf_t *oInf )
+{
+    if( !com_getSipName( iSip->sig.top, NULL, &oInf->type ) ) {return false;}
+    if( !getCallId( &iSip->prm, oInf ) ) {return false;}
+    return getCSeq( &iSip->prm, oInf );
+}
+
+// トランザクションのキー (Call-ID + CSeq)
+static size_t makeTransKey( char *oKey, size_t iSize, const sipInf_t *iInf )
+{
+    return (size_t)snprintf( oKey, iSize, "%s|%s", iInf->callId, iInf->cseq );
+}
+
+static void procSipRequest( sipInf_t *iInf )
+{
+    if( iInf->type == COM_SIG_SIP_ACK ) {return;}  // ACKには応答がない
+    sipMethod_t*  method = &(gSipMethod[iInf->method]);
+    char  key[ANLZ_TRKEY_MAX];
+    size_t  keySize = makeTransKey( key, sizeof(key), iInf );
+    BOOL  exist = false;
+    sipTrans_t*  trans = anlz_addTrans( &gSipTrans, key, keySize, &exist );
+    if( !trans ) {return;}
+    if( exist ) {method->retrans++;  return;}
+    *trans = (sipTrans_t){ .method = iInf->method };
+    method->requests++;
+    if( iInf->method == COM_SIG_SIP_BYE ) {
+        struct timeval  duration;
+        if( anlz_searchTrans( &gSipDlg, iInf->callId, strlen(iInf->callId),
+                              &duration ) )
+        {
+            anlz_addHist( &gSipDialog.duration, &duration );
+            gSipDialog.terminated++;
+            anlz_deleteTrans( &gSipDlg, iInf->callId, strlen(iInf->callId) );
+        }
+    }
+}
+
+static void establishDialog( sipInf_t *iInf )
+{
+    BOOL  exist = false;
+    size_t  keySize = strlen( iInf->callId );
+    if( anlz_addTrans( &gSipDlg, iInf->callId, keySize, &exist ) ) {
+        if( !exist ) {gSipDialog.established++;}
+    }
+}
+
+enum {
+    SIP_RINGING_MIN = 180,
+    SIP_RINGING_MAX = 189,
+    SIP_FINAL_MIN = 200,
+    SIP_FINAL_MAX = 699
+};
+
+static void procSipResponse( sipInf_t *iInf )
+{
+    char  key[ANLZ_TRKEY_MAX];
+    size_t  keySize = makeTransKey( key, sizeof(key), iInf );
+    struct timeval  latency;
+    sipTrans_t*  trans = anlz_searchTrans( &gSipTrans, key, keySize, &latency );
+    if( !trans ) {gSipUnmatched++;  return;}
+    sipMethod_t*  method = &(gSipMethod[trans->method]);
+    long  code = iInf->type;
+    if( code >= SIP_RINGING_MIN && code <= SIP_RINGING_MAX ) {
+        if( trans->method == COM_SIG_SIP_INVITE && !trans->ringing ) {
+            anlz_addHist( &method->provisional, &latency );
+            trans->ringing = true;
+        }
+        return;
+    }
+    if( code < SIP_FINAL_MIN || code > SIP_FINAL_MAX ) {return;}
+    anlz_addHist( &method->final, &latency );
+    method->status[code / 100]++;
+    if( trans->method == COM_SIG_SIP_INVITE && code / 100 == 2 ) {
+        establishDialog( iInf );
+    }
+    anlz_deleteTrans( &gSipTrans, key, keySize );
+}
+
+static void trackSip( com_sigInf_t *iSip )
+{
+    sipInf_t  inf;
+    if( !getSipInf( iSip, &inf ) ) {return;}
+    if( inf.type < COM_SIG_SIP_RESPONSE ) {procSipRequest( &inf );}
+    else {procSipResponse( &inf );}
+}
+
+void anlz_trackSip( com_sigInf_t *iSignal )
+{
+    anlz_seekStack( iSignal, COM_SIG_SIP, trackSip );
+}
+
+static void printSipMethod( sipMethod_t *iMethod )
+{
+    com_printf( "  %s  requests=%lu retrans=%lu timeout=%lu  final:",
+                iMethod->label, iMethod->requests, iMethod->retrans,
+                iMethod->timeout );
+    for( long i = 2;  i < SIP_STATUS_CLASS;  i++ ) {
+        com_printf( " %ldxx=%lu", i, iMethod->status[i] );
+    }
+    com_printLf();
+    anlz_printHist( "request -> 18x", &iMethod->provisional );
+    anlz_printHist( "request -> final", &iMethod->final );
+}
+
+void anlz_reportSip( void )
+{
+    anlz_flushTrans( &gSipTrans );
+    anlz_flushTrans( &gSipDlg );
+    com_printTag( "=", 79, COM_PTAG_LEFT, "SIP transactions" );
+    for( long i = 0;  i < COM_SIG_SIP_RESPONSE;  i++ ) {
+        sipMethod_t*  method = &(gSipMethod[i]);
+        if( method->requests ) {printSipMethod( method );}
+    }
+    com_printf( "  unmatched responses=%lu  dropped transactions=%lu\n",
+                gSipUnmatched, gSipTrans.overflowCnt );
+    com_printTag( "=", 79, COM_PTAG_LEFT, "SIP dialogs" );
+    com_printf( "  established=%lu terminated=%lu not terminated=%lu "
+                "dropped=%lu\n",
+                gSipDialog.established, gSipDialog.terminated,
+                gSipDialog.timeout, gSipDlg.overflowCnt );
+    anlz_printHist( "established -> BYE", &gSipDialog.duration );
+    com_printLf();
+    anlz_freeTrans( &gSipTrans );
+    anlz_freeTrans( &gSipDlg );
+}
+
@@ -0,0 +1,194 @@
+/*
+ *****************************************************************************
+ *
+ * 簡易信号アナライザー Analyzer 統計モジュールソース
+ *
+ *****************************************************************************
+ */
+
+#include "anlz_if.h"
+#include "anlz_com.h"
+
+// プロトコル階層ノード
+//   同一フレーム内で同じ階層が複数出現しても(SCTPの複数チャンク等)
+//   1フレームとして数えるため、最後に数えたフレーム番号を保持する。
+typedef struct statNode {
+    long               ptype;      // プロトコル種別
+    long               lastFrame;  // 最後に集計したフレーム番号
+    ulong              packets;    // 出現フレーム数
+    ulong              bytes;      // 出現フレームのバイト数合計
+    long               childCnt;   // 次階層ノード数
+    long               childCapa;  // 次階層ノードの容量
+    struct statNode*   child;      // 次階層ノード
+} statNode_t;
+
+static statNode_t  gStatTop;      // 階層の起点 (フレームそのもの)
+static long  gStatFrame = 0;      // 集計したフレーム数
+static long  gStatNG = 0;         // 解析NGとなったフレーム数
+static ulong  gStatBytes = 0;     // 集計したバイト数
+
+// キャプチャ時刻 (最初と最後)
+static BOOL  gStatStamped = false;
+static struct timeval  gStatFirst;
+static struct timeval  gStatLast;
+
+// 処理時間計測
+static com_stopwatch_t  gStatWatch;
+static BOOL  gStatWatching = false;
+
+static void freeStatNode( statNode_t *oNode )
+{
+    for( long i = 0;  i < oNode->childCnt;  i++ ) {
+        freeStatNode( &(oNode->child[i]) );
+    }
+    com_free( oNode->child );
+    oNode->childCnt = oNode->childCapa = 0;
+}
+
+void anlz_startStat( void )
+{
+    freeStatNode( &gStatTop );
+    gStatTop = (statNode_t){ .ptype = COM_SIG_UNKNOWN };
+    gStatFrame = gStatNG = 0;
+    gStatBytes = 0;
+    gStatStamped = false;
+    gStatWatching = com_startStopwatch( &gStatWatch );
+}
+
+static statNode_t *getChildNode( statNode_t *ioNode, long iType )
+{
+    for( long i = 0;  i < ioNode->childCnt;  i++ ) {
+        if( ioNode->child[i].ptype == iType ) {return &(ioNode->child[i]);}
+    }
+    statNode_t*  child =
+        com_reallocAddrCap( &ioNode->child, sizeof(*child), COM_TABLEEND,
+                            &ioNode->childCnt, &ioNode->childCapa, 1,
+                            "statNode(%ld)", iType );
+    if( child ) {child->ptype = iType;}
+    return child;
+}
+
+static void countNode( statNode_t *ioNode, com_off iFrameLen )
+{
+    if( ioNode->lastFrame == gStatFrame ) {return;}
+    ioNode->lastFrame = gStatFrame;
+    ioNode->packets++;
+    ioNode->bytes += iFrameLen;
+}
+
+static void countStacks(
+        statNode_t *ioNode, com_sigStk_t *iStack, com_off iFrameLen )
+{
+    for( long i = 0;  i < iStack->cnt;  i++ ) {
+        com_sigInf_t*  target = &(iStack->stack[i]);
+        long  ptype = com_getSigType( target );
+        if( ptype == COM_SIG_END ) {continue;}
+        statNode_t*  node = getChildNode( ioNode, ptype );
+        if( !node ) {continue;}
+        countNode( node, iFrameLen );
+        if( target->next.cnt ) {countStacks( node, &target->next, iFrameLen );}
+    }
+}
+
+static void updateStamp( void )
+{
+    struct timeval  stamp;
+    if( !com_getSignalTime( &stamp ) ) {return;}
+    if( !gStatStamped ) {gStatFirst = stamp;  gStatStamped = true;}
+    gStatLast = stamp;
+}
+
+void anlz_countStat( com_sigInf_t *iSignal, com_off iFrameLen, BOOL iResult )
+{
+    gStatFrame++;
+    if( !iResult ) {gStatNG++;}
+    gStatBytes += iFrameLen;
+    updateStamp();
+    countNode( &gStatTop, iFrameLen );
+    countStacks( &gStatTop, &(com_sigStk_t){ 1, iSignal, 0 }, iFrameLen );
+}
+
+static const char *getStatLabel( long iType )
+{
+    if( iType == COM_SIG_CONTINUE ) {return "(unknown)";}
+    if( iType == COM_SIG_FRAGMENT ) {return "(fragment)";}
+    if( iType == COM_SIG_EXTENSION ) {return "(extension)";}
+    if( iType == COM_SIG_ALLZERO ) {return "(all zero)";}
+    const char*  label = com_searchSigProtocol( iType );
+    if( !label ) {return "(not supported)";}
+    return label;
+}
+
+enum {
+    STAT_INDENT = 2,       // 階層ごとのインデント
+    STAT_LABEL_WIDTH = 32  // プロトコル名の表示幅 (インデント込み)
+};
+
+static double calcRate( ulong iCount, ulong iTotal )
+{
+    if( !iTotal ) {return 0.0;}
+    return (double)iCount * 100.0 / (double)iTotal;
+}
+
+static void printStatNode( statNode_t *iNode, long iDepth )
+{
+    for( long i = 0;  i < iNode->childCnt;  i++ ) {
+        statNode_t*  node = &(iNode->child[i]);
+        int  indent = (int)(iDepth * STAT_INDENT);
+        com_printf( "%*s%-*s %10lu %6.2f%% %14lu %6.2f%%\n",
+                    indent, "", STAT_LABEL_WIDTH - indent,
+                    getStatLabel( node->ptype ),
+                    node->packets, calcRate( node->packets, gStatTop.packets ),
+                    node->bytes, calcRate( node->bytes, gStatTop.bytes ) );
+        printStatNode( node, iDepth + 1 );
+    }
+}
+
+static double getSecond( const struct timeval *iTime )
+{
+    return (double)iTime->tv_sec + (double)iTime->tv_usec / 1000000.0;
+}
+
+static void printThroughput( const char *iLabel, double iSecond )
+{
+    if( iSecond <= 0.0 ) {return;}
+    com_printf( "  %-10s %.6f sec  (%.1f pps, %.3f Mbps)\n", iLabel, iSecond,
+                (double)gStatFrame / iSecond,
+                (double)gStatBytes * 8.0 / iSecond / 1000000.0 );
+}
+
+static void printSctpStat( void )
+{
+    com_sigSctpStat_t  sctp;
+    com_getSctpStat( &sctp, true );
+    if( !sctp.dataChunks ) {return;}
+    com_printf( "  %-10s data=%lu fragments=%lu reassembled=%lu\n",
+                "sctp", sctp.dataChunks, sctp.fragments, sctp.reassembled );
+    com_printf( "  %-10s retransmitted TSN=%lu duplicate TSN(SACK)=%lu "
+                "untracked=%lu\n",
+                "", sctp.retransTsn, sctp.dupTsn, sctp.untracked );
+}
+
+void anlz_printStat( void )
+{
+    com_printLf();
+    com_printTag( "=", 79, COM_PTAG_LEFT, "protocol hierarchy" );
+    com_printf( "%-*s %10s %7s %14s %7s\n", STAT_LABEL_WIDTH,
+                "protocol", "frames", "", "bytes", "" );
+    printStatNode( &gStatTop, 0 );
+    com_printTag( "=", 79, COM_PTAG_LEFT, "summary" );
+    com_printf( "  %-10s %ld  (analyze NG: %ld)\n",
+                "frames", gStatFrame, gStatNG );
+    com_printf( "  %-10s %lu\n", "bytes", gStatBytes );
+    if( gStatStamped ) {
+        printThroughput( "captured",
+                         getSecond( &gStatLast ) - getSecond( &gStatFirst ) );
+    }
+    if( gStatWatching && com_checkStopwatch( &gStatWatch ) ) {
+        printThroughput( "processed", getSecond( &gStatWatch.passed ) );
+    }
+    printSctpStat();
+    com_printLf();
+    freeStatNode( &gStatTop );
+}
+
@@ -0,0 +1,454 @@
+/*
+ *****************************************************************************
+ *
+ * 簡易信号アナライザー Analyzer TCAP追跡モジュールソース
+ *
+ *****************************************************************************
+ */
+
+#include "anlz_if.h"
+#include "anlz_com.h"
+
+// ダイアログは Beginの (OTID, SCCP Calling Party Address) をキーにする。
+// 相手側から来る信号は (DTID, SCCP Called Party Address) で同じキーになる。
+// 相手側の TIDは最初の Continueで分かるので、(相手OTID, 相手アドレス) を
+// 別名として登録し、発側から来る Continue/Endもダイアログに対応付ける。
+// オペレーションは (ダイアログ, 起動した側, Invoke ID) をキーにして、
+// Invoke→Return Result/Error の時間を INAP/GSM MAPのオペコードごとに集計する。
+// いずれも件数上限とタイムアウトで破棄するので、大きなキャプチャでも
+// 1パスで処理でき、メモリ使用量は上限内に収まる。
+
+enum {
+    TCAP_DIALOG_TIMEOUT = 300,    // ダイアログタイムアウト(秒)
+    TCAP_DIALOG_MAX = 262144,     // 保持する最大ダイアログ数
+    TCAP_INVOKE_TIMEOUT = 60,     // オペレーション応答なしと判断する時間(秒)
+    TCAP_INVOKE_MAX = 262144,     // 保持する最大オペレーション数
+    TCAP_ADDR_MAX = 24,           // キーに使う SCCPアドレスの最大長
+    TCAP_LOST_LIST = 16,          // 異常終了の詳細を表示する件数
+    TCAP_OP_BLOCK = 16            // 集計テーブル拡張単位
+};
+
+// オペコードごとの集計
+typedef struct {
+    long          ptype;        // COM_SIG_INAP or COM_SIG_GSMMAP
+    ulong         opcode;       // オペレーションコード (Local)
+    char          label[32];    // オペレーション名
+    ulong         invokes;      // Invoke数 (重複を除く)
+    ulong         results;      // Return Result数
+    ulong         errors;       // Return Error数
+    ulong         rejects;      // Reject数
+    ulong         timeout;      // 応答なしで破棄した数
+    anlz_hist_t   latency;      // Invoke→Return Result/Error の時間
+} tcapOp_t;
+
+static tcapOp_t*  gTcapOp = NULL;
+static long  gTcapOpCnt = 0;     // 使用中の集計数
+static long  gTcapOpMax = 0;     // 確保済みの集計数
+
+// ダイアログ集計
+typedef struct {
+    ulong         begun;        // Begin数 (重複を除く)
+    ulong         duplicate;    // 同じキーの Begin数
+    ulong         ended;        // Endで終了した数
+    ulong         aborted;      // Abortで終了した数
+    ulong         timeout;      // 終了を見ずに破棄した数
+    ulong         unmatched;    // 対応するダイアログが無かった信号数
+    ulong         unmatchedComp;  // 対応する Invokeが無かった応答数
+    anlz_hist_t   duration;     // Begin→End の時間
+} tcapDialog_t;
+
+static tcapDialog_t  gTcapDialog;
+
+// ダイアログ/別名のキー
+typedef struct {
+    uint32_t   tid;                   // トランザクションID
+    uint32_t   addrLen;               // SCCPアドレス長
+    com_bin    addr[TCAP_ADDR_MAX];   // SCCPアドレス
+} tcapKey_t;
+
+// ダイアログで保持するデータ
+typedef struct {
+    tcapKey_t       peer;       // 相手側の別名キー
+    struct timeval  stamp;      // Beginの時刻
+    uint32_t        otid;       // 発側の TID
+    uint32_t        hasPeer;    // 別名を登録済みかどうか
+    long            op;         // 最初の Invokeの gTcapOp[]位置 (無ければ-1)
+} tcapDlg_t;
+
+// オペレーションのキー
+typedef struct {
+    tcapKey_t  dlg;             // ダイアログのキー
+    uint32_t   invokeId;        // Invoke ID
+    uint32_t   fromOrg;         // 発側が起動したかどうか
+} tcapInvKey_t;
+
+// オペレーションで保持するデータ
+typedef struct {
+    long   op;                  // gTcapOp[]の位置
+} tcapInv_t;
+
+static anlz_trans_t  gTcapDlg;
+static anlz_trans_t  gTcapAlias;    // 相手側キー → ダイアログキー
+static anlz_trans_t  gTcapInv;
+
+// 異常終了したダイアログの詳細 (先頭 TCAP_LOST_LIST件のみ)
+typedef struct {
+    struct timeval  stamp;
+    ulong           otid;
+    long            op;
+    long            cause;      // Abortの P-Abort Cause (無ければ-1)
+    BOOL            isAbort;    // Abortか タイムアウトか
+} tcapLost_t;
+
+static tcapLost_t  gTcapLost[TCAP_LOST_LIST];
+static long  gTcapLostCnt = 0;
+
+enum { TCAP_NOCAUSE = -1 };
+
+static void addTcapLost( tcapDlg_t *iDlg, BOOL iIsAbort, long iCause )
+{
+    if( gTcapLostCnt >= TCAP_LOST_LIST ) {return;}
+    gTcapLost[gTcapLostCnt++] = (tcapLost_t){
+        .stamp = iDlg->stamp, .otid = iDlg->otid, .op = iDlg->op,
+        .cause = iCause, .isAbort = iIsAbort
+    };
+}
+
+static void expireTcapDialog( void *ioData, ANLZ_TREXP_t iCause )
+{
+    if( iCause == ANLZ_TREXP_OVERFLOW ) {return;}
+    gTcapDialog.timeout++;
+    addTcapLost( ioData, false, TCAP_NOCAUSE );
+}
+
+static void expireTcapInvoke( void *ioData, ANLZ_TREXP_t iCause )
+{
+    tcapInv_t*  inv = ioData;
+    if( iCause == ANLZ_TREXP_OVERFLOW ) {return;}
+    gTcapOp[inv->op].timeout++;
+}
+
+void anlz_startTcap( void )
+{
+    com_free( gTcapOp );
+    gTcapOpCnt = gTcapOpMax = 0;
+    memset( &gTcapDialog, 0, sizeof(gTcapDialog) );
+    gTcapLostCnt = 0;
+    anlz_initTrans( &gTcapDlg, TCAP_DIALOG_TIMEOUT, TCAP_DIALOG_MAX,
+                    sizeof(tcapKey_t), expireTcapDialog );
+    anlz_initTrans( &gTcapAlias, TCAP_DIALOG_TIMEOUT, TCAP_DIALOG_MAX,
+                    sizeof(tcapKey_t), NULL );
+    anlz_initTrans( &gTcapInv, TCAP_INVOKE_TIMEOUT, TCAP_INVOKE_MAX,
+                    sizeof(tcapInvKey_t), expireTcapInvoke );
+}
+
+static void setTcapOpLabel( tcapOp_t *oOp )
+{
+    char*  name = NULL;
+    if( oOp->ptype == COM_SIG_INAP ) {name = com_getInapOpName( oOp->opcode );}
+    else {name = com_getGsmmapOpName( oOp->opcode );}
+    if( !name ) {
+        snprintf( oOp->label, sizeof(oOp->label), "opcode#%lu", oOp->opcode );
+        return;
+    }
+    // オペレーション名の後ろに付くコード値は別に出すので落とす
+    (void)com_strcpy( oOp->label, name );
+    char*  space = strchr( oOp->label, ' ' );
+    if( space ) {*space = '\0';}
+}
+
+static long addTcapOp( long iType, ulong iOpcode )
+{
+    if( gTcapOpCnt == gTcapOpMax ) {
+        if( !com_realloct( &gTcapOp, sizeof(*gTcapOp), &gTcapOpMax,
+                           TCAP_OP_BLOCK, "tcap operation(%ld)",
+                           gTcapOpMax ) ) {return COM_TABLEEND;}
+    }
+    tcapOp_t*  op = &(gTcapOp[gTcapOpCnt]);
+    *op = (tcapOp_t){ .ptype = iType, .opcode = iOpcode };
+    setTcapOpLabel( op );
+    return gTcapOpCnt++;
+}
+
+// 組み合わせの数はたかが知れているので、線形に探す
+static long getTcapOp( long iType, ulong iOpcode )
+{
+    for( long i = 0;  i < gTcapOpCnt;  i++ ) {
+        if( gTcapOp[i].ptype == iType && gTcapOp[i].opcode == iOpcode ) {
+            return i;
+        }
+    }
+    return addTcapOp( iType, iOpcode );
+}
+
+// TCAP信号から追跡に必要な情報を取り出したもの
+typedef struct {
+    ulong          type;        // メッセージ種別 (COM_CAP_TCAP_MSG_t)
+    com_sigTlv_t*  otid;
+    com_sigTlv_t*  dtid;
+    com_sigTlv_t*  cldpad;      // SCCP Called Party Address
+    com_sigTlv_t*  clgpad;      // SCCP Calling Party Address
+} tcapInf_t;
+
+static BOOL getTcapInf( com_sigInf_t *iTcap, tcapInf_t *oInf )
+{
+    *oInf = (tcapInf_t){ .type = 0 };
+    if( !iTcap->prm.cnt ) {return false;}
+    oInf->type = iTcap->prm.list[0].tag;
+    oInf->otid = com_searchPrm( &iTcap->prm, COM_CAP_TCAP_OTID );
+    oInf->dtid = com_searchPrm( &iTcap->prm, COM_CAP_TCAP_DTID );
+    com_sigInf_t*  sccp = iTcap->prev;
+    if( sccp && com_getSigType( sccp ) == COM_SIG_SCCP ) {
+        oInf->cldpad = com_searchPrm( &sccp->prm, COM_CAP_SCCPPRM_CLDPAD );
+        oInf->clgpad = com_searchPrm( &sccp->prm, COM_CAP_SCCPPRM_CLGPAD );
+    }
+    return true;
+}
+
+static BOOL makeTcapKey(
+        tcapKey_t *oKey, com_sigTlv_t *iTid, com_sigTlv_t *iAddr )
+{
+    memset( oKey, 0, sizeof(*oKey) );
+    if( !iTid || !iTid->value || iTid->len > COM_32BIT_SIZE ) {return false;}
+    oKey->tid = (uint32_t)com_calcValue( iTid->value, iTid->len );
+    if( iAddr && iAddr->value ) {
+        oKey->addrLen = (uint32_t)iAddr->len;
+        if( oKey->addrLen > TCAP_ADDR_MAX ) {oKey->addrLen = TCAP_ADDR_MAX;}
+        memcpy( oKey->addr, iAddr->value, oKey->addrLen );
+    }
+    return true;
+}
+
+// 処理中の信号が属するダイアログ
+typedef struct {
+    tcapKey_t       key;        // ダイアログのキー
+    tcapDlg_t*      dlg;
+    struct timeval  elapsed;    // Beginからの経過時間
+    BOOL            fromOrg;    // 発側から来た信号かどうか
+} tcapCur_t;
+
+static BOOL procTcapBegin( tcapInf_t *iInf, tcapCur_t *oCur )
+{
+    if( !makeTcapKey( &oCur->key, iInf->otid, iInf->clgpad ) ) {return false;}
+    BOOL  exist = false;
+    oCur->dlg = anlz_addTrans( &gTcapDlg, &oCur->key, sizeof(oCur->key),
+                               &exist );
+    if( !oCur->dlg ) {return false;}
+    oCur->fromOrg = true;
+    if( exist ) {gTcapDialog.duplicate++;  return true;}
+    *oCur->dlg = (tcapDlg_t){ .otid = oCur->key.tid, .op = COM_TABLEEND };
+    (void)com_getSignalTime( &oCur->dlg->stamp );
+    gTcapDialog.begun++;
+    return true;
+}
+
+// (DTID, Called Party Address) から ダイアログを探す。
+// 着側からの信号ならダイアログのキーに、発側からなら別名に一致する。
+static BOOL searchTcapDialog( tcapInf_t *iInf, tcapCur_t *oCur )
+{
+    tcapKey_t  key;
+    if( !makeTcapKey( &key, iInf->dtid, iInf->cldpad ) ) {return false;}
+    oCur->dlg = anlz_searchTrans( &gTcapDlg, &key, sizeof(key),
+                                  &oCur->elapsed );
+    if( oCur->dlg ) {oCur->key = key;  return true;}
+    tcapKey_t*  alias =
+        anlz_searchTrans( &gTcapAlias, &key, sizeof(key), &oCur->elapsed );
+    if( !alias ) {return false;}
+    oCur->key = *alias;
+    oCur->fromOrg = true;
+    oCur->dlg = anlz_searchTrans( &gTcapDlg, &oCur->key, sizeof(oCur->key),
+                                  &oCur->elapsed );
+    return (oCur->dlg != NULL);
+}
+
+// 着側からの最初の Continueで 相手側の別名を登録する
+static void addTcapAlias( tcapInf_t *iInf, tcapCur_t *ioCur )
+{
+    if( ioCur->fromOrg || ioCur->dlg->hasPeer ) {return;}
+    tcapKey_t  peer;
+    if( !makeTcapKey( &peer, iInf->otid, iInf->clgpad ) ) {return;}
+    BOOL  exist = false;
+    tcapKey_t*  alias =
+        anlz_addTrans( &gTcapAlias, &peer, sizeof(peer), &exist );
+    if( !alias ) {return;}
+    *alias = ioCur->key;
+    ioCur->dlg->peer = peer;
+    ioCur->dlg->hasPeer = true;
+}
+
+static long getPabortCause( com_sigInf_t *iTcap )
+{
+    com_sigTlv_t*  cause = com_searchPrm( &iTcap->prm, COM_CAP_TCAP_PABORT );
+    if( !cause || !cause->value || !cause->len ) {return TCAP_NOCAUSE;}
+    return (long)com_calcValue( cause->value, cause->len );
+}
+
+static void closeTcapDialog(
+        com_sigInf_t *iTcap, tcapInf_t *iInf, tcapCur_t *iCur )
+{
+    if( iInf->type == COM_CAP_TCAP_END ) {
+        gTcapDialog.ended++;
+        anlz_addHist( &gTcapDialog.duration, &iCur->elapsed );
+    }
+    else {
+        gTcapDialog.aborted++;
+        addTcapLost( iCur->dlg, true, getPabortCause( iTcap ) );
+    }
+    if( iCur->dlg->hasPeer ) {
+        anlz_deleteTrans( &gTcapAlias, &iCur->dlg->peer,
+                          sizeof(iCur->dlg->peer) );
+    }
+    anlz_deleteTrans( &gTcapDlg, &iCur->key, sizeof(iCur->key) );
+}
+
+static BOOL makeTcapInvKey(
+        tcapInvKey_t *oKey, tcapCur_t *iCur, com_sigTcapCompHead_t *iComp,
+        BOOL iFromOrg )
+{
+    memset( oKey, 0, sizeof(*oKey) );
+    com_sigTlv_t*  invokeId = &(iComp->prm[COM_SIG_TCAP_INVOKEID]);
+    if( invokeId->len > COM_32BIT_SIZE ) {return false;}
+    oKey->dlg = iCur->key;
+    if( invokeId->value ) {
+        oKey->invokeId = (uint32_t)com_calcValue( invokeId->value,
+                                                  invokeId->len );
+    }
+    oKey->fromOrg = (uint32_t)iFromOrg;
+    return true;
+}
+
+static void procTcapInvoke(
+        com_sigInf_t *iComp, com_sigTcapCompHead_t *iHead, tcapCur_t *iCur )
+{
+    com_sigTlv_t*  opcode = &(iHead->prm[COM_SIG_TCAP_OPCODE]);
+    // Globalオペコードは集計対象外
+    if( !opcode->value || opcode->tag != COM_CAP_TCAP_OPCODE_LOCAL ) {return;}
+    tcapInvKey_t  key;
+    if( !makeTcapInvKey( &key, iCur, iHead, iCur->fromOrg ) ) {return;}
+    long  opIdx = getTcapOp( com_getSigType( iComp ), *opcode->value );
+    if( opIdx == COM_TABLEEND ) {return;}
+    if( iCur->dlg->op == COM_TABLEEND ) {iCur->dlg->op = opIdx;}
+    BOOL  exist = false;
+    tcapInv_t*  inv = anlz_addTrans( &gTcapInv, &key, sizeof(key), &exist );
+    if( !inv || exist ) {return;}
+    inv->op = opIdx;
+    gTcapOp[opIdx].invokes++;
+}
+
+static void procTcapResponse(
+        com_sigTcapCompHead_t *iHead, tcapCur_t *iCur, ulong iCompType )
+{
+    tcapInvKey_t  key;
+    // 応答は Invokeを起動した側の逆から来る
+    if( !makeTcapInvKey( &key, iCur, iHead, !iCur->fromOrg ) ) {return;}
+    struct timeval  latency;
+    tcapInv_t*  inv = anlz_searchTrans( &gTcapInv, &key, sizeof(key),
+                                        &latency );
+    if( !inv ) {gTcapDialog.unmatchedComp++;  return;}
+    tcapOp_t*  op = &(gTcapOp[inv->op]);
+    if( iCompType == COM_CAP_TCAP_REJECT ) {op->rejects++;}
+    else {
+        if( iCompType == COM_CAP_TCAP_RETURNERROR ) {op->errors++;}
+        else {op->results++;}
+        anlz_addHist( &op->latency, &latency );
+    }
+    anlz_deleteTrans( &gTcapInv, &key, sizeof(key) );
+}
+
+static void procTcapComponent( com_sigInf_t *iComp, tcapCur_t *iCur )
+{
+    long  type = com_getSigType( iComp );
+    if( type != COM_SIG_INAP && type != COM_SIG_GSMMAP ) {return;}
+    com_sigTcapCompHead_t*  head = iComp->ext;
+    if( !head || !iComp->sig.top ) {return;}
+    ulong  compType = *iComp->sig.top;
+    if( compType == COM_CAP_TCAP_INVOKE ) {
+        procTcapInvoke( iComp, head, iCur );
+    }
+    // Return Result(not last) はまだ続きがあるので、何もしない
+    else if( compType != COM_CAP_TCAP_RETURNRESULT2 ) {
+        procTcapResponse( head, iCur, compType );
+    }
+}
+
+static void trackTcap( com_sigInf_t *iTcap )
+{
+    tcapInf_t  inf;
+    if( !getTcapInf( iTcap, &inf ) ) {return;}
+    if( inf.type == COM_CAP_TCAP_UNDIRECTIONAL ) {return;}
+    tcapCur_t  cur = { .fromOrg = false };
+    if( inf.type == COM_CAP_TCAP_BEGIN ) {
+        if( !procTcapBegin( &inf, &cur ) ) {return;}
+    }
+    else {
+        if( !searchTcapDialog( &inf, &cur ) ) {
+            gTcapDialog.unmatched++;
+            return;
+        }
+        if( inf.type == COM_CAP_TCAP_CONTINUE ) {addTcapAlias( &inf, &cur );}
+    }
+    for( long i = 0;  i < iTcap->next.cnt;  i++ ) {
+        procTcapComponent( &(iTcap->next.stack[i]), &cur );
+    }
+    if( inf.type == COM_CAP_TCAP_END || inf.type == COM_CAP_TCAP_ABORT ) {
+        closeTcapDialog( iTcap, &inf, &cur );
+    }
+}
+
+void anlz_trackTcap( com_sigInf_t *iSignal )
+{
+    anlz_seekStack( iSignal, COM_SIG_TCAP, trackTcap );
+}
+
+static void printTcapOp( tcapOp_t *iOp )
+{
+    com_printf( "  %s %s (%lu)  invokes=%lu results=%lu errors=%lu "
+                "rejects=%lu timeout=%lu\n",
+                (iOp->ptype == COM_SIG_INAP) ? "INAP" : "MAP",
+                iOp->label, iOp->opcode, iOp->invokes, iOp->results,
+                iOp->errors, iOp->rejects, iOp->timeout );
+    anlz_printHist( "invoke -> result/error", &iOp->latency );
+}
+
+static void printTcapLost( void )
+{
+    if( !gTcapLostCnt ) {return;}
+    com_printf( "  aborted/timed-out dialogues (first %ld):\n",
+                gTcapLostCnt );
+    for( long i = 0;  i < gTcapLostCnt;  i++ ) {
+        tcapLost_t*  lost = &(gTcapLost[i]);
+        com_printf( "    %ld.%06ld  OTID=0x%08lx  %s  ",
+                    (long)lost->stamp.tv_sec, (long)lost->stamp.tv_usec,
+                    lost->otid,
+                    (lost->op >= 0) ? gTcapOp[lost->op].label : "-" );
+        if( !lost->isAbort ) {com_printf( "timeout\n" );}
+        else if( lost->cause == TCAP_NOCAUSE ) {com_printf( "U-Abort\n" );}
+        else {com_printf( "P-Abort cause=%ld\n", lost->cause );}
+    }
+}
+
+void anlz_reportTcap( void )
+{
+    anlz_flushTrans( &gTcapInv );
+    anlz_flushTrans( &gTcapDlg );
+    com_printTag( "=", 79, COM_PTAG_LEFT, "TCAP operations" );
+    for( long i = 0;  i < gTcapOpCnt;  i++ ) {printTcapOp( &gTcapOp[i] );}
+    com_printf( "  unmatched responses=%lu  dropped invokes=%lu\n",
+                gTcapDialog.unmatchedComp, gTcapInv.overflowCnt );
+    com_printTag( "=", 79, COM_PTAG_LEFT, "TCAP dialogues" );
+    com_printf( "  begun=%lu duplicate=%lu ended=%lu aborted=%lu "
+                "timeout=%lu\n",
+                gTcapDialog.begun, gTcapDialog.duplicate, gTcapDialog.ended,
+                gTcapDialog.aborted, gTcapDialog.timeout );
+    com_printf( "  unmatched messages=%lu  dropped dialogues=%lu\n",
+                gTcapDialog.unmatched, gTcapDlg.overflowCnt );
+    anlz_printHist( "begin -> end", &gTcapDialog.duration );
+    printTcapLost();
+    com_printLf();
+    anlz_freeTrans( &gTcapInv );
+    anlz_freeTrans( &gTcapAlias );
+    anlz_freeTrans( &gTcapDlg );
+    com_free( gTcapOp );
+    gTcapOpCnt = gTcapOpMax = 0;
+}
+
@@ -0,0 +1,462 @@
+/*
+ *****************************************************************************
+ *
+ * 簡易信号アナライザー Analyzer 信号追跡共通モジュールソース
+ *
+ *****************************************************************************
+ */
+
+#include "anlz_if.h"
+#include "anlz_com.h"
+
+///// 追跡処理の振り分け /////
+
+// 追跡処理一覧 (追跡処理を追加したら、ここに登録する)
+typedef struct {
+    const char*  label;                        // --track で指定する名前
+    void  (*start)( void );                    // ファイル読込開始時
+    void  (*count)( com_sigInf_t *iSignal );   // 信号の解析後
+    void  (*end)( void );                      // ファイル読込終了時
+} trackFunc_t;
+
+static trackFunc_t  gTrackFunc[] = {
+    { "sip", anlz_startSip, anlz_trackSip, anlz_reportSip },
+    { "diameter", anlz_startDiameter, anlz_trackDiameter,
+                  anlz_reportDiameter },
+    { "dns", anlz_startDns, anlz_trackDns, anlz_reportDns },
+    { "rtp", anlz_startRtp, anlz_trackRtp, anlz_reportRtp },
+    { "tcap", anlz_startTcap, anlz_trackTcap, anlz_reportTcap },
+    { NULL, NULL, NULL, NULL }  // 最後は必ずこれで
+};
+
+static BOOL  gTrackUse[COM_ELMCNT(gTrackFunc)];
+static BOOL  gTrackAny = false;
+
+BOOL anlz_useTrack( const char *iLabel )
+{
+    for( long i = 0;  gTrackFunc[i].label;  i++ ) {
+        if( !strcasecmp( iLabel, gTrackFunc[i].label ) ) {
+            gTrackUse[i] = gTrackAny = true;
+            return true;
+        }
+    }
+    com_error( COM_ERR_PARAMNG, "not support track %s", iLabel );
+    return false;
+}
+
+void anlz_startTrack( void )
+{
+    for( long i = 0;  gTrackFunc[i].label;  i++ ) {
+        if( gTrackUse[i] ) {gTrackFunc[i].start();}
+    }
+}
+
+void anlz_countTrack( com_sigInf_t *iSignal )
+{
+    if( !gTrackAny ) {return;}
+    for( long i = 0;  gTrackFunc[i].label;  i++ ) {
+        if( gTrackUse[i] ) {gTrackFunc[i].count( iSignal );}
+    }
+}
+
+void anlz_endTrack( void )
+{
+    for( long i = 0;  gTrackFunc[i].label;  i++ ) {
+        if( gTrackUse[i] ) {gTrackFunc[i].end();}
+    }
+}
+
+static void seekStack(
+        com_sigStk_t *iStack, long iType, anlz_seekStack_t iFunc )
+{
+    for( long i = 0;  i < iStack->cnt;  i++ ) {
+        com_sigInf_t*  target = &(iStack->stack[i]);
+        if( com_getSigType( target ) == iType ) {iFunc( target );}
+        else if( target->next.cnt ) {seekStack( &target->next, iType, iFunc );}
+    }
+}
+
+void anlz_seekStack( com_sigInf_t *iHead, long iType, anlz_seekStack_t iFunc )
+{
+    seekStack( &(com_sigStk_t){ 1, iHead, 0 }, iType, iFunc );
+}
+
+
+
+///// 応答時間ヒストグラム /////
+//
+// マイクロ秒単位の値を 1オクターブ(2倍)ごとに ANLZ_HIST_SUB分割したバケットで
+// 数える。値が 4未満のときはそのままバケット番号とする。
+// 各バケットの幅は値の 1/4 程度なので、パーセンタイル値の誤差もその範囲に
+// 収まる。件数がいくら増えてもメモリ使用量は変わらない。
+
+enum { HIST_SUBBIT = 2 };   // ANLZ_HIST_SUB = 1 << HIST_SUBBIT
+
+static long getBitWidth( ulong iValue )
+{
+    long  width = 0;
+    while( iValue ) {width++;  iValue >>= 1;}
+    return width;
+}
+
+static long getHistIndex( ulong iUsec )
+{
+    if( iUsec < ANLZ_HIST_SUB ) {return (long)iUsec;}
+    long  shift = getBitWidth( iUsec ) - 1 - HIST_SUBBIT;
+    long  idx = (shift + 1) * ANLZ_HIST_SUB + (long)(iUsec >> shift)
+                - ANLZ_HIST_SUB;
+    if( idx >= ANLZ_HIST_SIZE ) {idx = ANLZ_HIST_SIZE - 1;}
+    return idx;
+}
+
+// バケットの下限値 (上限値は次のバケットの下限値)
+static ulong getHistBase( long iIndex )
+{
+    if( iIndex < ANLZ_HIST_SUB ) {return (ulong)iIndex;}
+    long  shift = iIndex / ANLZ_HIST_SUB - 1;
+    return (ulong)(ANLZ_HIST_SUB + iIndex % ANLZ_HIST_SUB) << shift;
+}
+
+void anlz_addHist( anlz_hist_t *ioHist, const struct timeval *iTime )
+{
+    if( iTime->tv_sec < 0 ) {return;}   // 時刻が逆行した場合は数えない
+    ulong  usec = (ulong)iTime->tv_sec * 1000000 + (ulong)iTime->tv_usec;
+    if( !ioHist->count || usec < ioHist->min ) {ioHist->min = usec;}
+    if( usec > ioHist->max ) {ioHist->max = usec;}
+    ioHist->count++;
+    ioHist->sum += usec;
+    ioHist->bucket[getHistIndex( usec )]++;
+}
+
+ulong anlz_getHistPercentile( const anlz_hist_t *iHist, long iPercent )
+{
+    if( !iHist->count ) {return 0;}
+    ulong  target = (iHist->count * (ulong)iPercent + 99) / 100;
+    ulong  sum = 0;
+    for( long i = 0;  i < ANLZ_HIST_SIZE;  i++ ) {
+        sum += iHist->bucket[i];
+        if( sum < target ) {continue;}
+        // バケットの中間値を返す (ただし実際の最小値/最大値の範囲内とする)
+        ulong  value = (getHistBase( i ) + getHistBase( i + 1 )) / 2;
+        if( value < iHist->min ) {value = iHist->min;}
+        if( value > iHist->max ) {value = iHist->max;}
+        return value;
+    }
+    return iHist->max;
+}
+
+// マイクロ秒→ミリ秒
+static double msec( ulong iUsec )
+{
+    return (double)iUsec / 1000.0;
+}
+
+enum {
+    HIST_BAR_MAX = 40    // 分布表示の最大文字数
+};
+
+static void printHistBar( const anlz_hist_t *iHist )
+{
+    // オクターブ単位にまとめて、件数があるところのみ表示する
+    ulong  peak = 0;
+    ulong  octave[ANLZ_HIST_SIZE / ANLZ_HIST_SUB] = {0};
+    for( long i = 0;  i < ANLZ_HIST_SIZE;  i++ ) {
+        ulong*  cnt = &octave[i / ANLZ_HIST_SUB];
+        *cnt += iHist->bucket[i];
+        if( *cnt > peak ) {peak = *cnt;}
+    }
+    for( long i = 0;  i < (long)COM_ELMCNT(octave);  i++ ) {
+        if( !octave[i] ) {continue;}
+        com_printf( "      < %12.3f ms %10lu ",
+                    msec( getHistBase( (i + 1) * ANLZ_HIST_SUB ) ), octave[i] );
+        com_repeat( "*", (long)(octave[i] * HIST_BAR_MAX / peak) + 1, true );
+    }
+}
+
+void anlz_printHist( const char *iLabel, const anlz_hist_t *iHist )
+{
+    if( !iHist->count ) {return;}
+    com_printf( "    %-24s count=%lu  min=%.3f avg=%.3f p50=%.3f p90=%.3f "
+                "p99=%.3f max=%.3f (ms)\n",
+                iLabel, iHist->count, msec( iHist->min ),
+                msec( iHist->sum / iHist->count ),
+                msec( anlz_getHistPercentile( iHist, 50 ) ),
+                msec( anlz_getHistPercentile( iHist, 90 ) ),
+                msec( anlz_getHistPercentile( iHist, 99 ) ),
+                msec( iHist->max ) );
+    printHistBar( iHist );
+}
+
+
+
+///// 応答待ちトランザクション管理 /////
+//
+// 管理データはテーブルで保持し、キーからテーブル位置をハッシュで引く。
+// ハッシュは .bucketに各チェーンの先頭位置を持ち、同じ位置になるものは
+// 管理データの .chainでつなぐ。.bucketは .max以上の 2の冪で確保するので、
+// チェーンは平均1個以下に収まる。
+// 使用中の管理データは 古い順の双方向リストでつなぎ、タイムアウト判定は
+// 一番古いものから順に行う。未使用の管理データは .olderを使った単方向リスト
+// で再利用する。テーブルは確保数の倍ずつ(最低 ANLZ_TRANS_BLOCK) .maxまで
+// 拡張する。
+
+#define TRANS_NOLINK  (-1)
+
+enum {
+    ANLZ_TRANS_BLOCK = 1024    // テーブル拡張の最小単位
+};
+
+// ハッシュ参照はランダムアクセスになるため、大きな .bucketは TLBミスを
+// 抑えるよう大容量領域としてヒュージページで捕捉する
+static BOOL isLargeBucket( ulong iSize )
+{
+    return (iSize * sizeof(long) >= COM_LARGE_HUGESIZE);
+}
+
+ulong anlz_calcHash( const void *iKey, size_t iKeySize )
+{
+    const com_bin*  key = iKey;
+    uint64_t  hash = COM_FNV_OFFSET;
+    for( size_t i = 0;  i < iKeySize;  i++ ) {
+        hash ^= key[i];
+        hash *= COM_FNV_PRIME;
+    }
+    return (ulong)hash;
+}
+
+void anlz_initTrans(
+        anlz_trans_t *oTrans, long iTimeout, long iMax, size_t iKeyMax,
+        anlz_expireTrans_t iFunc )
+{
+    size_t  stride = sizeof(anlz_trEntry_t) + iKeyMax;
+    stride = (stride + sizeof(long) - 1) / sizeof(long) * sizeof(long);
+    *oTrans = (anlz_trans_t){
+        .stride = stride, .keyMax = iKeyMax,
+        .max = iMax, .timeout = iTimeout, .expire = iFunc,
+        .oldest = TRANS_NOLINK, .newest = TRANS_NOLINK, .empty = TRANS_NOLINK
+    };
+    ulong  size = 1;
+    while( size < (ulong)iMax ) {size <<= 1;}
+    if( isLargeBucket( size ) ) {
+        oTrans->bucket = com_allocLarge( size * sizeof(long), true,
+                                         COM_LARGE_LOCALNODE,
+                                         "transaction bucket" );
+    }
+    else {
+        oTrans->bucket = com_malloc( size * sizeof(long),
+                                     "transaction bucket" );
+    }
+    if( !oTrans->bucket ) {return;}
+    for( ulong i = 0;  i < size;  i++ ) {oTrans->bucket[i] = TRANS_NOLINK;}
+    oTrans->mask = size - 1;
+}
+
+static anlz_trEntry_t *getEntry( anlz_trans_t *iTrans, long iIndex )
+{
+    return (anlz_trEntry_t*)(iTrans->entry + (size_t)iIndex * iTrans->stride);
+}
+
+static long getIndex( anlz_trans_t *iTrans, anlz_trEntry_t *iEntry )
+{
+    return (long)((size_t)((com_bin*)iEntry - iTrans->entry) / iTrans->stride);
+}
+
+static long *getBucket( anlz_trans_t *iTrans, ulong iHashVal )
+{
+    return &(iTrans->bucket[iHashVal & iTrans->mask]);
+}
+
+static void unchainEntry( anlz_trans_t *ioTrans, anlz_trEntry_t *ioEntry )
+{
+    long  idx = getIndex( ioTrans, ioEntry );
+    long*  link = getBucket( ioTrans, ioEntry->hashVal );
+    while( *link != idx ) {link = &(getEntry( ioTrans, *link )->chain);}
+    *link = ioEntry->chain;
+}
+
+static void unlinkEntry( anlz_trans_t *ioTrans, anlz_trEntry_t *ioEntry )
+{
+    if( ioEntry->older != TRANS_NOLINK ) {
+        getEntry( ioTrans, ioEntry->older )->newer = ioEntry->newer;
+    }
+    else {ioTrans->oldest = ioEntry->newer;}
+    if( ioEntry->newer != TRANS_NOLINK ) {
+        getEntry( ioTrans, ioEntry->newer )->older = ioEntry->older;
+    }
+    else {ioTrans->newest = ioEntry->older;}
+}
+
+static void releaseEntry( anlz_trans_t *ioTrans, anlz_trEntry_t *ioEntry )
+{
+    unchainEntry( ioTrans, ioEntry );
+    unlinkEntry( ioTrans, ioEntry );
+    ioEntry->older = ioTrans->empty;
+    ioTrans->empty = getIndex( ioTrans, ioEntry );
+    ioTrans->use--;
+}
+
+static void expireEntry(
+        anlz_trans_t *ioTrans, anlz_trEntry_t *ioEntry, ANLZ_TREXP_t iCause )
+{
+    if( iCause == ANLZ_TREXP_TIMEOUT ) {ioTrans->timeoutCnt++;}
+    if( iCause == ANLZ_TREXP_OVERFLOW ) {ioTrans->overflowCnt++;}
+    if( ioTrans->expire ) {ioTrans->expire( ioEntry->data, iCause );}
+    releaseEntry( ioTrans, ioEntry );
+}
+
+static BOOL isTransTimeout(
+        anlz_trans_t *iTrans, anlz_trEntry_t *iEntry,
+        const struct timeval *iNow )
+{
+    if( !iNow ) {return false;}
+    return (iNow->tv_sec - iEntry->stamp.tv_sec > iTrans->timeout);
+}
+
+static void expireOld( anlz_trans_t *ioTrans, const struct timeval *iNow )
+{
+    while( ioTrans->oldest != TRANS_NOLINK ) {
+        anlz_trEntry_t*  old = getEntry( ioTrans, ioTrans->oldest );
+        if( !isTransTimeout( ioTrans, old, iNow ) ) {break;}
+        expireEntry( ioTrans, old, ANLZ_TREXP_TIMEOUT );
+    }
+}
+
+static const struct timeval *getNow( struct timeval *oNow )
+{
+    if( !com_getSignalTime( oNow ) ) {return NULL;}
+    return oNow;
+}
+
+static BOOL extendEntry( anlz_trans_t *ioTrans )
+{
+    // 拡張のたびに全体をコピーするので、倍々で増やして回数を抑える
+    long  add = ioTrans->cnt;
+    if( add < ANLZ_TRANS_BLOCK ) {add = ANLZ_TRANS_BLOCK;}
+    long  rest = ioTrans->max - ioTrans->cnt;
+    if( add > rest ) {add = rest;}
+    long  top = ioTrans->cnt;
+    if( !com_realloct( &ioTrans->entry, ioTrans->stride, &ioTrans->cnt, add,
+                       "transaction(%ld)", top ) ) {return false;}
+    // 追加した分は全て未使用リストにつなぐ
+    for( long i = ioTrans->cnt - 1;  i >= top;  i-- ) {
+        getEntry( ioTrans, i )->older = ioTrans->empty;
+        ioTrans->empty = i;
+    }
+    return true;
+}
+
+static long getEmptyEntry( anlz_trans_t *ioTrans )
+{
+    if( ioTrans->empty == TRANS_NOLINK ) {
+        if( ioTrans->cnt >= ioTrans->max ) {
+            // 上限到達時は一番古いものを追い出して空ける
+            expireEntry( ioTrans, getEntry( ioTrans, ioTrans->oldest ),
+                         ANLZ_TREXP_OVERFLOW );
+        }
+        else if( !extendEntry( ioTrans ) ) {return TRANS_NOLINK;}
+    }
+    long  idx = ioTrans->empty;
+    ioTrans->empty = getEntry( ioTrans, idx )->older;
+    return idx;
+}
+
+static size_t limitKeySize( anlz_trans_t *iTrans, size_t iKeySize )
+{
+    if( iKeySize > iTrans->keyMax ) {return iTrans->keyMax;}
+    return iKeySize;
+}
+
+static anlz_trEntry_t *searchEntry(
+        anlz_trans_t *iTrans, const void *iKey, size_t iKeySize,
+        ulong iHashVal )
+{
+    if( !iTrans->bucket ) {return NULL;}
+    for( long idx = *getBucket( iTrans, iHashVal );  idx != TRANS_NOLINK; ) {
+        anlz_trEntry_t*  entry = getEntry( iTrans, idx );
+        if( entry->hashVal == iHashVal && entry->keySize == iKeySize &&
+            !memcmp( entry->key, iKey, iKeySize ) ) {return entry;}
+        idx = entry->chain;
+    }
+    return NULL;
+}
+
+void *anlz_addTrans(
+        anlz_trans_t *ioTrans, const void *iKey, size_t iKeySize,
+        BOOL *oExist )
+{
+    struct timeval  now;
+    const struct timeval*  nowPtr = getNow( &now );
+    expireOld( ioTrans, nowPtr );
+    iKeySize = limitKeySize( ioTrans, iKeySize );
+    ulong  hashVal = anlz_calcHash( iKey, iKeySize );
+    anlz_trEntry_t*  entry = searchEntry( ioTrans, iKey, iKeySize, hashVal );
+    *oExist = (entry != NULL);
+    if( entry ) {return entry->data;}
+    if( !ioTrans->bucket ) {return NULL;}
+    long  idx = getEmptyEntry( ioTrans );
+    if( idx == TRANS_NOLINK ) {return NULL;}
+    entry = getEntry( ioTrans, idx );
+    long*  bucket = getBucket( ioTrans, hashVal );
+    *entry = (anlz_trEntry_t){
+        .older = ioTrans->newest, .newer = TRANS_NOLINK, .chain = *bucket,
+        .hashVal = hashVal, .keySize = iKeySize
+    };
+    memcpy( entry->key, iKey, iKeySize );
+    if( nowPtr ) {entry->stamp = now;}
+    *bucket = idx;
+    if( ioTrans->newest != TRANS_NOLINK ) {
+        getEntry( ioTrans, ioTrans->newest )->newer = idx;
+    }
+    else {ioTrans->oldest = idx;}
+    ioTrans->newest = idx;
+    ioTrans->use++;
+    return entry->data;
+}
+
+static anlz_trEntry_t *findEntry(
+        anlz_trans_t *iTrans, const void *iKey, size_t iKeySize )
+{
+    iKeySize = limitKeySize( iTrans, iKeySize );
+    return searchEntry( iTrans, iKey, iKeySize,
+                        anlz_calcHash( iKey, iKeySize ) );
+}
+
+void *anlz_searchTrans(
+        anlz_trans_t *ioTrans, const void *iKey, size_t iKeySize,
+        struct timeval *oLatency )
+{
+    anlz_trEntry_t*  entry = findEntry( ioTrans, iKey, iKeySize );
+    if( !entry ) {return NULL;}
+    struct timeval  now;
+    if( getNow( &now ) ) {timersub( &now, &entry->stamp, oLatency );}
+    else {*oLatency = (struct timeval){0};}
+    return entry->data;
+}
+
+void anlz_deleteTrans(
+        anlz_trans_t *ioTrans, const void *iKey, size_t iKeySize )
+{
+    anlz_trEntry_t*  entry = findEntry( ioTrans, iKey, iKeySize );
+    if( entry ) {releaseEntry( ioTrans, entry );}
+}
+
+void anlz_flushTrans( anlz_trans_t *ioTrans )
+{
+    struct timeval  now;
+    expireOld( ioTrans, getNow( &now ) );
+    while( ioTrans->oldest != TRANS_NOLINK ) {
+        expireEntry( ioTrans, getEntry( ioTrans, ioTrans->oldest ),
+                     ANLZ_TREXP_REMAIN );
+    }
+}
+
+void anlz_freeTrans( anlz_trans_t *ioTrans )
+{
+    com_free( ioTrans->entry );
+    if( isLargeBucket( ioTrans->mask + 1 ) ) {
+        com_freeLarge( ioTrans->bucket );
+    }
+    else {com_free( ioTrans->bucket );}
+    *ioTrans = (anlz_trans_t){ .oldest = TRANS_NOLINK };
+}
+
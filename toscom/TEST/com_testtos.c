@@ -85,6 +85,53 @@ void test_realloct( void )
     com_assertNull( "table", table );
 }
 
+///// test_realloctCap() /////////////////////////////////////////////////////
+
+void test_realloctCap( void )
+{
+    startFunc( __func__ );
+    int* table = NULL;
+    long count = 0, capa = 0;
+    // 1つずつ追加しても、容量を超えた時だけ倍々で再捕捉される
+    long  grow = 0, dirty = 0;
+    for( int i = 0;  i < 1000;  i++ ) {
+        long  before = capa;
+        int*  add = com_reallocAddrCap( &table, sizeof(int), COM_TABLEEND,
+                                        &count, &capa, 1, "TEST CAP" );
+        if( !add ) {break;}
+        if( *add ) {dirty++;}
+        *add = i;
+        if( capa != before ) {grow++;}
+    }
+    com_assertEquals( "cleared", 0L, dirty );
+    com_assertEquals( "count", 1000L, count );
+    com_assertEquals( "capacity", 1024L, capa );
+    com_assertEquals( "grow", 9L, grow );
+    // 途中挿入・途中削除は com_reallocAddr()と同じ
+    int*  ins = com_reallocAddrCap( &table, sizeof(int), 0, &count, &capa, 1,
+                                    "TEST INS" );
+    com_assertTrue( "insert top", ins == table && *ins == 0 && table[1] == 0 );
+    com_assertEquals( "moved", 999L, (long)table[1000] );
+    (void)com_reallocAddrCap( &table, sizeof(int), 0, &count, &capa, -1,
+                              "TEST DEL" );
+    // 縮小しても容量は変わらず、再拡張時は 0クリアされる
+    com_assertTrue( "shrink", com_realloctCap( &table, sizeof(int), &count,
+                                               &capa, -500, "TEST-500" ) );
+    com_assertEquals( "count", 500L, count );
+    com_assertEquals( "capacity", 1024L, capa );
+    com_assertTrue( "extend", com_realloctCap( &table, sizeof(int), &count,
+                                               &capa, 1, "TEST+1" ) );
+    com_assertEquals( "re-cleared", 0L, (long)table[500] );
+    com_assertTrue( "fit", com_shrinkTable( &table, sizeof(int), count, &capa,
+                                            "TEST FIT" ) );
+    com_assertEquals( "fitted", 501L, capa );
+    com_assertEquals( "kept", 499L, (long)table[499] );
+    com_assertTrue( "clear", com_realloctCap( &table, sizeof(int), &count,
+                                              &capa, -count, "TEST CLEAR" ) );
+    com_assertNull( "table", table );
+    com_assertEquals( "capacity", 0L, capa );
+}
+
 ///// test_getOpt() //////////////////////////////////////////////////////////
 
 static BOOL optFuncI( com_getOptInf_t *iOptInf )
@@ -638,6 +685,99 @@ void test_debugLog( void )
     // 画面出力と .test.log を目視確認
 }
 
+///// test_bufferedOutput() ///////////////////////////////////////////////////
+
+void test_bufferedOutput( void )
+{
+    startFunc( __func__ );
+    com_setBufferedOutput( true, 3, 0 );
+    com_printf( "line 1 (buffered)\n" );
+    com_printf( "line 2 (buffered)\n" );
+    com_debug( "not displayed until line 3" );
+    com_printf( "line 3 (flushed with line 1-2)\n" );
+    com_printf( "line 4 " );
+    com_printf( "(flushed by com_flushOutput)\n" );
+    com_flushOutput();
+    com_setBufferedOutput( false, 0, 0 );
+    com_printf( "line 5 (not buffered)\n" );
+    // 画面出力と .test.log を目視確認 (行の順番と内容が変わらないこと)
+}
+
+///// test_asyncOutput() /////////////////////////////////////////////////////
+
+void test_asyncOutput( void )
+{
+    startFunc( __func__ );
+    com_assertTrue( "async on",
+                    com_setAsyncOutput( true, 4, COM_ASYNCOUT_BLOCK ) );
+    for( long i = 0;  i < 20;  i++ ) {com_printf( "async line %ld\n", i );}
+    com_flushOutput();
+    com_asyncOutStat_t  stat;
+    com_getAsyncOutputStat( &stat );
+    com_assertEquals( "written", (long)stat.records, (long)stat.written );
+    com_assertEquals( "dropped", 0, (long)stat.dropped );
+    // 満杯時に新しい出力を捨てる (何行残るかはスレッドの動き次第)
+    (void)com_setAsyncOutput( true, 4, COM_ASYNCOUT_DROP_NEW );
+    for( long i = 0;  i < 100;  i++ ) {com_printf( "drop new %ld\n", i );}
+    (void)com_setAsyncOutput( false, 0, COM_ASYNCOUT_BLOCK );
+    com_getAsyncOutputStat( &stat );
+    com_assertEquals( "written", (long)stat.records, (long)stat.written );
+    com_printf( "written=%lu dropped=%lu\n", stat.written, stat.dropped );
+    // 複数スロットを使う出力も 1件単位で捨てる (途中で切れた行は出ない)
+    char  text[1200];
+    memset( text, 'x', sizeof(text) - 1 );
+    text[sizeof(text) - 1] = '\0';
+    (void)com_setAsyncOutput( true, 4, COM_ASYNCOUT_DROP_OLDEST );
+    for( long i = 0;  i < 20;  i++ ) {com_printf( "%ld %s\n", i, text );}
+    (void)com_setAsyncOutput( false, 0, COM_ASYNCOUT_BLOCK );
+    com_getAsyncOutputStat( &stat );
+    com_assertEquals( "whole records", (long)stat.records,
+                      (long)(stat.written + stat.dropped) );
+    com_printf( "written=%lu dropped=%lu\n", stat.written, stat.dropped );
+    // リングより長い出力は待たずに捨てる
+    (void)com_setAsyncOutput( true, 2, COM_ASYNCOUT_BLOCK );
+    com_printf( "%s\n", text );
+    (void)com_setAsyncOutput( false, 0, COM_ASYNCOUT_BLOCK );
+    com_getAsyncOutputStat( &stat );
+    com_assertEquals( "too long", 0L, (long)stat.records );
+    com_assertTrue( "dropped", stat.dropped > 0 );
+}
+
+///// test_binaryTrace() /////////////////////////////////////////////////////
+
+void test_binaryTrace( void )
+{
+    startFunc( __func__ );
+    com_assertTrue( "trace on", com_setBinaryTrace( ".test.btrc" ) );
+    for( long i = 0;  i < 3;  i++ ) {
+        com_debug( "binary trace %ld [%-6s] %5.2f %c %p %%", i, "str",
+                   (double)i / 3, (int)'A' + (int)i, (void*)&i );
+    }
+    com_debug( "width %*d precision %.*s size %zu",
+               5, 42, 3, "abcdef", sizeof(long) );
+    com_debug( "wide %ls", L"chars" );    // 整形済み文字列で記録される
+    com_debug( "multi\nline" );
+    com_setBinaryTrace( NULL );
+    com_debug( "after trace (text)" );
+    // ./btrcprint .test.btrc の結果とデバッグログを目視確認
+}
+
+///// test_flightRecorder() //////////////////////////////////////////////////
+
+void test_flightRecorder( void )
+{
+    startFunc( __func__ );
+    com_assertTrue( "recorder on",
+                    com_setFlightRecorder( ".test.fltr", 4096 ) );
+    // 4KBのリングを何周かさせる
+    for( long i = 0;  i < 200;  i++ ) {com_debug( "flight record %ld", i );}
+    com_dbgCom( "com record\nwith 2 lines" );
+    com_error( COM_ERR_DEBUGNG, "error record" );
+    com_assertTrue( "dump", com_dumpFlightRecorder( ".test.fltr", 5 ) );
+    com_assertTrue( "recorder off", com_setFlightRecorder( NULL, 0 ) );
+    com_assertTrue( "dump closed", com_dumpFlightRecorder( ".test.fltr", 1 ) );
+}
+
 /////test_chainData() ////////////////////////////////////////////////////////
 
 static char *spreadChain( com_strChain_t *iChain )
@@ -1545,6 +1685,277 @@ void test_doublefree( void )
     com_assertNull( "dummy", dummy );
 }
 
+///// test_memWatchTable() /////////////////////////////////////////////////
+
+enum { MEMWATCH_TEST_COUNT = 200000 };
+
+void test_memWatchTable( void )
+{
+    startFunc( __func__ );
+    static void*  blocks[MEMWATCH_TEST_COUNT];
+    com_skipMemInfo( true );
+    long  seqno = 0;
+    for( long i = 0;  i < MEMWATCH_TEST_COUNT;  i++ ) {
+        blocks[i] = com_malloc( 16, "watch %ld", i );
+        if( i == MEMWATCH_TEST_COUNT / 2 ) {
+            seqno = com_checkMemInfo( blocks[i] );
+        }
+    }
+    com_assertEquals( "seqno", seqno,
+                      com_checkMemInfo( blocks[MEMWATCH_TEST_COUNT / 2] ) );
+    // 奇数番目を先に解放し、表からの削除が他の検索を壊さないことを確認
+    for( long i = 1;  i < MEMWATCH_TEST_COUNT;  i += 2 ) {com_free(blocks[i]);}
+    com_assertEquals( "freed", 0L, com_checkMemInfo( (char*)blocks[0] + 1 ) );
+    long  found = 0;
+    for( long i = 0;  i < MEMWATCH_TEST_COUNT;  i += 2 ) {
+        if( com_checkMemInfo( blocks[i] ) ) {found++;}
+    }
+    com_assertEquals( "found", MEMWATCH_TEST_COUNT / 2L, found );
+    for( long i = 0;  i < MEMWATCH_TEST_COUNT;  i += 2 ) {com_free(blocks[i]);}
+    com_skipMemInfo( false );
+}
+
+///// test_fileWatchTable() /////////////////////////////////////////////////
+
+enum {
+    FILEWATCH_TEST_COUNT = 64,      // 同時にオープンするファイル数
+    FILEWATCH_TEST_LOOP = 200       // オープン/クローズの繰り返し回数
+};
+
+void test_fileWatchTable( void )
+{
+    startFunc( __func__ );
+    static FILE*  fps[FILEWATCH_TEST_COUNT];
+    com_skipFileInfo( true );
+    com_stopwatch_t  sw;
+    (void)com_startStopwatch( &sw );
+    long  found = 0;
+    // 同じパスを繰り返し開き、ラベルが共有されても監視情報が壊れないこと
+    for( long loop = 0;  loop < FILEWATCH_TEST_LOOP;  loop++ ) {
+        for( long i = 0;  i < FILEWATCH_TEST_COUNT;  i++ ) {
+            fps[i] = com_fopen( "/dev/null", "r" );
+        }
+        for( long i = 0;  i < FILEWATCH_TEST_COUNT;  i += 2 ) {
+            (void)com_fclose( fps[i] );
+        }
+        for( long i = 0;  i < FILEWATCH_TEST_COUNT;  i++ ) {
+            if( com_checkFileInfo( fps[i] ) ) {found++;}
+        }
+        for( long i = 1;  i < FILEWATCH_TEST_COUNT;  i += 2 ) {
+            (void)com_fclose( fps[i] );
+        }
+    }
+    (void)com_checkStopwatch( &sw );
+    com_skipFileInfo( false );
+    com_assertEquals( "found", FILEWATCH_TEST_LOOP * FILEWATCH_TEST_COUNT / 2L,
+                      found );
+    com_printf( " %d open/close: %ld.%06ldsec\n",
+                FILEWATCH_TEST_LOOP * FILEWATCH_TEST_COUNT,
+                sw.passed.tv_sec, sw.passed.tv_usec );
+    // 共有するファイルの半分をクローズしても、ラベルの内容が残ること
+    for( long i = 0;  i < FILEWATCH_TEST_COUNT;  i++ ) {
+        fps[i] = com_fopen( "/dev/null", "r" );
+    }
+    for( long i = 0;  i < FILEWATCH_TEST_COUNT;  i += 2 ) {
+        (void)com_fclose( fps[i] );
+    }
+    long  labeled = 0;
+    for( long i = 1;  i < FILEWATCH_TEST_COUNT;  i += 2 ) {
+        const char*  label = com_getFileInfoLabel( fps[i] );
+        if( label && !strcmp( label, "/dev/null" ) ) {labeled++;}
+    }
+    com_assertEquals( "label", FILEWATCH_TEST_COUNT / 2L, labeled );
+    for( long i = 1;  i < FILEWATCH_TEST_COUNT;  i += 2 ) {
+        (void)com_fclose( fps[i] );
+    }
+    // クローズ後は同じアドレスでも監視情報が見つからないこと
+    FILE*  fp = com_fopen( "/dev/null", "r" );
+    const FILE*  key = fp;
+    com_assertTrue( "seqno", com_checkFileInfo( key ) > 0 );
+    (void)com_fclose( fp );
+    com_assertEquals( "closed", 0L, com_checkFileInfo( key ) );
+}
+
+///// test_memSampling() ///////////////////////////////////////////////////
+
+void test_memSampling( void )
+{
+    startFunc( __func__ );
+    static void*  blocks[MEMWATCH_TEST_COUNT];
+    size_t  rate = com_getWatchMemSampling();
+    com_setWatchMemSampling( 4096 );
+    com_assertEquals( "rate", 4096L, (long)com_getWatchMemSampling() );
+    com_skipMemInfo( true );
+    for( long i = 0;  i < MEMWATCH_TEST_COUNT;  i++ ) {
+        blocks[i] = com_malloc( 64, "sample %ld", i );
+    }
+    // 約 12.8MBの捕捉で、平均 4KBごとの抽出なので 3000件程度が抽出される
+    long  sampled = 0;
+    for( long i = 0;  i < MEMWATCH_TEST_COUNT;  i++ ) {
+        if( com_checkMemInfo( blocks[i] ) ) {sampled++;}
+    }
+    com_printf( "sampled = %ld / %d\n", sampled, MEMWATCH_TEST_COUNT );
+    com_assertTrue( "sampled", sampled > 2000 && sampled < 4500 );
+    // 半分を解放した時点の推定一覧で 6.4MB前後になることを目視確認
+    for( long i = 0;  i < MEMWATCH_TEST_COUNT;  i += 2 ) {com_free(blocks[i]);}
+    com_listMemInfo();
+    // 抽出を止める前に全て解放し、設定も元に戻す
+    for( long i = 1;  i < MEMWATCH_TEST_COUNT;  i += 2 ) {com_free(blocks[i]);}
+    com_skipMemInfo( false );
+    com_setWatchMemSampling( rate );
+    // 抽出した監視情報が残っていなければ、二重解放の検出に戻る
+    int*  dummy = com_malloc( sizeof(int), "after sampling" );
+    const int*  key = dummy;
+    com_free( dummy );
+    com_deleteMemInfo( COM_FILELOC, COM_FREE, key );
+    com_assertEquals( "double free", COM_ERR_DOUBLEFREE, com_getLastError() );
+}
+
+///// test_memSnapshot() ///////////////////////////////////////////////////
+
+enum { SNAPSHOT_TEST_COUNT = 100 };
+
+void test_memSnapshot( void )
+{
+    startFunc( __func__ );
+    static void*  leak[SNAPSHOT_TEST_COUNT];
+    com_memSnapshot_t  snap1, snap2, snap3;
+    com_skipMemInfo( true );
+    com_assertTrue( "snap1", com_snapshotMemInfo( &snap1 ) );
+    for( long i = 0;  i < SNAPSHOT_TEST_COUNT;  i++ ) {
+        leak[i] = com_malloc( 32, "leak %ld", i );
+        void*  tmp = com_malloc( 64, "temp %ld", i );   // すぐ解放する
+        com_free( tmp );
+    }
+    com_assertTrue( "snap2", com_snapshotMemInfo( &snap2 ) );
+    // 増えたのは leak[]の呼び元だけ
+    com_assertEquals( "grown", 1, com_diffMemInfo( &snap1, &snap2 ) );
+    com_assertEqualsU( "count", snap1.count + SNAPSHOT_TEST_COUNT,
+                       snap2.count );
+    com_assertEqualsU( "bytes", snap1.bytes + SNAPSHOT_TEST_COUNT * 32,
+                       snap2.bytes );
+    com_assertEquals( "seqno", snap1.seqno + SNAPSHOT_TEST_COUNT * 2,
+                      snap2.seqno );
+    for( long i = 0;  i < SNAPSHOT_TEST_COUNT;  i++ ) {com_free( leak[i] );}
+    com_assertTrue( "snap3", com_snapshotMemInfo( &snap3 ) );
+    com_assertEquals( "shrank", 0, com_diffMemInfo( &snap2, &snap3 ) );
+    com_assertEqualsU( "count", snap1.count, snap3.count );
+    com_freeMemSnapshot( &snap1 );
+    com_freeMemSnapshot( &snap2 );
+    com_freeMemSnapshot( &snap3 );
+    com_assertNull( "free", snap3.site );
+    com_skipMemInfo( false );
+}
+
+///// test_allocProfile() //////////////////////////////////////////////////
+
+void test_allocProfile( void )
+{
+    startFunc( __func__ );
+    com_assertTrue( "profile on", com_setAllocProfile( true ) );
+    com_assertTrue( "signal",
+                    com_setAllocProfileSignal( SIGUSR1, ".test.allocprof" ) );
+    char*  grow = NULL;
+    long  cnt = 0;
+    // 1つずつ伸ばす realloc()が捕捉回数の多い呼び元として出ることを確認
+    for( long i = 0;  i < 1000;  i++ ) {
+        (void)com_realloct( &grow, sizeof(*grow), &cnt, 1, "grow" );
+    }
+    void*  leak = com_malloc( 4096, "leak" );
+    (void)raise( SIGUSR1 );
+    com_free( grow );   // この解放時に .test.allocprofへ出力される
+    com_dumpAllocProfile( NULL );
+    com_assertTrue( "signal output", com_checkExistFile(".test.allocprof") );
+    com_free( leak );
+    com_assertTrue( "profile off", com_setAllocProfile( false ) );
+    com_dumpAllocProfile( NULL );   // 何も出力されない
+    (void)signal( SIGUSR1, SIG_DFL );
+}
+
+///// test_allocBench() ///////////////////////////////////////////////////
+
+enum {
+    ALLOCBENCH_COUNT = 1000000,    // メモリ捕捉解放の計測回数
+    FILEBENCH_COUNT = 10000,       // ファイルオープンクローズの計測回数
+    ALLOCBENCH_SIZE = 64           // 捕捉サイズ
+};
+
+// 最適化で捕捉と解放の組が省略されないように、捕捉結果を必ず書き込む
+static void* volatile  gBenchSink = NULL;
+
+static double getBenchNsec( com_stopwatch_t *ioWatch, long iCount )
+{
+    (void)com_checkStopwatch( ioWatch );
+    long  usec = ioWatch->passed.tv_sec * 1000000 + ioWatch->passed.tv_usec;
+    return (double)usec * 1000.0 / (double)iCount;
+}
+
+static double benchAlloc( BOOL iUseCom )
+{
+    com_stopwatch_t  sw;
+    (void)com_startStopwatch( &sw );
+    for( long i = 0;  i < ALLOCBENCH_COUNT;  i++ ) {
+        char*  ptr = NULL;
+        if( iUseCom ) {ptr = com_malloc( ALLOCBENCH_SIZE, NULL );}
+        else {ptr = calloc( ALLOCBENCH_SIZE, 1 );}
+        gBenchSink = ptr;
+        if( iUseCom ) {com_free( ptr );}
+        else {free( ptr );}
+    }
+    return getBenchNsec( &sw, ALLOCBENCH_COUNT );
+}
+
+static double benchFile( BOOL iUseCom )
+{
+    com_stopwatch_t  sw;
+    (void)com_startStopwatch( &sw );
+    for( long i = 0;  i < FILEBENCH_COUNT;  i++ ) {
+        FILE*  fp = NULL;
+        if( iUseCom ) {fp = com_fopen( "/dev/null", "r" );}
+        else {fp = fopen( "/dev/null", "r" );}
+        gBenchSink = fp;
+        if( iUseCom ) {(void)com_fclose( fp );}
+        else {(void)fclose( fp );}
+    }
+    return getBenchNsec( &sw, FILEBENCH_COUNT );
+}
+
+static void printBench( const char *iLabel, double iLibc, double iCom )
+{
+    com_printf( "%-18s libc %8.1fns  com %8.1fns  (x%.2f)\n",
+                iLabel, iLibc, iCom, iCom / iLibc );
+}
+
+void test_allocBench( void )
+{
+    startFunc( __func__ );
+#ifdef USE_RELEASE_ABI
+    com_printf( "USE_RELEASE_ABI: on\n" );
+#else
+    com_printf( "USE_RELEASE_ABI: off\n" );
+#endif
+    // 通常の I/Fと同じ結果になることを確認
+    char*  ptr = com_malloc( ALLOCBENCH_SIZE, "bench" );
+    com_assertEquals( "zero clear", 0, ptr[ALLOCBENCH_SIZE - 1] );
+    com_free( ptr );
+    com_assertNull( "free", ptr );
+    FILE*  fp = com_fopen( "/dev/null", "r" );
+    com_assertEquals( "fclose", 0, com_fclose( fp ) );
+    com_assertNull( "fclose", fp );
+
+    // 監視処理の負荷は除き、監視OFFの状態での呼出負荷を標準関数と比べる
+    COM_DEBUG_MODE_t  memMode = com_getWatchMemInfo();
+    COM_DEBUG_MODE_t  fileMode = com_getWatchFileInfo();
+    com_setWatchMemInfo( COM_DEBUG_OFF );
+    com_setWatchFileInfo( COM_DEBUG_OFF );
+    (void)benchAlloc( false );   // 初回はヒープ拡張の負荷が乗るので空回しする
+    printBench( "malloc/free", benchAlloc( false ), benchAlloc( true ) );
+    printBench( "fopen/fclose", benchFile( false ), benchFile( true ) );
+    com_setWatchMemInfo( memMode );
+    com_setWatchFileInfo( fileMode );
+    // 計測値は環境依存のため目視確認 (USE_RELEASE_ABI指定時は x1.0前後)
+}
+
 ///// test_prmNG() ///////////////////////////////////////////////////////////
 
 void test_prmNG( void )
@@ -1666,6 +2077,192 @@ void test_ringBuffer( void )
     com_freeRingBuf( &ring );
 }
 
+///// test_arena() ////////////////////////////////////////////////////////
+
+void test_arena( void )
+{
+    startFunc( __func__ );
+    com_arena_t*  arena = com_createArena( 256 );
+    com_assertNotNull( "arena", arena );
+    char*  first = com_allocArena( arena, 10 );
+    char*  second = com_allocArena( arena, 10 );
+    com_assertEquals( "align", (long)COM_ARENA_ALIGN, (long)(second - first) );
+    com_arenaMark_t  mark;
+    com_markArena( arena, &mark );
+    // チャンクをまたぐ切り出しと、チャンクより大きい切り出し
+    for( long i = 0;  i < 100;  i++ ) {(void)com_allocArena( arena, 32 );}
+    char*  big = com_allocArena( arena, 1000 );
+    com_assertNotNull( "big", big );
+    com_assertEquals( "used", 3232L + 1008L, (long)arena->used );
+    com_rewindArena( arena, &mark );
+    com_assertEquals( "rewind", 32L, (long)arena->used );
+    char*  again = com_allocArena( arena, 1 );
+    com_assertTrue( "same position", again == second + COM_ARENA_ALIGN );
+    com_resetArena( arena );
+    com_assertEquals( "reset", 0L, (long)arena->used );
+    again = com_allocArena( arena, 1 );
+    com_assertTrue( "reuse", again == first );
+    com_freeArena( &arena );
+    com_assertNull( "freed", arena );
+}
+
+///// test_pool() /////////////////////////////////////////////////////////
+
+enum { POOL_TEST_COUNT = 10000, POOL_TEST_THREAD = 4 };
+
+typedef struct {
+    long   no;
+    char   name[24];
+} poolItem_t;
+
+static void *procPoolThread( void *ioPool )
+{
+    poolItem_t*  item[100];
+    for( long i = 0;  i < POOL_TEST_COUNT;  i++ ) {
+        long  idx = i % 100;
+        if( i >= 100 ) {com_freePoolObj( ioPool, &item[idx] );}
+        item[idx] = com_allocPool( ioPool );
+        item[idx]->no = i;
+    }
+    for( long i = 0;  i < 100;  i++ ) {com_freePoolObj( ioPool, &item[i] );}
+    // スレッド終了時にキャッシュはデポに戻る
+    return NULL;
+}
+
+static long  gAllocHookCount = 0;
+
+// エラー処理中にメモリを捕捉するフック (メモリ監視のロック解除後に呼ばれる)
+static COM_HOOKERR_ACTION_t allocInHook( com_hookErrInf_t *iInf )
+{
+    if( iInf->code == COM_ERR_DOUBLEFREE ) {
+        void*  tmp = com_malloc( 16, "alloc in hook" );
+        com_free( tmp );
+        gAllocHookCount++;
+    }
+    return COM_HOOKERR_EXEC;
+}
+
+void test_pool( void )
+{
+    startFunc( __func__ );
+    com_pool_t*  pool = com_createPool( sizeof(poolItem_t), 8, true );
+    com_assertNotNull( "pool", pool );
+    poolItem_t*  first = com_allocPool( pool );
+    poolItem_t*  second = com_allocPool( pool );
+    // デバッグ指定時は末尾に状態を示す1語が付く
+    com_assertEquals( "unit", 48L, (long)((char*)second - (char*)first) );
+    first->no = 1;
+    poolItem_t*  freed = first;
+    com_freePoolObj( pool, &first );
+    com_assertNull( "freed obj", first );
+    first = com_allocPool( pool );
+    com_assertTrue( "reuse", first == freed );
+    com_assertEquals( "cleared", 0L, first->no );
+    com_printf( "--- write after free (COM_ERR_DEBUGNG expected) ---\n" );
+    com_freePoolObj( pool, &first );
+    freed->name[5] = 'x';
+    first = com_allocPool( pool );
+    com_printf( "--- double free (COM_ERR_DOUBLEFREE expected) ---\n" );
+    // フックでメモリを捕捉しても、デッドロックしないこと
+    com_hookError( allocInHook );
+    freed = first;
+    com_freePoolObj( pool, &first );
+    com_freePoolObj( pool, &freed );
+    // 抽出監視中でも、プール自身で二重返却を検出すること
+    size_t  rate = com_getWatchMemSampling();
+    com_setWatchMemSampling( 1UL << 30 );
+    first = com_allocPool( pool );
+    freed = first;
+    com_freePoolObj( pool, &first );
+    const void*  key = freed;
+    com_freePoolObj( pool, &freed );
+    com_setWatchMemSampling( rate );
+    // メモリ監視のロック中に検出したエラーも、解除後にフックが呼ばれること
+    com_deleteMemInfo( COM_FILELOC, COM_FREEPOOLOBJ, key );
+    com_hookError( NULL );
+    com_assertEquals( "alloc in hook", 3L, gAllocHookCount );
+    // 二重返却されたオブジェクトを2回渡さないこと
+    first = com_allocPool( pool );
+    freed = com_allocPool( pool );
+    com_assertTrue( "not twice", first != freed );
+    com_freePoolObj( pool, &first );
+    com_freePoolObj( pool, &freed );
+    com_freePoolObj( pool, &second );
+    com_freePool( &pool );
+    com_assertNull( "freed pool", pool );
+
+    com_printf( "--- multi thread ---\n" );
+    pool = com_createPool( sizeof(poolItem_t), 0, false );
+    pthread_t  th[POOL_TEST_THREAD];
+    for( long i = 0;  i < POOL_TEST_THREAD;  i++ ) {
+        com_assertEquals( "create", 0L,
+                          (long)pthread_create( &th[i], NULL,
+                                                procPoolThread, pool ) );
+    }
+    for( long i = 0;  i < POOL_TEST_THREAD;  i++ ) {
+        (void)pthread_join( th[i], NULL );
+    }
+    com_printf( "objects = %zu\n", pool->objCount );
+    com_assertEquals( "all returned", (long)pool->objCount, pool->depotCount );
+    com_freePool( &pool );
+}
+
+///// test_allocLarge() ///////////////////////////////////////////////////
+
+static char*  gLargeType[] = { "NONE", "NORMAL", "THP", "HUGETLB" };
+
+static void checkLargeArea( char *iLabel, void *iAddr, size_t iUnit )
+{
+    size_t  mapSize = 0;
+    COM_LARGE_t  type = com_getLargeType( iAddr, &mapSize );
+    com_printf( "%s: %p %s (%zu)\n", iLabel, iAddr, gLargeType[type], mapSize );
+    com_assertNotEquals( "type", (long)COM_LARGE_NONE, (long)type );
+    com_assertEqualsU( "map size", 0, mapSize % iUnit );
+    com_assertEqualsU( "align", 0, (uintptr_t)iAddr % iUnit );
+}
+
+void test_allocLarge( void )
+{
+    startFunc( __func__ );
+    size_t  page = (size_t)sysconf( _SC_PAGESIZE );
+    uchar*  normal = com_allocLarge( 100000, false, COM_LARGE_ANYNODE,
+                                     "normal area" );
+    com_assertNotNull( "normal", normal );
+    checkLargeArea( "normal", normal, page );
+    com_assertEquals( "cleared", 0L, (long)(normal[0] + normal[99999]) );
+    memset( normal, 0xff, 100000 );
+
+    size_t  size = COM_LARGE_HUGESIZE + COM_LARGE_HUGESIZE / 2;
+    uchar*  huge = com_allocLarge( size, true, COM_LARGE_LOCALNODE,
+                                   "huge area" );
+    com_assertNotNull( "huge", huge );
+    checkLargeArea( "huge", huge, COM_LARGE_HUGESIZE );
+    memset( huge, 0xff, size );
+    com_freeLarge( huge );
+    com_assertNull( "freed", huge );
+    com_freeLarge( huge );   // NULLなら何もしない
+
+    com_printf( "--- ring buffer ---\n" );
+    com_ringBuf_t*  ring =
+        com_createRingBuf( 1024, 4096, false, false, NULL );
+    com_assertNotNull( "ring", ring );
+    checkLargeArea( "ring", ring->buf, COM_LARGE_HUGESIZE );
+    char  data[] = "large ring";
+    com_assertTrue( "push", com_pushRingBuf( ring, data, sizeof(data) ) );
+    com_assertString( "pull", data, com_pullRingBuf( ring ) );
+    com_freeRingBuf( &ring );
+    com_assertNull( "freed ring", ring );
+
+    com_printf( "--- not large area (COM_ERR_DOUBLEFREE expected) ---\n" );
+    uchar*  other = normal + page;
+    com_freeLarge( other );
+    com_assertNotNull( "not freed", other );
+    uchar*  freed = normal;
+    com_freeLarge( normal );
+    COM_LARGE_t  type = com_getLargeType( freed, NULL );
+    com_assertEquals( "none", (long)COM_LARGE_NONE, (long)type );
+}
+
 ///// test_config() //////////////////////////////////////////////////////////
 
 #define KEY_TEST1  "TEST1"
@@ -3000,6 +3597,7 @@ static void exam_baseFunctions( int iArgc, char **iArgv )
     // テストしたい関数のコメントアウトを外して再ビルドする
 
     //test_realloct();                // テーブル捕捉解放
+    //test_realloctCap();             // テーブル捕捉解放(容量管理付き)
     //test_getOpt();                  // オプションチェック
     //test_strdup();                  // 文字列複製
     //test_convertString();           // 文字列変換
@@ -3015,6 +3613,10 @@ static void exam_baseFunctions( int iArgc, char **iArgv )
     //test_checkFiles();              // 複数ファイル有無チェック
     //test_printTag();                // タグ出力チェック
     //test_debugLog();                // デバッグログ出力
+    //test_bufferedOutput();          // 出力バッファリング
+    //test_asyncOutput();             // 非同期出力
+    //test_binaryTrace();             // バイナリトレース
+    //test_flightRecorder();          // フライトレコーダー
     //test_chainData();               // チェーン構造データ
     //test_chainNum();                // チェーン構造データ (数値版)
     //test_bufferData();              // 文字列バッファデータ
@@ -3035,9 +3637,18 @@ static void exam_baseFunctions( int iArgc, char **iArgv )
     //test_fileInfo();                // ファイル情報取得
     //test_strtooct();                // バイナリテキストのバイナリ化
     //test_doublefree();              // 二重解放
+    //test_memWatchTable();           // メモリ監視表
+    //test_fileWatchTable();          // ファイル監視表
+    //test_memSampling();             // メモリ監視サンプリング
+    //test_memSnapshot();             // メモリ監視スナップショット
+    //test_allocProfile();            // メモリ捕捉プロファイル
+    //test_allocBench();              // 呼出負荷計測(リリースABI)
     //test_prmNG();                   // パラメータNG処理
     //test_getFileFunc();             // ファイル名取得
     //test_ringBuffer();              // リングバッファ
+    //test_arena();                   // アリーナ
+    //test_pool();                    // オブジェクトプール
+    //test_allocLarge();              // 大容量領域
     //test_config();                  // コンフィグ機能
     //test_assertion();               // アサート機能
 }
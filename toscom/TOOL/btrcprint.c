@@ -0,0 +1,412 @@
+/*
+ *****************************************************************************
+ *
+ * バイナリトレース表示ツール  btrcprint
+ *
+ *   com_setBinaryTrace()で記録したファイルを読み、デバッグログと同じ形式の
+ *   文字列にして標準出力に出す。ファイル形式は com_if.hの
+ *   com_setBinaryTrace()の説明を参照。
+ *   記録したプログラムと同じマシン(バイト順・型サイズ)で使うこと。
+ *
+ *   使い方:  btrcprint ファイル名 [ファイル名...]
+ *
+ *   toscomの型定義のみ使い、toscomの I/Fは一切使用しない。
+ *
+ *****************************************************************************
+ */
+
+#include "com_if.h"
+
+// 書式文字列のアドレスと内容の対応表 ----------------------------------------
+
+typedef struct {
+    uint64_t   addr;
+    char*      format;
+} format_t;
+
+static format_t*  gFormat = NULL;
+static size_t  gFormatMax = 0;      // 2のべき乗
+static size_t  gFormatCnt = 0;
+
+static size_t hashAddr( uint64_t iAddr )
+{
+    return (size_t)((iAddr >> 3) * 0x9E3779B97F4A7C15ull) & (gFormatMax - 1);
+}
+
+static format_t *seekFormat( uint64_t iAddr )
+{
+    if( !gFormatMax ) {return NULL;}
+    for( size_t i = hashAddr( iAddr );  ;  i = (i + 1) & (gFormatMax - 1) ) {
+        if( gFormat[i].addr == iAddr || !gFormat[i].format ) {
+            return &(gFormat[i]);
+        }
+    }
+}
+
+static void expandFormat( void )
+{
+    format_t*  old = gFormat;
+    size_t  oldMax = gFormatMax;
+    gFormatMax = oldMax ? oldMax * 2 : 1024;
+    if( !(gFormat = calloc( gFormatMax, sizeof(*gFormat) )) ) {
+        fprintf( stderr, "no memory for format table\n" );
+        exit( EXIT_FAILURE );
+    }
+    for( size_t i = 0;  i < oldMax;  i++ ) {
+        if( old[i].format ) {*seekFormat( old[i].addr ) = old[i];}
+    }
+    free( old );
+}
+
+// 同じアドレスが再度登録された場合は後の内容で置き換える
+static void addFormat( uint64_t iAddr, const char *iFormat )
+{
+    if( (gFormatCnt + 1) * 2 > gFormatMax ) {expandFormat();}
+    format_t*  fmt = seekFormat( iAddr );
+    if( !fmt->format ) {gFormatCnt++;}
+    free( fmt->format );
+    fmt->addr = iAddr;
+    if( !(fmt->format = strdup( iFormat )) ) {
+        fprintf( stderr, "no memory for format\n" );
+        exit( EXIT_FAILURE );
+    }
+}
+
+static void freeFormat( void )
+{
+    for( size_t i = 0;  i < gFormatMax;  i++ ) {free( gFormat[i].format );}
+    free( gFormat );
+    gFormat = NULL;
+    gFormatMax = gFormatCnt = 0;
+}
+
+// 文字列の組み立て -----------------------------------------------------------
+
+typedef struct {
+    char*    text;
+    size_t   len;
+    size_t   size;
+} text_t;
+
+static void addText( text_t *ioText, const char *iSrc, size_t iLen )
+{
+    if( ioText->len + iLen + 1 > ioText->size ) {
+        size_t  size = ioText->size ? ioText->size : 4096;
+        while( ioText->len + iLen + 1 > size ) {size *= 2;}
+        char*  text = realloc( ioText->text, size );
+        if( !text ) {
+            fprintf( stderr, "no memory for text\n" );
+            exit( EXIT_FAILURE );
+        }
+        ioText->text = text;
+        ioText->size = size;
+    }
+    memcpy( ioText->text + ioText->len, iSrc, iLen );
+    ioText->len += iLen;
+    ioText->text[ioText->len] = '\0';
+}
+
+// 記録された引数の読み出し ---------------------------------------------------
+
+typedef struct {
+    const char*   top;
+    const char*   end;
+} args_t;
+
+typedef struct {
+    long          type;      // COM_BTRC_ARG_t
+    const char*   value;
+    size_t        len;
+} arg_t;
+
+static BOOL nextArg( args_t *ioArgs, arg_t *oArg )
+{
+    com_btrcArg_t  head;
+    if( ioArgs->top + sizeof(head) > ioArgs->end ) {return false;}
+    memcpy( &head, ioArgs->top, sizeof(head) );
+    size_t  size = (sizeof(head) + head.len + 7) & ~(size_t)7;
+    if( ioArgs->top + size > ioArgs->end ) {return false;}
+    *oArg = (arg_t){ head.type, ioArgs->top + sizeof(head), head.len };
+    ioArgs->top += size;
+    return true;
+}
+
+static int64_t getInt( const arg_t *iArg )
+{
+    int64_t  value = 0;
+    memcpy( &value, iArg->value, sizeof(value) );
+    return value;
+}
+
+// 変換指定 1つ分の整形 -------------------------------------------------------
+
+// 書式を解析した結果 (com_debug.cの記録時と同じ解析をする)
+typedef struct {
+    char   spec[64];      // "%" から変換指定子までの文字列
+    long   starCnt;       // 幅・精度の '*' の数
+} spec_t;
+
+static const char *getSpec( const char *iFmt, spec_t *oSpec )
+{
+    const char*  top = iFmt - 1;    // '%'の位置
+    while( *iFmt && strchr( "-+ #0'", *iFmt ) ) {iFmt++;}
+    if( *iFmt == '*' ) {oSpec->starCnt++;  iFmt++;}
+    while( isdigit( (unsigned char)*iFmt ) ) {iFmt++;}
+    if( *iFmt == '.' ) {
+        iFmt++;
+        if( *iFmt == '*' ) {oSpec->starCnt++;  iFmt++;}
+        while( isdigit( (unsigned char)*iFmt ) ) {iFmt++;}
+    }
+    while( *iFmt && strchr( "hlqjztL", *iFmt ) ) {iFmt++;}
+    if( *iFmt ) {iFmt++;}
+    size_t  len = (size_t)(iFmt - top);
+    if( len >= sizeof(oSpec->spec) ) {len = sizeof(oSpec->spec) - 1;}
+    memcpy( oSpec->spec, top, len );
+    oSpec->spec[len] = '\0';
+    return iFmt;
+}
+
+// '*'の数に応じて幅・精度を渡して整形する
+#define FORMAT_VALUE( VALUE ) \
+    ((iSpec->starCnt == 0) ? \
+        snprintf( oBuf, iSize, iSpec->spec, (VALUE) ) : \
+     (iSpec->starCnt == 1) ? \
+        snprintf( oBuf, iSize, iSpec->spec, iStar[0], (VALUE) ) : \
+        snprintf( oBuf, iSize, iSpec->spec, iStar[0], iStar[1], (VALUE) ))
+
+// 書式は記録されたものを使うので、リテラルでないことの警告は抑止する
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+
+static int formatValue(
+        char *oBuf, size_t iSize, const spec_t *iSpec, const int *iStar,
+        const arg_t *iArg, const char *iStr )
+{
+    double  dval = 0;
+    long double  ldval = 0;
+    switch( iArg->type ) {
+        case COM_BTRC_INT:      return FORMAT_VALUE( (int)getInt( iArg ) );
+        case COM_BTRC_LONG:     return FORMAT_VALUE( (long)getInt( iArg ) );
+        case COM_BTRC_LLONG:
+            return FORMAT_VALUE( (long long)getInt( iArg ) );
+        case COM_BTRC_INTMAX:   return FORMAT_VALUE( (intmax_t)getInt( iArg ) );
+        case COM_BTRC_SIZE:     return FORMAT_VALUE( (size_t)getInt( iArg ) );
+        case COM_BTRC_PTRDIFF:
+            return FORMAT_VALUE( (ptrdiff_t)getInt( iArg ) );
+        case COM_BTRC_DOUBLE:
+            memcpy( &dval, iArg->value, sizeof(dval) );
+            return FORMAT_VALUE( dval );
+        case COM_BTRC_LDOUBLE:
+            memcpy( &ldval, iArg->value, sizeof(ldval) );
+            return FORMAT_VALUE( ldval );
+        case COM_BTRC_PTR:
+            return FORMAT_VALUE( (void*)(uintptr_t)getInt( iArg ) );
+        case COM_BTRC_STR:      return FORMAT_VALUE( iStr );
+        default:  break;
+    }
+    return snprintf( oBuf, iSize, "<?>" );
+}
+
+#pragma GCC diagnostic pop
+
+static void addArg(
+        text_t *ioText, const spec_t *iSpec, const int *iStar,
+        const arg_t *iArg )
+{
+    // 記録した文字列は '\0'終端していないので複製する
+    char*  str = NULL;
+    if( iArg->type == COM_BTRC_STR ) {
+        if( !(str = strndup( iArg->value, iArg->len )) ) {
+            fprintf( stderr, "no memory for string\n" );
+            exit( EXIT_FAILURE );
+        }
+    }
+    char  buf[512];
+    int  len = formatValue( buf, sizeof(buf), iSpec, iStar, iArg, str );
+    if( len > 0 && (size_t)len < sizeof(buf) ) {
+        addText( ioText, buf, (size_t)len );
+    }
+    else if( len > 0 ) {
+        char*  big = malloc( (size_t)len + 1 );
+        if( big ) {
+            (void)formatValue( big, (size_t)len + 1, iSpec, iStar, iArg, str );
+            addText( ioText, big, (size_t)len );
+            free( big );
+        }
+    }
+    free( str );
+}
+
+// レコードの表示 -------------------------------------------------------------
+
+static BOOL getArgs(
+        args_t *ioArgs, const spec_t *iSpec, int *oStar, arg_t *oArg )
+{
+    for( long i = 0;  i < iSpec->starCnt;  i++ ) {
+        if( !nextArg( ioArgs, oArg ) ) {return false;}
+        oStar[i] = (int)getInt( oArg );
+    }
+    return nextArg( ioArgs, oArg );
+}
+
+static void renderLog(
+        text_t *ioText, const com_btrcLog_t *iHead, const char *iBody,
+        size_t iLen )
+{
+    format_t*  fmt = seekFormat( iHead->format );
+    if( !fmt || !fmt->format ) {
+        char  buf[64];
+        int  len = snprintf( buf, sizeof(buf), "<unknown format 0x%llx>",
+                             (unsigned long long)iHead->format );
+        addText( ioText, buf, (size_t)len );
+        return;
+    }
+    args_t  args = { iBody, iBody + iLen };
+    for( const char* fmtPtr = fmt->format;  *fmtPtr;  ) {
+        const char*  pct = strchr( fmtPtr, '%' );
+        if( !pct ) {addText( ioText, fmtPtr, strlen( fmtPtr ) );  break;}
+        addText( ioText, fmtPtr, (size_t)(pct - fmtPtr) );
+        if( pct[1] == '%' ) {
+            addText( ioText, "%", 1 );
+            fmtPtr = pct + 2;
+            continue;
+        }
+        spec_t  spec = { "", 0 };
+        fmtPtr = getSpec( pct + 1, &spec );
+        int  star[2] = { 0, 0 };
+        arg_t  arg;
+        if( getArgs( &args, &spec, star, &arg ) ) {
+            addArg( ioText, &spec, star, &arg );
+        }
+        else {addText( ioText, "<?>", 3 );}
+    }
+}
+
+// デバッグログと同じく 1行ずつタイムスタンプとプレフィックスを付ける
+static void printLines( const com_btrcLog_t *iHead, text_t *ioText )
+{
+    struct tm  tm;
+    time_t  sec = (time_t)iHead->sec;
+    char  stamp[64] = "";
+    if( localtime_r( &sec, &tm ) ) {
+        snprintf( stamp, sizeof(stamp), "[%02d%02d%02d %02d%02d%02d]",
+                  tm.tm_year % 100, tm.tm_mon + 1, tm.tm_mday,
+                  tm.tm_hour, tm.tm_min, tm.tm_sec );
+    }
+    const char*  prefix = iHead->isCom ? "COM" : "DBG";
+    addText( ioText, "\n", 1 );
+    const char*  line = ioText->text;
+    for( const char* lf;  (lf = strchr( line, '\n' ));  line = lf + 1 ) {
+        printf( "%s[%s] %.*s\n", stamp, prefix, (int)(lf - line), line );
+    }
+}
+
+static void procRecord(
+        const com_btrcRec_t *iRec, const char *iBody, size_t iLen )
+{
+    if( iRec->type == COM_BTRC_FORMAT ) {
+        uint64_t  addr;
+        if( iLen <= sizeof(addr) ) {return;}
+        memcpy( &addr, iBody, sizeof(addr) );
+        addFormat( addr, iBody + sizeof(addr) );
+        return;
+    }
+    com_btrcLog_t  head;
+    size_t  bodyHead = sizeof(head) - sizeof(*iRec);
+    if( iLen < bodyHead ) {return;}
+    head.rec = *iRec;
+    memcpy( (char*)&head + sizeof(*iRec), iBody, bodyHead );
+    text_t  text = { NULL, 0, 0 };
+    addText( &text, "", 0 );
+    if( iRec->type == COM_BTRC_LOG ) {
+        renderLog( &text, &head, iBody + bodyHead, iLen - bodyHead );
+    }
+    else if( iRec->type == COM_BTRC_TEXT ) {
+        addText( &text, iBody + bodyHead, strlen( iBody + bodyHead ) );
+    }
+    else {free( text.text );  return;}    // 未知のレコードは読み飛ばす
+    printLines( &head, &text );
+    free( text.text );
+}
+
+// ファイルの読み込み ---------------------------------------------------------
+
+enum { RECORD_MAX = 16 * 1024 * 1024 };    // 壊れたファイルの判定用
+
+static BOOL checkHead( FILE *iFp, const char *iPath )
+{
+    com_btrcHead_t  head;
+    if( fread( &head, sizeof(head), 1, iFp ) != 1 ||
+        memcmp( head.magic, COM_BTRC_MAGIC, sizeof(COM_BTRC_MAGIC) ) )
+    {
+        fprintf( stderr, "%s: not a binary trace file\n", iPath );
+        return false;
+    }
+    if( head.order != COM_BTRC_ORDER || head.version != COM_BTRC_VERSION ) {
+        fprintf( stderr, "%s: unsupported byte order or version\n", iPath );
+        return false;
+    }
+    return true;
+}
+
+static BOOL readRecords( FILE *iFp, const char *iPath )
+{
+    char*  body = NULL;
+    size_t  bodySize = 0;
+    com_btrcRec_t  rec;
+    BOOL  result = true;
+    while( fread( &rec, sizeof(rec), 1, iFp ) == 1 ) {
+        if( rec.size < sizeof(rec) || rec.size > RECORD_MAX ) {
+            fprintf( stderr, "%s: broken record\n", iPath );
+            result = false;
+            break;
+        }
+        size_t  len = rec.size - sizeof(rec);
+        if( len + 1 > bodySize ) {
+            char*  tmp = realloc( body, len + 1 );
+            if( !tmp ) {
+                fprintf( stderr, "no memory for record\n" );
+                result = false;
+                break;
+            }
+            body = tmp;
+            bodySize = len + 1;
+        }
+        if( len && fread( body, len, 1, iFp ) != 1 ) {
+            fprintf( stderr, "%s: truncated record\n", iPath );
+            result = false;
+            break;
+        }
+        body[len] = '\0';
+        procRecord( &rec, body, len );
+    }
+    free( body );
+    return result;
+}
+
+static BOOL printTrace( const char *iPath )
+{
+    FILE*  fp = fopen( iPath, "rb" );
+    if( !fp ) {
+        fprintf( stderr, "%s: %s\n", iPath, strerror( errno ) );
+        return false;
+    }
+    BOOL  result = checkHead( fp, iPath ) && readRecords( fp, iPath );
+    fclose( fp );
+    freeFormat();
+    return result;
+}
+
+int main( int iArgc, char **iArgv )
+{
+    if( iArgc < 2 ) {
+        fprintf( stderr, "usage: %s FILE [FILE...]\n", iArgv[0] );
+        return EXIT_FAILURE;
+    }
+    int  result = EXIT_SUCCESS;
+    for( int i = 1;  i < iArgc;  i++ ) {
+        if( !printTrace( iArgv[i] ) ) {result = EXIT_FAILURE;}
+    }
+    return result;
+}
+
@@ -18,6 +18,12 @@
 #include "com_if.h"
 #include "com_debug.h"
 
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <semaphore.h>
+
 #ifdef USE_FUNCTRACE
 #include <dlfcn.h>
 #endif
@@ -149,9 +155,14 @@ static void openDebugLog( void )
     }
 }
 
+static void flushAllOutBuf( void );
+static void drainAsync( void );
+
 void com_closeDebugLog( void )
 {
     if( !gDebugLog ) {return;}
+    flushAllOutBuf();
+    drainAsync();
     // fopen()で開いているので、com_fclose()は使用しない
     fclose( gDebugLog );
     gDebugLog = NULL;
@@ -196,33 +207,1267 @@ void com_suspendStdout( BOOL iMode )
     gSuspendStdout = iMode;
 }
 
+static __thread com_printHook_t  gPrintHook = NULL;
+static __thread void*  gPrintHookData = NULL;
+
+void com_hookPrint( com_printHook_t iFunc, void *iUserData )
+{
+    gPrintHook = iFunc;
+    gPrintHookData = iUserData;
+}
+
 // デバッグログ用タイムスタンプ
 typedef struct {
     char date[16];  // パディングの都合で COM_DATA_SSIZE の代わりに 16
     char time[16];  // パディングの都合で COM_DATA_SSIZE の代わりに 16
 } stamp_t;
 
-static void dispTimeStamp( FILE *ioFp, stamp_t *iStamp )
+// タイムスタンプは秒単位なので、秒が変わった時だけ作り直す
+static void getTimeStamp( stamp_t *oStamp )
+{
+    static __thread time_t  cached = 0;
+    static __thread stamp_t  stamp;
+    time_t  now = time( NULL );
+    if( now != cached ) {
+        com_getCurrentTime( COM_FORM_SIMPLE, stamp.date, stamp.time, NULL );
+        cached = now;
+    }
+    *oStamp = stamp;
+}
+
+// 出力バッファリング (com_setBufferedOutput()) ------------------------------
+
+enum {
+    OUTBUF_SIZE = 65536,            // 出力先ごとのバッファサイズ
+    OUTBUF_LINES_DEFAULT = 1024,    // 書き出すまでの行数のデフォルト
+    OUTBUF_TARGETS = 2              // 画面とデバッグログ
+};
+
+// 出力先ごとのバッファ
+typedef struct {
+    FILE*    fp;
+    size_t   len;
+    char     data[OUTBUF_SIZE];
+} outTarget_t;
+
+// スレッドごとの出力バッファ
+typedef struct outBuf {
+    struct outBuf*   next;
+    outTarget_t      target[OUTBUF_TARGETS];
+    long             lines;      // 前回書き出し後の行数
+    struct timeval   flushed;    // 前回書き出し時刻
+    BOOL             orphan;     // 終了処理で gOutBufListから外された
+} outBuf_t;
+
+static BOOL  gBufferedOutput = false;
+static long  gOutBufLines = OUTBUF_LINES_DEFAULT;
+static long  gOutBufMsec = 0;
+// 全スレッドのバッファ (gMutexOutで排他する)
+static outBuf_t*  gOutBufList = NULL;
+static __thread outBuf_t*  gOutBuf = NULL;
+static pthread_key_t  gOutBufKey;
+static pthread_once_t  gOutBufOnce = PTHREAD_ONCE_INIT;
+
+static void flushOutTarget( outTarget_t *ioTarget )
+{
+    if( !ioTarget->len ) {return;}
+    (void)fwrite( ioTarget->data, 1, ioTarget->len, ioTarget->fp );
+    fflush( ioTarget->fp );
+    ioTarget->len = 0;
+}
+
+static void flushOutBuf( outBuf_t *ioBuf )
+{
+    for( long i = 0;  i < OUTBUF_TARGETS;  i++ ) {
+        flushOutTarget( &(ioBuf->target[i]) );
+    }
+    ioBuf->lines = 0;
+    // com_gettimeofday()はエラー時に画面出力するので使わない
+    (void)gettimeofday( &ioBuf->flushed, NULL );
+}
+
+static void flushAllOutBuf( void )
+{
+    for( outBuf_t* buf = gOutBufList;  buf;  buf = buf->next ) {
+        flushOutBuf( buf );
+    }
+}
+
+// スレッド終了時に書き出して解放する
+static void releaseOutBuf( void *ioBuf )
+{
+    outBuf_t*  target = ioBuf;
+    com_mutexLock( &gMutexOut, __func__ );
+    // 終了処理後は出力先が閉じられているので、書き出さずに解放だけする
+    if( !target->orphan ) {flushOutBuf( target );}
+    for( outBuf_t** ptr = &gOutBufList;  *ptr;  ptr = &((*ptr)->next) ) {
+        if( *ptr == target ) {*ptr = (*ptr)->next;  break;}
+    }
+    // malloc()で確保しているので、com_free()は使用しない
+    free( ioBuf );
+    com_mutexUnlock( &gMutexOut, __func__ );
+}
+
+static void createOutBufKey( void )
+{
+    (void)pthread_key_create( &gOutBufKey, releaseOutBuf );
+}
+
+static outBuf_t *getOutBuf( void )
+{
+    if( gOutBuf ) {return gOutBuf;}
+    (void)pthread_once( &gOutBufOnce, createOutBufKey );
+    // com_malloc()はメモリ監視で画面出力することがあるので使わない
+    outBuf_t*  buf = calloc( 1, sizeof(*buf) );
+    if( !buf ) {return NULL;}
+    (void)gettimeofday( &buf->flushed, NULL );
+    buf->next = gOutBufList;
+    gOutBufList = buf;
+    (void)pthread_setspecific( gOutBufKey, buf );
+    gOutBuf = buf;
+    return buf;
+}
+
+static outTarget_t *getOutTarget( outBuf_t *ioBuf, FILE *iFp )
+{
+    for( long i = 0;  i < OUTBUF_TARGETS;  i++ ) {
+        if( ioBuf->target[i].fp == iFp ) {return &(ioBuf->target[i]);}
+    }
+    for( long i = 0;  i < OUTBUF_TARGETS;  i++ ) {
+        outTarget_t*  target = &(ioBuf->target[i]);
+        if( !target->fp || !target->len ) {target->fp = iFp;  return target;}
+    }
+    // 出力先が変わった場合 (通常は発生しない)
+    outTarget_t*  target = &(ioBuf->target[OUTBUF_TARGETS - 1]);
+    flushOutTarget( target );
+    target->fp = iFp;
+    return target;
+}
+
+static BOOL isFlushTime( outBuf_t *iBuf )
+{
+    if( gOutBufMsec <= 0 ) {return false;}
+    struct timeval  now;
+    (void)gettimeofday( &now, NULL );
+    long  passed = (now.tv_sec - iBuf->flushed.tv_sec) * 1000
+                   + (now.tv_usec - iBuf->flushed.tv_usec) / 1000;
+    return (passed >= gOutBufMsec);
+}
+
+// バッファに貯められなかったら falseを返す (呼び元で直接書き込む)
+static BOOL bufferOutput( FILE *ioFp, const char *iText, size_t iLen )
+{
+    if( !iLen ) {return true;}
+    outBuf_t*  buf = getOutBuf();
+    if( !buf ) {return false;}
+    outTarget_t*  target = getOutTarget( buf, ioFp );
+    if( target->len + iLen > OUTBUF_SIZE ) {flushOutTarget( target );}
+    if( iLen > OUTBUF_SIZE ) {return false;}
+    memcpy( target->data + target->len, iText, iLen );
+    target->len += iLen;
+    if( iText[iLen - 1] == '\n' ) {buf->lines++;}
+    if( buf->lines >= gOutBufLines || isFlushTime( buf ) ) {flushOutBuf( buf );}
+    return true;
+}
+
+void com_setBufferedOutput( BOOL iMode, long iLines, long iMsec )
 {
-    if( iStamp ) {fprintf( ioFp, "[%s %s]", iStamp->date, iStamp->time );}
+    com_mutexLock( &gMutexOut, __func__ );
+    if( !iMode ) {flushAllOutBuf();}
+    gBufferedOutput = iMode;
+    gOutBufLines = (iLines > 0) ? iLines : OUTBUF_LINES_DEFAULT;
+    gOutBufMsec = iMsec;
+    com_mutexUnlock( &gMutexOut, __func__ );
+}
+
+// 非同期出力 (com_setAsyncOutput()) -----------------------------------------
+//
+// 出力は固定長スロットのリングに積み、専用スレッドが writev()で書き込む。
+// リングは各スロットにシーケンス番号を持たせたロックフリーのキューで、
+// 出力側(gMutexOutで直列化済み)と書き込みスレッドは CASだけで同期する。
+// 長い出力は連続する複数スロットを使うが、積むのも取り出すのも出力1件単位で
+// 行い、出力の途中で切れることはない。
+// COM_ASYNCOUT_DROP_OLDEST では出力側も取り出しをするので、取り出し側も
+// 複数になりうるが、同じ仕組みでそのまま動作する。
+
+enum {
+    ASYNC_SLOTS_DEFAULT = 4096,    // スロット数のデフォルト
+    ASYNC_SLOT_SIZE = 496,         // 1スロットのデータサイズ
+    ASYNC_BATCH = 64,              // 書き込みスレッドが一度に取り出す数
+    ASYNC_WAIT_USEC = 100          // 空き待ち/書き込み完了待ちの間隔(μ秒)
+};
+
+// スロット (長い出力は連続する複数スロットに分けて格納する)
+typedef struct {
+    size_t   seq;     // シーケンス番号
+    size_t   count;   // 出力1件分のスロット数 (先頭スロットのみ有効)
+    FILE*    fp;
+    size_t   len;
+    char     data[ASYNC_SLOT_SIZE];
+} asyncSlot_t;
+
+// 非同期出力の管理データ
+typedef struct {
+    asyncSlot_t*   slot;
+    size_t         mask;        // スロット数 - 1
+    size_t         enqPos;      // 次に積む位置
+    size_t         deqPos;      // 次に取り出す位置
+    long           policy;      // COM_ASYNCOUT_POLICY_t
+    BOOL           stop;        // 書き込みスレッド停止要求
+    BOOL           writing;     // 書き込みスレッドが書き込み中
+    pthread_t      thread;
+    sem_t          sem;         // 積んだ数 (書き込みスレッドの起床用)
+    com_asyncOutStat_t  stat;
+} asyncOut_t;
+
+static asyncOut_t  gAsync;
+static BOOL  gAsyncOutput = false;
+
+#define ALOAD( VAR )         __atomic_load_n( &(VAR), __ATOMIC_ACQUIRE )
+#define ASTORE( VAR, VAL )   __atomic_store_n( &(VAR), (VAL), __ATOMIC_RELEASE )
+#define AINC( VAR )          __atomic_add_fetch( &(VAR), 1, __ATOMIC_RELAXED )
+#define ACAS( VAR, OLD, NEW ) \
+    __atomic_compare_exchange_n( &(VAR), &(OLD), (NEW), false, \
+                                 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )
+
+// iPosから iCount個のスロットが空いているか
+static BOOL hasFreeSlots( size_t iPos, size_t iCount )
+{
+    for( size_t i = 0;  i < iCount;  i++ ) {
+        asyncSlot_t*  slot = &(gAsync.slot[(iPos + i) & gAsync.mask]);
+        if( ALOAD( slot->seq ) != iPos + i ) {return false;}
+    }
+    return true;
+}
+
+// 積まれた出力を 1件分(複数スロットならその全て)まとめて取り出す。
+// 空なら falseを返す。先頭スロットは最後に公開されるので、それが見えた時点で
+// 残りのスロットも揃っている。参照し終えたら releaseSlots()で空きに戻すこと。
+static BOOL takeRecord( size_t *oPos, size_t *oCount )
+{
+    size_t  pos = ALOAD( gAsync.deqPos );
+    while(1) {
+        asyncSlot_t*  slot = &(gAsync.slot[pos & gAsync.mask]);
+        long  diff = (long)(ALOAD( slot->seq ) - (pos + 1));
+        if( !diff ) {
+            size_t  count = ALOAD( slot->count );
+            if( ACAS( gAsync.deqPos, pos, pos + count ) ) {
+                *oPos = pos;
+                *oCount = count;
+                return true;
+            }
+        }
+        else if( diff < 0 ) {return false;}
+        else {pos = ALOAD( gAsync.deqPos );}
+    }
+}
+
+static void releaseSlots( size_t iPos, size_t iCount )
+{
+    for( size_t i = 0;  i < iCount;  i++ ) {
+        asyncSlot_t*  slot = &(gAsync.slot[(iPos + i) & gAsync.mask]);
+        ASTORE( slot->seq, iPos + i + gAsync.mask + 1 );
+    }
+}
+
+static void waitAsync( void )
+{
+    struct timespec  wait = { 0, ASYNC_WAIT_USEC * 1000 };
+    (void)nanosleep( &wait, NULL );
+}
+
+// iCount個の空きスロットを確保し、その先頭位置を *oPosに返す。
+// 出力側は gMutexOutで直列化されているので、確保に CASは要らない。
+// 満杯時は COM_ASYNCOUT_POLICY_t に従う。捨てる場合は falseを返す。
+static BOOL getFreeSlots( size_t iCount, size_t *oPos )
+{
+    size_t  pos = ALOAD( gAsync.enqPos );
+    BOOL  blocked = false;
+    while( !hasFreeSlots( pos, iCount ) ) {
+        if( gAsync.policy == COM_ASYNCOUT_DROP_NEW ) {return false;}
+        if( gAsync.policy == COM_ASYNCOUT_DROP_OLDEST ) {
+            size_t  old, count;
+            if( takeRecord( &old, &count ) ) {
+                releaseSlots( old, count );
+                AINC( gAsync.stat.dropped );
+            }
+            // 書き込みスレッドが参照中のスロットは空くのを待つ
+            else {waitAsync();}
+            continue;
+        }
+        if( !blocked ) {AINC( gAsync.stat.blocked );  blocked = true;}
+        waitAsync();
+    }
+    ASTORE( gAsync.enqPos, pos + iCount );
+    *oPos = pos;
+    return true;
+}
+
+static void fillSlot(
+        asyncSlot_t *ioSlot, FILE *iFp, const char **ioText, size_t *ioLen )
+{
+    ioSlot->fp = iFp;
+    ioSlot->len = 0;
+    for( long i = 0;  i < 2 && ioSlot->len < ASYNC_SLOT_SIZE;  i++ ) {
+        size_t  copy = ASYNC_SLOT_SIZE - ioSlot->len;
+        if( copy > ioLen[i] ) {copy = ioLen[i];}
+        memcpy( ioSlot->data + ioSlot->len, ioText[i], copy );
+        ioSlot->len += copy;
+        ioText[i] += copy;
+        ioLen[i] -= copy;
+    }
+}
+
+// iHeadと iTextを続けて積む。
+// 必要なスロットを先に全て確保し、出力1件が丸ごと積まれるか丸ごと捨てられる
+// ようにする (途中で切れた行が次の出力とつながらないように)。
+static void enqueueOutput(
+        FILE *iFp, const char *iHead, size_t iHeadLen, const char *iText )
+{
+    const char*  text[2] = { iHead, iText };
+    size_t  len[2] = { iHeadLen, strlen( iText ) };
+    size_t  count = (len[0] + len[1] + ASYNC_SLOT_SIZE - 1) / ASYNC_SLOT_SIZE;
+    if( !count ) {return;}
+    size_t  pos;
+    // リング全体より長い出力は、待っても積めないので捨てる
+    if( count > gAsync.mask + 1 || !getFreeSlots( count, &pos ) ) {
+        AINC( gAsync.stat.dropped );
+        return;
+    }
+    for( size_t i = 0;  i < count;  i++ ) {
+        fillSlot( &(gAsync.slot[(pos + i) & gAsync.mask]), iFp, text, len );
+    }
+    ASTORE( gAsync.slot[pos & gAsync.mask].count, count );
+    // 先頭スロットを最後に公開する
+    for( size_t i = count;  i > 0;  i-- ) {
+        ASTORE( gAsync.slot[(pos + i - 1) & gAsync.mask].seq, pos + i );
+    }
+    AINC( gAsync.stat.records );
+    (void)sem_post( &gAsync.sem );
+}
+
+static void writeIov( int iFd, struct iovec *ioIov, int iCnt )
+{
+    while( iCnt > 0 ) {
+        ssize_t  ret = writev( iFd, ioIov, iCnt );
+        if( ret < 0 ) {
+            if( errno == EINTR ) {continue;}
+            return;
+        }
+        size_t  done = (size_t)ret;
+        while( iCnt > 0 && done >= ioIov->iov_len ) {
+            done -= ioIov->iov_len;
+            ioIov++;
+            iCnt--;
+        }
+        if( iCnt > 0 ) {
+            ioIov->iov_base = (char*)ioIov->iov_base + done;
+            ioIov->iov_len -= done;
+        }
+    }
+}
+
+// 取り出したデータ (スロットはすぐ空きに戻すのでコピーして書き込む)
+typedef struct {
+    FILE*    fp;
+    size_t   len;
+    char     data[ASYNC_SLOT_SIZE];
+} asyncRecord_t;
+
+static asyncRecord_t  gAsyncBatch[ASYNC_BATCH];
+
+// 出力先が同じデータはまとめて writev()する
+static void writeBatch( long iCnt )
+{
+    struct iovec  iov[ASYNC_BATCH];
+    for( long top = 0;  top < iCnt;  ) {
+        int  cnt = 0;
+        FILE*  fp = gAsyncBatch[top].fp;
+        while( top < iCnt && gAsyncBatch[top].fp == fp ) {
+            iov[cnt].iov_base = gAsyncBatch[top].data;
+            iov[cnt].iov_len = gAsyncBatch[top].len;
+            cnt++;
+            top++;
+        }
+        writeIov( fileno( fp ), iov, cnt );
+    }
+}
+
+// 積まれた出力を取り出して書き込む。何も無ければ falseを返す。
+// 1件の出力がバッチに収まらない場合は、途中で書き込んで続きをコピーする。
+static BOOL writeRecords( void )
+{
+    long  cnt = 0;
+    ulong  done = 0;    // コピーを終えた出力数
+    size_t  pos, count;
+    BOOL  taken = false;
+    while( takeRecord( &pos, &count ) ) {
+        taken = true;
+        for( size_t i = 0;  i < count;  i++ ) {
+            if( cnt == ASYNC_BATCH ) {
+                writeBatch( cnt );
+                __atomic_add_fetch( &gAsync.stat.written, done,
+                                    __ATOMIC_RELAXED );
+                cnt = 0;
+                done = 0;
+            }
+            asyncSlot_t*  slot = &(gAsync.slot[(pos + i) & gAsync.mask]);
+            asyncRecord_t*  rec = &(gAsyncBatch[cnt++]);
+            rec->fp = slot->fp;
+            rec->len = slot->len;
+            memcpy( rec->data, slot->data, slot->len );
+        }
+        releaseSlots( pos, count );
+        done++;
+    }
+    writeBatch( cnt );
+    __atomic_add_fetch( &gAsync.stat.written, done, __ATOMIC_RELAXED );
+    return taken;
+}
+
+static void *asyncWriter( void *iArg )
+{
+    COM_UNUSED( iArg );
+    while(1) {
+        while( sem_wait( &gAsync.sem ) && errno == EINTR ) {}
+        ASTORE( gAsync.writing, true );
+        while( writeRecords() ) {}
+        ASTORE( gAsync.writing, false );
+        if( ALOAD( gAsync.stop ) ) {break;}
+    }
+    return NULL;
+}
+
+// 積んだデータが全て書き込まれるまで待つ
+static void drainAsync( void )
+{
+    if( !gAsyncOutput ) {return;}
+    while( ALOAD( gAsync.deqPos ) != ALOAD( gAsync.enqPos ) ||
+           ALOAD( gAsync.writing ) ) {
+        (void)sem_post( &gAsync.sem );
+        waitAsync();
+    }
+}
+
+static size_t getSlotCount( long iSlots )
+{
+    size_t  cnt = 1;
+    if( iSlots <= 0 ) {iSlots = ASYNC_SLOTS_DEFAULT;}
+    while( cnt < (size_t)iSlots ) {cnt <<= 1;}
+    return cnt;
+}
+
+static BOOL startAsync( long iSlots, COM_ASYNCOUT_POLICY_t iPolicy )
+{
+    size_t  cnt = getSlotCount( iSlots );
+    // com_malloc()はメモリ監視で画面出力することがあるので使わない
+    asyncSlot_t*  slot = calloc( cnt, sizeof(*slot) );
+    if( !slot ) {return false;}
+    for( size_t i = 0;  i < cnt;  i++ ) {slot[i].seq = i;}
+    gAsync = (asyncOut_t){
+        .slot = slot, .mask = cnt - 1, .policy = iPolicy
+    };
+    if( sem_init( &gAsync.sem, 0, 0 ) ) {free( slot );  return false;}
+    if( pthread_create( &gAsync.thread, NULL, asyncWriter, NULL ) ) {
+        (void)sem_destroy( &gAsync.sem );
+        free( slot );
+        return false;
+    }
+    gAsyncOutput = true;
+    return true;
+}
+
+static void stopAsync( void )
+{
+    if( !gAsyncOutput ) {return;}
+    drainAsync();
+    gAsyncOutput = false;
+    ASTORE( gAsync.stop, true );
+    (void)sem_post( &gAsync.sem );
+    (void)pthread_join( gAsync.thread, NULL );
+    (void)sem_destroy( &gAsync.sem );
+    // malloc()で確保しているので、com_free()は使用しない
+    free( gAsync.slot );
+    gAsync.slot = NULL;
+}
+
+BOOL com_setAsyncOutput(
+        BOOL iMode, long iSlots, COM_ASYNCOUT_POLICY_t iPolicy )
+{
+    if( COM_UNLIKELY(iPolicy < COM_ASYNCOUT_BLOCK ||
+                     iPolicy > COM_ASYNCOUT_DROP_NEW) ) {COM_PRMNG(false);}
+    com_mutexLock( &gMutexOut, __func__ );
+    flushAllOutBuf();
+    stopAsync();
+    BOOL  result = true;
+    if( iMode ) {result = startAsync( iSlots, iPolicy );}
+    com_mutexUnlock( &gMutexOut, __func__ );
+    return result;
+}
+
+void com_getAsyncOutputStat( com_asyncOutStat_t *oStat )
+{
+    if( COM_UNLIKELY(!oStat) ) {COM_PRMNG();}
+    oStat->records = ALOAD( gAsync.stat.records );
+    oStat->written = ALOAD( gAsync.stat.written );
+    oStat->dropped = ALOAD( gAsync.stat.dropped );
+    oStat->blocked = ALOAD( gAsync.stat.blocked );
+}
+
+// バイナリトレース (com_setBinaryTrace()) -----------------------------------
+//
+// 記録はスレッドごとのバッファに対して行い、gMutexOutは使わない。
+// バッファはファイルへの書き出し時に他スレッドからも触るので、バッファごとに
+// mutexを持つ。com_mutexLock()は排他のたびに文字列整形をするので使わない。
+// ロックの順番は gTrcListMutex → バッファの mutex → gTrcFileMutex とする。
+
+enum {
+    TRC_BUF_SIZE = 65536,       // スレッドごとのバッファサイズ
+    TRC_REC_MAX = 8192,         // 1レコードの最大サイズ
+    TRC_KNOWN = 1024,           // 登録済み書式を覚えておく数 (2のべき乗)
+    TRC_PROBE = 8               // 登録済み書式の探索回数
+};
+
+// スレッドごとの記録バッファ
+typedef struct trcBuf {
+    struct trcBuf*    next;
+    pthread_mutex_t   mutex;
+    size_t            len;
+    const char*       known[TRC_KNOWN];    // 登録済みの書式アドレス
+    uint64_t          rec[TRC_REC_MAX / 8];   // レコード作成用
+    uint64_t          data[TRC_BUF_SIZE / 8];
+    BOOL              orphan;    // 終了処理で gTrcBufListから外された
+} trcBuf_t;
+
+static BOOL  gBinTrace = false;
+static FILE*  gTrcFp = NULL;
+static pthread_mutex_t  gTrcFileMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t  gTrcListMutex = PTHREAD_MUTEX_INITIALIZER;
+static trcBuf_t*  gTrcBufList = NULL;    // gTrcListMutexで排他する
+static __thread trcBuf_t*  gTrcBuf = NULL;
+static pthread_key_t  gTrcBufKey;
+
+// バッファの mutexをロックした状態で呼ぶこと
+static void flushTrcBuf( trcBuf_t *ioBuf )
+{
+    if( !ioBuf->len ) {return;}
+    pthread_mutex_lock( &gTrcFileMutex );
+    if( gTrcFp ) {(void)fwrite( ioBuf->data, 1, ioBuf->len, gTrcFp );}
+    pthread_mutex_unlock( &gTrcFileMutex );
+    ioBuf->len = 0;
+}
+
+static void flushAllTrcBuf( void )
+{
+    pthread_mutex_lock( &gTrcListMutex );
+    for( trcBuf_t* buf = gTrcBufList;  buf;  buf = buf->next ) {
+        pthread_mutex_lock( &buf->mutex );
+        flushTrcBuf( buf );
+        pthread_mutex_unlock( &buf->mutex );
+    }
+    pthread_mutex_lock( &gTrcFileMutex );
+    if( gTrcFp ) {fflush( gTrcFp );}
+    pthread_mutex_unlock( &gTrcFileMutex );
+    pthread_mutex_unlock( &gTrcListMutex );
+}
+
+// 以下は com_debug()・com_dbgCom()からのみ使用する
+#ifndef CHECK_PRINT_FORMAT    // make checkfを打った時に指定されるマクロ
+static pthread_once_t  gTrcBufOnce = PTHREAD_ONCE_INIT;
+
+// スレッド終了時に書き出して解放する
+static void releaseTrcBuf( void *ioBuf )
+{
+    trcBuf_t*  target = ioBuf;
+    pthread_mutex_lock( &gTrcListMutex );
+    pthread_mutex_lock( &target->mutex );
+    // 終了処理後は記録ファイルが閉じられているので、書き出さない
+    if( !target->orphan ) {flushTrcBuf( target );}
+    pthread_mutex_unlock( &target->mutex );
+    for( trcBuf_t** ptr = &gTrcBufList;  *ptr;  ptr = &((*ptr)->next) ) {
+        if( *ptr == target ) {*ptr = (*ptr)->next;  break;}
+    }
+    pthread_mutex_unlock( &gTrcListMutex );
+    (void)pthread_mutex_destroy( &target->mutex );
+    // malloc()で確保しているので、com_free()は使用しない
+    free( target );
+}
+
+static void createTrcBufKey( void )
+{
+    (void)pthread_key_create( &gTrcBufKey, releaseTrcBuf );
+}
+
+static trcBuf_t *getTrcBuf( void )
+{
+    if( gTrcBuf ) {return gTrcBuf;}
+    (void)pthread_once( &gTrcBufOnce, createTrcBufKey );
+    // com_malloc()はメモリ監視でデバッグ出力することがあるので使わない
+    trcBuf_t*  buf = calloc( 1, sizeof(*buf) );
+    if( !buf ) {return NULL;}
+    (void)pthread_mutex_init( &buf->mutex, NULL );
+    pthread_mutex_lock( &gTrcListMutex );
+    buf->next = gTrcBufList;
+    gTrcBufList = buf;
+    pthread_mutex_unlock( &gTrcListMutex );
+    (void)pthread_setspecific( gTrcBufKey, buf );
+    gTrcBuf = buf;
+    return buf;
+}
+
+static size_t alignRec( size_t iSize )
+{
+    return (iSize + 7) & ~(size_t)7;
+}
+
+// バッファの mutexをロックした状態で呼ぶこと
+static char *reserveTrcRec( trcBuf_t *ioBuf, size_t iSize )
+{
+    if( ioBuf->len + iSize > TRC_BUF_SIZE ) {flushTrcBuf( ioBuf );}
+    char*  rec = (char*)ioBuf->data + ioBuf->len;
+    ioBuf->len += iSize;
+    memset( rec, 0, iSize );
+    return rec;
+}
+
+// 書式を初めて使った時だけ、書式文字列のレコードを記録する。
+// 覚えておける数を超えた分は忘れるので、同じ書式を再度記録することがある。
+static void registerFormat( trcBuf_t *ioBuf, const char *iFormat )
+{
+    size_t  idx = ((uintptr_t)iFormat >> 3) & (TRC_KNOWN - 1);
+    for( long i = 0;  i < TRC_PROBE;  i++ ) {
+        const char*  known = ioBuf->known[(idx + (size_t)i) & (TRC_KNOWN - 1)];
+        if( known == iFormat ) {return;}
+        if( !known ) {idx = (idx + (size_t)i) & (TRC_KNOWN - 1);  break;}
+    }
+    ioBuf->known[idx] = iFormat;
+    size_t  len = strlen( iFormat ) + 1;
+    size_t  head = sizeof(com_btrcRec_t) + sizeof(uint64_t);
+    if( head + len > TRC_REC_MAX ) {len = TRC_REC_MAX - head;}
+    size_t  size = alignRec( head + len );
+    char*  rec = reserveTrcRec( ioBuf, size );
+    com_btrcRec_t  recHead = { COM_BTRC_FORMAT, (uint32_t)size };
+    memcpy( rec, &recHead, sizeof(recHead) );
+    uint64_t  addr = (uintptr_t)iFormat;
+    memcpy( rec + sizeof(recHead), &addr, sizeof(addr) );
+    memcpy( rec + head, iFormat, len - 1 );
+}
+
+// 書式の長さ修飾子
+typedef enum {
+    TRC_MOD_NONE = 0, TRC_MOD_L, TRC_MOD_LL, TRC_MOD_J, TRC_MOD_Z, TRC_MOD_T,
+    TRC_MOD_LD
+} TRC_MOD_t;
+
+static TRC_MOD_t getTrcModifier( const char **ioFmt )
+{
+    const char*  fmt = *ioFmt;
+    TRC_MOD_t  mod = TRC_MOD_NONE;
+    switch( *fmt ) {
+        case 'h':  fmt++;  if( *fmt == 'h' ) {fmt++;}  break;
+        case 'l':  fmt++;  mod = TRC_MOD_L;
+                   if( *fmt == 'l' ) {fmt++;  mod = TRC_MOD_LL;}  break;
+        case 'q':  fmt++;  mod = TRC_MOD_LL;   break;
+        case 'j':  fmt++;  mod = TRC_MOD_J;    break;
+        case 'z':  fmt++;  mod = TRC_MOD_Z;    break;
+        case 't':  fmt++;  mod = TRC_MOD_T;    break;
+        case 'L':  fmt++;  mod = TRC_MOD_LD;   break;
+        default:  break;
+    }
+    *ioFmt = fmt;
+    return mod;
+}
+
+// 変換指定子から引数の型を得る。解析できない場合は 0を返す。
+static COM_BTRC_ARG_t getTrcArgType( char iConv, TRC_MOD_t iMod )
+{
+    const COM_BTRC_ARG_t  INTS[] = {
+        COM_BTRC_INT, COM_BTRC_LONG, COM_BTRC_LLONG, COM_BTRC_INTMAX,
+        COM_BTRC_SIZE, COM_BTRC_PTRDIFF, COM_BTRC_INT
+    };
+    if( strchr( "diouxX", iConv ) ) {return INTS[iMod];}
+    if( strchr( "eEfFgGaA", iConv ) ) {
+        return (iMod == TRC_MOD_LD) ? COM_BTRC_LDOUBLE : COM_BTRC_DOUBLE;
+    }
+    if( iMod != TRC_MOD_NONE ) {return 0;}    // %ls・%lc は扱わない
+    if( iConv == 'c' ) {return COM_BTRC_INT;}
+    if( iConv == 's' ) {return COM_BTRC_STR;}
+    if( iConv == 'p' ) {return COM_BTRC_PTR;}
+    return 0;
+}
+
+// レコード作成中の情報
+typedef struct {
+    char*     rec;
+    size_t    len;
+    long      argCnt;
+    BOOL      ok;          // 解析できたかどうか
+} trcRec_t;
+
+static void addTrcArg(
+        trcRec_t *ioRec, COM_BTRC_ARG_t iType, const void *iValue,
+        size_t iLen )
+{
+    size_t  size = alignRec( sizeof(com_btrcArg_t) + iLen );
+    if( ioRec->len + size > TRC_REC_MAX ) {
+        // 文字列は入る分だけ記録する
+        if( iType != COM_BTRC_STR ||
+            ioRec->len + sizeof(com_btrcArg_t) + 8 > TRC_REC_MAX )
+        {
+            ioRec->ok = false;
+            return;
+        }
+        iLen = (TRC_REC_MAX - ioRec->len - sizeof(com_btrcArg_t)) & ~7ul;
+        size = sizeof(com_btrcArg_t) + iLen;
+    }
+    com_btrcArg_t  arg = { (uint32_t)iType, (uint32_t)iLen };
+    memcpy( ioRec->rec + ioRec->len, &arg, sizeof(arg) );
+    memset( ioRec->rec + ioRec->len + sizeof(arg), 0, size - sizeof(arg) );
+    memcpy( ioRec->rec + ioRec->len + sizeof(arg), iValue, iLen );
+    ioRec->len += size;
+    ioRec->argCnt++;
+}
+
+// va_argは型を直接書く必要があるため、型ごとに値を取り出して記録する
+#define ADD_TRC_ARG( TYPE, VATYPE ) \
+    do { \
+        TYPE  value_ = (TYPE)va_arg( *ioAp, VATYPE ); \
+        addTrcArg( ioRec, iType, &value_, sizeof(value_) ); \
+    } while(0)
+
+static void addTrcValue( trcRec_t *ioRec, COM_BTRC_ARG_t iType, va_list *ioAp )
+{
+    switch( iType ) {
+        case COM_BTRC_INT:      ADD_TRC_ARG( int64_t, int );          break;
+        case COM_BTRC_LONG:     ADD_TRC_ARG( int64_t, long );         break;
+        case COM_BTRC_LLONG:    ADD_TRC_ARG( int64_t, long long );    break;
+        case COM_BTRC_INTMAX:   ADD_TRC_ARG( int64_t, intmax_t );     break;
+        case COM_BTRC_SIZE:     ADD_TRC_ARG( uint64_t, size_t );      break;
+        case COM_BTRC_PTRDIFF:  ADD_TRC_ARG( int64_t, ptrdiff_t );    break;
+        case COM_BTRC_DOUBLE:   ADD_TRC_ARG( double, double );        break;
+        case COM_BTRC_LDOUBLE:  ADD_TRC_ARG( long double, long double );  break;
+        case COM_BTRC_PTR:      ADD_TRC_ARG( uint64_t, void* );       break;
+        case COM_BTRC_STR: {
+            const char*  str = va_arg( *ioAp, const char* );
+            if( !str ) {str = "(null)";}
+            addTrcArg( ioRec, iType, str, strlen( str ) );
+            break;
+        }
+        default:  ioRec->ok = false;  break;
+    }
+}
+
+// 変換指定 1つ分 (%の次から) を解析して引数を記録する
+static const char *addTrcConversion(
+        trcRec_t *ioRec, const char *iFmt, va_list *ioAp )
+{
+    if( *iFmt == '%' ) {return iFmt + 1;}
+    while( *iFmt && strchr( "-+ #0'", *iFmt ) ) {iFmt++;}
+    if( *iFmt == '*' ) {addTrcValue( ioRec, COM_BTRC_INT, ioAp );  iFmt++;}
+    while( isdigit( (uchar)*iFmt ) ) {iFmt++;}
+    if( *iFmt == '$' ) {ioRec->ok = false;  return iFmt;}
+    if( *iFmt == '.' ) {
+        iFmt++;
+        if( *iFmt == '*' ) {addTrcValue( ioRec, COM_BTRC_INT, ioAp );  iFmt++;}
+        while( isdigit( (uchar)*iFmt ) ) {iFmt++;}
+    }
+    TRC_MOD_t  mod = getTrcModifier( &iFmt );
+    COM_BTRC_ARG_t  type = getTrcArgType( *iFmt, mod );
+    if( !*iFmt || !type ) {ioRec->ok = false;  return iFmt;}
+    addTrcValue( ioRec, type, ioAp );
+    return iFmt + 1;
+}
+
+static void setTrcLogHead(
+        trcRec_t *ioRec, COM_BTRC_REC_t iType, const char *iFormat,
+        BOOL iCom )
+{
+    struct timeval  now;
+    (void)gettimeofday( &now, NULL );
+    com_btrcLog_t  head = {
+        .rec = { (uint32_t)iType, (uint32_t)ioRec->len },
+        .format = (iType == COM_BTRC_LOG) ? (uintptr_t)iFormat : 0,
+        .sec = now.tv_sec,  .usec = now.tv_usec,
+        .argCnt = (uint32_t)ioRec->argCnt,  .isCom = iCom ? 1 : 0
+    };
+    memcpy( ioRec->rec, &head, sizeof(head) );
+}
+
+// 解析できない書式は整形済み文字列で記録する
+static void makeTrcText(
+        trcRec_t *ioRec, const char *iFormat, va_list iAp )
+{
+    size_t  head = sizeof(com_btrcLog_t);
+    int  len = vsnprintf( ioRec->rec + head, TRC_REC_MAX - head, iFormat, iAp );
+    if( len < 0 ) {len = 0;}
+    if( (size_t)len >= TRC_REC_MAX - head ) {len = TRC_REC_MAX - (int)head - 1;}
+    ioRec->len = alignRec( head + (size_t)len + 1 );
+    memset( ioRec->rec + head + len, 0, ioRec->len - head - (size_t)len );
+    ioRec->argCnt = 0;
+}
+
+// 記録できなかった場合は falseを返す (呼び元で通常の出力をする)
+static BOOL traceBinary( BOOL iCom, const char *iFormat, va_list iAp )
+{
+    if( iCom && gNoComDebugLog ) {return true;}
+    trcBuf_t*  buf = getTrcBuf();
+    if( !buf ) {return false;}
+    pthread_mutex_lock( &buf->mutex );
+    trcRec_t  rec = { (char*)buf->rec, sizeof(com_btrcLog_t), 0, true };
+    va_list  ap;
+    va_copy( ap, iAp );
+    for( const char* fmt = iFormat;  *fmt && rec.ok;  ) {
+        if( *fmt++ == '%' ) {fmt = addTrcConversion( &rec, fmt, &ap );}
+    }
+    va_end( ap );
+    COM_BTRC_REC_t  type = COM_BTRC_LOG;
+    if( rec.ok ) {registerFormat( buf, iFormat );}
+    else {makeTrcText( &rec, iFormat, iAp );  type = COM_BTRC_TEXT;}
+    setTrcLogHead( &rec, type, iFormat, iCom );
+    memcpy( reserveTrcRec( buf, rec.len ), rec.rec, rec.len );
+    pthread_mutex_unlock( &buf->mutex );
+    return true;
+}
+#endif   // CHECK_PRINT_FORMAT
+
+static BOOL openBinaryTrace( const char *iPath )
+{
+    // デバッグ出力が記録されてしまうので、com_fopen()は使用しない
+    FILE*  fp = fopen( iPath, "wb" );
+    if( !fp ) {
+        com_error( COM_ERR_FILEDIRNG, "fail to open trace file(%s)", iPath );
+        return false;
+    }
+    com_btrcHead_t  head = {
+        COM_BTRC_MAGIC, COM_BTRC_VERSION, COM_BTRC_ORDER
+    };
+    (void)fwrite( &head, sizeof(head), 1, fp );
+    // 前回の記録の残りと、書式の登録状況をクリアする
+    pthread_mutex_lock( &gTrcListMutex );
+    for( trcBuf_t* buf = gTrcBufList;  buf;  buf = buf->next ) {
+        pthread_mutex_lock( &buf->mutex );
+        buf->len = 0;
+        memset( buf->known, 0, sizeof(buf->known) );
+        pthread_mutex_unlock( &buf->mutex );
+    }
+    pthread_mutex_unlock( &gTrcListMutex );
+    pthread_mutex_lock( &gTrcFileMutex );
+    gTrcFp = fp;
+    pthread_mutex_unlock( &gTrcFileMutex );
+    __atomic_store_n( &gBinTrace, true, __ATOMIC_RELEASE );
+    return true;
+}
+
+static void closeBinaryTrace( void )
+{
+    __atomic_store_n( &gBinTrace, false, __ATOMIC_RELEASE );
+    flushAllTrcBuf();
+    pthread_mutex_lock( &gTrcFileMutex );
+    // fopen()で開いているので、com_fclose()は使用しない
+    if( gTrcFp ) {fclose( gTrcFp );}
+    gTrcFp = NULL;
+    pthread_mutex_unlock( &gTrcFileMutex );
+}
+
+BOOL com_setBinaryTrace( const char *iPath )
+{
+    closeBinaryTrace();
+    if( !iPath ) {return true;}
+    return openBinaryTrace( iPath );
+}
+
+// 全バッファの解放 (com_finalizeDebugMode()から呼ぶ)
+static void freeAllTrcBuf( void )
+{
+    closeBinaryTrace();
+    // 他スレッドのバッファはまだ参照されているので、リストから外すだけにして
+    // そのスレッドの終了時に releaseTrcBuf()で解放させる
+    pthread_mutex_lock( &gTrcListMutex );
+    while( gTrcBufList ) {
+        trcBuf_t*  buf = gTrcBufList;
+        gTrcBufList = buf->next;
+        pthread_mutex_lock( &buf->mutex );
+        buf->orphan = true;
+        pthread_mutex_unlock( &buf->mutex );
+    }
+    pthread_mutex_unlock( &gTrcListMutex );
+    if( !gTrcBuf ) {return;}
+    (void)pthread_setspecific( gTrcBufKey, NULL );
+    (void)pthread_mutex_destroy( &gTrcBuf->mutex );
+    free( gTrcBuf );
+    gTrcBuf = NULL;
+}
+
+// フライトレコーダー (com_setFlightRecorder()) ------------------------------
+//
+// リングの位置(head/tail)は通算のバイト数で持ち、リング上の位置は sizeで
+// 割った余りとする。上書きする範囲の tailを先に進めてから書き込み、書き終えて
+// から headを進めるので、途中でプロセスが消えても tail～head は壊れない。
+// 記録側の排他は pthread_mutex (競合しなければシステムコールは発生しない)。
+
+enum {
+    FLTREC_SIZE_DEFAULT = 1024 * 1024,    // リングサイズのデフォルト
+    FLTREC_TEXT_MAX = COM_DATABUF_SIZE    // 1レコードの文字列の最大長
+};
+
+static com_fltrecHead_t*  gFltHead = NULL;    // mmap()した領域の先頭
+static char*  gFltRing = NULL;
+static size_t  gFltMapSize = 0;
+static pthread_mutex_t  gFltMutex = PTHREAD_MUTEX_INITIALIZER;
+static BOOL  gFlightRec = false;
+
+static size_t alignFltRec( size_t iSize )
+{
+    return (iSize + 7) & ~(size_t)7;
+}
+
+// 最古のレコードを捨てて、iPos + iSize までを書き込み可能にする
+static void makeFltRoom( uint64_t iPos, size_t iSize )
+{
+    com_fltrecHead_t*  head = gFltHead;
+    while( iPos + iSize - head->tail > head->size ) {
+        size_t  off = (size_t)(head->tail % head->size);
+        size_t  rest = (size_t)head->size - off;
+        com_fltrecRec_t*  rec = (com_fltrecRec_t*)(gFltRing + off);
+        size_t  skip = rest;
+        if( rest >= sizeof(*rec) && rec->size && rec->size <= rest ) {
+            skip = rec->size;
+        }
+        __atomic_store_n( &head->tail, head->tail + skip, __ATOMIC_RELEASE );
+    }
+}
+
+// リング終端に入りきらない場合は詰め物をして先頭に戻る
+static void wrapFltRing( size_t iSize )
+{
+    com_fltrecHead_t*  head = gFltHead;
+    size_t  off = (size_t)(head->head % head->size);
+    size_t  rest = (size_t)head->size - off;
+    if( rest >= iSize ) {return;}
+    makeFltRoom( head->head, rest );
+    if( rest >= sizeof(com_fltrecRec_t) ) {
+        *(com_fltrecRec_t*)(gFltRing + off) =
+            (com_fltrecRec_t){ .size = (uint32_t)rest, .kind = COM_FLTREC_PAD };
+    }
+    __atomic_store_n( &head->head, head->head + rest, __ATOMIC_RELEASE );
+}
+
+static void writeFltRec(
+        COM_FLTREC_KIND_t iKind, const char *iText, const char *iAdd )
+{
+    size_t  textLen = strlen( iText );
+    size_t  addLen = iAdd ? strlen( iAdd ) : 0;
+    // 末尾の改行は記録しない (表示時に付ける)
+    if( !addLen && textLen && iText[textLen - 1] == '\n' ) {textLen--;}
+    if( textLen > FLTREC_TEXT_MAX ) {textLen = FLTREC_TEXT_MAX;}
+    if( textLen + addLen > FLTREC_TEXT_MAX ) {
+        addLen = FLTREC_TEXT_MAX - textLen;
+    }
+    size_t  size =
+        alignFltRec( sizeof(com_fltrecRec_t) + textLen + addLen + 1 );
+    struct timeval  now;
+    (void)gettimeofday( &now, NULL );
+    pthread_mutex_lock( &gFltMutex );
+    com_fltrecHead_t*  head = gFltHead;
+    if( head && size <= head->size ) {
+        __atomic_store_n( &head->writing, 1, __ATOMIC_RELEASE );
+        wrapFltRing( size );
+        makeFltRoom( head->head, size );
+        char*  rec = gFltRing + head->head % head->size;
+        *(com_fltrecRec_t*)rec = (com_fltrecRec_t){
+            (uint32_t)size, (uint32_t)iKind, now.tv_sec, now.tv_usec,
+            head->seq++
+        };
+        char*  text = rec + sizeof(com_fltrecRec_t);
+        memcpy( text, iText, textLen );
+        memcpy( text + textLen, iAdd, addLen );
+        memset( text + textLen + addLen, 0,
+                size - sizeof(com_fltrecRec_t) - textLen - addLen );
+        __atomic_store_n( &head->head, head->head + size, __ATOMIC_RELEASE );
+        __atomic_store_n( &head->writing, 0, __ATOMIC_RELEASE );
+    }
+    pthread_mutex_unlock( &gFltMutex );
+}
+
+#ifndef CHECK_PRINT_FORMAT    // make checkfを打った時に指定されるマクロ
+// com_debug()・com_dbgCom()からのみ使用する
+static void recordFlight( BOOL iCom, const char *iFormat, va_list iAp )
+{
+    if( iCom && gNoComDebugLog ) {return;}
+    char  text[FLTREC_TEXT_MAX];
+    vsnprintf( text, sizeof(text), iFormat, iAp );
+    writeFltRec( iCom ? COM_FLTREC_COM : COM_FLTREC_DBG, text, NULL );
+}
+#endif   // CHECK_PRINT_FORMAT
+
+static void setFltState( COM_FLTREC_STATE_t iState, long iCode )
+{
+    com_fltrecHead_t*  head = gFltHead;
+    if( !head ) {return;}
+    head->code = (int32_t)iCode;
+    __atomic_store_n( &head->state, (uint32_t)iState, __ATOMIC_RELEASE );
+}
+
+void com_sealFlightRecorder( int iSignal )
+{
+    // シグナルハンドラーから呼ばれるので、非同期シグナル安全な処理のみ行う
+    setFltState( iSignal ? COM_FLTREC_SIGNAL : COM_FLTREC_CLOSED, iSignal );
+    if( !iSignal ) {return;}
+    (void)signal( iSignal, SIG_DFL );
+    (void)raise( iSignal );
+}
+
+void com_markExitFlightRecorder( long iCode )
+{
+    setFltState( COM_FLTREC_EXIT, iCode );
+}
+
+static void closeFlightRecorder( void )
+{
+    if( !gFltHead ) {return;}
+    __atomic_store_n( &gFlightRec, false, __ATOMIC_RELEASE );
+    pthread_mutex_lock( &gFltMutex );
+    if( gFltHead->state == COM_FLTREC_RUNNING ) {
+        setFltState( COM_FLTREC_CLOSED, 0 );
+    }
+    (void)munmap( gFltHead, gFltMapSize );
+    gFltHead = NULL;
+    gFltRing = NULL;
+    pthread_mutex_unlock( &gFltMutex );
+}
+
+static void *mapFltFile( const char *iPath, size_t iMapSize )
+{
+    // デバッグ出力が記録されてしまうので、com_fopen()等は使用しない
+    int  fd = open( iPath, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+    if( fd < 0 ) {return NULL;}
+    void*  map = MAP_FAILED;
+    if( !ftruncate( fd, (off_t)iMapSize ) ) {
+        map = mmap( NULL, iMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    }
+    (void)close( fd );
+    return (map == MAP_FAILED) ? NULL : map;
+}
+
+static size_t getFltSize( size_t iSize )
+{
+    size_t  page = (size_t)sysconf( _SC_PAGESIZE );
+    if( !iSize ) {iSize = FLTREC_SIZE_DEFAULT;}
+    return (iSize + page - 1) / page * page;
+}
+
+BOOL com_setFlightRecorder( const char *iPath, size_t iSize )
+{
+    closeFlightRecorder();
+    if( !iPath ) {return true;}
+    size_t  size = getFltSize( iSize );
+    size_t  mapSize = COM_FLTREC_HEADSIZE + size;
+    com_fltrecHead_t*  head = mapFltFile( iPath, mapSize );
+    if( !head ) {
+        com_error( COM_ERR_FILEDIRNG, "fail to map flight recorder(%s/%d)",
+                   iPath, errno );
+        return false;
+    }
+    *head = (com_fltrecHead_t){
+        .magic = COM_FLTREC_MAGIC, .version = COM_FLTREC_VERSION,
+        .order = COM_BTRC_ORDER, .size = size, .pid = getpid()
+    };
+    pthread_mutex_lock( &gFltMutex );
+    gFltHead = head;
+    gFltRing = (char*)head + COM_FLTREC_HEADSIZE;
+    gFltMapSize = mapSize;
+    pthread_mutex_unlock( &gFltMutex );
+    __atomic_store_n( &gFlightRec, true, __ATOMIC_RELEASE );
+    return true;
+}
+
+// com_dumpFlightRecorder()で使用する読み込み情報
+typedef struct {
+    const com_fltrecHead_t*   head;
+    const char*               ring;
+    uint64_t                  pos;      // 読み込み位置 (通算)
+} fltReader_t;
+
+static const com_fltrecRec_t *nextFltRec( fltReader_t *ioReader )
+{
+    const com_fltrecHead_t*  head = ioReader->head;
+    while( ioReader->pos < head->head ) {
+        size_t  off = (size_t)(ioReader->pos % head->size);
+        size_t  rest = (size_t)head->size - off;
+        const com_fltrecRec_t*  rec =
+            (const com_fltrecRec_t*)(ioReader->ring + off);
+        if( rest < sizeof(*rec) ) {ioReader->pos += rest;  continue;}
+        if( rec->size < sizeof(*rec) || rec->size > rest || rec->size % 8 ) {
+            return NULL;    // 壊れている
+        }
+        ioReader->pos += rec->size;
+        if( rec->kind != COM_FLTREC_PAD ) {return rec;}
+    }
+    return NULL;
+}
+
+static void dumpFltRec( const com_fltrecRec_t *iRec )
+{
+    const char*  LABEL[] = { "", "DBG", "COM", "ERR" };
+    const char*  label = "?";
+    if( iRec->kind <= COM_FLTREC_ERR ) {label = LABEL[iRec->kind];}
+    struct tm  tm;
+    time_t  sec = (time_t)iRec->sec;
+    if( !localtime_r( &sec, &tm ) ) {memset( &tm, 0, sizeof(tm) );}
+    const char*  line = (const char*)(iRec + 1);
+    const char*  end = (const char*)iRec + iRec->size;
+    while( line < end && *line ) {
+        const char*  lf = memchr( line, '\n', (size_t)(end - line) );
+        int  len = (int)strnlen( line, (size_t)(lf ? lf - line : end - line) );
+        com_printf( "[%02d%02d%02d %02d%02d%02d.%06ld][%s] %.*s\n",
+                    tm.tm_year % 100, tm.tm_mon + 1, tm.tm_mday,
+                    tm.tm_hour, tm.tm_min, tm.tm_sec, (long)iRec->usec,
+                    label, len, line );
+        if( !lf ) {break;}
+        line = lf + 1;
+    }
+}
+
+static void dumpFltHead( const char *iPath, const com_fltrecHead_t *iHead )
+{
+    const char*  STATE[] = { "running (or died)", "closed", "signal", "exit" };
+    const char*  state =
+        (iHead->state <= COM_FLTREC_EXIT) ? STATE[iHead->state] : "?";
+    com_printf( "flight recorder %s (pid=%ld records=%lu)\n",
+                iPath, (long)iHead->pid, (ulong)iHead->seq );
+    com_printf( "  state=%s code=%ld%s\n", state, (long)iHead->code,
+                iHead->writing ? " (stopped while writing a record)" : "" );
+}
+
+static BOOL dumpFltRing(
+        const char *iPath, const com_fltrecHead_t *iHead, long iCount )
+{
+    fltReader_t  reader = { iHead, (const char*)iHead + COM_FLTREC_HEADSIZE,
+                            iHead->tail };
+    long  total = 0;
+    while( nextFltRec( &reader ) ) {total++;}
+    BOOL  broken = (reader.pos < iHead->head);
+    dumpFltHead( iPath, iHead );
+    reader.pos = iHead->tail;
+    long  skip = (iCount > 0 && total > iCount) ? total - iCount : 0;
+    const com_fltrecRec_t*  rec = NULL;
+    while( (rec = nextFltRec( &reader )) ) {
+        if( skip ) {skip--;  continue;}
+        dumpFltRec( rec );
+    }
+    if( broken ) {
+        com_error( COM_ERR_DEBUGNG, "flight recorder is broken(%s)", iPath );
+    }
+    return !broken;
+}
+
+static BOOL checkFltHead( const char *iPath, const com_fltrecHead_t *iHead,
+                          size_t iFileSize )
+{
+    if( memcmp( iHead->magic, COM_FLTREC_MAGIC, sizeof(COM_FLTREC_MAGIC) ) ||
+        iHead->version != COM_FLTREC_VERSION ||
+        iHead->order != COM_BTRC_ORDER ||
+        COM_FLTREC_HEADSIZE + iHead->size > iFileSize ||
+        iHead->tail > iHead->head || iHead->head - iHead->tail > iHead->size )
+    {
+        com_error( COM_ERR_DEBUGNG, "not a flight recorder(%s)", iPath );
+        return false;
+    }
+    return true;
+}
+
+BOOL com_dumpFlightRecorder( const char *iPath, long iCount )
+{
+    if( COM_UNLIKELY(!iPath) ) {COM_PRMNG(false);}
+    int  fd = open( iPath, O_RDONLY );
+    struct stat  st;
+    if( fd < 0 || fstat( fd, &st ) ) {
+        if( fd >= 0 ) {(void)close( fd );}
+        com_error( COM_ERR_FILEDIRNG, "fail to open flight recorder(%s)",
+                   iPath );
+        return false;
+    }
+    size_t  fileSize = (size_t)st.st_size;
+    void*  map = MAP_FAILED;
+    if( fileSize >= COM_FLTREC_HEADSIZE ) {
+        map = mmap( NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0 );
+    }
+    (void)close( fd );
+    if( map == MAP_FAILED ) {
+        com_error( COM_ERR_DEBUGNG, "not a flight recorder(%s)", iPath );
+        return false;
+    }
+    BOOL  result = checkFltHead( iPath, map, fileSize );
+    if( result ) {result = dumpFltRing( iPath, map, iCount );}
+    (void)munmap( map, fileSize );
+    return result;
+}
+
+void com_flushOutput( void )
+{
+    if( gBinTrace ) {flushAllTrcBuf();}
+    if( !gBufferedOutput && !gAsyncOutput ) {return;}
+    com_mutexLock( &gMutexOut, __func__ );
+    flushAllOutBuf();
+    drainAsync();
+    com_mutexUnlock( &gMutexOut, __func__ );
+}
+
+// 全バッファの解放 (com_finalizeDebugMode()から呼ぶ)
+static void freeAllOutBuf( void )
+{
+    com_setBufferedOutput( false, 0, 0 );
+    (void)com_setAsyncOutput( false, 0, COM_ASYNCOUT_BLOCK );
+    // 他スレッドのバッファはまだ参照されているので、リストから外すだけにして
+    // そのスレッドの終了時に releaseOutBuf()で解放させる
+    com_mutexLock( &gMutexOut, __func__ );
+    while( gOutBufList ) {
+        outBuf_t*  buf = gOutBufList;
+        gOutBufList = buf->next;
+        buf->orphan = true;
+    }
+    com_mutexUnlock( &gMutexOut, __func__ );
+    if( !gOutBuf ) {return;}
+    (void)pthread_setspecific( gOutBufKey, NULL );
+    free( gOutBuf );
+    gOutBuf = NULL;
+}
+
+static size_t addTimeStamp( char *oBuf, size_t iSize, stamp_t *iStamp )
+{
+    if( !iStamp ) {return 0;}
+    return (size_t)snprintf( oBuf, iSize, "[%s %s]",
+                             iStamp->date, iStamp->time );
 }
 
 static void writeFile(
         FILE *ioFp, BOOL iLineTop, stamp_t *iStamp, char *iPrefixLabel )
 {
     if( COM_UNLIKELY(!ioFp) ) {return;}    // 念の為 NULLチェックを入れておく
+    char  head[COM_LINEBUF_SIZE];
+    size_t  len = 0;
     if( iLineTop ) {
-        dispTimeStamp( ioFp, iStamp );
-        if( iPrefixLabel ) {fprintf( ioFp, "[%s] ", iPrefixLabel );}
-        else if( iStamp ) {fprintf( ioFp, " " );}
+        len += addTimeStamp( head, sizeof(head), iStamp );
+        if( iPrefixLabel ) {
+            len += (size_t)snprintf( head + len, sizeof(head) - len,
+                                     "[%s] ", iPrefixLabel );
+        }
+        else if( iStamp ) {head[len++] = ' ';}
     }
     // 改行なしの途中でもデバッグ出力はまず改行して出力する
     else if( iPrefixLabel ) {
-        fprintf( ioFp, "\n" );
-        dispTimeStamp( ioFp, iStamp );
-        fprintf( ioFp, "[%s] ", iPrefixLabel );
+        head[len++] = '\n';
+        len += addTimeStamp( head + len, sizeof(head) - len, iStamp );
+        len += (size_t)snprintf( head + len, sizeof(head) - len,
+                                 "[%s] ", iPrefixLabel );
+    }
+    if( gAsyncOutput ) {enqueueOutput( ioFp, head, len, gWriteBuf );  return;}
+    if( gBufferedOutput ) {
+        if( bufferOutput( ioFp, head, len ) &&
+            bufferOutput( ioFp, gWriteBuf, strlen( gWriteBuf ) ) ) {return;}
     }
-    fprintf( ioFp, "%s", gWriteBuf );
+    (void)fwrite( head, 1, len, ioFp );
+    fputs( gWriteBuf, ioFp );
     fflush( ioFp );
 }
 
@@ -278,10 +1523,13 @@ static void printProc(
 {
     static BOOL  lineTop = true;
     if( iMode == COM_DEBUG_OFF ) {return;}
+    if( gPrintHook && iMode == COM_DEBUG_ON && iPrefix == NO_PREFIX ) {
+        gPrintHook( iText, gPrintHookData );
+        return;
+    }
 
     outputInf_t  outInf = { iMode, ioFp, &lineTop, {{0},{0}}, NULL };
-    stamp_t*  stamp = &(outInf.stamp);
-    com_getCurrentTime( COM_FORM_SIMPLE, stamp->date, stamp->time, NULL );
+    getTimeStamp( &(outInf.stamp) );
     if( !getDebugPrefix( iPrefix, &(outInf.prefix) ) ) {return;}
     // 改行コードごとに区切って1行ずつ出力
     (void)com_seekTextLine( iText, 0, true, outputLine, &outInf,
@@ -587,6 +1835,13 @@ static void debugCom( BOOL iCom )
 static void dispDebug( BOOL iCom, const char *iFormat, va_list iAp )
 {
     if( gPrintDebugMode == COM_DEBUG_OFF ) {return;}
+    if( __atomic_load_n( &gFlightRec, __ATOMIC_ACQUIRE ) && iFormat ) {
+        recordFlight( iCom, iFormat, iAp );
+        return;
+    }
+    if( __atomic_load_n( &gBinTrace, __ATOMIC_ACQUIRE ) && iFormat ) {
+        if( traceBinary( iCom, iFormat, iAp ) ) {return;}
+    }
     getLockAndForm( __func__, gLogBuff, sizeof(gLogBuff), iFormat, iAp );
     debugCom( iCom );
     com_mutexUnlock( &gMutexOut, __func__ );
@@ -695,7 +1950,8 @@ typedef struct {
     char*     name;    // 出力用ラベル
 } dbgErrCount_t;
 
-static com_sortTable_t  gErrorTable = {0, COM_SORT_SKIP, 0, NULL, NULL};
+static com_sortTable_t  gErrorTable =
+    {0, COM_SORT_SKIP, 0, NULL, NULL, 0};
 static BOOL  gOccuredError = false;   // エラー発生有無フラグ
 
 void com_registerErrorCode( const com_dbgErrName_t *iList )
@@ -830,6 +2086,18 @@ static void countError( long iCode )
 
 static char  gErrorLogBuf[COM_LINEBUF_SIZE];
 
+// エラー内容は改行を除き、発生箇所を付けて記録する
+static void recordFlightError( COM_FILEPRM )
+{
+    char  loc[COM_LINEBUF_SIZE];
+    snprintf( loc, sizeof(loc), " in %s:line %ld %s()", COM_FILEVAR );
+    char  text[COM_LINEBUF_SIZE];
+    (void)com_strcpy( text, gErrorLogBuf );
+    size_t  len = strlen( text );
+    if( len && text[len - 1] == '\n' ) {text[len - 1] = '\0';}
+    writeFltRec( COM_FLTREC_ERR, text, loc );
+}
+
 static void branchErrorOutput( char *iBuf, COM_DEBUG_MODE_t iDispMode )
 {
     FILE* logTarget = gErrLog ? gDebugLog : NULL;
@@ -885,6 +2153,7 @@ void com_errorFunc(
     }
     COM_DEBUG_LOCKOFF( &gMutexError, __func__ );
     SET_ERRORLOG;
+    if( gFlightRec ) {recordFlightError( COM_FILEVAR );}
     COM_HOOKERR_ACTION_t hookAct = hookExec( iCode, gErrorLogBuf, COM_FILEVAR );
     if( hookAct == COM_HOOKERR_SKIP ) {
         setErrorInf( iCode );
@@ -917,25 +2186,58 @@ char *com_strerror( int iErrno )
 
 // デバッグ監視機能共通処理 --------------------------------------------------
 
+// 監視情報のラベル
+// ファイル監視では同じ内容のラベルは1つにまとめ、参照数で管理する(インターン)。
+// 同じパスを繰り返し開く場合、監視データごとに固定長のラベルを持つより小さい。
+// メモリ監視のラベルはほとんどが一意で、捕捉ごとにラベルの捕捉/解放と
+// ハッシュ探索が増えるだけなので、インターンせずに監視データの直後に持つ。
+typedef struct {
+    ulong    refs;        // 参照数 (0になったら解放)
+    size_t   hash;        // textのハッシュ値
+    char     text[];
+} watchLabel_t;
+
 // デバッグ監視共通データ
+// 呼び元のファイル名と関数名は COM_FILELOCで渡される文字列リテラルなので
+// コピーせずにアドレスだけ保持する。
 typedef struct watchInfo {
     long          type;
     long          seqno;
     const void*   ptr;
     size_t        size;
-    char          label[COM_DEBUGINFO_LABEL]; // マクロ宣言は com_custom.h
+    size_t        sample;                     // 採取時のサンプリング間隔
     struct watchInfo*  prev;
     struct watchInfo*  next;
-    char          file[COM_DEBUGINFO_LABEL];  // 呼び元ファイル名
+    const char*   file;                       // 呼び元ファイル名
     long          line;                       // 呼び元ライン数
-    char          func[COM_DEBUGINFO_LABEL];  // 呼び元関数名
+    const char*   func;                       // 呼び元関数名
+    watchLabel_t* label;                      // インターンしたラベル
+    const char*   text;                       // データ直後に持つラベル
 } watchInfo_t;
 
+// どちらも NULLならラベルなし
+#define WATCH_LABEL( INFO ) \
+    ((INFO)->label ? (INFO)->label->text : (INFO)->text ? (INFO)->text : "")
+
+// 監視データはまとめて確保したスラブから切り出し、解放時は空きリストに戻す
+// (ラベルを直後に持つグループでは、間隔は getWatchUnit()の大きさになる)
+typedef struct watchSlab {
+    struct watchSlab*  next;
+    watchInfo_t        info[];
+} watchSlab_t;
+
 // デバッグ監視情報グループ
 typedef struct {
     watchInfo_t*   top;       // 先頭データ
     watchInfo_t*   last;      // 最終データ
-    watchInfo_t**  ptrList;   // ptrリスト(ptrでソートしたデータ)
+    watchInfo_t**  table;     // ptrをキーにしたハッシュ表(オープンアドレス)
+    size_t         tableSize; // ハッシュ表のサイズ (2のべき乗)
+    watchSlab_t*   slab;      // 確保したスラブ
+    watchInfo_t*   freeList;  // 未使用データ (.nextでつなぐ)
+    watchLabel_t** labels;    // ラベルのハッシュ表(オープンアドレス)
+    size_t         labelSize; // ラベルのハッシュ表のサイズ (2のべき乗)
+    size_t         labelCnt;  // 登録中のラベル数
+    size_t         labelInline; // 0以外ならインターンせず、このサイズで持つ
     long           seqno;     // シーケンス番号
     size_t         count;     // 現存データ数
     size_t         using;     // 使用量
@@ -948,6 +2250,28 @@ typedef struct {
 // ただ情報の欠落は発生するため、その信頼度は落ちる。
 static BOOL  gMemoryFailure = false;
 
+// gMutexMemInfoでロック中に起きたエラーは内容だけ記録し、解除後に出力する。
+// エラー処理やフックがメモリを捕捉すると、同じスレッドで再ロックになるため。
+static __thread BOOL  gMemInfoLocked = false;
+static __thread long  gMemInfoErr = COM_NO_ERROR;
+static __thread char  gMemInfoErrMsg[COM_TEXTBUF_SIZE];
+static __thread const char*  gMemInfoErrFile = NULL;
+static __thread long  gMemInfoErrLine = 0;
+static __thread const char*  gMemInfoErrFunc = NULL;
+
+#define WATCH_ERROR( CODE, ... ) \
+    do { \
+        if( !gMemInfoLocked ) {com_error( (CODE), __VA_ARGS__ );} \
+        else if( gMemInfoErr == COM_NO_ERROR ) { \
+            gMemInfoErr = (CODE); \
+            gMemInfoErrFile = __FILE__; \
+            gMemInfoErrLine = __LINE__; \
+            gMemInfoErrFunc = __func__; \
+            (void)snprintf( gMemInfoErrMsg, sizeof(gMemInfoErrMsg), \
+                            __VA_ARGS__ ); \
+        } \
+    } while(0)
+
 static inline void setLabel( const char *iLabel, char *oTarget, size_t iSize )
 {
     if( !iLabel ) {return;}
@@ -960,13 +2284,97 @@ static inline void setLabel( const char *iLabel, char *oTarget, size_t iSize )
 #define SET_LABEL( LABEL, TARGET ) \
     setLabel( (LABEL), (TARGET), sizeof(TARGET) )
 
-static inline void setWatchInfo(
-        watchInfo_t *oTarget, const char *iLabel, COM_FILEPRM )
+// ラベルのインターン
+// 監視データの .ptrと同じく、線形探索のオープンアドレス方式のハッシュ表で
+// 管理し、削除時は後続を詰め直す。ラベルは COM_DEBUGINFO_LABELで切り詰めた
+// 内容で登録するので、長いラベルも同じ先頭部分なら1つにまとまる。
+
+enum { WATCH_LABEL_MIN = 256 };    // ラベルのハッシュ表の初期サイズ
+
+static size_t hashLabel( const char *iText )
 {
-    SET_LABEL( iLabel, oTarget->label );
-    SET_LABEL( iFILE,  oTarget->file );
-    oTarget->line = iLINE;
-    SET_LABEL( iFUNC,  oTarget->func );
+    // FNV-1a
+    uint64_t  hash = COM_FNV_OFFSET;
+    for( const uchar* tmp = (const uchar*)iText;  *tmp;  tmp++ ) {
+        hash = (hash ^ *tmp) * COM_FNV_PRIME;
+    }
+    return (size_t)hash;
+}
+
+// iTextの位置、または iTextを入れるべき空き位置を返す
+static size_t seekLabelTable(
+        const watchGroup_t *iGrp, const char *iText, size_t iHash )
+{
+    size_t  mask = iGrp->labelSize - 1;
+    size_t  idx = iHash & mask;
+    for( ;  iGrp->labels[idx];  idx = (idx + 1) & mask ) {
+        const watchLabel_t*  tmp = iGrp->labels[idx];
+        if( tmp->hash == iHash && !strcmp( tmp->text, iText ) ) {break;}
+    }
+    return idx;
+}
+
+static BOOL expandLabelTable( watchGroup_t *ioGrp )
+{
+    size_t  newSize = ioGrp->labelSize ? ioGrp->labelSize * 2 : WATCH_LABEL_MIN;
+    watchLabel_t**  newTable = calloc( newSize, sizeof(*newTable) );
+    if( !newTable ) {return false;}
+    watchLabel_t**  oldTable = ioGrp->labels;
+    size_t  oldSize = ioGrp->labelSize;
+    ioGrp->labels = newTable;
+    ioGrp->labelSize = newSize;
+    for( size_t i = 0;  i < oldSize;  i++ ) {
+        watchLabel_t*  tmp = oldTable[i];
+        if( !tmp ) {continue;}
+        newTable[seekLabelTable( ioGrp, tmp->text, tmp->hash )] = tmp;
+    }
+    free( oldTable );
+    return true;
+}
+
+// 登録できなかったときは NULLを返す (ラベルなしの扱いになるだけ)
+static watchLabel_t *internLabel( watchGroup_t *ioGrp, const char *iLabel )
+{
+    if( !iLabel ) {return NULL;}
+    char  text[COM_DEBUGINFO_LABEL] = {0};
+    SET_LABEL( iLabel, text );
+    if( (ioGrp->labelCnt + 1) * 2 > ioGrp->labelSize ) {
+        if( !expandLabelTable( ioGrp ) ) {return NULL;}
+    }
+    size_t  hash = hashLabel( text );
+    size_t  idx = seekLabelTable( ioGrp, text, hash );
+    watchLabel_t*  label = ioGrp->labels[idx];
+    if( !label ) {
+        size_t  len = strlen( text ) + 1;
+        if( !(label = malloc( sizeof(*label) + len )) ) {return NULL;}
+        label->refs = 0;
+        label->hash = hash;
+        memcpy( label->text, text, len );
+        ioGrp->labels[idx] = label;
+        ioGrp->labelCnt++;
+    }
+    label->refs++;
+    return label;
+}
+
+static void releaseLabel( watchGroup_t *ioGrp, watchLabel_t *ioLabel )
+{
+    if( !ioLabel || --(ioLabel->refs) ) {return;}
+    size_t  mask = ioGrp->labelSize - 1;
+    size_t  hole = seekLabelTable( ioGrp, ioLabel->text, ioLabel->hash );
+    ioGrp->labels[hole] = NULL;
+    ioGrp->labelCnt--;
+    free( ioLabel );
+    // 後続のデータで、空いた位置に移しても探索できるものを詰めていく
+    for( size_t idx = (hole + 1) & mask;  ioGrp->labels[idx];
+         idx = (idx + 1) & mask )
+    {
+        size_t  home = ioGrp->labels[idx]->hash & mask;
+        if( ((idx - home) & mask) < ((idx - hole) & mask) ) {continue;}
+        ioGrp->labels[hole] = ioGrp->labels[idx];
+        ioGrp->labels[idx] = NULL;
+        hole = idx;
+    }
 }
 
 static inline long increaseSeqno( watchGroup_t *ioGrp )
@@ -976,77 +2384,119 @@ static inline long increaseSeqno( watchGroup_t *ioGrp )
 }
 
 // 監視情報を watchGroup_t型に集約。
-// .top から始まる線形リストは追加時は末尾追加のみの双方向リストに変更。
-// 更に .ptrList に 各要素の .ptr でソートした要素リストを作成するように修正。
-//
-// 以後 .ptrの検索をしたい時は .ptrList の方で検索して、要素のアドレスを受け
-// そのアドレスで処理を進めることとした。二分探索で検索できるので、
-// 単純な線形リストよりは、検索が速くなるはず。
-
-#define IDXVAL( INDEX )   (const void*)ioGrp->ptrList[*oIdx + INDEX]->ptr
+// .top から始まる線形リストは追加時は末尾追加のみの双方向リスト。
+// .ptrの検索は .table のハッシュ表で行う。線形探索のオープンアドレス方式で
+// 削除時は後続を詰め直すため、墓標は残らない。
+// 使用率が半分を超えたら表を倍に広げるので、追加/検索/削除は平均 O(1)。
+
+enum {
+    WATCH_TABLE_MIN = 1024,    // ハッシュ表の初期サイズ (2のべき乗)
+    WATCH_SLAB_COUNT = 1024    // スラブ1つあたりの監視データ数
+};
 
-static void adjustIndex(
-        watchGroup_t *ioGrp, const void *iPtr, size_t *oIdx )
+static inline size_t getWatchHash( const watchGroup_t *iGrp, const void *iPtr )
 {
-    while( (*oIdx > 0) && (IDXVAL(0) > iPtr) ) {(*oIdx)--;}
-    while( (*oIdx < ioGrp->count - 1) && IDXVAL(0) < iPtr ) {(*oIdx)++;}
+    // 下位ビットはアラインメントで偏るので、乗算で全体に散らす
+    uint64_t  key = (uint64_t)(uintptr_t)iPtr * 0x9e3779b97f4a7c15u;
+    return (size_t)(key >> 32) & (iGrp->tableSize - 1);
 }
 
-// ioGrp->count は既に変更後の値であり、
-// ioGrp->ptrListの要素数とは一致しない。そのため、iSizeで要素数を受け取る
-//
-static BOOL binSearch(
-        watchGroup_t *ioGrp, const void *iPtr, size_t *oIdx, size_t iSize )
+// iPtrの位置、または iPtrを入れるべき空き位置を返す
+static size_t seekWatchTable( const watchGroup_t *iGrp, const void *iPtr )
 {
-    if( !(ioGrp->ptrList) ) {*oIdx = 0; return false;}
-    size_t binMin = 0;
-    size_t binMax = iSize - 1;
-    *oIdx = iSize / 2;
-    while(1) {
-        if( iPtr > IDXVAL(0) ) {
-            if( *oIdx == iSize - 1 ) {break;}
-            binMin = *oIdx + 1;
-        }
-        else if( iPtr < IDXVAL(0) ) {
-            if( *oIdx == 0 ) {break;}
-            binMax = *oIdx - 1;
-        }
-        else {return true;}
-        if( binMin > binMax ) {break;}
-        *oIdx = binMin + (binMax - binMin) / 2;
+    size_t  idx = getWatchHash( iGrp, iPtr );
+    while( iGrp->table[idx] && iGrp->table[idx]->ptr != iPtr ) {
+        idx = (idx + 1) & (iGrp->tableSize - 1);
     }
-    adjustIndex( ioGrp, iPtr, oIdx );
-    return false;
+    return idx;
 }
 
-static BOOL reallocInner( watchGroup_t *ioGrp )
+static BOOL expandWatchTable( watchGroup_t *ioGrp )
 {
-    if( !(ioGrp->count) ) {
-        free( ioGrp->ptrList );
-        ioGrp->ptrList = NULL;
-        return true;
+    size_t  newSize = ioGrp->tableSize ? ioGrp->tableSize * 2 : WATCH_TABLE_MIN;
+    watchInfo_t**  newTable = calloc( newSize, sizeof(*newTable) );
+    if( !newTable ) {
+        WATCH_ERROR( COM_ERR_DEBUGNG,
+                     "##### watch table expand failure #####" );
+        return false;
     }
-    void* tmp = realloc( ioGrp->ptrList, sizeof(void*) * ioGrp->count );
-    if( tmp ) {ioGrp->ptrList = tmp;  return true;}
-    com_error( COM_ERR_DEBUGNG, "##### watch list realloc failure #####" );
-    return false;
+    watchInfo_t**  oldTable = ioGrp->table;
+    size_t  oldSize = ioGrp->tableSize;
+    ioGrp->table = newTable;
+    ioGrp->tableSize = newSize;
+    for( size_t i = 0;  i < oldSize;  i++ ) {
+        if( !oldTable[i] ) {continue;}
+        ioGrp->table[seekWatchTable( ioGrp, oldTable[i]->ptr )] = oldTable[i];
+    }
+    free( oldTable );
+    return true;
 }
 
-static void addWatchTable( watchGroup_t *ioGrp, watchInfo_t *iNew )
+static BOOL addWatchTable( watchGroup_t *ioGrp, watchInfo_t *iNew )
 {
-    size_t  index = 0;
-    if( binSearch( ioGrp, iNew->ptr, &index, ioGrp->count - 1 ) ) {
-        com_error( COM_ERR_DEBUGNG,
+    if( (ioGrp->count + 1) * 2 > ioGrp->tableSize ) {
+        if( !expandWatchTable( ioGrp ) ) {return false;}
+    }
+    size_t  idx = seekWatchTable( ioGrp, iNew->ptr );
+    if( ioGrp->table[idx] ) {
+        WATCH_ERROR( COM_ERR_DEBUGNG,
               "##### same address(%p) already registered #####", iNew->ptr );
-        return;
+        return false;
     }
-    if( !reallocInner( ioGrp ) ) {return;}
-    if( index < ioGrp->count - 1 ) {
-        watchInfo_t**  base = ioGrp->ptrList + index;
-        memmove( base + 1, base,
-                 sizeof(watchInfo_t*) * (ioGrp->count - index - 1) );
+    ioGrp->table[idx] = iNew;
+    return true;
+}
+
+static void deleteWatchTable( watchGroup_t *ioGrp, size_t iIdx )
+{
+    size_t  mask = ioGrp->tableSize - 1;
+    size_t  hole = iIdx;
+    ioGrp->table[hole] = NULL;
+    // 後続のデータで、空いた位置に移しても探索できるものを詰めていく
+    for( size_t idx = (hole + 1) & mask;  ioGrp->table[idx];
+         idx = (idx + 1) & mask )
+    {
+        size_t  home = getWatchHash( ioGrp, ioGrp->table[idx]->ptr );
+        if( ((idx - home) & mask) < ((idx - hole) & mask) ) {continue;}
+        ioGrp->table[hole] = ioGrp->table[idx];
+        ioGrp->table[idx] = NULL;
+        hole = idx;
     }
-    ioGrp->ptrList[index] = iNew;
+}
+
+// 監視データ1つ分の大きさ (ラベルを直後に持つ場合はその分を加える)
+static size_t getWatchUnit( const watchGroup_t *iGrp )
+{
+    size_t  align = sizeof(void*);
+    return sizeof(watchInfo_t) +
+           (iGrp->labelInline + align - 1) / align * align;
+}
+
+static watchInfo_t *getWatchSlab( watchGroup_t *ioGrp )
+{
+    if( !ioGrp->freeList ) {
+        size_t  unit = getWatchUnit( ioGrp );
+        watchSlab_t*  slab = malloc( sizeof(watchSlab_t) +
+                                     unit * WATCH_SLAB_COUNT );
+        if( !slab ) {return NULL;}
+        slab->next = ioGrp->slab;
+        ioGrp->slab = slab;
+        char*  top = (char*)(slab->info);
+        for( size_t i = 0;  i < WATCH_SLAB_COUNT;  i++ ) {
+            watchInfo_t*  info = (void*)(top + unit * i);
+            info->next = ioGrp->freeList;
+            ioGrp->freeList = info;
+        }
+    }
+    watchInfo_t*  result = ioGrp->freeList;
+    ioGrp->freeList = result->next;
+    return result;
+}
+
+static void releaseWatchSlab( watchGroup_t *ioGrp, watchInfo_t *iInfo )
+{
+    iInfo->next = ioGrp->freeList;
+    ioGrp->freeList = iInfo;
 }
 
 static void addWatchList( watchGroup_t *ioGrp, watchInfo_t *ioNew )
@@ -1058,24 +2508,38 @@ static void addWatchList( watchGroup_t *ioGrp, watchInfo_t *ioNew )
     else { ioGrp->top = ioNew; }
     ioGrp->last = ioNew;
     (ioGrp->count)++;
-    addWatchTable( ioGrp, ioNew );
 }
 
 static BOOL addWatchInfo(
         watchGroup_t *ioGrp, watchInfo_t **oNew, long iType,
         const void *iPtr, size_t iSize, const char *iLabel, COM_FILEPRM )
 {
-    watchInfo_t*  newInfo = malloc( sizeof(watchInfo_t) );
-    if( !newInfo || ioGrp->count == COM_DEBUG_SEQNO_MAX ) {
-        com_error( COM_ERR_DEBUGNG,
+    watchInfo_t*  newInfo = NULL;
+    if( ioGrp->count < COM_DEBUG_SEQNO_MAX ) {
+        newInfo = getWatchSlab( ioGrp );
+    }
+    if( !newInfo ) {
+        WATCH_ERROR( COM_ERR_DEBUGNG,
                    "##### fail to create new watchInfo(%s) #####", iLabel );
         gMemoryFailure = true;
-        if( newInfo ) {free( newInfo );}
         return false;
     }
-    *newInfo = (watchInfo_t){ iType, increaseSeqno(ioGrp),
-                              iPtr, iSize, "", NULL, NULL, "", 0, "" };
-    setWatchInfo( newInfo, iLabel, COM_FILEVAR );
+    *newInfo = (watchInfo_t){ iType, 0, iPtr, iSize, 0, NULL, NULL,
+                              iFILE, iLINE, iFUNC, NULL, NULL };
+    if( ioGrp->labelInline ) {
+        char*  text = (char*)(newInfo + 1);
+        text[0] = '\0';
+        setLabel( iLabel, text, ioGrp->labelInline );
+        newInfo->text = text;
+    }
+    else {newInfo->label = internLabel( ioGrp, iLabel );}
+    if( !addWatchTable( ioGrp, newInfo ) ) {
+        gMemoryFailure = true;
+        releaseLabel( ioGrp, newInfo->label );
+        releaseWatchSlab( ioGrp, newInfo );
+        return false;
+    }
+    newInfo->seqno = increaseSeqno( ioGrp );
     addWatchList( ioGrp, newInfo );
     *oNew = newInfo;
     return true;
@@ -1090,46 +2554,25 @@ static void updateUsing( watchGroup_t *ioGrp, size_t iAdd )
 enum { NO_DEBUG_INFO = -1 };
 
 static BOOL searchWatchList(
-        watchGroup_t *iGrp, const void *iPtr, watchInfo_t **oCur )
+        watchGroup_t *iGrp, const void *iPtr, size_t *oIdx )
 {
-    size_t  index = 0;
-    if( binSearch( iGrp, iPtr, &index, iGrp->count ) ) {
-        *oCur = iGrp->ptrList[index];
-        return true;
-    }
-    *oCur = NULL;
-    return false;
+    if( !iGrp->count ) {return false;}
+    *oIdx = seekWatchTable( iGrp, iPtr );
+    return (iGrp->table[*oIdx] != NULL);
 }
 
 static long checkWatchInfo( watchGroup_t *iGrp, const void *iPtr )
 {
-    watchInfo_t* tmp;
-    if( searchWatchList( iGrp, iPtr, &tmp ) ) {return tmp->seqno;}
+    size_t  idx = 0;
+    if( searchWatchList( iGrp, iPtr, &idx ) ) {return iGrp->table[idx]->seqno;}
     return NO_DEBUG_INFO;
 }
 
-static long getSeqno( watchGroup_t *iGrp, const void *iPtr )
-{
-    long  result = checkWatchInfo( iGrp, iPtr );
-    if( result == NO_DEBUG_INFO ) {return 0;}
-    return result;
-}
-
-static void deleteWatchTable( watchGroup_t *ioGrp, watchInfo_t *iCur )
-{
-    size_t  index = 0;
-    if( !binSearch( ioGrp, iCur->ptr, &index, ioGrp->count + 1 ) ) {
-        com_error( COM_ERR_DEBUGNG,
-              "##### address(%p) not registered #####", iCur->ptr );
-        return;
-    }
-    if( index < ioGrp->count ) {
-        watchInfo_t**  base = ioGrp->ptrList + index;
-        memmove( base, base + 1,
-                 sizeof(watchInfo_t*) * (ioGrp->count - index) );
-    }
-    ioGrp->ptrList[ioGrp->count] = NULL;
-    (void)reallocInner( ioGrp );
+static long getSeqno( watchGroup_t *iGrp, const void *iPtr )
+{
+    long  result = checkWatchInfo( iGrp, iPtr );
+    if( result == NO_DEBUG_INFO ) {return 0;}
+    return result;
 }
 
 static void deleteWatchList( watchGroup_t *ioGrp, watchInfo_t *ioCur )
@@ -1147,23 +2590,49 @@ static void deleteWatchList( watchGroup_t *ioGrp, watchInfo_t *ioCur )
     }
     else { ioCur->next->prev = ioCur->prev; }
     (ioGrp->count)--;
-    deleteWatchTable( ioGrp, ioCur );
 }
 
+// oTargetにコピーしたラベルは、使い終わったら releaseLabel()で解放すること
+// 直後に持つラベル(.text)は、次にその領域が使われるまで参照できる
 static BOOL deleteWatchInfo(
         watchGroup_t *ioGrp, const void *iPtr, watchInfo_t *oTarget )
 {
-    watchInfo_t*  tmp = NULL; 
-    if( searchWatchList( ioGrp, iPtr, &tmp ) ) {
+    size_t  idx = 0;
+    if( searchWatchList( ioGrp, iPtr, &idx ) ) {
+        watchInfo_t*  tmp = ioGrp->table[idx];
         // 削除対象のデータをコピーして通知
-        COM_SET_IF_EXIST( oTarget, *tmp );
+        *oTarget = *tmp;
+        deleteWatchTable( ioGrp, idx );
         deleteWatchList( ioGrp, tmp );
-        free( tmp );
+        releaseWatchSlab( ioGrp, tmp );
         return true;
     }
     return false;
 }
 
+// 一覧出力用に、その時点の全データを iCompareでソートしたリストを作る。
+// 出力時しか使わないので、都度作って解放する。
+static int compareWatchPtr( const void *iData1, const void *iData2 )
+{
+    const watchInfo_t*  info1 = *(watchInfo_t* const*)iData1;
+    const watchInfo_t*  info2 = *(watchInfo_t* const*)iData2;
+    if( info1->ptr < info2->ptr ) {return -1;}
+    return (info1->ptr > info2->ptr);
+}
+
+static watchInfo_t **sortWatchList(
+        watchGroup_t *iGrp, int (*iCompare)( const void*, const void* ) )
+{
+    watchInfo_t**  result = malloc( sizeof(*result) * iGrp->count );
+    if( !result ) {return NULL;}
+    size_t  cnt = 0;
+    for( watchInfo_t* tmp = iGrp->top;  tmp;  tmp = tmp->next ) {
+        result[cnt++] = tmp;
+    }
+    qsort( result, cnt, sizeof(*result), iCompare );
+    return result;
+}
+
 static void setDebugErrorOn( BOOL *oMode, long *oSeqno, long iSeqno )
 {
     *oMode = true;
@@ -1202,12 +2671,335 @@ static void dispWatchInfo(
 
 
 
+// メモリ捕捉プロファイル ----------------------------------------------------
+
+// 呼び元(ファイル名のアドレス＋ライン数)をキーにした集計表と、捕捉中の
+// メモリのアドレスから呼び元を引く表を、どちらもオープンアドレスの
+// ハッシュ表で持つ。メモリ監視とは独立して動作する。
+// com_malloc()等のメモリ監視の呼び出しから使われるので、表の領域は
+// malloc()で直接確保し、出力中はロックを持ったまま com_printf()を呼ばない。
+
+typedef struct {
+    const char*   file;
+    long          line;
+    const char*   func;
+    ulong         count;      // 捕捉回数
+    size_t        bytes;      // 捕捉サイズ累計
+    size_t        live;       // 未解放サイズ
+    size_t        peak;       // 未解放サイズの最大
+} allocSite_t;
+
+typedef struct {
+    const void*   ptr;
+    size_t        size;
+    long          site;       // gAllocSite[]の位置 (NO_ALLOC_SITEなら未使用)
+} allocLive_t;
+
+enum {
+    NO_ALLOC_SITE = -1,
+    ALLOC_SITE_MIN = 256,       // 呼び元集計表の初期サイズ (2のべき乗)
+    ALLOC_LIVE_MIN = 4096       // 捕捉中メモリ表の初期サイズ (2のべき乗)
+};
+
+static BOOL  gAllocProfile = false;
+static pthread_mutex_t  gMutexProfile = PTHREAD_MUTEX_INITIALIZER;
+static allocSite_t*  gAllocSite = NULL;
+static size_t  gAllocSiteSize = 0;
+static size_t  gAllocSiteCount = 0;
+static allocLive_t*  gAllocLive = NULL;
+static size_t  gAllocLiveSize = 0;
+static size_t  gAllocLiveCount = 0;
+static volatile sig_atomic_t  gAllocProfileReq = 0;   // シグナルでの出力要求
+static char  gAllocProfilePath[COM_LINEBUF_SIZE];
+
+static inline size_t hashAllocKey( uintptr_t iKey, long iLine, size_t iSize )
+{
+    uint64_t  key = ((uint64_t)iKey ^ (uint64_t)iLine) * 0x9e3779b97f4a7c15u;
+    return (size_t)(key >> 32) & (iSize - 1);
+}
+
+static size_t seekAllocSite( const char *iFile, long iLine )
+{
+    size_t  idx = hashAllocKey( (uintptr_t)iFile, iLine, gAllocSiteSize );
+    while( gAllocSite[idx].file &&
+           (gAllocSite[idx].file != iFile || gAllocSite[idx].line != iLine) )
+    {
+        idx = (idx + 1) & (gAllocSiteSize - 1);
+    }
+    return idx;
+}
+
+static size_t seekAllocLive( const void *iPtr )
+{
+    size_t  idx = hashAllocKey( (uintptr_t)iPtr, 0, gAllocLiveSize );
+    while( gAllocLive[idx].site != NO_ALLOC_SITE &&
+           gAllocLive[idx].ptr != iPtr )
+    {
+        idx = (idx + 1) & (gAllocLiveSize - 1);
+    }
+    return idx;
+}
+
+static allocLive_t *callocAllocLive( size_t iSize )
+{
+    allocLive_t*  result = malloc( sizeof(*result) * iSize );
+    if( !result ) {return NULL;}
+    for( size_t i = 0;  i < iSize;  i++ ) {result[i].site = NO_ALLOC_SITE;}
+    return result;
+}
+
+// 呼び元集計表を広げる。集計表の位置は捕捉中メモリ表が保持しているので
+// 捕捉中メモリ表の .siteも付け替える。
+static BOOL expandAllocSite( void )
+{
+    size_t  newSize = gAllocSiteSize ? gAllocSiteSize * 2 : ALLOC_SITE_MIN;
+    allocSite_t*  newSite = calloc( newSize, sizeof(*newSite) );
+    long*  move = malloc( sizeof(*move) * (gAllocSiteSize + 1) );
+    if( !newSite || !move ) {free( newSite );  free( move );  return false;}
+    allocSite_t*  oldSite = gAllocSite;
+    size_t  oldSize = gAllocSiteSize;
+    gAllocSite = newSite;
+    gAllocSiteSize = newSize;
+    for( size_t i = 0;  i < oldSize;  i++ ) {
+        if( !oldSite[i].file ) {continue;}
+        size_t  idx = seekAllocSite( oldSite[i].file, oldSite[i].line );
+        gAllocSite[idx] = oldSite[i];
+        move[i] = (long)idx;
+    }
+    for( size_t i = 0;  i < gAllocLiveSize;  i++ ) {
+        if( gAllocLive[i].site == NO_ALLOC_SITE ) {continue;}
+        gAllocLive[i].site = move[gAllocLive[i].site];
+    }
+    free( oldSite );
+    free( move );
+    return true;
+}
+
+static BOOL expandAllocLive( void )
+{
+    size_t  newSize = gAllocLiveSize ? gAllocLiveSize * 2 : ALLOC_LIVE_MIN;
+    allocLive_t*  newLive = callocAllocLive( newSize );
+    if( !newLive ) {return false;}
+    allocLive_t*  oldLive = gAllocLive;
+    size_t  oldSize = gAllocLiveSize;
+    gAllocLive = newLive;
+    gAllocLiveSize = newSize;
+    for( size_t i = 0;  i < oldSize;  i++ ) {
+        if( oldLive[i].site == NO_ALLOC_SITE ) {continue;}
+        gAllocLive[seekAllocLive( oldLive[i].ptr )] = oldLive[i];
+    }
+    free( oldLive );
+    return true;
+}
+
+static void deleteAllocLive( size_t iIdx )
+{
+    size_t  mask = gAllocLiveSize - 1;
+    size_t  hole = iIdx;
+    gAllocLive[hole].site = NO_ALLOC_SITE;
+    for( size_t idx = (hole + 1) & mask;  gAllocLive[idx].site != NO_ALLOC_SITE;
+         idx = (idx + 1) & mask )
+    {
+        size_t  home = hashAllocKey( (uintptr_t)gAllocLive[idx].ptr, 0,
+                                     gAllocLiveSize );
+        if( ((idx - home) & mask) < ((idx - hole) & mask) ) {continue;}
+        gAllocLive[hole] = gAllocLive[idx];
+        gAllocLive[idx].site = NO_ALLOC_SITE;
+        hole = idx;
+    }
+}
+
+static long getAllocSite( COM_FILEPRM )
+{
+    if( (gAllocSiteCount + 1) * 2 > gAllocSiteSize ) {
+        if( !expandAllocSite() ) {return NO_ALLOC_SITE;}
+    }
+    size_t  idx = seekAllocSite( iFILE, iLINE );
+    if( !gAllocSite[idx].file ) {
+        gAllocSite[idx] = (allocSite_t){ iFILE, iLINE, iFUNC, 0, 0, 0, 0 };
+        gAllocSiteCount++;
+    }
+    return (long)idx;
+}
+
+static void dumpAllocProfile( const char *iPath );
+
+// シグナルによる出力要求があれば、表を更新した後のこのタイミングで出力する
+#define CHECK_PROFILE_REQUEST \
+    if( gAllocProfileReq ) { \
+        gAllocProfileReq = 0; \
+        dumpAllocProfile( gAllocProfilePath ); \
+    }
+
+static void profileAlloc( const void *iPtr, size_t iSize, COM_FILEPRM )
+{
+    pthread_mutex_lock( &gMutexProfile );
+    long  site = getAllocSite( COM_FILEVAR );
+    if( site != NO_ALLOC_SITE ) {
+        allocSite_t*  tmp = &(gAllocSite[site]);
+        tmp->count++;
+        tmp->bytes += iSize;
+        if( (gAllocLiveCount + 1) * 2 <= gAllocLiveSize || expandAllocLive() ) {
+            size_t  idx = seekAllocLive( iPtr );
+            allocLive_t*  live = &(gAllocLive[idx]);
+            if( live->site == NO_ALLOC_SITE ) {gAllocLiveCount++;}
+            else {gAllocSite[live->site].live -= live->size;}
+            gAllocLive[idx] = (allocLive_t){ iPtr, iSize, site };
+            tmp->live += iSize;
+            if( tmp->live > tmp->peak ) {tmp->peak = tmp->live;}
+        }
+    }
+    CHECK_PROFILE_REQUEST;
+    pthread_mutex_unlock( &gMutexProfile );
+}
+
+static void profileFree( const void *iPtr )
+{
+    pthread_mutex_lock( &gMutexProfile );
+    // プロファイル開始前に捕捉したメモリは表にないので、何もしない
+    if( gAllocLiveCount ) {
+        size_t  idx = seekAllocLive( iPtr );
+        if( gAllocLive[idx].site != NO_ALLOC_SITE ) {
+            gAllocSite[gAllocLive[idx].site].live -= gAllocLive[idx].size;
+            deleteAllocLive( idx );
+            gAllocLiveCount--;
+        }
+    }
+    CHECK_PROFILE_REQUEST;
+    pthread_mutex_unlock( &gMutexProfile );
+}
+
+static void freeAllocProfile( void )
+{
+    free( gAllocSite );
+    gAllocSite = NULL;
+    gAllocSiteSize = gAllocSiteCount = 0;
+    free( gAllocLive );
+    gAllocLive = NULL;
+    gAllocLiveSize = gAllocLiveCount = 0;
+}
+
+BOOL com_setAllocProfile( BOOL iMode )
+{
+    pthread_mutex_lock( &gMutexProfile );
+    BOOL  result = true;
+    if( iMode && !gAllocProfile ) {
+        if( !expandAllocSite() || !expandAllocLive() ) {
+            freeAllocProfile();
+            com_error( COM_ERR_DEBUGNG, "fail to start allocation profile" );
+            result = false;
+        }
+        else {gAllocProfile = true;}
+    }
+    else if( !iMode ) {
+        gAllocProfile = false;
+        freeAllocProfile();
+    }
+    pthread_mutex_unlock( &gMutexProfile );
+    return result;
+}
+
+static int compareAllocSite( const void *iData1, const void *iData2 )
+{
+    const allocSite_t*  site1 = iData1;
+    const allocSite_t*  site2 = iData2;
+    if( site1->bytes > site2->bytes ) {return -1;}
+    return (site1->bytes < site2->bytes);
+}
+
+// ロック中に集計表をコピーし、ソートしたものを返す
+static allocSite_t *copyAllocSite( size_t *oCount )
+{
+    allocSite_t*  result = malloc( sizeof(*result) * (gAllocSiteCount + 1) );
+    if( !result ) {return NULL;}
+    *oCount = 0;
+    for( size_t i = 0;  i < gAllocSiteSize;  i++ ) {
+        if( gAllocSite[i].file ) {result[(*oCount)++] = gAllocSite[i];}
+    }
+    qsort( result, *oCount, sizeof(*result), compareAllocSite );
+    return result;
+}
+
+#define PROFILE_HEAD \
+    "\n### allocation profile by call site (%zu sites) ###\n" \
+    "     count          bytes     live bytes      peak live  call site\n"
+#define PROFILE_LINE  "%10lu %14zu %14zu %14zu  %s() in %s line %ld\n"
+#define PROFILE_PRM( SITE ) \
+    (SITE).count, (SITE).bytes, (SITE).live, (SITE).peak, \
+    (SITE).func, (SITE).file, (SITE).line
+
+// ロック中に呼ぶ。ファイル出力はロックを持ったままで問題ない。
+static void dumpAllocProfile( const char *iPath )
+{
+    size_t  count = 0;
+    allocSite_t*  site = copyAllocSite( &count );
+    if( !site ) {return;}
+    FILE*  fp = fopen( iPath, "a" );
+    if( fp ) {
+        fprintf( fp, PROFILE_HEAD, count );
+        for( size_t i = 0;  i < count;  i++ ) {
+            fprintf( fp, PROFILE_LINE, PROFILE_PRM( site[i] ) );
+        }
+        fclose( fp );
+    }
+    free( site );
+}
+
+void com_dumpAllocProfile( const char *iPath )
+{
+    pthread_mutex_lock( &gMutexProfile );
+    if( !gAllocProfile ) {pthread_mutex_unlock( &gMutexProfile );  return;}
+    if( iPath ) {
+        dumpAllocProfile( iPath );
+        pthread_mutex_unlock( &gMutexProfile );
+        return;
+    }
+    size_t  count = 0;
+    allocSite_t*  site = copyAllocSite( &count );
+    pthread_mutex_unlock( &gMutexProfile );
+    if( !site ) {return;}
+    // com_printf()の中でメモリ捕捉があり得るので、ロックを外してから出力する
+    com_printf( PROFILE_HEAD, count );
+    for( size_t i = 0;  i < count;  i++ ) {
+        com_printf( PROFILE_LINE, PROFILE_PRM( site[i] ) );
+    }
+    free( site );
+}
+
+static void requestAllocProfile( int iSignal )
+{
+    COM_UNUSED( iSignal );
+    gAllocProfileReq = 1;
+}
+
+BOOL com_setAllocProfileSignal( int iSignal, const char *iPath )
+{
+    if( !iPath ) {COM_PRMNG(false);}
+    if( !com_strcpy( gAllocProfilePath, iPath ) ) {COM_PRMNG(false);}
+    struct sigaction  act;
+    memset( &act, 0, sizeof(act) );
+    act.sa_handler = requestAllocProfile;
+    act.sa_flags = SA_RESTART;
+    (void)sigemptyset( &act.sa_mask );
+    if( sigaction( iSignal, &act, NULL ) ) {
+        com_error( COM_ERR_DEBUGNG, "fail to set signal(%d) for profile",
+                   iSignal );
+        return false;
+    }
+    return true;
+}
+
+
+
 // メモリ監視処理 ------------------------------------------------------------
 
 static COM_DEBUG_MODE_t  gWatchMemInfoMode = COM_DEBUG_OFF;
 
 void com_setWatchMemInfo( COM_DEBUG_MODE_t iMode )
 {
+#ifdef USE_RELEASE_ABI  // リリースABIでは監視処理を通らないため常にOFF
+    iMode = COM_DEBUG_OFF;
+#endif
     setDebugMode( &gWatchMemInfoMode, iMode );
 }
 
@@ -1217,11 +3009,81 @@ COM_DEBUG_MODE_t com_getWatchMemInfo( void )
 }
 
 // メモリ監視情報グループ
-static watchGroup_t  gMemGrp;
+// 登録/削除とスナップショット取得は gMutexMemInfoで排他する
+static watchGroup_t  gMemGrp = { .labelInline = COM_DEBUGINFO_LABEL };
+static pthread_mutex_t  gMutexMemInfo = PTHREAD_MUTEX_INITIALIZER;
+
+static void lockMemInfo( void )
+{
+    pthread_mutex_lock( &gMutexMemInfo );
+    gMemInfoLocked = true;
+}
+
+static void unlockMemInfo( void )
+{
+    gMemInfoLocked = false;
+    pthread_mutex_unlock( &gMutexMemInfo );
+    if( gMemInfoErr == COM_NO_ERROR ) {return;}
+    long  code = gMemInfoErr;
+    gMemInfoErr = COM_NO_ERROR;
+    // 発生箇所は記録した位置とする
+    com_errorFunc( code, true, gMemInfoErrFile, gMemInfoErrLine,
+                   gMemInfoErrFunc, "%s", gMemInfoErrMsg );
+}
+
+// サンプリング監視
+// 捕捉サイズの累計が、平均 gMemSampleRateバイトの指数分布で決めた間隔を
+// 超えるたびに、その捕捉を1つ監視対象にする(バイト単位のポアソン抽出)。
+// サイズ sの捕捉が抽出される確率は 1-exp(-s/R)なので、その逆数を重みとして
+// 一覧出力時に全体の推定値を出す。
+static size_t  gMemSampleRate = 0;      // 0なら全数監視
+static size_t  gMemSampledCnt = 0;      // 抽出中に作った監視情報の現存数
+static double  gMemSampleLeft = 0.0;    // 次の抽出までの残りバイト数
+static uint64_t  gMemSampleSeed = 0x2545f4914f6cdd1du;
+
+static double getSampleInterval( void )
+{
+    // xorshift64*で (0,1]の一様乱数を作り、指数分布に変換する
+    gMemSampleSeed ^= gMemSampleSeed >> 12;
+    gMemSampleSeed ^= gMemSampleSeed << 25;
+    gMemSampleSeed ^= gMemSampleSeed >> 27;
+    uint64_t  rnd = (gMemSampleSeed * 0x2545f4914f6cdd1du) >> 11;
+    double  uniform = ((double)rnd + 1.0) / 9007199254740992.0;  // 2^53
+    return -log( uniform ) * (double)gMemSampleRate;
+}
+
+void com_setWatchMemSampling( size_t iRate )
+{
+    gMemSampleRate = iRate;
+    if( !iRate ) {return;}
+    gMemSampleSeed ^= (uint64_t)time( NULL ) ^ (uint64_t)getpid();
+    if( !gMemSampleSeed ) {gMemSampleSeed = 1;}
+    gMemSampleLeft = getSampleInterval();
+}
+
+size_t com_getWatchMemSampling( void )
+{
+    return gMemSampleRate;
+}
+
+// 抽出中か、抽出中に作った監視情報が残っている間は抽出扱いとする
+static BOOL isMemSampled( void )
+{
+    return (gMemSampleRate || gMemSampledCnt);
+}
+
+static BOOL sampleMemInfo( size_t iSize )
+{
+    gMemSampleLeft -= (double)iSize;
+    if( gMemSampleLeft > 0.0 ) {return false;}
+    gMemSampleLeft = getSampleInterval();
+    return true;
+}
 
 static char*  gMemOperator[] = {
     "free", "malloc", "realloc", "strdup", "strndup", "scanDir",
-    "freeaddrinfo", "getaddrinfo"      // セレクト機能用
+    "freeaddrinfo", "getaddrinfo",     // セレクト機能用
+    "allocPool", "freePoolObj", "allocLarge", "freeLarge"
 };
 
 char *com_getMemOperator( COM_MEM_OPR_t iType )
@@ -1238,7 +3100,7 @@ static void dispMemInfo(
     MAKELOG( "%s%08ld com_%-12s %12p %10zu (%10zu)\n",
                  iPre, oInfo->seqno, com_getMemOperator( iType ),
                  oInfo->ptr, oInfo->size, gMemGrp.using );
-    dispWatchInfo( iMode, iPre, oInfo->label, COM_FILEVAR );
+    dispWatchInfo( iMode, iPre, WATCH_LABEL( oInfo ), COM_FILEVAR );
 }
 
 static __thread BOOL  gSkipMemInfo = false;
@@ -1294,17 +3156,26 @@ void com_addMemInfo(
         COM_FILEPRM, COM_MEM_OPR_t iType, const void *iPtr, size_t iSize,
         const char *iFormat, ... )
 {
+    if( gAllocProfile ) {profileAlloc( iPtr, iSize, COM_FILEVAR );}
     if( !gWatchMemInfoMode ) {return;}
-
+    lockMemInfo();
+    // 抽出しない捕捉は書式展開もせずに戻る
+    if( gMemSampleRate && !sampleMemInfo( iSize ) ) {
+        unlockMemInfo();
+        return;
+    }
     com_setFuncTrace( false );
     COM_SET_FORMAT( gLogBuff );
     watchInfo_t*  new = NULL;
     if( addWatchInfo( &gMemGrp,&new,iType,iPtr,iSize,gLogBuff,COM_FILEVAR ) ) {
+        new->sample = gMemSampleRate;
+        if( new->sample ) {gMemSampledCnt++;}
         updateUsing( &gMemGrp, iSize );
         if( gSkipMemInfo && !gForceLog ) {gSkipMemInfoCount++;}
         else {dispMemInfo( "++M", iType, new, gWatchMemInfoMode, COM_FILEVAR );}
     }
     com_setFuncTrace( true );
+    unlockMemInfo();
 }
 
 long com_checkMemInfo( const void *iPtr )
@@ -1312,27 +3183,37 @@ long com_checkMemInfo( const void *iPtr )
     if( !gWatchMemInfoMode ) {return 0;}
 
     com_setFuncTrace( false );
+    lockMemInfo();
     long  seqno = getSeqno( &gMemGrp, iPtr );
+    unlockMemInfo();
     com_setFuncTrace( true );
     return seqno;
 }
 
 void com_deleteMemInfo( COM_FILEPRM, COM_MEM_OPR_t iType, const void *iPtr )
 {
+    if( gAllocProfile ) {profileFree( iPtr );}
     if( !gWatchMemInfoMode ) {return;}
 
     com_setFuncTrace( false );
+    lockMemInfo();
     watchInfo_t  tmp;
     memset( &tmp, 0, sizeof(tmp) );
-    if( !deleteWatchInfo( &gMemGrp, iPtr, &tmp ) ) {
-        // 該当する情報がない＝二重解放の疑いが濃厚
-        com_error( COM_ERR_DOUBLEFREE, "no meminfo to free(%p)", iPtr );
-        com_setFuncTrace( true );
-        return;
+    if( deleteWatchInfo( &gMemGrp, iPtr, &tmp ) ) {
+        updateUsing( &gMemGrp, -(tmp.size) );
+        if( gSkipMemInfo && !gForceLog ) {gSkipMemInfoCount++;}
+        else {
+            dispMemInfo( "--M", iType, &tmp, gWatchMemInfoMode, COM_FILEVAR );
+        }
+        releaseLabel( &gMemGrp, tmp.label );
+        if( tmp.sample ) {gMemSampledCnt--;}
+    }
+    // サンプリングしていたら、抽出されなかったメモリの解放と区別できない
+    // そうでなければ該当する情報がない＝二重解放の疑いが濃厚
+    else if( !isMemSampled() ) {
+        WATCH_ERROR( COM_ERR_DOUBLEFREE, "no meminfo to free(%p)", iPtr );
     }
-    updateUsing( &gMemGrp, -(tmp.size) );
-    if( gSkipMemInfo && !gForceLog ) {gSkipMemInfoCount++;}
-    else {dispMemInfo( "--M", iType, &tmp, gWatchMemInfoMode, COM_FILEVAR );}
+    unlockMemInfo();
     com_setFuncTrace( true );
 }
 
@@ -1342,10 +3223,13 @@ void com_deleteMemInfo( COM_FILEPRM, COM_MEM_OPR_t iType, const void *iPtr )
     if( !GROUP.count ) {return;} \
     com_printf( "\n### %s (%zu) ###\n", LIST, GROUP.count ); \
     if( gMemoryFailure ) {com_printf( "### but not enough memory ###\n" );} \
-    if( iByAddr ) { \
+    watchInfo_t**  sorted = NULL; \
+    if( iByAddr ) {sorted = sortWatchList( &GROUP, compareWatchPtr );} \
+    if( sorted ) { \
         for( size_t idx = 0;  idx < GROUP.count;  idx++ ) { \
-            DISPFUNC( GROUP.ptrList[idx] ); \
+            DISPFUNC( sorted[idx] ); \
         } \
+        free( sorted ); \
     } \
     else { \
         for( watchInfo_t* tmp = GROUP.top;  tmp;  tmp = tmp->next ) { \
@@ -1361,16 +3245,96 @@ static void dispNotFreed( watchInfo_t *iInfo )
                         iInfo->file, iInfo->line, iInfo->func );
 }
 
+// サンプリング時の呼び元ごとの推定値
+typedef struct {
+    const char*   file;
+    long          line;
+    const char*   func;
+    long          samples;    // 抽出した数
+    double        count;      // 推定捕捉数
+    double        bytes;      // 推定捕捉サイズ
+} memSite_t;
+
+static int compareMemSiteLoc( const void *iData1, const void *iData2 )
+{
+    const watchInfo_t*  info1 = *(watchInfo_t* const*)iData1;
+    const watchInfo_t*  info2 = *(watchInfo_t* const*)iData2;
+    int  result = strcmp( info1->file, info2->file );
+    if( result ) {return result;}
+    if( info1->line == info2->line ) {return 0;}
+    return (info1->line < info2->line) ? -1 : 1;
+}
+
+static int compareMemSiteBytes( const void *iData1, const void *iData2 )
+{
+    const memSite_t*  site1 = iData1;
+    const memSite_t*  site2 = iData2;
+    if( site1->bytes > site2->bytes ) {return -1;}
+    return (site1->bytes < site2->bytes);
+}
+
+static void addMemSite( memSite_t *ioSite, const watchInfo_t *iInfo )
+{
+    double  weight = 1.0;
+    if( iInfo->sample ) {
+        weight = 1.0 / -expm1( -(double)iInfo->size / (double)iInfo->sample );
+    }
+    ioSite->samples++;
+    ioSite->count += weight;
+    ioSite->bytes += weight * (double)iInfo->size;
+}
+
+static long makeMemSite( watchInfo_t **iList, memSite_t *oSite )
+{
+    long  cnt = 0;
+    for( size_t i = 0;  i < gMemGrp.count;  i++ ) {
+        if( !i || compareMemSiteLoc( &iList[i - 1], &iList[i] ) ) {
+            oSite[cnt++] = (memSite_t){ iList[i]->file, iList[i]->line,
+                                        iList[i]->func, 0, 0.0, 0.0 };
+        }
+        addMemSite( &oSite[cnt - 1], iList[i] );
+    }
+    return cnt;
+}
+
+static void listMemSite( void )
+{
+    com_dbgCom( "\n### Using Memory MAX = %zu (sampled) ###\n",
+                gMemGrp.usingMax );
+    if( !gMemGrp.count ) {return;}
+    watchInfo_t**  list = sortWatchList( &gMemGrp, compareMemSiteLoc );
+    memSite_t*  site = malloc( sizeof(*site) * gMemGrp.count );
+    if( !list || !site ) {free( list );  free( site );  return;}
+    long  siteCnt = makeMemSite( list, site );
+    qsort( site, (size_t)siteCnt, sizeof(*site), compareMemSiteBytes );
+    gNoComDebugLog = false;
+    com_printf( "\n### estimated not freed memory by call site "
+                "(%zu samples, rate %zu bytes) ###\n",
+                gMemGrp.count, gMemSampleRate );
+    for( long i = 0;  i < siteCnt;  i++ ) {
+        com_printf( "? M %12.0f bytes %10.0f blocks (%5ld samples)  "
+                    "%s() in %s line %ld\n",
+                    site[i].bytes, site[i].count, site[i].samples,
+                    site[i].func, site[i].file, site[i].line );
+    }
+    free( list );
+    free( site );
+}
+
 static void listMemInfo( BOOL iByAddr )
 {
+    if( isMemSampled() && !iByAddr ) {listMemSite();  return;}
     DISP_LIST_INFO( "Using Memory MAX", "not freed memory list",
                     dispNotFreed, gMemGrp );
 }
 
+// 一覧出力中に他スレッドの登録/削除で監視データが移動しないようにロックする
 #define LIST_MEM_INFO( BYADDR ) \
     if( !gWatchMemInfoMode ) {return;} \
     com_setFuncTrace( false ); \
+    lockMemInfo(); \
     listMemInfo( BYADDR ); \
+    unlockMemInfo(); \
     com_setFuncTrace( true );
 
 void com_listMemInfo( void )
@@ -1383,6 +3347,211 @@ void com_listMemInfoByAddr( void )
     LIST_MEM_INFO( true )
 }
 
+// メモリ監視スナップショット
+// 呼び元(ファイル名のアドレス＋ライン数)ごとの集計を一時的なハッシュ表で作る。
+// 監視情報を1回なめるだけで、ソートや書式展開はしない。
+// 呼び元のファイル名とライン数はプロセス内で不変なので、2つのスナップショットの
+// 比較もアドレスとライン数の一致で行う。
+
+enum { SNAP_TABLE_MIN = 256 };    // 集計用ハッシュ表の初期サイズ (2のべき乗)
+
+typedef struct {
+    memSite_t*  site;       // 呼び元ごとの集計 (tableSize / 2 まで入る)
+    long        siteCnt;
+    long*       table;      // siteの位置 (NO_ALLOC_SITEなら空き)
+    size_t      tableSize;
+} snapSite_t;
+
+static size_t seekSnapSite(
+        const snapSite_t *iSnap, const char *iFile, long iLine )
+{
+    size_t  idx = hashAllocKey( (uintptr_t)iFile, iLine, iSnap->tableSize );
+    while( iSnap->table[idx] != NO_ALLOC_SITE ) {
+        const memSite_t*  tmp = &(iSnap->site[iSnap->table[idx]]);
+        if( tmp->file == iFile && tmp->line == iLine ) {break;}
+        idx = (idx + 1) & (iSnap->tableSize - 1);
+    }
+    return idx;
+}
+
+static BOOL makeSnapTable( snapSite_t *ioSnap, size_t iSize )
+{
+    long*  table = malloc( sizeof(*table) * iSize );
+    if( !table ) {return false;}
+    for( size_t i = 0;  i < iSize;  i++ ) {table[i] = NO_ALLOC_SITE;}
+    free( ioSnap->table );
+    ioSnap->table = table;
+    ioSnap->tableSize = iSize;
+    for( long i = 0;  i < ioSnap->siteCnt;  i++ ) {
+        memSite_t*  tmp = &(ioSnap->site[i]);
+        ioSnap->table[seekSnapSite( ioSnap, tmp->file, tmp->line )] = i;
+    }
+    return true;
+}
+
+static BOOL expandSnapSite( snapSite_t *ioSnap )
+{
+    size_t  newSize = SNAP_TABLE_MIN;
+    if( ioSnap->tableSize ) {newSize = ioSnap->tableSize * 2;}
+    memSite_t*  newSite = realloc( ioSnap->site,
+                                   sizeof(*newSite) * (newSize / 2) );
+    if( !newSite ) {return false;}
+    ioSnap->site = newSite;
+    return makeSnapTable( ioSnap, newSize );
+}
+
+static BOOL addSnapSite( snapSite_t *ioSnap, const watchInfo_t *iInfo )
+{
+    if( (size_t)ioSnap->siteCnt * 2 >= ioSnap->tableSize ) {
+        if( !expandSnapSite( ioSnap ) ) {return false;}
+    }
+    size_t  idx = seekSnapSite( ioSnap, iInfo->file, iInfo->line );
+    if( ioSnap->table[idx] == NO_ALLOC_SITE ) {
+        ioSnap->table[idx] = ioSnap->siteCnt;
+        ioSnap->site[ioSnap->siteCnt++] =
+            (memSite_t){ iInfo->file, iInfo->line, iInfo->func, 0, 0.0, 0.0 };
+    }
+    addMemSite( &(ioSnap->site[ioSnap->table[idx]]), iInfo );
+    return true;
+}
+
+static void setSnapshot( com_memSnapshot_t *oSnap, snapSite_t *iSnap )
+{
+    double  count = 0.0;
+    double  bytes = 0.0;
+    for( long i = 0;  i < iSnap->siteCnt;  i++ ) {
+        count += iSnap->site[i].count;
+        bytes += iSnap->site[i].bytes;
+    }
+    *oSnap = (com_memSnapshot_t){ gMemGrp.seqno, iSnap->siteCnt, iSnap->site,
+                                  (size_t)count, (size_t)bytes };
+}
+
+BOOL com_snapshotMemInfo( com_memSnapshot_t *oSnap )
+{
+    if( !oSnap ) {COM_PRMNG(false);}
+    *oSnap = (com_memSnapshot_t){ 0, 0, NULL, 0, 0 };
+    if( !gWatchMemInfoMode ) {return false;}
+
+    com_setFuncTrace( false );
+    snapSite_t  snap = { NULL, 0, NULL, 0 };
+    BOOL  result = true;
+    lockMemInfo();
+    for( watchInfo_t* tmp = gMemGrp.top;  tmp && result;  tmp = tmp->next ) {
+        result = addSnapSite( &snap, tmp );
+    }
+    if( result ) {setSnapshot( oSnap, &snap );}
+    unlockMemInfo();
+    free( snap.table );
+    if( !result ) {
+        free( snap.site );
+        com_error( COM_ERR_DEBUGNG, "##### fail to make mem snapshot #####" );
+    }
+    com_setFuncTrace( true );
+    return result;
+}
+
+// 比較結果 (呼び元ごとの増加分)
+typedef struct {
+    const memSite_t*  site;   // iNew側の集計
+    double            count;  // 増加数
+    double            bytes;  // 増加サイズ
+} memSiteDiff_t;
+
+static int compareMemSiteDiff( const void *iData1, const void *iData2 )
+{
+    const memSiteDiff_t*  diff1 = iData1;
+    const memSiteDiff_t*  diff2 = iData2;
+    if( diff1->bytes > diff2->bytes ) {return -1;}
+    return (diff1->bytes < diff2->bytes);
+}
+
+// iNewの呼び元ごとに iOldとの差分を作り、増加した呼び元の数を返す
+static long makeMemSiteDiff(
+        const com_memSnapshot_t *iOld, const com_memSnapshot_t *iNew,
+        memSiteDiff_t *oDiff, long *oShrink )
+{
+    snapSite_t  old = { iOld->site, iOld->siteCnt, NULL, 0 };
+    size_t  size = SNAP_TABLE_MIN;
+    while( size < (size_t)old.siteCnt * 2 ) {size *= 2;}
+    if( !makeSnapTable( &old, size ) ) {return COM_TABLEEND;}
+    const memSite_t*  newSite = iNew->site;
+    long  grown = 0;
+    long  matched = 0;
+    for( long i = 0;  i < iNew->siteCnt;  i++ ) {
+        memSiteDiff_t  diff = { &newSite[i], newSite[i].count,
+                                newSite[i].bytes };
+        long  idx = old.table[seekSnapSite( &old, newSite[i].file,
+                                            newSite[i].line )];
+        if( idx != NO_ALLOC_SITE ) {
+            matched++;
+            diff.count -= old.site[idx].count;
+            diff.bytes -= old.site[idx].bytes;
+        }
+        if( diff.bytes > 0.0 || diff.count > 0.0 ) {oDiff[grown++] = diff;}
+        else if( diff.bytes < 0.0 ) {(*oShrink)++;}
+    }
+    // iNewに無い呼び元は全て解放された
+    *oShrink += old.siteCnt - matched;
+    free( old.table );
+    return grown;
+}
+
+static void printMemSiteDiff(
+        const com_memSnapshot_t *iOld, const com_memSnapshot_t *iNew,
+        const memSiteDiff_t *iDiff, long iGrown, long iShrink )
+{
+    long  allocs = iNew->seqno - iOld->seqno;
+    if( allocs < 0 ) {allocs += COM_DEBUG_SEQNO_MAX;}
+    com_printf( "\n### memory growth by call site "
+                "(seqno %ld -> %ld, %ld allocations) ###\n",
+                iOld->seqno, iNew->seqno, allocs );
+    com_printf( "### total %+.0f blocks %+.0f bytes "
+                "(now %zu blocks %zu bytes) ###\n",
+                (double)iNew->count - (double)iOld->count,
+                (double)iNew->bytes - (double)iOld->bytes,
+                iNew->count, iNew->bytes );
+    for( long i = 0;  i < iGrown;  i++ ) {
+        const memSite_t*  site = iDiff[i].site;
+        com_printf( "+ M %+12.0f bytes %+10.0f blocks (now %12.0f bytes)  "
+                    "%s() in %s line %ld\n",
+                    iDiff[i].bytes, iDiff[i].count, site->bytes,
+                    site->func, site->file, site->line );
+    }
+    com_printf( "### %ld call sites shrank ###\n", iShrink );
+}
+
+long com_diffMemInfo(
+        const com_memSnapshot_t *iOld, const com_memSnapshot_t *iNew )
+{
+    if( !iOld || !iNew ) {COM_PRMNG(0);}
+    com_setFuncTrace( false );
+    // iNew->siteCntが 0でも malloc()の結果が NULLにならないよう 1つ多くする
+    size_t  size = sizeof(memSiteDiff_t) * (size_t)(iNew->siteCnt + 1);
+    memSiteDiff_t*  diff = malloc( size );
+    long  shrink = 0;
+    long  grown = COM_TABLEEND;
+    if( diff ) {grown = makeMemSiteDiff( iOld, iNew, diff, &shrink );}
+    if( grown == COM_TABLEEND ) {
+        com_error( COM_ERR_DEBUGNG, "##### fail to diff mem snapshot #####" );
+        free( diff );
+        com_setFuncTrace( true );
+        return 0;
+    }
+    qsort( diff, (size_t)grown, sizeof(*diff), compareMemSiteDiff );
+    printMemSiteDiff( iOld, iNew, diff, grown, shrink );
+    free( diff );
+    com_setFuncTrace( true );
+    return grown;
+}
+
+void com_freeMemSnapshot( com_memSnapshot_t *ioSnap )
+{
+    if( !ioSnap ) {return;}
+    free( ioSnap->site );
+    *ioSnap = (com_memSnapshot_t){ 0, 0, NULL, 0, 0 };
+}
+
 static BOOL  gDebugMemMode = false;
 static long  gDebugMemSeqno = 0;
 
@@ -1409,6 +3578,9 @@ static COM_DEBUG_MODE_t gWatchFileInfoMode = COM_DEBUG_OFF;
 
 void com_setWatchFileInfo( COM_DEBUG_MODE_t iMode )
 {
+#ifdef USE_RELEASE_ABI  // リリースABIでは監視処理を通らないため常にOFF
+    iMode = COM_DEBUG_OFF;
+#endif
     setDebugMode( &gWatchFileInfoMode, iMode );
 }
 
@@ -1442,7 +3614,7 @@ static void dispFileInfo(
     // iTypeだけは iIndo->typeと異なる可能性があるため、別入力
     MAKELOG( "%s%08ld com_f%-7s %12p (%5zu)\n",
                  iPre, oInfo->seqno, type[iType], oInfo->ptr, gFileGrp.count );
-    dispWatchInfo( iMode, iPre, oInfo->label, COM_FILEVAR );
+    dispWatchInfo( iMode, iPre, WATCH_LABEL( oInfo ), COM_FILEVAR );
 }
 
 void com_addFileInfo(
@@ -1471,6 +3643,14 @@ long com_checkFileInfo( const FILE *iFp )
     return seqno;
 }
 
+const char *com_getFileInfoLabel( const FILE *iFp )
+{
+    if( !gWatchFileInfoMode ) {return NULL;}
+    size_t  idx = 0;
+    if( !searchWatchList( &gFileGrp, iFp, &idx ) ) {return NULL;}
+    return WATCH_LABEL( gFileGrp.table[idx] );
+}
+
 void com_deleteFileInfo( COM_FILEPRM, COM_FILE_OPR_t iType, const FILE *iFp )
 {
     if( !gWatchFileInfoMode ) {return;}
@@ -1487,6 +3667,7 @@ void com_deleteFileInfo( COM_FILEPRM, COM_FILE_OPR_t iType, const FILE *iFp )
     if( !gSkipFileInfo ) {
         dispFileInfo( "--F", iType, &tmp, gWatchFileInfoMode, COM_FILEVAR );
     }
+    releaseLabel( &gFileGrp, tmp.label );
     com_setFuncTrace( true );
 }
 
@@ -1603,41 +3784,104 @@ BOOL com_mutexUnlockCom( pthread_mutex_t *ioMutex, COM_FILEPRM, BOOL iResult )
 // 関数呼出トレース機能関連 --------------------------------------------------
 
 #ifdef USE_FUNCTRACE
-static __thread  char gFileNameBuf[COM_LINEBUF_SIZE];
-static __thread  char gFilePathBuf[COM_LINEBUF_SIZE];
+// ネームリストは最初に必要になった時に全て読み込み、アドレス順の表にして
+// 以後は二分探索で引く (nm -n の出力はアドレス順になっている)。
+// 表は一度作ったら変更しないので、作成後は排他なしで参照できる。
 
 typedef struct {
-    void*   addr;
-    char*   name;
+    ulong   addr;
+    char*   name;       // "名前 (ファイル位置)"
 } funcName_t;
 
-enum { NEED_DATA_COUNT = 2 };
+static funcName_t*  gNameList = NULL;
+static long  gNameCount = 0;
+static long  gNameMax = 0;
+static BOOL  gNameLoaded = false;
+static pthread_mutex_t  gMutexNameList = PTHREAD_MUTEX_INITIALIZER;
+
+enum { NEED_DATA_COUNT = 2, NAMELIST_BLOCK = 4096 };
+
+__attribute__((no_instrument_function))
+static BOOL addNameList( ulong iAddr, const char *iName, const char *iPath )
+{
+    if( gNameCount == gNameMax ) {
+        // メモリ監視の対象にしないよう、com_realloc()は使用しない
+        funcName_t*  tmp = realloc( gNameList, sizeof(*gNameList) *
+                                    (size_t)(gNameMax + NAMELIST_BLOCK) );
+        if( !tmp ) {return false;}
+        gNameList = tmp;
+        gNameMax += NAMELIST_BLOCK;
+    }
+    char  fileName[COM_WORDBUF_SIZE] = {0};
+    com_getFileName( fileName, sizeof(fileName), iPath );
+    size_t  size = strlen( iName ) + strlen( fileName ) + 4;
+    char*  name = malloc( size );
+    if( !name ) {return false;}
+    snprintf( name, size, "%s (%s)", iName, fileName );
+    gNameList[gNameCount++] = (funcName_t){ iAddr, name };
+    return true;
+}
 
 __attribute__((no_instrument_function))
-static BOOL seekFuncName( com_seekFileResult_t *iInf )
+static BOOL readNameLine( com_seekFileResult_t *iInf )
 {
-    funcName_t*  data = iInf->userData;
-    ulong  addr = com_strtoul( iInf->line, 16, false );
-    if( addr != (ulong)(data->addr) ) {return true;}
-    int cnt = sscanf( iInf->line, "%*s %*s %s %s", gFileNameBuf, gFilePathBuf );
+    char  name[COM_LINEBUF_SIZE];
+    char  path[COM_LINEBUF_SIZE];
+    int cnt = sscanf( iInf->line, "%*s %*s %s %s", name, path );
     if( cnt != NEED_DATA_COUNT ) {return true;}
-    if( !strcmp( gFileNameBuf, ".text" ) ) {return true;}
-    char  fileName[COM_WORDBUF_SIZE] = {0};
-    com_getFileName( fileName, sizeof(fileName), gFilePathBuf );
-    com_connectString( gFileNameBuf, sizeof(gFileNameBuf), " (%s)", fileName );
-    data->name = gFileNameBuf;
-    return false;
+    if( !strcmp( name, ".text" ) ) {return true;}
+    return addNameList( com_strtoul( iInf->line, 16, false ), name, path );
+}
+
+__attribute__((no_instrument_function))
+static void loadNameList( void )
+{
+    pthread_mutex_lock( &gMutexNameList );
+    if( !gNameLoaded && com_checkExistFile( MAKEFILE_NAMELIST ) ) {
+        char  nmBuf[COM_LINEBUF_SIZE];
+        (void)com_seekFile( MAKEFILE_NAMELIST, readNameLine, NULL,
+                            nmBuf, sizeof(nmBuf) );
+    }
+    __atomic_store_n( &gNameLoaded, true, __ATOMIC_RELEASE );
+    pthread_mutex_unlock( &gMutexNameList );
+}
+
+__attribute__((no_instrument_function))
+static const char *searchNameList( ulong iAddr )
+{
+    long  low = 0;
+    long  high = gNameCount - 1;
+    while( low <= high ) {
+        long  mid = (low + high) / 2;
+        if( gNameList[mid].addr == iAddr ) {return gNameList[mid].name;}
+        if( gNameList[mid].addr < iAddr ) {low = mid + 1;}
+        else {high = mid - 1;}
+    }
+    return NULL;
 }
 
+// 一致するアドレスが無ければ NULLを返す。
+// PIEでビルドした場合、ネームリストのアドレスはロード先からのオフセットに
+// なるため、見つからなければロード先アドレスを引いて再検索する。
 __attribute__((no_instrument_function))
 static const char *seekNameList( void *iFunc )
 {
-    if( !com_checkExistFile( MAKEFILE_NAMELIST ) ) {return NULL;}
-    funcName_t  data = { iFunc, NULL };
-    char  nmBuf[COM_LINEBUF_SIZE];
-    (void)com_seekFile( MAKEFILE_NAMELIST, seekFuncName, &data,
-                        nmBuf, sizeof(nmBuf) );
-    return data.name;
+    if( !__atomic_load_n( &gNameLoaded, __ATOMIC_ACQUIRE ) ) {loadNameList();}
+    const char*  result = searchNameList( (ulong)iFunc );
+    if( result ) {return result;}
+    Dl_info  dli;
+    if( !dladdr( iFunc, &dli ) || !dli.dli_fbase ) {return NULL;}
+    return searchNameList( (ulong)iFunc - (ulong)dli.dli_fbase );
+}
+
+__attribute__((no_instrument_function))
+static void freeNameList( void )
+{
+    for( long i = 0;  i < gNameCount;  i++ ) {free( gNameList[i].name );}
+    free( gNameList );
+    gNameList = NULL;
+    gNameCount = gNameMax = 0;
+    gNameLoaded = false;
 }
 
 const char *com_seekNameList( void *iAddr )
@@ -1669,43 +3913,57 @@ void com_setFuncTraceReal( BOOL iMode, COM_FILEPRM )
     else {gFuncTraceMode = true;}
 }
 
+// トレース情報はスレッドごとの固定長リングに、アドレスとタイムスタンプだけを
+// 記録する。書き込むのはそのスレッドだけなので排他は不要。
+// 関数名の解決は com_dispFuncTrace()で出力する時にのみ行う。
+
 typedef struct {
-    void*  func;
-    long   level;
+    void*      func;
+    uint64_t   stamp;     // タイムスタンプ (x86ならTSC、それ以外はナノ秒)
+    long       level;     // ネスト
+    BOOL       isExit;    // 関数復帰時なら true
 } funcTrace_t;
 
 static __thread funcTrace_t  gFuncTraceList[COM_FUNCTRACE_MAX];
+static __thread ulong  gFuncTraceCount = 0;    // 記録した数 (通算)
+static __thread long  gFuncNestCount = 0;
 
-// まだデバッグ機能が動作していない状態から動作することを想定し、
-// com_createRingBuf()によるバッファ領域の静的確保を行わず、手動設定する。
-// .bufについては別途関数内で gFuncTraceList を設定する。
+__attribute__((no_instrument_function))
+static inline uint64_t getTraceStamp( void )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t  low, high;
+    __asm__ __volatile__( "rdtsc" : "=a"(low), "=d"(high) );
+    return ((uint64_t)high << 32) | low;
+#else
+    struct timespec  now;
+    (void)clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
 
-static __thread com_ringBuf_t  gFuncTracer = {
-    NULL, sizeof(funcTrace_t), COM_FUNCTRACE_MAX, 0, 0, 0,
-    true, false, 0, NULL
-};
-static __thread long  gFuncNestCount = 0;
+__attribute__((no_instrument_function))
+static inline void addFuncTrace( void *iFunc, long iLevel, BOOL iIsExit )
+{
+    funcTrace_t*  trace =
+        &(gFuncTraceList[gFuncTraceCount++ % COM_FUNCTRACE_MAX]);
+    *trace = (funcTrace_t){ iFunc, getTraceStamp(), iLevel, iIsExit };
+}
 
 __attribute__((no_instrument_function))
 void __cyg_profile_func_enter( void *iFunc, void *iCaller )
 {
     COM_UNUSED( iCaller );
     if( !gFuncTraceMode ) {return;}
-    COM_TRACER_SET( false );
-    gFuncTracer.buf = gFuncTraceList;  // 初期化ではエラーになるのでここで設定
-    com_pushRingBuf( &gFuncTracer,
-                     &(funcTrace_t){ iFunc, gFuncNestCount++ },
-                     sizeof( funcTrace_t ) );
-    COM_TRACER_RESUME;
+    addFuncTrace( iFunc, gFuncNestCount++, false );
 }
 
 __attribute__((no_instrument_function))
 void __cyg_profile_func_exit( void *iFunc, void *iCaller )
 {
-    COM_UNUSED( iFunc );
     COM_UNUSED( iCaller );
     if( !gFuncTraceMode ) {return;}
-    gFuncNestCount--;
+    addFuncTrace( iFunc, --gFuncNestCount, true );
 }
 
 __attribute__((no_instrument_function))
@@ -1727,18 +3985,31 @@ static pthread_mutex_t gMutexFuncTrace = PTHREAD_MUTEX_INITIALIZER;
 __attribute__((no_instrument_function))
 void com_dispFuncTrace( void )
 {
-    com_mutexLock( &gMutexFuncTrace, __func__ );
     COM_TRACER_SET( false );
+    pthread_mutex_lock( &gMutexFuncTrace );
     com_printf( "\n##### function trace list #####\n" );
-    funcTrace_t*  tracer = NULL;
-    for( size_t i = 0;  (tracer = com_pullRingBuf( &gFuncTracer ));  i++ ) {
-        com_printf( "[%06zd] %p ", i, tracer->func );
+    ulong  count = gFuncTraceCount;
+    ulong  top = (count > COM_FUNCTRACE_MAX) ? count - COM_FUNCTRACE_MAX : 0;
+    uint64_t  prev = 0;
+    for( ulong i = top;  i < count;  i++ ) {
+        funcTrace_t*  tracer = &(gFuncTraceList[i % COM_FUNCTRACE_MAX]);
+        if( i == top ) {prev = tracer->stamp;}
+        com_printf( "[%06lu] %p +%-10llu ", i - top, tracer->func,
+                    (unsigned long long)(tracer->stamp - prev) );
+        prev = tracer->stamp;
         com_repeat( " ", tracer->level, false );
-        com_printf( "%s\n", getFuncName( tracer->func ) );
+        com_printf( "%s %s\n", tracer->isExit ? "<-" : "->",
+                    getFuncName( tracer->func ) );
     }
+    gFuncTraceCount = 0;    // 出力した情報は破棄する
+    pthread_mutex_unlock( &gMutexFuncTrace );
     COM_TRACER_RESUME;
-    com_mutexUnlock( &gMutexFuncTrace, __func__ );
 }
+
+// ネームリスト表の解放 (com_finalizeDebugMode()から呼ぶ)
+#define FREE_NAMELIST  freeNameList()
+#else
+#define FREE_NAMELIST  do{} while(0)
 #endif // USE_FUNCTRACE
 
 
@@ -1982,6 +4253,11 @@ void com_finalizeDebugMode( void )
     com_listMemInfo();
     com_listFileInfo();
     com_dispTitle( "end" );
+    closeFlightRecorder();
+    (void)com_setAllocProfile( false );
+    FREE_NAMELIST;
+    freeAllTrcBuf();
+    freeAllOutBuf();
     com_closeDebugLog();
 }
 
@@ -86,7 +86,11 @@ typedef enum {
     COM_STRNDUP,           // com_strndup()
     COM_SCANDIR,           // com_scandir()
     COM_FREEADDRINFO,      // com_freeAddrInfo()  ＊com_select.h使用時のみ
-    COM_GETADDRINFO        // com_getAddrInfo()   ＊com_select.h使用時のみ
+    COM_GETADDRINFO,       // com_getAddrInfo()   ＊com_select.h使用時のみ
+    COM_ALLOCPOOL,         // com_allocPool()
+    COM_FREEPOOLOBJ,       // com_freePoolObj()
+    COM_ALLOCLARGE,        // com_allocLarge()
+    COM_FREELARGE          // com_freeLarge()
 } COM_MEM_OPR_t;
 
 char *com_getMemOperator( COM_MEM_OPR_t iType );
@@ -103,6 +107,11 @@ char *com_getMemOperator( COM_MEM_OPR_t iType );
  *
  * iFormat以降の内容は参考情報として保持するが、COM_DEBUGINFO_LABEL が、
  * 保持する最大サイズとなる。超える場合は切り捨てる。
+ * COM_FILEPRMのファイル名と関数名はコピーせずにアドレスのみ保持するため、
+ * COM_FILELOCで渡される文字列リテラルのように、プログラム終了まで有効な
+ * 文字列である必要がある。
+ * 監視情報は iPtrをキーとしたハッシュ表で管理するので、監視情報の数に
+ * 関わらず追加/確認/削除の負荷はほぼ一定となる。
  *
  * realloc()を使用する処理の場合、先に com_deleteMmeInfo()で元アドレスの
  * メモリ監視情報削除が必要。
@@ -234,6 +243,7 @@ typedef enum {
  *
  * iPathの内容は参考情報として保持するが、COM_DEBUGINFO_LABEL が最大サイズで
  * それを超える場合は切り捨てられる。
+ * COM_FILEPRMの扱いは com_addMemInfo()と同じ。
  */
 void com_addFileInfo(
         COM_FILEPRM, COM_FILE_OPR_t iType, const FILE *iFp, const char *iPath );
@@ -251,6 +261,19 @@ void com_addFileInfo(
  */
 long com_checkFileInfo( const FILE *iFp );
 
+/*
+ * ファイル監視情報ラベル取得  com_getFileInfoLabel()
+ *   指定されたアドレスの監視情報のラベル文字列を返す。
+ *   そのアドレスの監視情報がない場合は NULLを返す。
+ *   ファイル監視モードが COM_DEBUG_OFFの場合、常に NULLを返す。
+ * ---------------------------------------------------------------------------
+ *   エラーは発生しない。
+ * ===========================================================================
+ * 返すのは同じラベルの監視情報で共有している文字列なので、変更はしないこと。
+ * 該当する全てのファイルがクローズされると解放される。
+ */
+const char *com_getFileInfoLabel( const FILE *iFp );
+
 /*
  * ファイル監視情報削除  com_deleteFileInfo()
  * ---------------------------------------------------------------------------
@@ -438,6 +461,25 @@ void com_logCom( const char *iFormat, ... );
  */
 void com_suspendStdout( BOOL iMode );
 
+/*
+ * 画面出力フック  com_hookPrint()
+ * ---------------------------------------------------------------------------
+ *   エラーは発生しない。
+ * ===========================================================================
+ *   設定はスレッドごとに保持する。
+ * ===========================================================================
+ * iFuncに関数を設定すると、そのスレッドで com_printf()・com_repeat()・
+ * com_printBinary()など 画面出力＆ログ出力するI/Fの出力文字列を、画面にも
+ * デバッグログにも出さずに iFuncに渡す。iUserDataもそのまま iFuncに渡す。
+ * 渡される文字列は 1行ごとに区切られているとは限らない。
+ * NULLを設定すれば解除される。
+ *
+ * 主に com_openDecodeSink()で、デコーダーが直接 com_printf()で出力した
+ * 文字列を構造化データとして取り込むために使用する。
+ */
+typedef void(*com_printHook_t)( const char *iText, void *ioUserData );
+void com_hookPrint( com_printHook_t iFunc, void *iUserData );
+
 /*
  * タイトル表示  com_dispTitle()
  * ---------------------------------------------------------------------------
@@ -489,13 +531,21 @@ void com_adjustError( void );
  */
 void com_closeDebugLog( void );
 
+/*
+ * フライトレコーダー終了コード記録  com_markExitFlightRecorder()
+ * ---------------------------------------------------------------------------
+ * com_exitFunc()から呼び、フライトレコーダーに終了コード iCodeを記録する。
+ * フライトレコーダーを使用していなければ何もしない。
+ */
+void com_markExitFlightRecorder( long iCode );
+
 #ifdef USE_FUNCTRACE
 /*
  * ファイルの呼出/復帰時にコールされるシステム関数
  *   ＊関数呼出トレース機能用。この機能自体の説明は com_if.hの
  *     com_dispFuncTrace() の記述を参照。
  * ---------------------------------------------------------------------------
- *   幾つかエラーが出る可能性があるが、発生時は作者に連絡すること。
+ *   エラーは発生しない。
  * ===========================================================================
  * 関数呼出トレース機能を使用するために、GNU拡張で定義が定められているI/Fの
  * プロトタイプ宣言となる。本関数を使用するためには「関数呼出トレース機能」が
@@ -505,6 +555,8 @@ void com_closeDebugLog( void );
  * GNU拡張で名称が固定されているため、関数名やプロトタイプの変更は不可能。
  *  __cyg_profile_func_enter()は関数呼出時にコールされる。
  *  __cyg_profile_func_exit()は関数復帰時にコールされる。
+ * どちらもスレッドごとのリングバッファにアドレスとタイムスタンプを書くだけで
+ * 排他もメモリ確保も行わない。
  * 使い方の詳細については、これらの関数の使い方を示した情報を確認すること。
  */
 void __cyg_profile_func_enter( void *iFunc, void *iCaller );
@@ -155,6 +155,7 @@ static size_t inputProc(
     while(1) {
         if( iFlag->clear ) {com_clear();}
         if( prompt ) {com_printf( "%s", prompt );}
+        com_flushOutput();
         if( !inputString( oData, iSize, &onlyEnter ) ) {continue;}
         if( onlyEnter ) {if( iFlag->enterSkip ) {break;} else {continue;}}
         // データ入力に問題がなければループを抜けて返す
@@ -203,6 +204,7 @@ size_t com_inputMultiLine( char *oData, size_t iSize, const char *iFormat, ... )
     if( COM_UNLIKELY(!oData) ) {COM_PRMNG(0);}
     COM_SET_FORMAT( gPromptBuff );
     if( iFormat ) {com_printf( "%s", gPromptBuff );}
+    com_flushOutput();
     memset( oData, 0, iSize );
     clearerr( stdin );
     size_t  result = fread( oData, 1, iSize, stdin );
@@ -910,6 +912,7 @@ static pthread_mutex_t  gMutexRegxp = PTHREAD_MUTEX_INITIALIZER;
 
 static regex_t  *gRegexList = NULL;
 static com_regex_id_t  gRegexId = 0;
+static long  gRegexCapa = 0;
 
 com_regex_id_t com_regcomp( com_regcomp_t *iRegex )
 {
@@ -925,9 +928,9 @@ com_regex_id_t com_regcomp( com_regcomp_t *iRegex )
     long  newId = gRegexId;
     com_skipMemInfo( true );
     com_mutexLock( &gMutexRegxp, __func__ );
-    long addresult = com_realloct(
-                       &gRegexList, sizeof(gRegexList[0]), &gRegexId, 1,
-                       "regex comp list(%ld)", gRegexId );
+    long addresult = com_realloctCap(
+                       &gRegexList, sizeof(gRegexList[0]), &gRegexId,
+                       &gRegexCapa, 1, "regex comp list(%ld)", gRegexId );
     com_mutexUnlock( &gMutexRegxp, __func__ );
     com_skipMemInfo( false );
     if( !addresult ) {return COM_REGXP_NG;}
@@ -1004,6 +1007,7 @@ static void freeRegex( void )
         regfree( &(gRegexList[i]) );
     }
     com_free( gRegexList );
+    gRegexId = gRegexCapa = 0;
 }
 
 
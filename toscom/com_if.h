@@ -24,6 +24,9 @@
  *  ・COMHASH  ：ハッシュテーブル関連I/F (ハッシュ検索を伴うデータ形式)
  *  ・COMSORT  ：ソートテーブル関連I/F (二分探索法を使うデータ形式)
  *  ・COMRING  ：リングバッファ関連I/F
+ *  ・COMARENA ：アリーナ関連I/F
+ *  ・COMPOOL  ：オブジェクトプール関連I/F
+ *  ・COMLARGE ：大容量領域関連I/F
  *  ・COMCFG   ：コンフィグ関連I/F
  *  ・COMCONV  ：データ変換関連I/F
  *  ・COMUSTR  ：文字列ユーティリティ関連I/F
@@ -33,6 +36,7 @@
  *  ・COMPRINT ：画面出力/ロギング関連I/F
  *  ・COMDEBUG ：デバッグ関連I/F
  *  ・COMTEST  ：テスト関連I/F
+ *  ・COMRELABI：リリースABI (監視処理を省いた軽量I/Fへの置き換え)
  *
  *****************************************************************************
  */
@@ -141,6 +145,8 @@
 #include <dirent.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <pthread.h>
 #include <float.h>
 #include <math.h>
@@ -850,6 +856,78 @@ void *com_reallocAddrFunc(
         void *iAddr, size_t iUnit, long iPos, long *ioCount, long iReszize,
         COM_FILEPRM, const char *iFormat, ... );
 
+/*
+ * メモリ再捕捉(容量管理付き)  com_realloctCap()・com_reallocAddrCap()
+ *                             com_shrinkTable()
+ *   com_realloctCap()・com_shrinkTable()は処理結果を true/false で返す。
+ *   com_reallocAddrCap()は com_reallocAddr()と同じアドレスを返す。
+ *   再捕捉したアドレスは、必ず com_free()で解放すること。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG: [com_prmNG] !ioCapa
+ *                    com_shrinkTable()で iCount < 0 || iCount > *ioCapa
+ *   その他は com_realloct()・com_reallocAddr()と同じ。
+ * ===========================================================================
+ *   mutexによる排他処理が動作するためスレッドセーフとなる。
+ * ===========================================================================
+ * com_realloct()・com_reallocAddr()はテーブルの要素数ぴったりのメモリを
+ * 再捕捉するため、1つずつ追加していくと毎回 realloc()とデータコピーが走り、
+ * n個の追加で O(n^2)の負荷になる。
+ * com_realloctCap()・com_reallocAddrCap()は要素数(ioCount)とは別に、
+ * 捕捉済みの容量(ioCapa)を保持することで、この負荷を避ける。
+ * ・拡張後の要素数が容量以内なら、メモリ再捕捉はせずに要素数だけ更新する。
+ * ・容量を超える場合は、容量を 2倍(最低 COM_TABLE_CAPAMIN)に拡張する。
+ *   それでも足りなければ拡張後の要素数を容量とする。
+ * ・縮小時もメモリ再捕捉はせずに要素数だけ更新する。
+ *   ただし要素数が 0になる時は、com_realloct()と同様に com_free()を実施し、
+ *   *ioCapaも 0にする。
+ * 追加した要素を 0クリアするのは com_realloct()と同じ。
+ * ioCapa以外の引数は com_realloct()・com_reallocAddr()と同じ。
+ * *ioCapaは最初 0にしておき、その後は本I/Fの中でだけ変更すること。
+ * テーブルを com_free()で直接解放した時は、*ioCountと共に 0に戻すこと。
+ *
+ * com_shrinkTable()は容量を iCountまで縮小し、*ioCapaを iCountにする。
+ * 追加が終わって、以後サイズが変わらないテーブルの余分な容量を返すのに使う。
+ * iCountが 0なら com_free()を実施する。
+ */
+
+enum { COM_TABLE_CAPAMIN = 4 };   // 容量拡張時の最低容量
+
+/*
+ * プロトタイプ形式 (この形で使用すること)
+ *   BOOL com_realloctCap( void *ioAddr, size_t iUnit, long *ioCount,
+ *                         long *ioCapa, long iResize,
+ *                         const char *iFormat, ... );
+ *   void *com_reallocAddrCap(
+ *       void *iAddr, size_t iUnit, long iPos, long *ioCount, long *ioCapa,
+ *       long iResize, const char *iFormat, ... );
+ *   BOOL com_shrinkTable( void *ioAddr, size_t iUnit, long iCount,
+ *                         long *ioCapa, const char *iFormat, ... );
+ */
+#define com_realloctCap( ADDR, UNIT, COUNT, CAPA, RESIZE, ... ) \
+    com_realloctCapFunc( (ADDR), (UNIT), (COUNT), (CAPA), (RESIZE), \
+                         COM_FILELOC, __VA_ARGS__ )
+
+#define com_reallocAddrCap( ADDR, UNIT, POS, COUNT, CAPA, RESIZE, ... ) \
+    com_reallocAddrCapFunc( (ADDR), (UNIT), (POS), (COUNT), (CAPA), \
+                            (RESIZE), COM_FILELOC, __VA_ARGS__ )
+
+#define com_shrinkTable( ADDR, UNIT, COUNT, CAPA, ... ) \
+    com_shrinkTableFunc( (ADDR), (UNIT), (COUNT), (CAPA), \
+                         COM_FILELOC, __VA_ARGS__ )
+
+/* 処理実体関数 */
+BOOL com_realloctCapFunc(
+        void *ioAddr, size_t iUnit, long *ioCount, long *ioCapa, long iResize,
+        COM_FILEPRM, const char *iFormat, ... );
+
+void *com_reallocAddrCapFunc(
+        void *ioAddr, size_t iUnit, long iPos, long *ioCount, long *ioCapa,
+        long iResize, COM_FILEPRM, const char *iFormat, ... );
+
+BOOL com_shrinkTableFunc(
+        void *ioAddr, size_t iUnit, long iCount, long *ioCapa,
+        COM_FILEPRM, const char *iFormat, ... );
+
 /*
  * 文字列複製  com_strdup()・com_strndup()
  *   strdup()と同じように捕捉したアドレスを返す。処理NGのときは NULLを返す。
@@ -1701,6 +1779,11 @@ typedef ulong  com_hash_t;      // ハッシュ値計算結果型
 #define COM_HASHID_MAX  LONG_MAX
 #define COM_HASHID_NOTREG  (-1)  // ハッシュテーブル登録なしの状態(初期状態)
 
+// 64bit FNV-1aの定数 (calcHashKey()で使用。独自の計算関数でも使って良い)
+// 計算途中の値は ulongではなく uint64_tで持つこと。
+#define COM_FNV_OFFSET  UINT64_C(14695981039346656037)
+#define COM_FNV_PRIME   UINT64_C(1099511628211)
+
 // ハッシュ値計算個別関数プロトタイプ
 typedef com_hash_t (*com_calcHashKey)(
         const void *iKey, size_t iKeySize, size_t iTableSize );
@@ -1964,6 +2047,12 @@ BOOL com_deleteHashFunc(
  *
  * .table[]や その各要素の dataは、データ追加のたびにメモリ捕捉するので、
  * 使用後は com_freeSortTable()でメモリ解放を実施すること。
+ *
+ * この I/Fを使わずに初期化する場合、.capacityも必ず 0にすること。
+ * .capacityは .table[]の実際の容量で、.count以上あれば再捕捉せずに使うため、
+ * 不定値のままだと捕捉していない領域に書き込んでしまう。
+ * 構造体の末尾にあるので、{0, COM_SORT_SKIP, 0, NULL, NULL} のように
+ * 初期化子で省略すれば 0になるが、メンバーを個別に代入する場合は注意すること。
  */
 
 // ソートテーブル データ型
@@ -1988,6 +2077,7 @@ typedef struct {
     int32_t  dummyFor64bit;
     com_sort_t*       table;          // ソートテーブル本体
     com_sort_t**      search;         // 検索結果出力用
+    long              capacity;       // テーブル容量 (初期値は必ず 0)
 } com_sortTable_t;
 
 void com_initializeSortTable( com_sortTable_t *oTable, COM_SORT_MATCH_t iAct );
@@ -2357,6 +2447,10 @@ typedef struct {
  * 特に開放が必要なデータない場合は NULLを指定すれば良い。
  * この関数の動作については com_freeRingBuf_tの宣言箇所で記載済み。
  *
+ * バッファ全体のサイズ(iUnit * iSize)が COM_LARGE_HUGESIZE以上の場合は、
+ * com_allocLarge()でヒュージページを要求し、生成したスレッドの NUMAノードに
+ * 割り当てて捕捉する。
+ *
  * リングバッファの動作仕様については、このI/F説明の直前で記載しているので、
  * 使い方の流れはそちらを参照して欲しい。
  * リングバッファに登録するデータは特定の型(構造体等)とし、その sizeof()値が
@@ -2477,6 +2571,465 @@ void com_freeRingBufFunc( com_ringBuf_t **oRing, COM_FILEPRM );
 
 
 
+/*
+ *****************************************************************************
+ * COMARENA:アリーナ関連I/F (com_proc.c)
+ *****************************************************************************
+ */
+
+/*
+ * アリーナはまとめて捕捉したチャンク(領域)から、小さなメモリを先頭から
+ * 順に切り出して使うメモリ管理となる。切り出しはポインタを進めるだけなので
+ * com_malloc()よりはるかに軽く、個々の領域を解放する必要もない。
+ * 1つの要求や1パケットの処理など、短い間だけ使う小さなデータを多数扱い、
+ * 処理が終わったらまとめて捨てる、という使い方に向く。
+ *
+ * アリーナは com_createArena()で生成する。
+ * 領域の切り出しは com_allocArena()で行う。チャンクに空きがなくなったら
+ * 新しいチャンクを捕捉して続ける。
+ * com_markArena()でその時点の使用位置を記録し、com_rewindArena()でそこまで
+ * 戻すと、記録後に切り出した領域をまとめて破棄できる。
+ * com_resetArena()は全ての領域を破棄し、アリーナを生成直後の状態に戻す。
+ * 破棄した領域のチャンクは解放せずに保持し、以後の切り出しで再利用する。
+ * 使い終わったアリーナは com_freeArena()で解放する。
+ *
+ * チャンクは com_malloc()で捕捉するため、メモリ監視ではチャンク単位で
+ * 1つの監視情報となり、com_createArena()を呼んだ位置が捕捉位置になる。
+ * 切り出した個々の領域はメモリ監視の対象外となる。
+ *
+ * アリーナは排他処理をしないので、1つのアリーナは1つのスレッドだけで
+ * 使うこと(スレッドごとにアリーナを生成する想定)。
+ *
+ * 使用例：
+ *     com_arena_t*  arena = com_createArena( 0 );
+ *     while( (パケットがある) ) {
+ *         item_t*  item = com_allocArena( arena, sizeof(item_t) );
+ *         (パケット処理で必要な領域を com_allocArena()で切り出して使用)
+ *         com_resetArena( arena );
+ *     }
+ *     com_freeArena( &arena );
+ */
+
+// アリーナのチャンク (ヘッダの後に切り出し用の領域が続く)
+typedef struct com_arenaChunk {
+    struct com_arenaChunk*  next;    // 次のチャンク
+    size_t   size;                   // 切り出し用の領域サイズ
+    size_t   used;                   // 切り出し済みサイズ
+} com_arenaChunk_t;
+
+// アリーナ構造
+typedef struct {
+    com_arenaChunk_t*  chunk;        // 使用中のチャンク (最新が先頭)
+    com_arenaChunk_t*  spare;        // 破棄済みで再利用待ちのチャンク
+    size_t   chunkSize;              // 標準のチャンクサイズ
+    size_t   used;                   // 切り出し済みサイズ合計
+    size_t   capacity;               // 捕捉しているチャンクのサイズ合計
+    const char*  file;               // 生成したファイル名
+    long     line;                   // 生成したライン数
+    const char*  func;               // 生成した関数名
+} com_arena_t;
+
+// com_markArena()で記録する使用位置
+typedef struct {
+    com_arenaChunk_t*  chunk;
+    size_t   chunkUsed;
+    size_t   used;
+} com_arenaMark_t;
+
+// 切り出す領域のアラインメントと、標準のチャンクサイズ
+enum {
+    COM_ARENA_ALIGN = 16,
+    COM_ARENA_CHUNK = 65536
+};
+
+/*
+ * アリーナ生成  com_createArena()
+ *   生成したアリーナのアドレスを返す。
+ *   生成に失敗した場合は NULLを返す。
+ *   このアリーナは使用後に、com_freeArena()で解放が必要。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_NOMEMORY: アリーナのメモリ捕捉NG
+ * ===========================================================================
+ *   マルチスレッドで影響を受ける処理は無い。
+ * ===========================================================================
+ * iChunkSizeで1つのチャンクの切り出し用領域サイズを指定する。0を指定すると
+ * COM_ARENA_CHUNKとなる。最初のチャンクは本I/Fで捕捉する。
+ * iChunkSizeより大きな領域の切り出し要求があった場合は、その領域だけのために
+ * 別途チャンクを捕捉する。
+ */
+
+/*
+ * プロトタイプ形式 (この形で使用すること)
+ *   com_arena_t *com_createArena( size_t iChunkSize );
+ */
+#define com_createArena( CHUNKSIZE ) \
+    com_createArenaFunc( (CHUNKSIZE), COM_FILELOC )
+
+com_arena_t *com_createArenaFunc( size_t iChunkSize, COM_FILEPRM );
+
+/*
+ * アリーナ領域切り出し  com_allocArena()
+ *   切り出した領域のアドレスを返す。
+ *   切り出しに失敗した場合は NULLを返す。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG [com_prmNG] !ioArena || !iSize
+ *   COM_ERR_NOMEMORY: チャンクのメモリ捕捉NG
+ * ===========================================================================
+ *   同じアリーナを複数スレッドで使用することは想定しない。
+ * ===========================================================================
+ * ioArenaから iSizeバイトの領域を切り出し、0クリアして返す。
+ * 返すアドレスは COM_ARENA_ALIGNの倍数に揃える。
+ * 切り出した領域を個別に解放することはできない(com_free()してはいけない)。
+ * com_rewindArena()・com_resetArena()・com_freeArena()でまとめて破棄する。
+ */
+void *com_allocArena( com_arena_t *ioArena, size_t iSize );
+
+/*
+ * アリーナ使用位置記録  com_markArena()
+ * アリーナ使用位置復帰  com_rewindArena()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG [com_prmNG] !iArena || !oMark  (com_markArena)
+ *                               !ioArena || !iMark (com_rewindArena)
+ * ===========================================================================
+ *   同じアリーナを複数スレッドで使用することは想定しない。
+ * ===========================================================================
+ * com_markArena()は iArenaの現在の使用位置を oMarkに記録する。
+ * com_rewindArena()は ioArenaの使用位置を iMarkの位置まで戻し、記録後に
+ * 切り出した領域を全て破棄する。破棄した領域を使い続けてはいけない。
+ * 記録後に com_resetArena()や、それより前の位置への com_rewindArena()を
+ * 行った場合、その記録は使えなくなる。
+ */
+void com_markArena( com_arena_t *iArena, com_arenaMark_t *oMark );
+void com_rewindArena( com_arena_t *ioArena, const com_arenaMark_t *iMark );
+
+/*
+ * アリーナリセット  com_resetArena()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG [com_prmNG] !ioArena
+ * ===========================================================================
+ *   同じアリーナを複数スレッドで使用することは想定しない。
+ * ===========================================================================
+ * ioArenaで切り出した領域を全て破棄する。
+ * 標準サイズのチャンクは再利用のために保持し、大きな領域のために別途捕捉した
+ * チャンクは解放する。
+ */
+void com_resetArena( com_arena_t *ioArena );
+
+/*
+ * アリーナ解放  com_freeArena()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG [com_prmNG] !oArena
+ * ===========================================================================
+ *   同じアリーナを複数スレッドで使用することは想定しない。
+ * ===========================================================================
+ * oArenaで指定したアリーナを全チャンクとともに解放し、NULLを格納する。
+ * 引数がダブルポインタになっていることに注意。
+ */
+
+/*
+ * プロトタイプ形式 (この形で使用すること)
+ *   void com_freeArena( com_arena_t **oArena );
+ */
+#define com_freeArena( ARENA ) \
+    com_freeArenaFunc( (ARENA), COM_FILELOC )
+
+void com_freeArenaFunc( com_arena_t **oArena, COM_FILEPRM );
+
+
+
+/*
+ *****************************************************************************
+ * COMPOOL:オブジェクトプール関連I/F (com_proc.c)
+ *****************************************************************************
+ */
+
+/*
+ * オブジェクトプールは同じサイズのオブジェクトを繰り返し捕捉/解放する処理で
+ * 解放したオブジェクトを捨てずに保持し、次の捕捉で再利用する仕組みとなる。
+ * 構造体を1つずつ com_malloc()/com_free()する処理を置き換えることで、
+ * 捕捉/解放の度に標準関数やメモリ監視を通る負荷を避けられる。
+ *
+ * プールは com_createPool()で生成する。
+ * オブジェクトの捕捉は com_allocPool()、返却は com_freePoolObj()で行う。
+ * 使い終わったプールは com_freePool()で解放する。
+ *
+ * 各スレッドはプールごとに空きオブジェクトのキャッシュを持ち、捕捉/返却は
+ * 通常そのキャッシュだけで完結するため排他処理をしない。キャッシュが空に
+ * なったらプール共有の保管場所(デポ)から一括で補充し、キャッシュに溜まり
+ * 過ぎたら一括でデポに戻す。この時だけ排他処理を行う。デポも空ならば
+ * オブジェクトをまとめた領域(スラブ)を新たに捕捉して切り出す。
+ * スラブは com_malloc()で捕捉するため、メモリ監視ではスラブ単位の監視情報と
+ * なり、com_createPool()を呼んだ位置が捕捉位置になる。
+ *
+ * 生成時にデバッグ指定をすると、以下も行う。
+ * ・返却されたオブジェクトを COM_POOL_POISONで埋め、次の捕捉時にその内容が
+ *   変わっていないかチェックする(返却後の書き込みを検出する)。
+ * ・オブジェクトの末尾に状態を示す1語を付け、捕捉中でないオブジェクトの
+ *   返却(二重返却)を COM_ERR_DOUBLEFREEのエラーにする。返却は行わない。
+ *   メモリ監視の設定に関係なく検出する。
+ * ・メモリ監視が ONであれば、オブジェクトごとに com_allocPool()を呼んだ
+ *   位置で監視情報を作る。返却漏れは解放漏れとしてプログラム終了時に出力する。
+ * デバッグ指定をしない場合、これらのチェックは一切行わない。
+ *
+ * 使用例：
+ *     com_pool_t*  pool = com_createPool( sizeof(item_t), 0, false );
+ *     item_t*  item = com_allocPool( pool );
+ *     (item を使った処理)
+ *     com_freePoolObj( pool, &item );
+ *     com_freePool( &pool );
+ */
+
+// オブジェクトプール構造
+typedef struct com_pool {
+    struct com_pool*  next;          // 生成済みプールのリスト
+    ulong    id;                     // プール識別番号(再利用しない)
+    size_t   size;                   // オブジェクトのサイズ
+    size_t   unit;                   // アラインメント後のサイズ
+    long     batch;                  // デポとの一括補充/返却数
+    BOOL     debug;                  // デバッグ指定
+    pthread_mutex_t  mutex;          // デポ・スラブ用
+    void*    depot;                  // デポの空きオブジェクトのリスト
+    long     depotCount;             // デポの空きオブジェクト数
+    void*    slab;                   // 捕捉したスラブのリスト
+    size_t   objCount;               // スラブから切り出したオブジェクト総数
+    const char*  file;               // 生成したファイル名
+    long     line;                   // 生成したライン数
+    const char*  func;               // 生成した関数名
+} com_pool_t;
+
+// デバッグ指定時に返却したオブジェクトを埋める値と、標準の一括補充数
+enum {
+    COM_POOL_POISON = 0xdd,
+    COM_POOL_BATCH = 32
+};
+
+/*
+ * オブジェクトプール生成  com_createPool()
+ *   生成したプールのアドレスを返す。
+ *   生成に失敗した場合は NULLを返す。
+ *   このプールは使用後に、com_freePool()で解放が必要。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG [com_prmNG] !iSize || iBatch < 0
+ *   COM_ERR_NOMEMORY: プールのメモリ捕捉NG
+ * ===========================================================================
+ *   マルチスレッドで影響を受ける処理は無い。
+ * ===========================================================================
+ * iSizeバイトのオブジェクトのプールを生成する。
+ * iBatchはデポとの間で一括補充/返却するオブジェクト数で、0を指定すると
+ * COM_POOL_BATCHとなる。1回に捕捉するスラブはその 4倍の数のオブジェクトを
+ * 持つ。iDebugは前述のデバッグ指定。
+ */
+
+/*
+ * プロトタイプ形式 (この形で使用すること)
+ *   com_pool_t *com_createPool( size_t iSize, long iBatch, BOOL iDebug );
+ */
+#define com_createPool( SIZE, BATCH, DEBUG ) \
+    com_createPoolFunc( (SIZE), (BATCH), (DEBUG), COM_FILELOC )
+
+com_pool_t *com_createPoolFunc(
+        size_t iSize, long iBatch, BOOL iDebug, COM_FILEPRM );
+
+/*
+ * オブジェクト捕捉  com_allocPool()
+ *   捕捉したオブジェクトのアドレスを返す。
+ *   捕捉に失敗した場合は NULLを返す。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG [com_prmNG] !ioPool
+ *                   返却後のオブジェクトへの書き込みを検出(デバッグ指定時)
+ *   COM_ERR_NOMEMORY: スラブ/キャッシュのメモリ捕捉NG
+ * ===========================================================================
+ *   マルチスレッドについては考慮済み。
+ * ===========================================================================
+ * ioPoolからオブジェクトを1つ取り出し、0クリアして返す。
+ * 返すアドレスは 16の倍数に揃える。
+ */
+
+/*
+ * プロトタイプ形式 (この形で使用すること)
+ *   void *com_allocPool( com_pool_t *ioPool );
+ */
+#define com_allocPool( POOL ) \
+    com_allocPoolFunc( (POOL), COM_FILELOC )
+
+void *com_allocPoolFunc( com_pool_t *ioPool, COM_FILEPRM );
+
+/*
+ * オブジェクト返却  com_freePoolObj()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG [com_prmNG] !ioPool || !ioAddr
+ *   COM_ERR_DOUBLEFREE: 捕捉中でないオブジェクトの返却(デバッグ指定時)
+ * ===========================================================================
+ *   マルチスレッドについては考慮済み。
+ * ===========================================================================
+ * ioAddrのオブジェクトを ioPoolに返却し、NULLを格納する。
+ * ioAddrはオブジェクトのポインタ変数のアドレスを指定する(com_free()と同じ)。
+ * 捕捉したスレッドと別のスレッドで返却しても良い。
+ * ioPoolから捕捉したのではないオブジェクトを指定してはいけない。
+ */
+
+/*
+ * プロトタイプ形式 (この形で使用すること)
+ *   void com_freePoolObj( com_pool_t *ioPool, void *ioAddr );
+ */
+#define com_freePoolObj( POOL, ADDR ) \
+    com_freePoolObjFunc( (POOL), (ADDR), COM_FILELOC )
+
+void com_freePoolObjFunc( com_pool_t *ioPool, void *ioAddr, COM_FILEPRM );
+
+/*
+ * オブジェクトプール解放  com_freePool()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG [com_prmNG] !oPool
+ * ===========================================================================
+ *   マルチスレッドについては考慮済み。
+ *   ただし他のスレッドが使用中のプールを解放してはいけない。
+ * ===========================================================================
+ * oPoolで指定したプールを全スレッドのキャッシュ・スラブとともに解放し、
+ * NULLを格納する。返却されていないオブジェクトも使えなくなる。
+ * 引数がダブルポインタになっていることに注意。
+ */
+
+/*
+ * プロトタイプ形式 (この形で使用すること)
+ *   void com_freePool( com_pool_t **oPool );
+ */
+#define com_freePool( POOL ) \
+    com_freePoolFunc( (POOL), COM_FILELOC )
+
+void com_freePoolFunc( com_pool_t **oPool, COM_FILEPRM );
+
+
+
+/*
+ *****************************************************************************
+ * COMLARGE:大容量領域関連I/F (com_proc.c)
+ *****************************************************************************
+ */
+
+/*
+ * リングバッファやファイル読込用のバッファのように、サイズが大きく長時間
+ * 使い続ける領域を捕捉するための I/Fとなる。
+ * com_malloc()と違い mmap()で領域を捕捉し、以下の指定が出来る。
+ * ・ヒュージページの要求
+ *   大きな領域を通常の 4KBページで使うと、ランダムなアクセスでページ変換の
+ *   キャッシュ(TLB)のミスが多発する。ヒュージページを使うとページ数が減り、
+ *   このミスを抑えられる。まず MAP_HUGETLBで予約済みのヒュージページを
+ *   要求し、それが出来なければ madvise(MADV_HUGEPAGE)で透過的ヒュージページ
+ *   (THP)を要求する。それも出来なければ通常ページのまま使う。
+ * ・NUMAノードへの割り当て
+ *   指定したノード、または呼んだスレッドが動いているノードのメモリを優先して
+ *   使うよう mbind()で指定する。指定できない環境や存在しないノードの場合は
+ *   何もせず、通常通りの割り当てとなる。
+ * いずれも出来なかった場合でも領域の捕捉自体は成功し、そのまま使える。
+ * 実際にどの形で捕捉したかは com_getLargeType()で確認できる。
+ *
+ * 捕捉した領域はメモリ監視の対象となり、com_freeLarge()で解放する。
+ * com_free()で解放してはいけない。
+ * mmap()の単位で捕捉するため、小さな領域を捕捉するのには向かない。
+ * 目安として COM_LARGE_HUGESIZE以上の領域に使うことを想定している。
+ *
+ * 使用例：
+ *     char*  buf = com_allocLarge( size, true, COM_LARGE_LOCALNODE, "buf" );
+ *     (buf を使った処理)
+ *     com_freeLarge( buf );
+ */
+
+// ヒュージページのサイズ (x86_64の標準値)
+enum {
+    COM_LARGE_HUGESIZE = 2 * 1024 * 1024
+};
+
+// NUMAノードの指定 (0以上の場合はノード番号の指定となる)
+enum {
+    COM_LARGE_LOCALNODE = -2,    // 呼んだスレッドが動いているノード
+    COM_LARGE_ANYNODE   = -1,    // ノードを指定しない
+    COM_LARGE_NODEMAX   = 64     // 指定できるノード番号の上限(これ未満)
+};
+
+// 捕捉した領域のページ種別
+typedef enum {
+    COM_LARGE_NONE = 0,     // com_allocLarge()で捕捉した領域ではない
+    COM_LARGE_NORMAL,       // 通常ページ
+    COM_LARGE_THP,          // 透過的ヒュージページ(madvise()を受付)
+    COM_LARGE_HUGETLB       // 予約済みヒュージページ(MAP_HUGETLB)
+} COM_LARGE_t;
+
+/*
+ * 大容量領域捕捉  com_allocLarge()
+ *   捕捉したアドレスを返す。捕捉NGのときは NULLを返す。
+ *   捕捉したアドレスは、必ず com_freeLarge()で解放すること。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG:  [com_prmNG] !iSize || iNode < COM_LARGE_LOCALNODE ||
+ *                                 iNode >= COM_LARGE_NODEMAX
+ *   COM_ERR_NOMEMORY: メモリ捕捉NG
+ *   監視情報登録時の com_addMemInfo()によるエラー
+ * ===========================================================================
+ *   mutexによる排他処理が動作するためスレッドセーフとなる。
+ * ===========================================================================
+ * iSizeバイトの領域を捕捉し、0クリアした状態で返す。
+ * iHugeが trueならヒュージページを要求する。その場合は実際に捕捉する領域を
+ * COM_LARGE_HUGESIZEの倍数に切り上げ、アドレスもその境界に揃える。
+ * iNodeは割り当てる NUMAノードで、COM_LARGE_LOCALNODE・COM_LARGE_ANYNODE
+ * またはノード番号を指定する。
+ * iFormat以降は com_malloc()と同じく、デバッグ表示用の情報となる。
+ *
+ * ＊com_debugMemoryErrorOn()を使うことで、わざと結果をNGにすることが可能。
+ */
+
+/*
+ * プロトタイプ形式 (この形で使用すること)
+ *   void *com_allocLarge( size_t iSize, BOOL iHuge, long iNode,
+ *                         const char *iFormat, ... );
+ */
+#define com_allocLarge( SIZE, HUGEPAGE, NODE, ... ) \
+    com_allocLargeFunc( (SIZE), (HUGEPAGE), (NODE), COM_FILELOC, \
+                        __VA_ARGS__ )
+
+void *com_allocLargeFunc(
+        size_t iSize, BOOL iHuge, long iNode, COM_FILEPRM,
+        const char *iFormat, ... );
+
+/*
+ * 大容量領域解放  com_freeLarge()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG: [com_prmNG] !ioAddr
+ *   COM_ERR_DOUBLEFREE: com_allocLarge()で捕捉していない領域の指定
+ * ===========================================================================
+ *   mutexによる排他処理が動作するためスレッドセーフとなる。
+ * ===========================================================================
+ * ioAddrの領域を解放し、NULLを格納する。
+ * com_free()と同じく、ioAddrには領域のポインタ変数をそのまま指定する。
+ * その値が NULLの場合は何もしない。
+ */
+
+/*
+ * プロトタイプ形式 (この形で使用すること)
+ *   void com_freeLarge( void *ioAddr );
+ */
+#define com_freeLarge( ADDR ) \
+    com_freeLargeFunc( &(ADDR), COM_FILELOC )
+
+void com_freeLargeFunc( void *ioAddr, COM_FILEPRM );
+
+/*
+ * 大容量領域ページ種別取得  com_getLargeType()
+ *   iAddrの領域を捕捉したページ種別を返す。
+ *   com_allocLarge()で捕捉した領域でなければ COM_LARGE_NONEを返す。
+ * ---------------------------------------------------------------------------
+ *   エラーは発生しない。
+ * ===========================================================================
+ *   mutexによる排他処理が動作するためスレッドセーフとなる。
+ * ===========================================================================
+ * iAddrは com_allocLarge()が返したアドレスを指定する。
+ * oMapSizeが NULLでなければ、実際に捕捉したサイズを格納する。
+ * COM_LARGE_THPは要求を受け付けたことを示すもので、実際にヒュージページに
+ * なるかはカーネルの設定と空きメモリ次第となる。
+ */
+COM_LARGE_t com_getLargeType( const void *iAddr, size_t *oMapSize );
+
+
+
 /*
  *****************************************************************************
  * COMCFG:コンフィグ関連I/F (com_proc.c)
@@ -5168,6 +5721,94 @@ void com_printf( const char *iFormat, ... );
 #define com_printf  printf
 #endif
 
+/*
+ * 出力バッファリング設定  com_setBufferedOutput()・com_flushOutput()
+ * ---------------------------------------------------------------------------
+ *   エラーは発生しない。
+ * ===========================================================================
+ *   mutexによる排他処理が動作するためスレッドセーフとなる。
+ * ===========================================================================
+ * com_setBufferedOutput()で iModeを trueにすると、com_printf()など画面出力＆
+ * ロギングする全I/Fの出力を、スレッドごとのバッファに貯めてから書き込む。
+ * デフォルトは falseで、1行ごとに fprintf()と fflush()をする従来の動作になる。
+ * バッファの内容は以下のいずれかで書き出す。
+ *   ・そのスレッドで前回書き出してから iLines行出力した
+ *     (iLinesが 0以下なら 1024行)
+ *   ・前回書き出してから iMsecミリ秒以上経過した後に出力した
+ *     (iMsecが 0以下なら時間では書き出さない)
+ *   ・バッファ(出力先ごとに 64KB)に入りきらなくなった
+ *   ・com_flushOutput()を呼んだ (全スレッドのバッファを書き出す)
+ *   ・com_input()などのキー入力待ち、com_waitEvent()の待ち受けに入る
+ *   ・スレッドが終了した、またはプログラムが終了した
+ *   ・iModeを falseにして com_setBufferedOutput()を呼んだ
+ * 時間での書き出しは出力の契機に判定するもので、タイマーは使わない。
+ * 出力がしばらく途絶えそうな時は com_flushOutput()を呼ぶこと。
+ *
+ * バッファはスレッドごとなので、複数スレッドが出力する場合、画面やログ上の
+ * 行の順番はスレッド間では実際の出力順と異なることがある。
+ * com_printCr()・com_printBack()による表示位置の制御も書き出すまで
+ * 画面に反映されない。
+ *
+ * なお、デバッグログのタイムスタンプは秒単位なので、バッファリングに関わらず
+ * 秒が変わった時だけ作成するようにしている。
+ */
+void com_setBufferedOutput( BOOL iMode, long iLines, long iMsec );
+
+void com_flushOutput( void );
+
+/*
+ * 非同期出力設定  com_setAsyncOutput()・com_getAsyncOutputStat()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG: [com_prmNG] iPolicyが範囲外
+ *   com_setAsyncOutput()は 以下の場合も falseを返す(非同期出力にならない)。
+ *     ・リングの確保に失敗した  ・書き込みスレッドを生成できなかった
+ * ===========================================================================
+ *   mutexによる排他処理が動作するためスレッドセーフとなる。
+ * ===========================================================================
+ * com_setAsyncOutput()で iModeを trueにすると、com_printf()など画面出力＆
+ * ロギングする全I/Fの出力を、ロックフリーのリングに積むだけにして、
+ * 書き込みは専用スレッドが writev()でまとめて行う。
+ * ディスクが遅くても、出力した側(com_waitEvent()のイベント処理など)は
+ * 書き込みを待たされない。文字列の整形は従来通り出力した側で行う。
+ * com_setBufferedOutput()と同時に有効にした場合はこちらが優先される。
+ *
+ * iSlotsはリングのスロット数で、2のべき乗に切り上げる(0以下なら 4096)。
+ * 1スロットは最大 496バイトで、それを超える出力は複数スロットを使う。
+ * iPolicyはリングが満杯の時の動作を指定する。
+ *   COM_ASYNCOUT_BLOCK:        空きが出来るまで待つ (出力は失われない)
+ *   COM_ASYNCOUT_DROP_OLDEST:  古い出力から順に捨てて積む
+ *   COM_ASYNCOUT_DROP_NEW:     積もうとした出力を捨てる
+ * 複数スロットを使う出力も、捨てる時は出力1件を丸ごと捨てる。
+ * スロット数を超える長さの出力は積めないので、iPolicyに関わらず捨てる。
+ *
+ * iModeを falseにすると、積まれた出力を全て書き込んでからスレッドを止める。
+ * com_flushOutput()も 積まれた出力が全て書き込まれるまで待つ。
+ * プログラム終了時も全て書き込んでから終了する。
+ * 書き込みは出力先の FILE*のバッファを介さず fileno()に対して行うため、
+ * 非同期出力中に fprintf()等で同じ出力先に直接書くと順番が前後しうる。
+ *
+ * com_getAsyncOutputStat()は 非同期出力の統計を *oStatに格納する。
+ * 件数はいずれも出力単位で、非同期出力を止めてもクリアしない。
+ * (com_setAsyncOutput()で iModeを trueにした時にクリアする)
+ */
+typedef enum {
+    COM_ASYNCOUT_BLOCK = 0,
+    COM_ASYNCOUT_DROP_OLDEST,
+    COM_ASYNCOUT_DROP_NEW
+} COM_ASYNCOUT_POLICY_t;
+
+BOOL com_setAsyncOutput(
+        BOOL iMode, long iSlots, COM_ASYNCOUT_POLICY_t iPolicy );
+
+typedef struct {
+    ulong   records;    // リングに積んだ数
+    ulong   written;    // 書き込んだ数
+    ulong   dropped;    // 満杯で捨てた数
+    ulong   blocked;    // 満杯で待たされた回数 (COM_ASYNCOUT_BLOCK)
+} com_asyncOutStat_t;
+
+void com_getAsyncOutputStat( com_asyncOutStat_t *oStat );
+
 /*
  * 文字列の複数連続出力  com_repeat()
  * ---------------------------------------------------------------------------
@@ -5529,6 +6170,176 @@ void com_dump( const void *iAddr, size_t iSize, const char *iFormat, ... );
  */
 void com_noComDebugLog( BOOL iMode );
 
+/*
+ * バイナリトレース  com_setBinaryTrace()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_FILEDIRNG: iPathのファイルが開けなかった。
+ * ===========================================================================
+ *   複数スレッドで呼ばれることは想定しない。
+ *   (記録自体は複数スレッドから行ってよい)
+ * ===========================================================================
+ * iPathにファイル名を指定すると、以後の com_debug()・com_dbgCom()の出力を
+ * 文字列に整形せず、書式文字列のアドレス・時刻・引数の値をそのまま
+ * スレッドごとのバッファに記録し、バッファが一杯になったらファイルに書き出す。
+ * 整形と出力排他が無くなるので、デバッグ出力が多い処理でも負荷が小さい。
+ * iPathに NULLを指定すると、全スレッドのバッファを書き出して終了する。
+ * 他にも com_flushOutput()の呼び出し、スレッド終了、プログラム終了時に
+ * バッファを書き出す。
+ *
+ * 記録中は com_debug()・com_dbgCom()の内容は画面にもデバッグログにも出ない。
+ * com_setDebugPrint()で COM_DEBUG_OFFにしていた場合は記録もしない。
+ * com_noComDebugLog()で抑制していれば com_dbgCom()は記録しない。
+ * com_debugFunc()・com_dump()などは、従来通り文字列で出力する。
+ *
+ * 記録したファイルは toscomと一緒にビルドされる btrcprint で
+ * デバッグログと同じ形式の文字列に変換して表示する ("btrcprint ファイル名")。
+ * 書式文字列はアドレスで記録し、その文字列自体は最初に使われた時に
+ * 1回だけ記録する。%sの文字列は記録時点の内容をコピーする。
+ * 位置指定(%1$d等)・%n・%ls・%lc を含む書式は解析できないので、
+ * その場合だけ記録時に文字列に整形して記録する。
+ *
+ * 以下はファイル形式の定義で、値はすべて記録したマシンのバイト順になる。
+ * ファイルは com_btrcHead_t で始まり、その後はレコードが並ぶ。
+ * 各レコードは com_btrcRec_t で始まり、sizeは 8の倍数になる。
+ *   COM_BTRC_FORMAT: com_btrcRec_t + uint64 書式アドレス + 書式文字列('\0'付)
+ *   COM_BTRC_LOG:    com_btrcLog_t + 引数(com_btrcArg_t + 値)×argCnt
+ *   COM_BTRC_TEXT:   com_btrcLog_t + 整形済み文字列('\0'付)
+ * 引数の値は 数値なら 8バイト(long doubleは 16バイト)、文字列なら
+ * lenバイトの文字列を 8の倍数に切り上げたサイズで格納する。
+ */
+BOOL com_setBinaryTrace( const char *iPath );
+
+#define COM_BTRC_MAGIC    "COMBTRC"
+#define COM_BTRC_VERSION  1
+#define COM_BTRC_ORDER    0x01020304
+
+typedef struct {
+    char       magic[8];      // COM_BTRC_MAGIC
+    uint32_t   version;       // COM_BTRC_VERSION
+    uint32_t   order;         // COM_BTRC_ORDER (バイト順の確認用)
+} com_btrcHead_t;
+
+typedef enum {
+    COM_BTRC_FORMAT = 1,      // 書式文字列の登録
+    COM_BTRC_LOG,             // 書式と引数による記録
+    COM_BTRC_TEXT             // 整形済み文字列による記録
+} COM_BTRC_REC_t;
+
+typedef struct {
+    uint32_t   type;          // COM_BTRC_REC_t
+    uint32_t   size;          // レコード全体のサイズ
+} com_btrcRec_t;
+
+typedef struct {
+    com_btrcRec_t  rec;
+    uint64_t   format;        // 書式文字列のアドレス (COM_BTRC_TEXTは 0)
+    int64_t    sec;           // 記録時刻
+    int64_t    usec;
+    uint32_t   argCnt;        // 引数の数 (COM_BTRC_TEXTは 0)
+    uint32_t   isCom;         // com_dbgCom()なら 1
+} com_btrcLog_t;
+
+typedef enum {
+    COM_BTRC_INT = 1,  COM_BTRC_LONG,  COM_BTRC_LLONG,  COM_BTRC_INTMAX,
+    COM_BTRC_SIZE,     COM_BTRC_PTRDIFF,  COM_BTRC_DOUBLE,  COM_BTRC_LDOUBLE,
+    COM_BTRC_PTR,      COM_BTRC_STR
+} COM_BTRC_ARG_t;
+
+typedef struct {
+    uint32_t   type;          // COM_BTRC_ARG_t
+    uint32_t   len;           // 値のサイズ (文字列は '\0'を含まない長さ)
+} com_btrcArg_t;
+
+/*
+ * フライトレコーダー  com_setFlightRecorder()・com_sealFlightRecorder()・
+ *                     com_dumpFlightRecorder()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_FILEDIRNG: ファイルの作成/読み込みに失敗した。
+ *   COM_ERR_DEBUGNG:   ファイルの内容が正しくない。
+ * ===========================================================================
+ *   com_setFlightRecorder()・com_dumpFlightRecorder()は
+ *   複数スレッドで呼ばれることは想定しない。(記録は複数スレッドから行える)
+ *   com_sealFlightRecorder()はシグナルハンドラー内で使用できる。
+ * ===========================================================================
+ * com_setFlightRecorder()は iPathのファイルを固定サイズのリングとして mmap()し
+ * 以後の com_debug()・com_dbgCom()・com_error()の内容を記録する。
+ * 記録はメモリへのコピーだけでシステムコールを伴わないため、ディスクへの
+ * 書き込みより軽い。プロセスが異常終了しても、書き込んだ内容はファイルに残る。
+ * リングが一杯になったら古いレコードから上書きする。
+ * iSizeはリングのサイズで、ページサイズの倍数に切り上げる(0なら 1MB)。
+ * iPathに NULLを指定すると、記録を正常終了としてファイルを閉じる。
+ * プログラム終了時も同様に閉じる。
+ *
+ * 記録中は com_debug()・com_dbgCom()の内容はリングにのみ記録し、
+ * 画面にもデバッグログにも出さない (バイナリトレースより優先する)。
+ * com_setDebugPrint()で COM_DEBUG_OFFにしていた場合は記録もしない。
+ * com_error()は従来通りの出力に加えて、発生箇所付きでリングにも記録する。
+ *
+ * com_sealFlightRecorder()はリングに終了理由として iSignalを記録する。
+ * シグナルハンドラーとして com_setSignalAction()でそのまま登録でき、
+ * その場合は記録後にシグナルのデフォルト動作に戻して再送出する。
+ *   static com_sigact_t gSigHandler[] = {
+ *       { SIGSEGV, { .sa_handler = com_sealFlightRecorder } },
+ *       { SIGABRT, { .sa_handler = com_sealFlightRecorder } },
+ *       { COM_SIGACT_END, { .sa_handler = NULL } }
+ *   };
+ * シグナル以外で使う場合は iSignalに 0を指定する(再送出はしない)。
+ * com_exit()で終了した場合は、その終了コードを記録する。
+ *
+ * com_dumpFlightRecorder()は iPathのリングから 最新 iCount件のレコードを
+ * デバッグログに近い形式(時刻はマイクロ秒まで)で com_printf()により出力する
+ * (0以下なら全件)。
+ * 異常終了後に再起動した時、前回の記録を確認するといった使い方を想定する。
+ * 記録中のファイルを指定した場合も、その時点の内容を出力する。
+ */
+BOOL com_setFlightRecorder( const char *iPath, size_t iSize );
+
+void com_sealFlightRecorder( int iSignal );
+
+BOOL com_dumpFlightRecorder( const char *iPath, long iCount );
+
+#define COM_FLTREC_MAGIC     "COMFLTR"
+#define COM_FLTREC_VERSION   1
+#define COM_FLTREC_HEADSIZE  4096       // ヘッダ部のサイズ (この後がリング)
+
+typedef enum {
+    COM_FLTREC_RUNNING = 0,   // 記録中 (または記録中にプロセスが消えた)
+    COM_FLTREC_CLOSED,        // 正常終了
+    COM_FLTREC_SIGNAL,        // com_sealFlightRecorder()で終了
+    COM_FLTREC_EXIT           // com_exit()で終了
+} COM_FLTREC_STATE_t;
+
+typedef struct {
+    char       magic[8];      // COM_FLTREC_MAGIC
+    uint32_t   version;       // COM_FLTREC_VERSION
+    uint32_t   order;         // COM_BTRC_ORDER (バイト順の確認用)
+    uint64_t   size;          // リングのサイズ
+    uint64_t   head;          // 次に書く位置 (リング先頭からの通算)
+    uint64_t   tail;          // 最古のレコードの位置 (リング先頭からの通算)
+    uint64_t   seq;           // 記録したレコード数
+    int64_t    pid;           // 記録したプロセスID
+    uint32_t   state;         // COM_FLTREC_STATE_t
+    int32_t    code;          // シグナル番号 または 終了コード
+    uint32_t   writing;       // レコード書き込み中なら 1
+    uint32_t   reserved;
+} com_fltrecHead_t;
+
+typedef enum {
+    COM_FLTREC_PAD = 0,       // リング終端の詰め物
+    COM_FLTREC_DBG,           // com_debug()
+    COM_FLTREC_COM,           // com_dbgCom()
+    COM_FLTREC_ERR            // com_error()
+} COM_FLTREC_KIND_t;
+
+// レコードは 8の倍数のサイズで、リング終端をまたがない
+typedef struct {
+    uint32_t   size;          // レコード全体のサイズ
+    uint32_t   kind;          // COM_FLTREC_KIND_t
+    int64_t    sec;           // 記録時刻
+    int64_t    usec;
+    uint64_t   seq;           // 通し番号
+} com_fltrecRec_t;            // この後に '\0'終端の文字列が続く
+
 /*
  * デバッグ監視情報 シーケンス番号最大値
  * -------------------------------------
@@ -5613,6 +6424,7 @@ void com_noComDebugLog( BOOL iMode );
  * プログラム開始当初から設定を反映させたいなら、com_initializeSpec()で
  * 本I/Fを呼ぶ必要がある。本I/F設定が makefileの設定より優先される。
  * (ビルド時に makefileの -DWATCHMEM で指定できる)
+ * -DUSE_RELEASE_ABI でビルドした場合は、常に COM_DEBUG_OFFとなる。
  */
 void com_setWatchMemInfo( COM_DEBUG_MODE_t iMode );
 
@@ -5627,6 +6439,48 @@ void com_setWatchMemInfo( COM_DEBUG_MODE_t iMode );
  */
 COM_DEBUG_MODE_t com_getWatchMemInfo( void );
 
+/*
+ * メモリ監視サンプリング設定  com_setWatchMemSampling()
+ * メモリ監視サンプリング設定取得  com_getWatchMemSampling()
+ * ---------------------------------------------------------------------------
+ *   エラーは発生しない。
+ * ===========================================================================
+ *   複数スレッドで呼ばれることは想定しない。
+ * ===========================================================================
+ * メモリ監視を全数ではなく抽出で行うように設定する。iRateには抽出の平均間隔を
+ * バイト数で指定し、0を指定すると全数監視に戻る。最初は 0 (全数監視)。
+ * 監視自体は com_setWatchMemInfo()で ONにしておく必要がある。
+ * com_getWatchMemSampling()は現在の設定値を返す。
+ *
+ * 捕捉サイズの累計が、平均 iRateバイトの指数分布でランダムに決めた間隔を
+ * 超えるたびに、その捕捉を1つ監視対象にする。大きな捕捉ほど抽出されやすく、
+ * サイズ sの捕捉が抽出される確率は 1-exp(-s/iRate) となる。
+ * 抽出しなかった捕捉は監視情報を作らず、デバッグ出力もしないので、
+ * 全数監視よりはるかに負荷が小さく、製品ビルドでも常用しやすい。
+ * 例えば iRateに 524288 (512KB)を指定すると、大まかに 512KB捕捉するごとに
+ * 1つの監視情報ができる。
+ *
+ * 抽出中と、抽出中に作られた監視情報が残っている間は、com_listMemInfo()の
+ * 出力(プログラム終了時の解放漏れ一覧を含む)は個別の監視情報ではなく、
+ * 呼び元(ファイル位置)ごとの推定値になる。抽出された監視情報それぞれを
+ * 抽出確率の逆数で重み付けし、解放漏れの推定サイズ・推定数を推定サイズが
+ * 大きい順に出力する。
+ *     ? M (推定サイズ) bytes (推定数) blocks (抽出数 samples)
+ *         関数名() in ソースファイル line ライン数
+ * 抽出数が少ない呼び元ほど推定値の誤差は大きい。個別の監視情報を見たい時は
+ * com_listMemInfoByAddr()を使う。
+ *
+ * 抽出しなかったメモリは解放時に監視情報が見つからないのが正常なため、
+ * 同じ間は COM_ERR_DOUBLEFREEによる二重解放の検出はしない。
+ * 0を指定し、抽出された監視情報が全て解放されると、個別の一覧出力と
+ * 二重解放の検出に戻る。ただしその後に、抽出中に捕捉して抽出されなかった
+ * メモリを解放すると二重解放と判定されるので、抽出を止める前に解放すること。
+ * また com_debugMemoryErrorOn()で指定するシーケンス番号は抽出した捕捉にしか
+ * 振られない点にも注意すること。
+ */
+void com_setWatchMemSampling( size_t iRate );
+size_t com_getWatchMemSampling( void );
+
 /*
  * メモリ捕捉NG発生ON  com_debugMemoryErrorOn()
  * ---------------------------------------------------------------------------
@@ -5651,6 +6505,140 @@ void com_debugMemoryErrorOn( long iSeqno );
  */
 void com_debugMemoryErrorOff( void );
 
+/*
+ * メモリ捕捉プロファイル設定  com_setAllocProfile()
+ *   処理結果を true/false で返す。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG: 集計用のメモリ捕捉失敗
+ * ===========================================================================
+ *   マルチスレッドについては考慮済み。
+ * ===========================================================================
+ * iModeに trueを指定すると、com_malloc()/com_realloc()/com_strdup()等の
+ * メモリ捕捉を、呼び元(ソースファイルとライン数)ごとに集計し始める。
+ * falseを指定すると集計を止め、集計結果を破棄する。最初は false。
+ * メモリ監視(com_setWatchMemInfo())の設定とは関係なく動作する。
+ *
+ * 呼び元ごとに以下を集計する。
+ *   count       捕捉回数 (realloc()による再捕捉も 1回と数える)
+ *   bytes       捕捉サイズの累計
+ *   live bytes  その呼び元で捕捉し、まだ解放していないサイズ
+ *   peak live   live bytesの最大値
+ * 集計開始前に捕捉したメモリの解放は集計に影響しない。
+ * 呼び元とメモリアドレスはどちらもハッシュ表で管理しているため、
+ * 集計中のメモリ捕捉/解放の負荷はほぼ一定となる。
+ *
+ * 集計結果は com_dumpAllocProfile()で出力する。
+ * プログラム終了時に集計は自動で停止し、集計結果も破棄する。
+ */
+BOOL com_setAllocProfile( BOOL iMode );
+
+/*
+ * メモリ捕捉プロファイル出力  com_dumpAllocProfile()
+ * ---------------------------------------------------------------------------
+ *   エラーは発生しない。
+ * ===========================================================================
+ *   マルチスレッドについては考慮済み。
+ * ===========================================================================
+ * com_setAllocProfile()で集計中の内容を、捕捉サイズの累計が大きい順に
+ * 以下の形式で出力する。集計していなければ何もしない。
+ *     count  bytes  live bytes  peak live  関数名() in ソースファイル line 行数
+ * iPathが NULLなら com_printf()で出力し、ファイル名を指定すると、その
+ * ファイルに追記する。出力しても集計内容はそのまま残る。
+ * 捕捉回数が極端に多い呼び元は、ループ内の細かい com_realloc()のように
+ * まとめて捕捉できる箇所である可能性が高い。
+ */
+void com_dumpAllocProfile( const char *iPath );
+
+/*
+ * メモリ捕捉プロファイル出力シグナル設定  com_setAllocProfileSignal()
+ *   処理結果を true/false で返す。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG: [com_prmNG] !iPath || iPathが長すぎる
+ *                    sigaction()の失敗
+ * ===========================================================================
+ *   複数スレッドで呼ばれることは想定しない。
+ * ===========================================================================
+ * iSignalのシグナルを受けたら com_dumpAllocProfile( iPath )の出力をするよう
+ * シグナルハンドラーを設定する。(例えば SIGUSR1を指定し kill -USR1 で出力)
+ * シグナルハンドラー内では出力要求を記録するだけで、実際の出力はその後
+ * 最初にメモリ捕捉/解放が行われた時になる。
+ * iSignalに既に設定されていたシグナルハンドラーは上書きされる。
+ */
+BOOL com_setAllocProfileSignal( int iSignal, const char *iPath );
+
+/*
+ * メモリ監視スナップショット取得  com_snapshotMemInfo()
+ *   処理結果を true/false で返す。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG: [com_prmNG] !oSnap
+ *                    集計用のメモリ捕捉失敗
+ * ===========================================================================
+ *   マルチスレッドについては考慮済み。
+ * ===========================================================================
+ * メモリ監視で保持している未解放メモリを、呼び元(ソースファイルとライン数)
+ * ごとに集計して oSnapに格納する。その時点のシーケンス番号も保持するので、
+ * 2つのスナップショットの間に何回メモリ捕捉があったかも分かる。
+ * 保持するのは呼び元ごとの数とサイズのみで、個々の監視情報は複製しないし、
+ * 書式展開や出力もしない。監視情報数に比例した時間で終わる。
+ * 取得中はメモリ監視の情報登録/削除を待たせる。
+ *
+ * メモリ監視が OFFの時は oSnapを空にして falseを返す。(エラーにはしない)
+ * com_setWatchMemSampling()で抽出監視をしている場合、集計値は
+ * com_listMemInfo()と同じ方法で求めた推定値になる。
+ *
+ * 取得したスナップショットは com_diffMemInfo()で比較し、不要になったら
+ * com_freeMemSnapshot()で解放すること。
+ */
+
+// メモリ監視スナップショット
+typedef struct {
+    long     seqno;      // 取得時点のシーケンス番号
+    long     siteCnt;    // 呼び元の数
+    void*    site;       // 呼び元ごとの集計 (内部形式なので直接参照しない)
+    size_t   count;      // 未解放メモリ数 (抽出監視時は推定値)
+    size_t   bytes;      // 未解放メモリサイズ (抽出監視時は推定値)
+} com_memSnapshot_t;
+
+BOOL com_snapshotMemInfo( com_memSnapshot_t *oSnap );
+
+/*
+ * メモリ監視スナップショット比較  com_diffMemInfo()
+ *   増加した呼び元の数を返す。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG: [com_prmNG] !iOld || !iNew
+ *                    比較用のメモリ捕捉失敗
+ * ===========================================================================
+ *   マルチスレッドで影響を受ける処理はない。
+ * ===========================================================================
+ * com_snapshotMemInfo()で取得した iOldから iNewまでの間に、未解放メモリが
+ * 増えた呼び元を、増加サイズが大きい順に com_printf()で以下の形式で出力する。
+ *     + M (増加サイズ) bytes (増加数) blocks (now (現在サイズ) bytes)
+ *         関数名() in ソースファイル line ライン数
+ * 先頭には間のメモリ捕捉回数(シーケンス番号の差)と全体の増減を出し、
+ * 最後に減った呼び元の数を出す。減った呼び元の個別の出力はしない。
+ *
+ * 長時間動作するプロセスで定期的にスナップショットを取って比較すると、
+ * 捕捉回数に対して増え続ける呼び元が、ゆっくり進む解放漏れの候補になる。
+ * 全監視情報を出力する com_listMemInfo()と違い、呼び元単位の出力なので
+ * 監視情報が大量にあっても出力は増えない。
+ * 抽出監視中のシーケンス番号は抽出した捕捉にしか振られないため、捕捉回数は
+ * 抽出した数になる。
+ */
+long com_diffMemInfo(
+        const com_memSnapshot_t *iOld, const com_memSnapshot_t *iNew );
+
+/*
+ * メモリ監視スナップショット解放  com_freeMemSnapshot()
+ * ---------------------------------------------------------------------------
+ *   エラーは発生しない。
+ * ===========================================================================
+ *   マルチスレッドで影響を受ける処理はない。
+ * ===========================================================================
+ * com_snapshotMemInfo()で取得した ioSnapの集計を解放し、内容を空にする。
+ * ioSnapが NULLや空の場合は何もしない。
+ */
+void com_freeMemSnapshot( com_memSnapshot_t *ioSnap );
+
 /*
  * ファイル監視設定  com_setWatchFileInfo()
  *   ＊COM_DEBUG_SILENTは、プログラム終了時の浮きのみ画面出力する。
@@ -5712,6 +6700,7 @@ void com_debugMemoryErrorOff( void );
  * プログラム開始当初から設定を反映させたいなら、com_initializeSpec()で
  * 本I/Fを呼ぶ必要がある。本I/F設定が makefileの設定より優先される。
  * (ビルド時に makefileの -DWATCHFILE で指定できる)
+ * -DUSE_RELEASE_ABI でビルドした場合は、常に COM_DEBUG_OFFとなる。
  */
 void com_setWatchFileInfo( COM_DEBUG_MODE_t iMode );
 
@@ -6091,6 +7080,8 @@ void com_outputErrorCount( void );
  * ただし「アドレス タイプ トークン名 ファイル位置」という書式になっていない
  * アドレスがヒットした場合、ファイル位置が正しく取得できない。基本的に
  * 本I/Fで対象となるのは、関数とグローバル変数である。
+ * ネームリストは最初に使用した時に一度だけ全て読み込んでアドレス順の表にし、
+ * 以後は表を二分探索する。読み込み後にネームリストを作り直しても反映しない。
  *
  * なお本I/Fは関数呼出トレース機能で使用されるが、関数呼出トレース機能の
  * コンパイルオプションを指定していなくても使用可能。NAMELISTで宣言された
@@ -6141,7 +7132,13 @@ const char *com_seekNameList( void *iAddr );
  * com_setFuncTrace()の詳細は、後述のI/F説明を確認すること。
  *
  * 関数呼出トレース使用時は、プログラム終了時にトレース情報を出力する。
- * トレース情報が保持するのは、呼び出した関数のアドレスとネストになる。
+ * トレース情報はスレッドごとの固定長リングバッファに排他なしで記録し、
+ * 保持するのは関数のアドレス・タイムスタンプ・ネスト・呼出/復帰の別になる。
+ * タイムスタンプは x86では TSC(rdtsc)、それ以外では CLOCK_MONOTONICの
+ * ナノ秒で、出力では直前の情報との差分を "+差分" として表示する。
+ * 関数呼出は "->"、復帰は "<-" で示す。関数名の解決は出力時にのみ行うため、
+ * 記録時の負荷は小さい。出力するのは本I/Fを呼んだスレッドの情報のみで、
+ * 出力した情報は破棄される。
  * 添付の makefileでは、関数呼出トレースに必要なオプションを設定した場合、
  * ビルド時に .namelist.toscom というファイルを作る。これは
  *     nm -nl (実行用ファイル) > .namelist.toscom
@@ -6425,6 +7422,166 @@ void com_assertNotEqualsPFunc(
         char *iLabel, void* iExpected, void* iResult, COM_FILEPRM );
 
 
+
+/*
+ *****************************************************************************
+ * COMRELABI:リリースABI (コンパイルオプション USE_RELEASE_ABI 指定時のみ)
+ *****************************************************************************
+ */
+
+/*
+ * リリースABI
+ *   makefileで -DUSE_RELEASE_ABI を指定すると、以下のI/Fを標準関数を直接呼ぶ
+ *   インライン関数に置き換える。
+ *     com_malloc()・com_realloc()・com_strdup()・com_strndup()・com_free()・
+ *     com_fopen()・com_fclose()
+ * ===========================================================================
+ *   標準関数のスレッドセーフ性に準じる。(mutexによる排他は行わない)
+ * ===========================================================================
+ * 通常これらのI/Fは呼び元のファイル名・行番号・関数名を引数として渡し、
+ * mutexによる排他の中でメモリ監視/ファイル監視の処理を呼ぶ。
+ * 監視が COM_DEBUG_OFFでもこの処理は毎回通るため、捕捉/解放を頻繁に繰り返す
+ * 処理では標準関数に比べて無視できない負荷になる。
+ * 本オプションを指定すると、呼び元情報の受け渡し・排他・監視処理を一切せず、
+ * 呼出負荷は calloc()/realloc()/strdup()/strndup()/free()/fopen()/fclose()を
+ * 直接使うのとほぼ同等になる。(com_testtos.cの test_allocBench()で計測可能)
+ * 以下は通常の I/Fと変わらない。
+ * ・com_malloc()は calloc()を使用して 0クリアする。
+ * ・com_free()と com_fclose()は、解放/クローズ後に変数へ NULLを格納する。
+ * ・サイズ 0 や NULLを指定した場合の動作と COM_ERR_DEBUGNGのエラー。
+ * ・捕捉/オープン失敗時の COM_ERR_NOMEMORY/COM_ERR_FILEDIRNGのエラー。
+ *   (ただしエラー発生位置は com_if.hのインライン関数となる)
+ *
+ * 一方で以下の制約があるため、デバッグを済ませたリリースビルドで使うこと。
+ * ・メモリ監視とファイル監視は常に COM_DEBUG_OFFとなり、
+ *   com_setWatchMemInfo()・com_setWatchFileInfo()の指定は無視される。
+ *   toscom内部の com_realloct()等による捕捉も含めて監視しないことで、
+ *   捕捉と解放で監視情報の不整合が起きないようにしている。
+ * ・iFormat以降の引数は sizeof内に置くだけで評価しない(未使用警告の抑止のみ)。
+ *   副作用のある式は書かないこと。
+ * ・com_debugMemoryErrorOn()等による故意の NGは効かない。
+ * ・toscomと、それを使うプログラムの両方を同じオプションでビルドすること。
+ *   添付の makefileでは RELOPTに指定すれば両方に反映される。
+ *
+ * 処理実体関数 com_mallocFunc()等はオプション指定の有無に関わらず存在する。
+ * com_reallocf()は置き換えず com_reallocfFunc()を使い続けるが、監視がOFFなので
+ * 排他以外の負荷は小さい。
+ * com_addHash()等のように、もともと呼び元情報を持たないI/Fは対象外となる。
+ * デバッグ出力やエラー出力(com_error()等)は、本オプション指定時も呼び元情報を
+ * そのまま出力する。
+ */
+#ifdef USE_RELEASE_ABI
+
+#undef com_malloc
+#undef com_realloc
+#undef com_strdup
+#undef com_strndup
+#undef com_free
+#undef com_fopen
+#undef com_fclose
+
+// 宣言のみで実体はない (sizeof内で iFormat以降の引数を参照するためのもの)
+int com_ignoreFormat( const char *iFormat, ... );
+
+#define COM_IGNORE_FORMAT( ... ) \
+    (void)sizeof( com_ignoreFormat( __VA_ARGS__ ) )
+
+#define com_malloc( SIZE, ... ) \
+    ( COM_IGNORE_FORMAT( __VA_ARGS__ ), com_mallocFast( (SIZE) ) )
+
+#define com_realloc( ADDR, SIZE, ... ) \
+    ( COM_IGNORE_FORMAT( __VA_ARGS__ ), com_reallocFast( (ADDR), (SIZE) ) )
+
+#define com_strdup( STRING, ... ) \
+    ( COM_IGNORE_FORMAT( __VA_ARGS__ ), \
+      com_strndupFast( (STRING), SIZE_MAX, "com_strdup" ) )
+
+#define com_strndup( STRING, SIZE, ... ) \
+    ( COM_IGNORE_FORMAT( __VA_ARGS__ ), \
+      com_strndupFast( (STRING), (SIZE), "com_strndup" ) )
+
+#define com_free( ADDR ) \
+    com_freeFast( &(ADDR) )
+
+#define com_fopen( PATH, MODE ) \
+    com_fopenFast( (PATH), (MODE) )
+
+#define com_fclose( FP ) \
+    com_fcloseFast( &(FP) )
+
+static inline void *com_mallocFast( size_t iSize )
+{
+    if( COM_UNLIKELY(!iSize) ) {
+        com_error( COM_ERR_DEBUGNG, "com_malloc() parameter NG" );
+        return NULL;
+    }
+    void*  ptr = calloc( iSize, 1 );
+    if( COM_UNLIKELY(!ptr) ) {
+        com_error( COM_ERR_NOMEMORY, "com_malloc NG (%zubyte)", iSize );
+    }
+    return ptr;
+}
+
+static inline void com_freeFast( void *ioAddr )
+{
+    void**  dmy = ioAddr;  // ioAddrはダブルポインタであることを想定
+    free( *dmy );
+    *dmy = NULL;
+}
+
+static inline void *com_reallocFast( void *iAddr, size_t iSize )
+{
+    if( !iSize ) {free( iAddr );  return NULL;}
+    void*  ptr = realloc( iAddr, iSize );
+    if( COM_UNLIKELY(!ptr) ) {
+        com_error( COM_ERR_NOMEMORY, "com_realloc NG (%zubyte)", iSize );
+    }
+    return ptr;
+}
+
+static inline char *com_strndupFast(
+        const char *iString, size_t iSize, const char *iName )
+{
+    if( COM_UNLIKELY(!iString || !iSize) ) {
+        com_error( COM_ERR_DEBUGNG, "%s() parameter NG", iName );
+        return NULL;
+    }
+    char*  ptr = strndup( iString, iSize );
+    if( COM_UNLIKELY(!ptr) ) {
+        com_error( COM_ERR_NOMEMORY, "%s NG (%s)", iName, iString );
+    }
+    return ptr;
+}
+
+static inline FILE *com_fopenFast( const char *iPath, const char *iMode )
+{
+    if( COM_UNLIKELY(!iPath || !iMode) ) {
+        com_error( COM_ERR_DEBUGNG, "com_fopen() parameter NG" );
+        return NULL;
+    }
+    FILE*  fp = fopen( iPath, iMode );
+    if( COM_UNLIKELY(!fp) ) {
+        com_error( COM_ERR_FILEDIRNG, "com_fopen NG (%s)", iPath );
+    }
+    return fp;
+}
+
+static inline int com_fcloseFast( FILE **ioFp )
+{
+    if( !(*ioFp) ) {return 0;}
+    int  fcloseErrno = 0;
+    if( fclose( *ioFp ) ) {
+        fcloseErrno = errno;
+        com_error( COM_ERR_FILEDIRNG, "com_fclose NG (%p:%s)",
+                   (void*)ioFp, com_strerror( fcloseErrno ) );
+    }
+    *ioFp = NULL;
+    return fcloseErrno;
+}
+
+#endif  // USE_RELEASE_ABI
+
+
 /*****************************************************************************/
 /* 共通で使用できる独自I/Fの宣言 */
 #include "com_spec.h"
@@ -14,6 +14,8 @@
 #include "com_if.h"
 #include "com_debug.h"
 #include <sys/sysmacros.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 
 /* 基本情報保持 *************************************************************/
@@ -86,6 +88,7 @@ static BOOL checkLongOpt( com_getOpt_t *iOpt )
 }
 
 static long    gOptRestCnt = 0;
+static long    gOptRestCapa = 0;
 static char**  gOptRestList = NULL;
 
 static com_strChain_t*  gOptMan = NULL;
@@ -94,7 +97,7 @@ enum {OPT_CHECK_ERROR = -1};
 
 static void freeOptSetting( void )
 {
-    gOptRestCnt = 0;
+    gOptRestCnt = gOptRestCapa = 0;
     com_free( gOptRestList );
 }
 
@@ -229,9 +232,10 @@ static BOOL checkOpt(
 static BOOL addRest( char *iPrm, COM_FILEPRM )
 {
     if( !iPrm ) {return true;}
-    char**  addArgv = com_reallocAddrFunc( &gOptRestList, sizeof(char*),
-                                           COM_TABLEEND, &gOptRestCnt, 1,
-                                           COM_FILEVAR, "rest opt(%s)", iPrm );
+    char**  addArgv = com_reallocAddrCapFunc( &gOptRestList, sizeof(char*),
+                                              COM_TABLEEND, &gOptRestCnt,
+                                              &gOptRestCapa, 1, COM_FILEVAR,
+                                              "rest opt(%s)", iPrm );
     if( COM_UNLIKELY(!addArgv) ) {return false;}
     *addArgv = iPrm;
     return true;
@@ -284,6 +288,7 @@ BOOL com_getOption(
 
 void com_exitFunc( long iType, COM_FILEPRM )
 {
+    com_markExitFlightRecorder( iType );
     if( iType != COM_NO_ERROR ) {
         // エラーコードが正常終了を示す場合、このメッセージは出力しない
         printf( "!!!!! \"%s\" forced to terminate\n", com_getAplName() );
@@ -398,39 +403,61 @@ static BOOL returnRealloct( void *iAddr, BOOL iResult )
     return iResult;
 }
 
+// 容量の拡張は倍々とし、最低でも COM_TABLE_CAPAMINとする
+static long growCapacity( long iCapa, long iNeed )
+{
+    long  capa = iCapa * 2;
+    if( capa < COM_TABLE_CAPAMIN ) {capa = COM_TABLE_CAPAMIN;}
+    return (capa < iNeed) ? iNeed : capa;
+}
+
+// ioCapaが NULLでなければ、容量内の拡縮は再捕捉しない
 static BOOL procRealloct(
-        void *ioAddr, size_t iUnit, long *ioCount, long iResize,
+        void *ioAddr, size_t iUnit, long *ioCount, long *ioCapa, long iResize,
         const char *iFormat, COM_FILEPRM, va_list iAp )
 {
     if( !iResize ) {return true;}
     if( iResize < 0 && -iResize >= *ioCount ) {iResize = -(*ioCount);}
+    char**  dmy = ioAddr;   // ioAddrはダブルポインタが渡されていることを想定
+    long  count = *ioCount + iResize;
+    if( ioCapa && count && count <= *ioCapa ) {
+        if( iResize > 0 ) {
+            memset( *dmy + (long)iUnit * (*ioCount), 0,
+                    iUnit * (size_t)iResize );
+        }
+        *ioCount = count;
+        return true;
+    }
     com_mutexLock( &gMutexMem, "realloct(%p)", ioAddr );
     COM_CLEAR_BUF( gMemLog );
     vsnprintf( gMemLog, sizeof(gMemLog), iFormat, iAp );
-    char**  dmy = ioAddr;   // ioAddrはダブルポインタが渡されていることを想定
-    if( (*ioCount + iResize) == 0 ) {
+    if( count == 0 ) {
         com_mutexUnlock( &gMutexMem, NULL );
         com_freeFunc( dmy, COM_FILEVAR );
         *ioCount = 0;
+        COM_SET_IF_EXIST( ioCapa, 0 );
         return true;
     }
-    char*  result = procRealloc( *dmy, iUnit * (size_t)(*ioCount + iResize),
+    long  capa = ioCapa ? growCapacity( *ioCapa, count ) : count;
+    char*  result = procRealloc( *dmy, iUnit * (size_t)capa,
                                  iFormat, COM_FILEVAR );
     if( !result ) {return returnRealloct( ioAddr, false );}
     if( iResize > 0 ) {
-        memset( result + (long)iUnit * (*ioCount), 0, iUnit * (size_t)iResize );
+        memset( result + (long)iUnit * (*ioCount), 0,
+                iUnit * (size_t)(capa - *ioCount) );
     }
     *dmy = result;
-    *ioCount += iResize;
+    *ioCount = count;
+    COM_SET_IF_EXIST( ioCapa, capa );
     return returnRealloct( ioAddr, true );
 }
 
-#define PROC_REALLOCT \
+#define PROC_REALLOCT( CAPA ) \
     BOOL  result = false; \
     do { \
         va_list  ap; \
         va_start( ap, iFormat ); \
-        result = procRealloct( ioAddr, iUnit, ioCount, iResize, \
+        result = procRealloct( ioAddr, iUnit, ioCount, (CAPA), iResize, \
                                iFormat, COM_FILEVAR, ap ); \
         va_end( ap ); \
     } while(0)
@@ -440,7 +467,32 @@ BOOL com_realloctFunc(
         COM_FILEPRM, const char *iFormat, ... )
 {
     if( !iResize ) {return true;}
-    PROC_REALLOCT;
+    PROC_REALLOCT( NULL );
+    return result;
+}
+
+BOOL com_realloctCapFunc(
+        void *ioAddr, size_t iUnit, long *ioCount, long *ioCapa, long iResize,
+        COM_FILEPRM, const char *iFormat, ... )
+{
+    if( COM_UNLIKELY(!ioCapa) ) {COM_PRMNG(false);}
+    if( !iResize ) {return true;}
+    PROC_REALLOCT( ioCapa );
+    return result;
+}
+
+BOOL com_shrinkTableFunc(
+        void *ioAddr, size_t iUnit, long iCount, long *ioCapa,
+        COM_FILEPRM, const char *iFormat, ... )
+{
+    if( COM_UNLIKELY(!ioCapa || iCount < 0 || iCount > *ioCapa) ) {
+        COM_PRMNG(false);
+    }
+    // 容量を要素数とみなして、実際の要素数まで縮小する
+    long*  ioCount = ioCapa;
+    long  iResize = iCount - *ioCapa;
+    if( !iResize ) {return true;}
+    PROC_REALLOCT( NULL );
     return result;
 }
 
@@ -495,9 +547,9 @@ static void moveTableData(
     else {memcpy( target, iStack, iMoveSize );}
 }
 
-void *com_reallocAddrFunc(
-        void *ioAddr, size_t iUnit, long iPos, long *ioCount, long iResize,
-        COM_FILEPRM, const char *iFormat, ... )
+static void *reallocAddr(
+        void *ioAddr, size_t iUnit, long iPos, long *ioCount, long *ioCapa,
+        long iResize, COM_FILEPRM, const char *iFormat, va_list iAp )
 {
     char**  dmy = ioAddr;
     if( !iPos && !(*ioCount) ) {iPos = COM_TABLEEND;}
@@ -510,7 +562,8 @@ void *com_reallocAddrFunc(
     if( !calcTmpSize( &tmp, &tmpSize, dmy, iUnit, iPos, *ioCount, &iResize ) ){
         return NULL;
     }
-    PROC_REALLOCT;
+    BOOL  result = procRealloct( ioAddr, iUnit, ioCount, ioCapa, iResize,
+                                 iFormat, COM_FILEVAR, iAp );
     if( COM_UNLIKELY(!result) ) {free( tmp );  return NULL;}
     dmy = ioAddr; // アドレス変化の可能性があるので再取得
     moveTableData( tmp, tmpSize, dmy, (long)iUnit, iPos, iResize );
@@ -518,6 +571,33 @@ void *com_reallocAddrFunc(
     return returnTablePos( dmy, iUnit, iPos, *ioCount, iResize );
 }
 
+#define REALLOC_ADDR( CAPA ) \
+    void*  result = NULL; \
+    do { \
+        va_list  ap; \
+        va_start( ap, iFormat ); \
+        result = reallocAddr( ioAddr, iUnit, iPos, ioCount, (CAPA), iResize, \
+                              COM_FILEVAR, iFormat, ap ); \
+        va_end( ap ); \
+    } while(0)
+
+void *com_reallocAddrFunc(
+        void *ioAddr, size_t iUnit, long iPos, long *ioCount, long iResize,
+        COM_FILEPRM, const char *iFormat, ... )
+{
+    REALLOC_ADDR( NULL );
+    return result;
+}
+
+void *com_reallocAddrCapFunc(
+        void *ioAddr, size_t iUnit, long iPos, long *ioCount, long *ioCapa,
+        long iResize, COM_FILEPRM, const char *iFormat, ... )
+{
+    if( COM_UNLIKELY(!ioCapa) ) {COM_PRMNG(NULL);}
+    REALLOC_ADDR( ioCapa );
+    return result;
+}
+
 static char *procStrdup(
         const char *iString, size_t iSize, const char *iFormat,
         COM_MEM_OPR_t iType, COM_FILEPRM )
@@ -1516,15 +1596,26 @@ const char *com_strDotw( COM_WD_TYPE_t iDotw, COM_WDSTR_TYPE_t iType )
 
 /* 文字列チェーンデータ処理 *************************************************/
 
+// チェーンの各データは全チェーン共通のプールから取る。
+// データ文字列は従来通りメモリ監視の対象となるので、解放漏れはそこで分かる。
+static com_pool_t*  gChainPool = NULL;
+static pthread_once_t  gChainPoolOnce = PTHREAD_ONCE_INIT;
+
+static void createChainPool( void )
+{
+    gChainPool = com_createPool( sizeof(com_strChain_t), 0, false );
+}
+
 static com_strChain_t *createNewChainData( COM_FILEPRM, const char *iKey )
 {
-    com_strChain_t*  new = com_mallocFunc( sizeof(com_strChain_t), COM_FILEVAR,
-                                           "newChainData(%s)", iKey );
+    (void)pthread_once( &gChainPoolOnce, createChainPool );
+    if( COM_UNLIKELY(!gChainPool) ) {return NULL;}
+    com_strChain_t*  new = com_allocPoolFunc( gChainPool, COM_FILEVAR );
     if( COM_UNLIKELY(!new) ) {return NULL;}
     new->data =
         com_strdupFunc( iKey, COM_FILEVAR, "newChainData->data(%s)", iKey );
     if( COM_UNLIKELY(!(new->data)) ) {
-        com_free( new );
+        com_freePoolObjFunc( gChainPool, &new, COM_FILEVAR );
         return NULL;
     }
     new->next = NULL;
@@ -1633,7 +1724,7 @@ static com_strChain_t *cutChainData(
     if( oForward ) {oForward->next = next;} else {*oChain = next;}
     com_skipMemInfo( true );
     com_freeFunc( &(target->data), COM_FILEVAR );
-    com_freeFunc( &target, COM_FILEVAR );
+    com_freePoolObjFunc( gChainPool, &target, COM_FILEVAR );
     com_skipMemInfo( false );
     return next;
 }
@@ -1739,7 +1830,7 @@ void com_freeChainDataFunc( com_strChain_t **ioChain, COM_FILEPRM )
     while( tmp ) {
         next = tmp->next;
         com_freeFunc( &(tmp->data), COM_FILEVAR );
-        com_freeFunc( &tmp, COM_FILEVAR );
+        com_freePoolObjFunc( gChainPool, &tmp, COM_FILEVAR );
         tmp = next;
     }
     *ioChain = NULL;
@@ -1861,6 +1952,15 @@ typedef struct hashMng {
 static hashMng_t*  gHash = NULL;
 static long  gHashCount = 0;
 
+// hashUnit_tは全テーブル共通のプールから取る (キーとデータは個別に捕捉)
+static com_pool_t*  gHashPool = NULL;
+static pthread_once_t  gHashPoolOnce = PTHREAD_ONCE_INIT;
+
+static void createHashPool( void )
+{
+    gHashPool = com_createPool( sizeof(hashUnit_t), 0, false );
+}
+
 static BOOL initHash( hashData_t *oTarget, const void *iAddr, size_t iSize )
 {
     if( COM_UNLIKELY(!iAddr) ) {return false;}
@@ -1873,7 +1973,7 @@ static void freeUnit( COM_FILEPRM, hashUnit_t **oTarget )
     if( !(*oTarget) ) {return;}
     com_freeFunc( &((*oTarget)->key.data), COM_FILEVAR );
     com_freeFunc( &((*oTarget)->data.data), COM_FILEVAR );
-    com_freeFunc( oTarget, COM_FILEVAR );
+    com_freePoolObjFunc( gHashPool, oTarget, COM_FILEVAR );
 }
 
 static void freeTable( COM_FILEPRM, hashUnit_t *oTable )
@@ -1888,11 +1988,13 @@ static void freeTable( COM_FILEPRM, hashUnit_t *oTable )
 
 static void freeAllHash( COM_FILEPRM )
 {
-    if( !gHash || !gHashCount ) {return;}
-    for( int i = 0;  i < gHashCount;  i++ ) {
-        if( gHash[i].tableSize > 0 ) {com_cancelHashFunc( i, COM_FILEVAR );}
+    if( gHash && gHashCount ) {
+        for( int i = 0;  i < gHashCount;  i++ ) {
+            if( gHash[i].tableSize > 0 ) {com_cancelHashFunc(i, COM_FILEVAR);}
+        }
+        com_freeFunc( &gHash, COM_FILEVAR );
     }
-    com_freeFunc( &gHash, COM_FILEVAR );
+    com_freePoolFunc( &gHashPool, COM_FILEVAR );
 }
 
 com_hashId_t com_registerHashFunc(
@@ -1951,16 +2053,17 @@ void com_cancelHashFunc( com_hashId_t iID, COM_FILEPRM )
 
 // ハッシュキーの計算に他のロジックを使いたい場合は
 // com_registerHash()で計算用関数のアドレスを渡す。
+// 以下は FNV-1aで、キーの全オクテットが結果に反映されるようにしている。
 
 static com_hash_t calcHashKey(
         const void *iKey, size_t iKeySize, size_t iTableSize )
 {
-    com_hash_t  sum = 0;
+    uint64_t  sum = COM_FNV_OFFSET;
     const uchar*  tmp = iKey;
     for( size_t i = 0;  i < iKeySize;  i++ ) {
-        sum = (sum << 3) + (com_hash_t)(tmp[i]);
+        sum = (sum ^ tmp[i]) * COM_FNV_PRIME;
     }
-    return (sum & iTableSize);
+    return (com_hash_t)(sum % iTableSize);
 }
 
 static hashUnit_t **getTop( com_hashId_t iID, hashData_t *iKey )
@@ -1993,8 +2096,9 @@ static hashUnit_t *searchHashData( hashUnit_t *iUnit, hashData_t *iKey )
 
 static hashUnit_t *getNewUnit( COM_FILEPRM )
 {
-    hashUnit_t*  new =
-        com_mallocFunc( sizeof(hashUnit_t), COM_FILEVAR, "getNewUnit" );
+    (void)pthread_once( &gHashPoolOnce, createHashPool );
+    if( COM_UNLIKELY(!gHashPool) ) {return NULL;}
+    hashUnit_t*  new = com_allocPoolFunc( gHashPool, COM_FILEVAR );
     if( COM_UNLIKELY(!new) ) {return NULL;}
     *new = (hashUnit_t){ {NULL, 0}, {NULL, 0}, NULL };
     return new;
@@ -2117,7 +2221,7 @@ void com_initializeSortTable( com_sortTable_t *oTable, COM_SORT_MATCH_t iAct )
 {
     if( COM_UNLIKELY(!oTable) ) {COM_PRMNG();}
 
-    *oTable = (com_sortTable_t){ 0, iAct, 0, NULL, NULL };
+    *oTable = (com_sortTable_t){ 0, iAct, 0, NULL, NULL, 0 };
 }
 
 static BOOL setSortData( COM_FILEPRM, com_sort_t *oTarget, com_sort_t *iData )
@@ -2157,7 +2261,7 @@ BOOL com_setSortDataFunc( com_sort_t *oTarget, com_sort_t *iData, COM_FILEPRM )
 
 static void resizeSortSearch( COM_FILEPRM, com_sortTable_t *oTable )
 {
-    size_t  cnt = (size_t)(oTable->count);
+    size_t  cnt = (size_t)(oTable->capacity);
     // 検索結果格納用領域の確保
     oTable->search = com_reallocfFunc( oTable->search,
                                        sizeof(com_sort_t*) * cnt, COM_FILEVAR,
@@ -2167,10 +2271,17 @@ static void resizeSortSearch( COM_FILEPRM, com_sortTable_t *oTable )
 
 static BOOL resizeSortTable( COM_FILEPRM, com_sortTable_t *oTable, long iMod )
 {
-    return com_realloctFunc( &(oTable->table), sizeof(com_sort_t),
-                             &(oTable->count), iMod, COM_FILEVAR,
-                             "resize sort table(%ld)", oTable->count + iMod );
-    // 関数処理を com_realloct()で共通化した
+    long  capa = oTable->capacity;
+    BOOL  result =
+        com_realloctCapFunc( &(oTable->table), sizeof(com_sort_t),
+                             &(oTable->count), &(oTable->capacity), iMod,
+                             COM_FILEVAR, "resize sort table(%ld)",
+                             oTable->count + iMod );
+    // 検索結果格納用領域はテーブル容量が変わった時だけ合わせる
+    if( result && capa != oTable->capacity ) {
+        resizeSortSearch( COM_FILEVAR, oTable );
+    }
+    return result;
 }
 
 // 二分検索(見つからない場合、追加されるべき位置を特定)
@@ -2260,7 +2371,6 @@ static BOOL addSortTable(
         COM_FILEPRM, com_sortTable_t *oTable, com_sort_t *iData, long iPos )
 {
     if( !resizeSortTable( COM_FILEVAR, oTable, 1 ) ) {return false;}
-    resizeSortSearch( COM_FILEVAR, oTable );
     com_sort_t*  tmp = oTable->table;
     for( long i = oTable->count - 1;  i > iPos;  i-- ) {tmp[i] = tmp[i - 1];}
     return setSortData( COM_FILEVAR, &tmp[iPos], iData );
@@ -2396,11 +2506,7 @@ long com_deleteSortTableFunc(
         deleteSortData( COM_FILEVAR, tbl, pos, &count, &result );
         if( !iDeleteAll ) {break;}
     }
-    if( result ) {
-        if( resizeSortTable( COM_FILEVAR, oTable, -result ) ) {
-            resizeSortSearch( COM_FILEVAR, oTable );
-        }
-    }
+    if( result ) {(void)resizeSortTable( COM_FILEVAR, oTable, -result );}
     com_skipMemInfo( false );
     return result;
 }
@@ -2435,6 +2541,7 @@ void com_freeSortTableFunc( com_sortTable_t *oTable, COM_FILEPRM )
     freeSortList( COM_FILEVAR, &(oTable->count), &(oTable->table) );
     com_freeFunc( &(oTable->table), COM_FILEVAR );
     com_freeFunc( &(oTable->search), COM_FILEVAR );
+    oTable->capacity = 0;
     com_skipMemInfo( false );
 }
 
@@ -2442,6 +2549,12 @@ void com_freeSortTableFunc( com_sortTable_t *oTable, COM_FILEPRM )
 
 /* リングバッファ関連 *******************************************************/
 
+// ヒュージページ以上のバッファは、大容量領域として捕捉する
+static BOOL isLargeRing( size_t iUnit, size_t iSize )
+{
+    return (iUnit * iSize >= COM_LARGE_HUGESIZE);
+}
+
 com_ringBuf_t *com_createRingBufFunc(
         size_t iUnit, size_t iSize, BOOL iOverwrite, BOOL iNotifyOverwrite,
         com_freeRingBuf_t iFunc, COM_FILEPRM )
@@ -2450,10 +2563,19 @@ com_ringBuf_t *com_createRingBufFunc(
         com_mallocFunc( sizeof(com_ringBuf_t), COM_FILEVAR,
                         "new ring buffer(%zu * %zu)", iUnit, iSize );
     if( COM_UNLIKELY(!ring) ) {return NULL;}
-    void*  buf = com_mallocFunc( iUnit * iSize, COM_FILEVAR,
-                        "new ring buffer area(%zu + %zu)", iUnit, iSize );
+    void*  buf = NULL;
+    if( isLargeRing( iUnit, iSize ) ) {
+        buf = com_allocLargeFunc( iUnit * iSize, true, COM_LARGE_LOCALNODE,
+                                  COM_FILEVAR,
+                                  "new ring buffer area(%zu * %zu)",
+                                  iUnit, iSize );
+    }
+    else {
+        buf = com_mallocFunc( iUnit * iSize, COM_FILEVAR,
+                              "new ring buffer area(%zu + %zu)", iUnit, iSize );
+    }
     if( COM_UNLIKELY(!buf) ) {
-        com_freeFunc( ring, COM_FILEVAR );
+        com_freeFunc( &ring, COM_FILEVAR );
         return NULL;
     }
     *ring = (com_ringBuf_t){
@@ -2528,12 +2650,595 @@ void com_freeRingBufFunc( com_ringBuf_t **oRing, COM_FILEPRM )
             ((*oRing)->freeFunc)( RINGBUF( *oRing, i ) );
         }
     }
-    com_freeFunc( &((*oRing)->buf), COM_FILEVAR );
+    if( isLargeRing( (*oRing)->unit, (*oRing)->size ) ) {
+        com_freeLargeFunc( &((*oRing)->buf), COM_FILEVAR );
+    }
+    else {com_freeFunc( &((*oRing)->buf), COM_FILEVAR );}
     com_freeFunc( oRing, COM_FILEVAR );
 }           
 
 
 
+/* アリーナ関連 *************************************************************/
+
+// チャンクヘッダの後、切り出し用の領域の開始位置
+#define ARENA_HEADSIZE \
+    ((sizeof(com_arenaChunk_t) + COM_ARENA_ALIGN - 1) & \
+     ~(size_t)(COM_ARENA_ALIGN - 1))
+
+#define ARENA_DATA( CHUNK )  ((char*)(CHUNK) + ARENA_HEADSIZE)
+
+#define ARENA_ALIGNED( SIZE ) \
+    (((SIZE) + COM_ARENA_ALIGN - 1) & ~(size_t)(COM_ARENA_ALIGN - 1))
+
+static com_arenaChunk_t *newArenaChunk(
+        com_arena_t *ioArena, size_t iSize, COM_FILEPRM )
+{
+    com_arenaChunk_t*  chunk = NULL;
+    // 標準サイズで足りるなら、再利用待ちのチャンクを使う
+    if( iSize <= ioArena->chunkSize && ioArena->spare ) {
+        chunk = ioArena->spare;
+        ioArena->spare = chunk->next;
+    }
+    else {
+        size_t  size = ioArena->chunkSize;
+        if( iSize > size ) {size = iSize;}
+        chunk = com_mallocFunc( ARENA_HEADSIZE + size, COM_FILEVAR,
+                                "arena chunk(%zu)", size );
+        if( COM_UNLIKELY(!chunk) ) {return NULL;}
+        chunk->size = size;
+        ioArena->capacity += size;
+    }
+    chunk->used = 0;
+    chunk->next = ioArena->chunk;
+    ioArena->chunk = chunk;
+    return chunk;
+}
+
+com_arena_t *com_createArenaFunc( size_t iChunkSize, COM_FILEPRM )
+{
+    com_arena_t*  arena =
+        com_mallocFunc( sizeof(com_arena_t), COM_FILEVAR, "new arena" );
+    if( COM_UNLIKELY(!arena) ) {return NULL;}
+    if( !iChunkSize ) {iChunkSize = COM_ARENA_CHUNK;}
+    *arena = (com_arena_t){
+        NULL, NULL, ARENA_ALIGNED( iChunkSize ), 0, 0, COM_FILEVAR
+    };
+    if( COM_UNLIKELY(!newArenaChunk( arena, arena->chunkSize, COM_FILEVAR )) ) {
+        com_freeFunc( &arena, COM_FILEVAR );
+        return NULL;
+    }
+    return arena;
+}
+
+void *com_allocArena( com_arena_t *ioArena, size_t iSize )
+{
+    if( COM_UNLIKELY(!ioArena || !iSize) ) {COM_PRMNG(NULL);}
+    size_t  size = ARENA_ALIGNED( iSize );
+    com_arenaChunk_t*  chunk = ioArena->chunk;
+    // チャンクの再捕捉に失敗していれば、チャンクが無いこともある
+    if( COM_UNLIKELY(!chunk || chunk->size - chunk->used < size) ) {
+        // 新しいチャンクの捕捉位置は、アリーナを生成した位置とする
+        chunk = newArenaChunk( ioArena, size, ioArena->file, ioArena->line,
+                               ioArena->func );
+        if( COM_UNLIKELY(!chunk) ) {return NULL;}
+    }
+    char*  result = ARENA_DATA( chunk ) + chunk->used;
+    chunk->used += size;
+    ioArena->used += size;
+    memset( result, 0, iSize );
+    return result;
+}
+
+void com_markArena( com_arena_t *iArena, com_arenaMark_t *oMark )
+{
+    if( COM_UNLIKELY(!iArena || !oMark) ) {COM_PRMNG();}
+    com_arenaChunk_t*  chunk = iArena->chunk;
+    *oMark = (com_arenaMark_t){ chunk, chunk ? chunk->used : 0, iArena->used };
+}
+
+// 先頭のチャンクを外し、標準サイズなら再利用待ちに、そうでなければ解放する
+static void dropArenaChunk( com_arena_t *ioArena, COM_FILEPRM )
+{
+    com_arenaChunk_t*  chunk = ioArena->chunk;
+    ioArena->chunk = chunk->next;
+    if( chunk->size == ioArena->chunkSize ) {
+        chunk->next = ioArena->spare;
+        ioArena->spare = chunk;
+        return;
+    }
+    ioArena->capacity -= chunk->size;
+    com_freeFunc( &chunk, COM_FILEVAR );
+}
+
+void com_rewindArena( com_arena_t *ioArena, const com_arenaMark_t *iMark )
+{
+    if( COM_UNLIKELY(!ioArena || !iMark) ) {COM_PRMNG();}
+    while( ioArena->chunk && ioArena->chunk != iMark->chunk ) {
+        dropArenaChunk( ioArena, COM_FILELOC );
+    }
+    if( ioArena->chunk ) {
+        ioArena->chunk->used = iMark->chunkUsed;
+        ioArena->used = iMark->used;
+        return;
+    }
+    // チャンクが無い状態で記録した位置でなければ、記録が見つからなかった
+    if( COM_UNLIKELY(iMark->chunk) ) {
+        com_error( COM_ERR_DEBUGNG, "arena mark not found" );
+    }
+    ioArena->used = 0;
+    // 捕捉に失敗しても、次の com_allocArena()で改めて捕捉する
+    (void)newArenaChunk( ioArena, ioArena->chunkSize, COM_FILELOC );
+}
+
+void com_resetArena( com_arena_t *ioArena )
+{
+    if( COM_UNLIKELY(!ioArena) ) {COM_PRMNG();}
+    while( ioArena->chunk ) {dropArenaChunk( ioArena, COM_FILELOC );}
+    ioArena->used = 0;
+    // 最初のチャンクは再利用待ちから取るので、失敗することはない
+    (void)newArenaChunk( ioArena, ioArena->chunkSize, COM_FILELOC );
+}
+
+static void freeArenaChunks( com_arenaChunk_t *oChunk, COM_FILEPRM )
+{
+    while( oChunk ) {
+        com_arenaChunk_t*  next = oChunk->next;
+        com_freeFunc( &oChunk, COM_FILEVAR );
+        oChunk = next;
+    }
+}
+
+void com_freeArenaFunc( com_arena_t **oArena, COM_FILEPRM )
+{
+    if( COM_UNLIKELY(!oArena) ) {COM_PRMNG();}
+    if( !(*oArena) ) {return;}
+    freeArenaChunks( (*oArena)->chunk, COM_FILEVAR );
+    freeArenaChunks( (*oArena)->spare, COM_FILEVAR );
+    com_freeFunc( oArena, COM_FILEVAR );
+}
+
+
+
+/* オブジェクトプール関連 ***************************************************/
+
+// スラブ/空きオブジェクトの先頭は次へのリンクとして使う
+#define POOL_NEXT( OBJ )  (*(void**)(OBJ))
+
+// スラブヘッダの後、オブジェクトの開始位置 (アラインメントはアリーナと同じ)
+#define POOL_HEADSIZE  ARENA_ALIGNED( sizeof(void*) )
+
+enum {
+    POOL_SLAB_BATCHES = 4     // 1スラブのオブジェクト数 (一括補充数の倍数)
+};
+
+// デバッグ指定時はオブジェクトの末尾に状態を示す1語を付ける。
+// メモリ監視の有無や抽出に関係なく、二重返却をプール自身で検出するため。
+#define POOL_STATE( POOL, OBJ ) \
+    (*(ulong*)(void*)((char*)(OBJ) + (POOL)->unit - sizeof(ulong)))
+
+enum {
+    POOL_OBJ_USED = 0x55534544,    // 捕捉中
+    POOL_OBJ_FREE = 0x46524545     // 返却済み
+};
+
+// スレッドごとのキャッシュ (プールごとに 1つ作り、スレッド内でリストにする)
+typedef struct poolCache {
+    struct poolCache*  next;
+    com_pool_t*  pool;        // 対象プール (解放済みの可能性あり)
+    ulong    id;              // 対象プールの識別番号
+    void*    free;            // 空きオブジェクトのリスト
+    long     count;           // 空きオブジェクト数
+} poolCache_t;
+
+// 生成済みプールのリスト (gMutexPoolで排他する)
+static pthread_mutex_t  gMutexPool = PTHREAD_MUTEX_INITIALIZER;
+static com_pool_t*  gPoolList = NULL;
+static ulong  gPoolId = 0;
+static __thread poolCache_t*  gPoolCache = NULL;
+static pthread_key_t  gPoolKey;
+static pthread_once_t  gPoolOnce = PTHREAD_ONCE_INIT;
+
+// キャッシュの対象プールが解放されていないか (gMutexPoolでロック中に呼ぶ)
+static BOOL isLivePool( const poolCache_t *iCache )
+{
+    for( com_pool_t* pool = gPoolList;  pool;  pool = pool->next ) {
+        if( pool == iCache->pool ) {return (pool->id == iCache->id);}
+    }
+    return false;
+}
+
+// iListの先頭から iCount個をデポに戻し、残りのリストを返す
+static void *returnToDepot( com_pool_t *ioPool, void *iList, long iCount )
+{
+    void*  tail = iList;
+    for( long i = 1;  i < iCount;  i++ ) {tail = POOL_NEXT( tail );}
+    void*  rest = POOL_NEXT( tail );
+    com_mutexLock( &ioPool->mutex, __func__ );
+    POOL_NEXT( tail ) = ioPool->depot;
+    ioPool->depot = iList;
+    ioPool->depotCount += iCount;
+    com_mutexUnlock( &ioPool->mutex, __func__ );
+    return rest;
+}
+
+// スレッド終了時に、解放されていないプールのキャッシュはデポに戻す
+static void releasePoolCache( void *ioCache )
+{
+    com_mutexLock( &gMutexPool, __func__ );
+    for( poolCache_t* cache = ioCache;  cache; ) {
+        poolCache_t*  next = cache->next;
+        if( cache->count && isLivePool( cache ) ) {
+            (void)returnToDepot( cache->pool, cache->free, cache->count );
+        }
+        // malloc()で確保しているので、com_free()は使用しない
+        free( cache );
+        cache = next;
+    }
+    com_mutexUnlock( &gMutexPool, __func__ );
+}
+
+// 解放済みプールのキャッシュを外す (gMutexPoolでロック中に呼ぶ)
+static void pruneCache( void )
+{
+    for( poolCache_t** ptr = &gPoolCache;  *ptr; ) {
+        if( isLivePool( *ptr ) ) {ptr = &((*ptr)->next);  continue;}
+        poolCache_t*  dead = *ptr;
+        *ptr = dead->next;
+        free( dead );
+    }
+    (void)pthread_setspecific( gPoolKey, gPoolCache );
+}
+
+static void createPoolKey( void )
+{
+    (void)pthread_key_create( &gPoolKey, releasePoolCache );
+}
+
+static poolCache_t *getPoolCache( com_pool_t *iPool )
+{
+    for( poolCache_t* cache = gPoolCache;  cache;  cache = cache->next ) {
+        if( cache->pool == iPool && cache->id == iPool->id ) {return cache;}
+    }
+    (void)pthread_once( &gPoolOnce, createPoolKey );
+    // メインスレッドでは終了時に解放されないので、メモリ監視の対象外とする
+    poolCache_t*  cache = calloc( 1, sizeof(*cache) );
+    if( COM_UNLIKELY(!cache) ) {
+        com_error( COM_ERR_NOMEMORY, "pool cache NG" );
+        return NULL;
+    }
+    cache->pool = iPool;
+    cache->id = iPool->id;
+    com_mutexLock( &gMutexPool, __func__ );
+    cache->next = gPoolCache;
+    gPoolCache = cache;
+    pruneCache();
+    com_mutexUnlock( &gMutexPool, __func__ );
+    return cache;
+}
+
+com_pool_t *com_createPoolFunc(
+        size_t iSize, long iBatch, BOOL iDebug, COM_FILEPRM )
+{
+    if( COM_UNLIKELY(!iSize || iBatch < 0) ) {COM_PRMNG(NULL);}
+    com_pool_t*  pool =
+        com_mallocFunc( sizeof(com_pool_t), COM_FILEVAR, "new pool" );
+    if( COM_UNLIKELY(!pool) ) {return NULL;}
+    *pool = (com_pool_t){
+        .size = iSize,
+        .unit = ARENA_ALIGNED( iSize + (iDebug ? sizeof(ulong) : 0) ),
+        .batch = iBatch ? iBatch : COM_POOL_BATCH, .debug = iDebug,
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+        .file = iFILE, .line = iLINE, .func = iFUNC
+    };
+    com_mutexLock( &gMutexPool, __func__ );
+    pool->id = ++gPoolId;
+    pool->next = gPoolList;
+    gPoolList = pool;
+    com_mutexUnlock( &gMutexPool, __func__ );
+    return pool;
+}
+
+// 先頭のリンクと末尾の状態を除いた部分を埋める
+static void poisonPoolObj( const com_pool_t *iPool, void *oObj )
+{
+    memset( (char*)oObj + sizeof(void*), COM_POOL_POISON,
+            iPool->unit - sizeof(void*) - sizeof(ulong) );
+    POOL_STATE( iPool, oObj ) = POOL_OBJ_FREE;
+}
+
+static void checkPoolPoison( const com_pool_t *iPool, const void *iObj )
+{
+    const uchar*  data = (const uchar*)iObj + sizeof(void*);
+    size_t  len = iPool->unit - sizeof(void*) - sizeof(ulong);
+    for( size_t i = 0;  i < len;  i++ ) {
+        if( COM_UNLIKELY(data[i] != COM_POOL_POISON) ) {
+            com_error( COM_ERR_DEBUGNG,
+                       "pool object(%p) modified after free (+%zu)",
+                       iObj, i + sizeof(void*) );
+            return;
+        }
+    }
+}
+
+// スラブを捕捉し、オブジェクトを切り出してデポに入れる (ロック中に呼ぶ)
+static BOOL newPoolSlab( com_pool_t *ioPool )
+{
+    size_t  count = (size_t)ioPool->batch * POOL_SLAB_BATCHES;
+    // スラブの捕捉位置は、プールを生成した位置とする
+    char*  slab = com_mallocFunc( POOL_HEADSIZE + ioPool->unit * count,
+                                  ioPool->file, ioPool->line, ioPool->func,
+                                  "pool slab(%zu*%zu)", ioPool->unit, count );
+    if( COM_UNLIKELY(!slab) ) {return false;}
+    POOL_NEXT( slab ) = ioPool->slab;
+    ioPool->slab = slab;
+    // アドレス順に取り出されるよう、後ろから積む
+    for( size_t i = count;  i > 0;  i-- ) {
+        char*  obj = slab + POOL_HEADSIZE + ioPool->unit * (i - 1);
+        if( ioPool->debug ) {poisonPoolObj( ioPool, obj );}
+        POOL_NEXT( obj ) = ioPool->depot;
+        ioPool->depot = obj;
+    }
+    ioPool->depotCount += (long)count;
+    ioPool->objCount += count;
+    return true;
+}
+
+static BOOL refillPoolCache( com_pool_t *ioPool, poolCache_t *oCache )
+{
+    com_mutexLock( &ioPool->mutex, __func__ );
+    if( !ioPool->depot && !newPoolSlab( ioPool ) ) {
+        com_mutexUnlock( &ioPool->mutex, __func__ );
+        return false;
+    }
+    // デポの先頭から順番を変えずに、一括補充数だけつなぎ替える
+    void*  tail = ioPool->depot;
+    long  count = 1;
+    for( ;  count < ioPool->batch && POOL_NEXT( tail );  count++ ) {
+        tail = POOL_NEXT( tail );
+    }
+    void*  top = ioPool->depot;
+    ioPool->depot = POOL_NEXT( tail );
+    ioPool->depotCount -= count;
+    com_mutexUnlock( &ioPool->mutex, __func__ );
+    POOL_NEXT( tail ) = oCache->free;
+    oCache->free = top;
+    oCache->count += count;
+    return true;
+}
+
+void *com_allocPoolFunc( com_pool_t *ioPool, COM_FILEPRM )
+{
+    if( COM_UNLIKELY(!ioPool) ) {COM_PRMNG(NULL);}
+    poolCache_t*  cache = getPoolCache( ioPool );
+    if( COM_UNLIKELY(!cache) ) {return NULL;}
+    if( !cache->free && !refillPoolCache( ioPool, cache ) ) {return NULL;}
+    void*  obj = cache->free;
+    cache->free = POOL_NEXT( obj );
+    cache->count--;
+    if( ioPool->debug ) {
+        checkPoolPoison( ioPool, obj );
+        POOL_STATE( ioPool, obj ) = POOL_OBJ_USED;
+        com_addMemInfo( COM_FILEVAR, COM_ALLOCPOOL, obj, ioPool->size, NULL );
+    }
+    memset( obj, 0, ioPool->size );
+    return obj;
+}
+
+// デバッグ指定時の返却チェック (二重返却なら falseを返す)
+static BOOL checkPoolFree( const com_pool_t *iPool, void *iObj, COM_FILEPRM )
+{
+    if( POOL_STATE( iPool, iObj ) != POOL_OBJ_USED ) {
+        com_errorFunc( COM_ERR_DOUBLEFREE, true, COM_FILEVAR,
+                       "pool object(%p) not in use", iObj );
+        return false;
+    }
+    com_deleteMemInfo( COM_FILEVAR, COM_FREEPOOLOBJ, iObj );
+    poisonPoolObj( iPool, iObj );
+    return true;
+}
+
+void com_freePoolObjFunc( com_pool_t *ioPool, void *ioAddr, COM_FILEPRM )
+{
+    if( COM_UNLIKELY(!ioPool || !ioAddr) ) {COM_PRMNG();}
+    void**  addr = ioAddr;
+    void*  obj = *addr;
+    if( !obj ) {return;}
+    *addr = NULL;
+    if( ioPool->debug && !checkPoolFree( ioPool, obj, COM_FILEVAR ) ) {return;}
+    poolCache_t*  cache = getPoolCache( ioPool );
+    if( COM_UNLIKELY(!cache) ) {  // キャッシュが無ければデポに直接戻す
+        POOL_NEXT( obj ) = NULL;
+        (void)returnToDepot( ioPool, obj, 1 );
+        return;
+    }
+    POOL_NEXT( obj ) = cache->free;
+    cache->free = obj;
+    // 溜まり過ぎたら、一括補充数だけデポに戻す
+    if( ++cache->count >= ioPool->batch * 2 ) {
+        cache->free = returnToDepot( ioPool, cache->free, ioPool->batch );
+        cache->count -= ioPool->batch;
+    }
+}
+
+void com_freePoolFunc( com_pool_t **oPool, COM_FILEPRM )
+{
+    if( COM_UNLIKELY(!oPool) ) {COM_PRMNG();}
+    com_pool_t*  pool = *oPool;
+    if( !pool ) {return;}
+    com_mutexLock( &gMutexPool, __func__ );
+    for( com_pool_t** ptr = &gPoolList;  *ptr;  ptr = &((*ptr)->next) ) {
+        if( *ptr == pool ) {*ptr = pool->next;  break;}
+    }
+    // 自スレッドのキャッシュはすぐに外す (他スレッドは次の捕捉か終了時)
+    if( gPoolCache ) {pruneCache();}
+    com_mutexUnlock( &gMutexPool, __func__ );
+    void*  slab = pool->slab;
+    while( slab ) {
+        void*  next = POOL_NEXT( slab );
+        com_freeFunc( &slab, COM_FILEVAR );
+        slab = next;
+    }
+    com_freeFunc( oPool, COM_FILEVAR );
+}
+
+
+
+/* 大容量領域関連 ***********************************************************/
+
+// mbind()のメモリポリシー (numaif.hに依存しないよう値を直接持つ)
+#define LARGE_MPOL_PREFERRED  1
+
+#define LARGE_ROUNDUP( SIZE, UNIT ) \
+    (((SIZE) + (UNIT) - 1) / (UNIT) * (UNIT))
+
+// 捕捉した大容量領域の管理情報
+typedef struct largeArea {
+    struct largeArea*  next;
+    void*    addr;
+    size_t   mapSize;                // 実際に捕捉したサイズ
+    long     type;                   // COM_LARGE_t
+} largeArea_t;
+
+static pthread_mutex_t  gMutexLarge = PTHREAD_MUTEX_INITIALIZER;
+static largeArea_t*  gLargeList = NULL;
+
+// iAlignの境界に揃えた領域を返す (その分多めに捕捉して前後を返却する)
+static void *mapAligned( size_t iSize, size_t iAlign )
+{
+    char*  top = mmap( NULL, iSize + iAlign, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( top == MAP_FAILED ) {return NULL;}
+    if( !iAlign ) {return top;}
+    size_t  head = (iAlign - (uintptr_t)top % iAlign) % iAlign;
+    if( head ) {(void)munmap( top, head );}
+    if( iAlign - head ) {(void)munmap( top + head + iSize, iAlign - head );}
+    return top + head;
+}
+
+// ヒュージページ → 透過的ヒュージページ → 通常ページ の順に捕捉を試みる
+static void *mapLargeArea( largeArea_t *oArea, BOOL iHuge )
+{
+    if( !iHuge ) {
+        oArea->mapSize =
+            LARGE_ROUNDUP( oArea->mapSize, (size_t)sysconf( _SC_PAGESIZE ) );
+        oArea->type = COM_LARGE_NORMAL;
+        return mapAligned( oArea->mapSize, 0 );
+    }
+    oArea->mapSize = LARGE_ROUNDUP( oArea->mapSize, COM_LARGE_HUGESIZE );
+#ifdef MAP_HUGETLB
+    void*  huge = mmap( NULL, oArea->mapSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    if( huge != MAP_FAILED ) {
+        oArea->type = COM_LARGE_HUGETLB;
+        return huge;
+    }
+#endif
+    void*  addr = mapAligned( oArea->mapSize, COM_LARGE_HUGESIZE );
+    oArea->type = COM_LARGE_NORMAL;
+#ifdef MADV_HUGEPAGE
+    if( addr && !madvise( addr, oArea->mapSize, MADV_HUGEPAGE ) ) {
+        oArea->type = COM_LARGE_THP;
+    }
+#endif
+    return addr;
+}
+
+static long getLocalNode( void )
+{
+#ifdef SYS_getcpu
+    uint  cpu = 0, node = 0;
+    if( !syscall( SYS_getcpu, &cpu, &node, NULL ) ) {return (long)node;}
+#endif
+    return COM_LARGE_ANYNODE;
+}
+
+// ノードに割り当てられなくても通常の割り当てで使えるので、結果は問わない
+static void bindLargeNode( const largeArea_t *iArea, long iNode )
+{
+    if( iNode == COM_LARGE_LOCALNODE ) {iNode = getLocalNode();}
+    if( iNode < 0 || iNode >= COM_LARGE_NODEMAX ) {return;}
+#ifdef SYS_mbind
+    ulong  mask = 1UL << iNode;
+    (void)syscall( SYS_mbind, iArea->addr, iArea->mapSize,
+                   LARGE_MPOL_PREFERRED, &mask, sizeof(mask) * CHAR_BIT + 1,
+                   0 );
+#else
+    (void)iArea;
+#endif
+}
+
+void *com_allocLargeFunc(
+        size_t iSize, BOOL iHuge, long iNode, COM_FILEPRM,
+        const char *iFormat, ... )
+{
+    if( COM_UNLIKELY(!iSize || iNode < COM_LARGE_LOCALNODE ||
+                     iNode >= COM_LARGE_NODEMAX) ) {COM_PRMNG(NULL);}
+    // 監視情報は領域そのもので作るので、管理情報はメモリ監視の対象外とする
+    largeArea_t*  area = malloc( sizeof(*area) );
+    com_mutexLock( &gMutexMem, "allocLarge(%zu)", iSize );
+    void*  ptr = NULL;
+    if( area && !com_debugMemoryError() ) {
+        *area = (largeArea_t){ .mapSize = iSize };
+        ptr = mapLargeArea( area, iHuge );
+    }
+    COM_SET_FORMAT( gMemLog );
+    checkAllocation( ptr, iFormat, iSize, COM_ALLOCLARGE, COM_FILEVAR );
+    com_mutexUnlock( &gMutexMem, NULL );
+    if( COM_UNLIKELY(!ptr) ) {free( area );  return NULL;}
+    area->addr = ptr;
+    bindLargeNode( area, iNode );
+    com_mutexLock( &gMutexLarge, __func__ );
+    area->next = gLargeList;
+    gLargeList = area;
+    com_mutexUnlock( &gMutexLarge, __func__ );
+    return ptr;
+}
+
+static largeArea_t **seekLargeArea( const void *iAddr )
+{
+    largeArea_t**  ptr = &gLargeList;
+    while( *ptr && (*ptr)->addr != iAddr ) {ptr = &((*ptr)->next);}
+    return ptr;
+}
+
+void com_freeLargeFunc( void *ioAddr, COM_FILEPRM )
+{
+    if( COM_UNLIKELY(!ioAddr) ) {COM_PRMNG();}
+    void**  addr = ioAddr;
+    if( !(*addr) ) {return;}
+    com_mutexLock( &gMutexLarge, __func__ );
+    largeArea_t**  ptr = seekLargeArea( *addr );
+    largeArea_t*  area = *ptr;
+    if( area ) {*ptr = area->next;}
+    com_mutexUnlock( &gMutexLarge, __func__ );
+    if( COM_UNLIKELY(!area) ) {
+        com_error( COM_ERR_DOUBLEFREE, "no large area to free(%p)", *addr );
+        return;
+    }
+    com_mutexLock( &gMutexMem, "freeLarge(%p)", *addr );
+    com_deleteMemInfo( COM_FILEVAR, COM_FREELARGE, area->addr );
+    (void)munmap( area->addr, area->mapSize );
+    *addr = NULL;
+    com_mutexUnlock( &gMutexMem, NULL );
+    free( area );
+}
+
+COM_LARGE_t com_getLargeType( const void *iAddr, size_t *oMapSize )
+{
+    COM_LARGE_t  type = COM_LARGE_NONE;
+    com_mutexLock( &gMutexLarge, __func__ );
+    largeArea_t*  area = *seekLargeArea( iAddr );
+    if( area ) {
+        type = (COM_LARGE_t)area->type;
+        if( oMapSize ) {*oMapSize = area->mapSize;}
+    }
+    com_mutexUnlock( &gMutexLarge, __func__ );
+    return type;
+}
+
+
+
 /* コンフィグ関連 ***********************************************************/
 
 typedef struct {
@@ -2545,12 +3250,14 @@ typedef struct {
 typedef struct {
     char*              key;
     long               valdCnt;
+    long               valdCapa;
     cfgVald_t*         vald;
     char*              data;
 } cfgData_t;
 
 static cfgData_t* gCfgData = NULL;
 static long  gCfgDataCnt = 0;
+static long  gCfgDataCapa = 0;
 
 static void freeCfgVald( cfgVald_t *ioVald )
 {
@@ -2566,7 +3273,7 @@ static void freeCfgData( cfgData_t *oCfg )
         freeCfgVald( &(oCfg->vald[i]) );
     }
     com_free( oCfg->vald );
-    oCfg->valdCnt = 0;
+    oCfg->valdCnt = oCfg->valdCapa = 0;
     com_free( oCfg->data );
 }
 
@@ -2574,7 +3281,7 @@ static void freeAllCfgData( void )
 {
     for( long i = 0;  i < gCfgDataCnt;  i++ ) {freeCfgData( &gCfgData[i] );}
     com_free( gCfgData );
-    gCfgDataCnt = 0;
+    gCfgDataCnt = gCfgDataCapa = 0;
 }
 
 static cfgData_t *searchCfgData( char *iKey )
@@ -2588,16 +3295,16 @@ static cfgData_t *searchCfgData( char *iKey )
 static cfgData_t *addNewCfgData( char *iKey, char *iData )
 {
     cfgData_t*  tmp =
-        com_reallocAddr( &gCfgData, sizeof(*gCfgData), COM_TABLEEND,
-                         &gCfgDataCnt, 1, "addNewCfgData" );
+        com_reallocAddrCap( &gCfgData, sizeof(*gCfgData), COM_TABLEEND,
+                            &gCfgDataCnt, &gCfgDataCapa, 1, "addNewCfgData" );
     if( !tmp ) {return NULL;}
     if( (tmp->key = com_strdup( iKey, NULL ) ) ) {
         if( !iData ) {return tmp;}
         if( (tmp->data = com_strdup( iData, NULL )) ) {return tmp;}
     }
     freeCfgData( tmp );
-    (void)com_realloct( &gCfgData, sizeof(*gCfgData), &gCfgDataCnt, -1,
-                        "addNewCfgData NG" );
+    (void)com_realloctCap( &gCfgData, sizeof(*gCfgData), &gCfgDataCnt,
+                           &gCfgDataCapa, -1, "addNewCfgData NG" );
     return NULL;
 }
 
@@ -2656,8 +3363,9 @@ BOOL com_addCfgValidator(
     GET_CONFIG_DATA( cfg, false );
     COM_DEBUG_AVOID_START( COM_NO_FUNCNAME );
     cfgVald_t*  vald =
-        com_reallocAddr( &(cfg->vald), sizeof(*(cfg->vald)), COM_TABLEEND,
-                         &(cfg->valdCnt), 1, "addCfgValidator" );
+        com_reallocAddrCap( &(cfg->vald), sizeof(*(cfg->vald)), COM_TABLEEND,
+                            &(cfg->valdCnt), &(cfg->valdCapa), 1,
+                            "addCfgValidator" );
     if( COM_UNLIKELY(!vald) ) {
         COM_DEBUG_AVOID_END( COM_NO_FUNCNAME );
         return false;
@@ -2667,8 +3375,9 @@ BOOL com_addCfgValidator(
     if( copyConditions( iCopy, &(vald->cond), iCond ) ) {return true;}
     com_error( COM_ERR_CONFIG, "fail to add condition (%s)", iKey );
     freeCfgVald( vald );
-    (void)com_realloct( &(cfg->vald), sizeof(*(cfg->vald)),
-                        &(cfg->valdCnt), -1, "addCfgValidator NG" );
+    (void)com_realloctCap( &(cfg->vald), sizeof(*(cfg->vald)),
+                           &(cfg->valdCnt), &(cfg->valdCapa), -1,
+                           "addCfgValidator NG" );
     COM_DEBUG_AVOID_END( COM_NO_FUNCNAME );
     return false;
 }
@@ -3784,6 +4493,7 @@ static void finalizeCom( void )
     com_resetBuffer( &gPopBuff );  // これ以降 com_popChainData()使用不可
     freeFormString();              // これ以降 com_getString()使用不可
     freeAllHash( COM_FILELOC );    // これ以降 ハッシュテーブル使用不可
+    com_freePool( &gChainPool );   // これ以降 文字列チェーン使用不可
     com_finalizeThread();
     com_dispFuncTrace();           // 関数呼び出しトレース未使用時は空白化
     com_adjustError();             // これ以降 エラー出力不可
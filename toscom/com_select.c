@@ -40,6 +40,7 @@ typedef struct {
 
 static pthread_mutex_t  gMutexEvent = PTHREAD_MUTEX_INITIALIZER;
 static com_selectId_t   gEventId = 0;       // 現在のイベント登録数
+static long  gEventCapa = 0;                // イベント情報の容量
 static eventInf_t*  gEventInf = NULL;   // イベント情報実体
 
 enum {
@@ -81,8 +82,9 @@ static com_selectId_t getEventId( BOOL iIsTimer )
     // 未使用領域がない時は、末尾に情報を追加
     com_selectId_t  id = selectEventId( iIsTimer );
     if( id == gEventId ) {
-        BOOL  result = com_realloct( &gEventInf, sizeof(*gEventInf), &gEventId,
-                                     1, "new event inf(%ld)", gEventId );
+        BOOL  result = com_realloctCap( &gEventInf, sizeof(*gEventInf),
+                                        &gEventId, &gEventCapa, 1,
+                                        "new event inf(%ld)", gEventId );
         if( !result ) {UNLOCKRETURN( COM_NO_SOCK );}
     }
     // 情報初期化
@@ -1111,6 +1113,7 @@ BOOL com_waitEvent( void )
         if( !selTimer && !count ) {return false;}  // 待機するもの無し
 
         int  result = 0;
+        com_flushOutput();
         if( 0 > (result = select( maxFd+1, &fds, NULL, NULL, selTimer )) ) {
             com_error( COM_ERR_SELECTNG,
                        "fail to select[%s]", com_strerror(errno) );
@@ -1402,6 +1405,7 @@ BOOL com_compareSockWithPort( void *iTargetSock, void *iSockAddr )
 static struct ifaddrs*  gIfAddr = NULL;
 static com_ifinfo_t*  gIfInfo = NULL;
 static long  gIfInfoCnt = 0;
+static long  gIfInfoCapa = 0;
 static int  gIfInfoSock = COM_NO_SOCK;  // 情報取得用に生成するソケット
 
 #ifdef __CYGWIN__          // Cygwinに linux/if_ether.h が無いので、敢えて定義
@@ -1457,8 +1461,8 @@ static com_ifinfo_t *getIfInfo( char *iIfname )
         if( !strcmp( gIfInfo[i].ifname, iIfname ) ) {return &(gIfInfo[i]);}
     }
     com_ifinfo_t*  newInfo =
-        com_reallocAddr( &gIfInfo, sizeof(*gIfInfo), COM_TABLEEND,
-                         &gIfInfoCnt, 1, "ifinfo list" );
+        com_reallocAddrCap( &gIfInfo, sizeof(*gIfInfo), COM_TABLEEND,
+                            &gIfInfoCnt, &gIfInfoCapa, 1, "ifinfo list" );
     if( newInfo ) {setIfInfo( newInfo, iIfname );}
     return newInfo;
 }
@@ -1481,7 +1485,7 @@ static void freeIfInfo( void )
         com_free( tmp->ifaddrs );
     }
     com_free( gIfInfo );
-    gIfInfoCnt = 0;
+    gIfInfoCnt = gIfInfoCapa = 0;
 }
 
 static struct ifaddrs *getifaddrsFunc( void )
@@ -2058,6 +2062,7 @@ static void finalizeSelect( void )
     }
     com_skipMemInfo( true );
     com_free( gEventInf );
+    gEventCapa = 0;
     freeIfInfo();
     COM_DEBUG_AVOID_END( COM_PROC_ALL );
 }
@@ -340,10 +340,12 @@ typedef struct {
     long  def;
     long  initEnd;
     long  cnt;
+    long  capa;
     com_sigPrtclType_t*  list;
 } mngProtocolType_t;
 
 static long  gPrtclTypeCnt = 0;
+static long  gPrtclTypeCapa = 0;
 static mngProtocolType_t*  gPrtclTypeInf = NULL;
 
 static mngProtocolType_t *getPrtclTypeInf( long iBase, BOOL iMakeNew )
@@ -353,9 +355,9 @@ static mngProtocolType_t *getPrtclTypeInf( long iBase, BOOL iMakeNew )
     }
     if( !iMakeNew ) {return NULL;}
     mngProtocolType_t*  tmp =
-        com_reallocAddr( &gPrtclTypeInf, sizeof(*gPrtclTypeInf),
-                         COM_TABLEEND, &gPrtclTypeCnt, 1,
-                         "add protocol type inf" );
+        com_reallocAddrCap( &gPrtclTypeInf, sizeof(*gPrtclTypeInf),
+                            COM_TABLEEND, &gPrtclTypeCnt, &gPrtclTypeCapa, 1,
+                            "add protocol type inf" );
     if( COM_UNLIKELY(!tmp) ) {com_exit( COM_ERR_NOMEMORY );}
     tmp->base = iBase;
     return tmp;
@@ -369,8 +371,9 @@ void com_setPrtclType( COM_PRTCLTYPE_t iBase, com_sigPrtclType_t *iList )
     mngProtocolType_t*  mngInf = getPrtclTypeInf( iBase, true );
     for( ;  iList->target.type != COM_PRTCLTYPE_END;  iList++ ) {
         com_sigPrtclType_t*  newList =
-            com_reallocAddr( &(mngInf->list), sizeof(*(mngInf->list)),
-                    COM_TABLEEND, &(mngInf->cnt), 1, "add protocol type" );
+            com_reallocAddrCap( &(mngInf->list), sizeof(*(mngInf->list)),
+                    COM_TABLEEND, &(mngInf->cnt), &(mngInf->capa), 1,
+                    "add protocol type" );
         if( COM_UNLIKELY(!newList) ) {com_exit( COM_ERR_NOMEMORY );}
         *newList = *iList;
     }
@@ -431,7 +434,7 @@ void com_freePrtclType( void )
     for( long i = 0;  i < gPrtclTypeCnt;  i++ ) {
         com_free( gPrtclTypeInf[i].list );
     }
-    gPrtclTypeCnt = 0;
+    gPrtclTypeCnt = gPrtclTypeCapa = 0;
     com_free( gPrtclTypeInf );
 }
 
@@ -454,6 +457,7 @@ void com_freeCapInf( com_capInf_t *oTarget )
     com_skipMemInfo( true );
     com_free( oTarget->fileName );
     com_fclose( oTarget->fp );
+    com_freeLarge( oTarget->readBuf );
     com_freeSigInf( &oTarget->head, true );
     com_freeSigStk( &oTarget->ifs, true );
     com_freeSigInf( &oTarget->signal, true );
@@ -472,6 +476,11 @@ static BOOL returnFalse(
 #define CAUSEIS( CAUSE, ERRCODE, ERRMSG ) \
     return returnFalse( oCapInf, (CAUSE), (ERRCODE), ERRMSG, COM_FILELOC )
 
+// キャプチャファイル読込用のストリームバッファサイズ
+//   1オクテットずつの読込やシステムコールの多発を避けるため大きめに取る。
+//   読込中は使い続けるので、ヒュージページ1つ分を大容量領域として捕捉する。
+#define CAP_STREAM_BUFSIZE  COM_LARGE_HUGESIZE
+
 static BOOL openCapture( const char *iPath, com_capInf_t *oCapInf )
 {
     if( !(oCapInf->fileName = com_strdup( iPath, NULL )) ) {
@@ -482,27 +491,50 @@ static BOOL openCapture( const char *iPath, com_capInf_t *oCapInf )
         CAUSEIS( COM_CAPERR_OPENFILE,
                  COM_ERR_ANALYZENG, "fail to open capture file" );
     }
+    // バッファ指定に失敗しても標準のバッファで読込は可能なので処理続行
+    oCapInf->readBuf = com_allocLarge( CAP_STREAM_BUFSIZE, true,
+                                       COM_LARGE_LOCALNODE, "capture buffer" );
+    (void)setvbuf( oCapInf->fp, oCapInf->readBuf, _IOFBF, CAP_STREAM_BUFSIZE );
     return true;
 }
 
 static com_bin  gCapBuf[COM_DATABUF_SIZE];
 
-// oBufが NULLの場合は バッファリングせず読み飛ばす処理になる
-static BOOL readCapture( com_capInf_t *oCapInf, com_bin *oBuf, com_off iSize )
+static BOOL failReadCapture( com_capInf_t *oCapInf )
 {
-    com_off  count = 0;
-    int  oct;
-    if( oBuf ) {memset( oBuf, 0, iSize );}
-    errno = 0;
-    while( EOF != (oct = fgetc( oCapInf->fp )) ) {
-        if( oBuf ) {oBuf[count++] = (com_bin)oct;}
-        if( count == iSize ) {return true;}
-    }
     // ファイルの末尾まで読んだ場合はエラー出力はしない
-    if( !errno ) {CAUSEIS( COM_CAPERR_NOMOREDATA, COM_NO_ERROR, NULL );}
+    if( !ferror( oCapInf->fp ) ) {
+        CAUSEIS( COM_CAPERR_NOMOREDATA, COM_NO_ERROR, NULL );
+    }
     CAUSEIS( COM_CAPERR_NOMOREDATA, COM_ERR_ILLSIZE, "fail to read file" );
 }
 
+// 読み飛ばしはまず fseek()を試み、できなければ読み捨てる
+static BOOL skipCapture( com_capInf_t *oCapInf, com_off iSize )
+{
+    if( iSize <= LONG_MAX ) {
+        if( !fseek( oCapInf->fp, (long)iSize, SEEK_CUR ) ) {return true;}
+    }
+    while( iSize ) {
+        com_off  unit = sizeof(gCapBuf);
+        if( unit > iSize ) {unit = iSize;}
+        if( unit != fread( gCapBuf, 1, unit, oCapInf->fp ) ) {
+            return failReadCapture( oCapInf );
+        }
+        iSize -= unit;
+    }
+    return true;
+}
+
+// oBufが NULLの場合は バッファリングせず読み飛ばす処理になる
+static BOOL readCapture( com_capInf_t *oCapInf, com_bin *oBuf, com_off iSize )
+{
+    if( !oBuf ) {return skipCapture( oCapInf, iSize );}
+    memset( oBuf, 0, iSize );
+    if( iSize == fread( oBuf, 1, iSize, oCapInf->fp ) ) {return true;}
+    return failReadCapture( oCapInf );
+}
+
 static ulong readValue( com_capInf_t *oCapInf, com_bin **oBuf, com_off iSize )
 {
     static com_bin  buf[8];
@@ -534,12 +566,8 @@ static BOOL addSignalData( com_capInf_t *oCapInf, com_off iSize )
     com_sigBin_t*  sig = &oCapInf->signal.sig;
     sig->top = com_reallocf( sig->top, sig->len + iSize, __func__ );
     if( !(sig->top) ) {return false;}
-    com_off  cnt = 0;
-    for( ;  cnt < iSize;  cnt++ ) {
-        com_bin  oct;
-        if( !readCapture( oCapInf, &oct, 1 ) ) {break;}
-        sig->top[sig->len + cnt] = oct;
-    }
+    com_off  cnt = fread( sig->top + sig->len, 1, iSize, oCapInf->fp );
+    if( cnt < iSize ) {(void)failReadCapture( oCapInf );}
     sig->len += cnt;
     return true;
 }
@@ -584,9 +612,10 @@ static BOOL getBlock( com_capInf_t *oCapInf, com_sigInf_t *oTarget )
 
 static com_sigInf_t *addSigInf( com_sigStk_t *ioTarget, char *iLabel )
 {
-    return com_reallocAddr( &(ioTarget->stack), sizeof(com_sigInf_t),
-                            COM_TABLEEND, &(ioTarget->cnt), 1,
-                            "%s[%ld]", iLabel, ioTarget->cnt );
+    return com_reallocAddrCap( &(ioTarget->stack), sizeof(com_sigInf_t),
+                               COM_TABLEEND, &(ioTarget->cnt),
+                               &(ioTarget->capa), 1,
+                               "%s[%ld]", iLabel, ioTarget->cnt );
 }
 
 static com_sigPrtclType_t  gFileNext[] = {
@@ -759,6 +788,8 @@ static uint searchPacketBlock( com_capInf_t *oCapInf, com_sigInf_t *oXPB )
     return 0;  // ここには来ないが関数構造的に必要
 }
 
+#define USEC_UNIT  1000000
+
 static BOOL getEpbData( com_capInf_t *oCapInf, com_sigInf_t *iEpb )
 {
     COM_CAST_HEAD( com_pcapngEpb_t, epb, iEpb->sig.top );
@@ -766,6 +797,10 @@ static BOOL getEpbData( com_capInf_t *oCapInf, com_sigInf_t *iEpb )
     if( !SETSIGNAL( &(oCapInf->signal), epb->pktData, epb->orgPktLen ) ) {
         return false;
     }
+    // if_tsresolは見ずにデフォルトのマイクロ秒単位として扱う
+    uint64_t  usec = ((uint64_t)epb->tStamp_h << 32) + epb->tStamp_l;
+    oCapInf->stamp = (struct timeval){ (time_t)(usec / USEC_UNIT),
+                                       (suseconds_t)(usec % USEC_UNIT) };
     oCapInf->signal.sig.ptype = oCapInf->ifs.stack[epb->ifID].sig.ptype;
     return true;
 }
@@ -813,12 +848,23 @@ static void procOrderPktHdr( com_pcapPkthdr_t *ioPktHdr, BOOL iOrder )
     convertOrder32( &(ioPktHdr->len), iOrder );
 }
 
+static void getLibpcapStamp(
+        com_capInf_t *oCapInf, com_pcapPkthdr_t *iPktHdr, BOOL iOrder )
+{
+    uint32_t  ts[2];   // 秒とマイクロ秒の順で格納されている
+    memcpy( ts, iPktHdr->ts, sizeof(ts) );
+    convertOrder32( &ts[0], iOrder );
+    convertOrder32( &ts[1], iOrder );
+    oCapInf->stamp = (struct timeval){ (time_t)ts[0], (suseconds_t)ts[1] };
+}
+
 static BOOL getLibpcap( com_capInf_t *oCapInf )
 {
     static com_bin  buf[sizeof(com_pcapPkthdr_t)];
     if( !readCapture( oCapInf, buf, sizeof(buf) ) ) {return false;}
     COM_CAST_HEAD( com_pcapPkthdr_t, pkthdr, buf );
     procOrderPktHdr( pkthdr, oCapInf->head.order );
+    getLibpcapStamp( oCapInf, pkthdr, oCapInf->head.order );
     if( !addSignalData( oCapInf, pkthdr->capLen ) ) {
         CAUSEIS( COM_CAPERR_GETSIGNAL, COM_ERR_INCORRECT, "signal data NG" );
     }
@@ -877,6 +923,7 @@ BOOL com_readCapFile( const char *iPath, com_capInf_t *oCapInf )
     }
     com_freeSigInf( &(oCapInf->signal), true );
     if( !getSignal( oCapInf ) ) {READEND(false);}
+    com_setSignalTime( &oCapInf->stamp );
     debugSignal( oCapInf );
     READEND(true);
 }
@@ -1036,6 +1083,7 @@ BOOL com_readCapLog( const char *iPath, com_capInf_t *oCapInf, BOOL iOrder )
         if( !getSignalText( oCapInf ) ) {READEND(false);}
     }
     oCapInf->signal.order = iOrder;
+    com_setSignalTime( NULL );
     debugSignal( oCapInf );
     oCapInf->hasRas = false;  // 次回検索に備えて、ここでリセット
     READEND( true );
@@ -1053,6 +1101,7 @@ static BOOL judgeSeek( BOOL iResult, com_seekCapInf_t *oInf )
             else {
                 com_sigInf_t*  sig = &(oInf->capInf.signal);
                 sig->order = oInf->order;
+                com_setSignalTime( NULL );
                 debugSignal( &oInf->capInf );
                 if( oInf->notify ) {iResult = (oInf->notify)( sig );}
             }
@@ -1076,6 +1125,27 @@ BOOL com_seekCapLog( com_seekFileResult_t *iInf )
 
 
 
+// 信号時刻 //////////////////////////////////////////////////////////////////
+
+static BOOL  gSetSignalTime = false;
+static struct timeval  gSignalTime;
+
+void com_setSignalTime( const struct timeval *iTime )
+{
+    gSetSignalTime = (iTime != NULL);
+    if( iTime ) {gSignalTime = *iTime;}
+}
+
+BOOL com_getSignalTime( struct timeval *oTime )
+{
+    if( COM_UNLIKELY(!oTime) ) {COM_PRMNG(false);}
+    if( !gSetSignalTime ) {*oTime = (struct timeval){ 0, 0 };}
+    else {*oTime = gSignalTime;}
+    return gSetSignalTime;
+}
+
+
+
 // デバッグ関連 //////////////////////////////////////////////////////////////
 
 static BOOL  gDebugSignal = false;
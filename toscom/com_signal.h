@@ -326,6 +326,7 @@ typedef struct {
     void*               ext;         // 追加情報
     long                cnt;         // 収集済みセグメント数
     com_sigSeg_t*       inf;         // 収集したセグメント情報
+    long                capa;        // infの容量
 } com_sigFrg_t;
 
 // 信号パラメータデータ構造
@@ -342,6 +343,7 @@ typedef struct {
     long                cnt;         // 解析分解したパラメータ数
     com_sigTlv_t*       list;        // 解析分解したパラメータ
     void*               spec;        // プロトコル固有情報
+    long                capa;        // listの容量
 } com_sigPrm_t;
 
 // 信号スタックデータ構造
@@ -349,6 +351,7 @@ struct com_sig_t;    // 実体定義はこの後(com_sigStk_t内で使うため
 typedef struct {
     long                cnt;         // 信号個数
     struct com_sig_t*   stack;       // 信号スタック情報
+    long                capa;        // stackの容量
 } com_sigStk_t;
 
 // 信号情報データ構造 (com_sigInf_t = struct com_sig_t)
@@ -879,10 +882,12 @@ typedef struct {
     ulong           cause;       // 処理結果
     char*           fileName;    // 読込中ファイル名
     FILE*           fp;          // 読込中ファイルポインタ
+    void*           readBuf;     // 読込用ストリームバッファ
     com_sigInf_t    head;        // ファイルヘッダ
     com_sigStk_t    ifs;         // I/F情報
     com_sigInf_t    signal;      // 信号全体
     BOOL            hasRas;      // Reassembledデータ読込有無
+    struct timeval  stamp;       // 信号のキャプチャ時刻
 } com_capInf_t;
 
 // 処理結果(NG要因)  (com_capInf_tの .causeに設定)
@@ -1129,6 +1134,9 @@ typedef struct {
  *               iPathを NULL指定して継続読込した場合、一度内容を解放して
  *               新たにメモリ確保を実施する。
  *   .hasRas     falseを固定設定。
+ *   .stamp      取得したパケットのキャプチャ時刻を設定。(true返送時)
+ *               同じ時刻を com_setSignalTime()で信号時刻としても設定する。
+ *               pcapng形式の時刻分解能はデフォルト(マイクロ秒)と想定する。
  */
 BOOL com_readCapFile( const char *iPath, com_capInf_t *oCapInf );
 
@@ -1197,6 +1205,8 @@ BOOL com_readCapFile( const char *iPath, com_capInf_t *oCapInf );
  *               その内容を格納する。解析I/Fは必要があればこちらを自動使用する。
  *               取得NG時は falseを返す(.cause=COM_CAPERR_GETSIGNAL)
  *   .hasRas     [差分あり] .signal.ras にデータ格納があったら trueを設定。
+ *   .stamp      [差分あり] テキストに時刻は無いため何も設定しない。
+ *               信号時刻も com_setSignalTime( NULL )で未設定状態にする。
  */
 BOOL com_readCapLog( const char *iPath, com_capInf_t *oCapInf, BOOL iOrder );
 
@@ -1302,6 +1312,30 @@ typedef struct {
 
 BOOL com_seekCapLog( com_seekFileResult_t *ioInf );
 
+/*
+ * 信号時刻設定/取得  com_setSignalTime()・com_getSignalTime()
+ *   com_getSignalTime()は信号時刻の設定有無を true/false で返す。
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG: [com_prmNG] !oTime (com_getSignalTime()のみ)
+ * ===========================================================================
+ *   マルチスレッドで動作することは想定していない。
+ * ===========================================================================
+ * 現在解析中の信号がキャプチャされた時刻(信号時刻)を設定/取得する。
+ * 信号時刻はフラグメントの保持期限判定など、信号をまたいだ時間計測で使う。
+ * 実時間ではなく信号時刻を使うことで、キャプチャの読込速度に関係なく
+ * 元の通信の時間経過で判定が可能となる。
+ *
+ * com_readCapFile()は信号を読み込むたびに、その時刻を本I/Fで設定する。
+ * 独自に信号を読み込んで解析する場合で、時刻が分かるなら、解析I/Fを呼ぶ前に
+ * com_setSignalTime()で設定すると良い。iTimeを NULLにすると未設定状態に戻る。
+ *
+ * com_getSignalTime()は設定された信号時刻を *oTimeに格納して trueを返す。
+ * 未設定状態の場合は *oTimeを 0クリアして falseを返す。
+ * (テキストログ読込時など、時刻が不明な場合がこれに該当する)
+ */
+void com_setSignalTime( const struct timeval *iTime );
+BOOL com_getSignalTime( struct timeval *oTime );
+
 
 
 /*
@@ -13,6 +13,349 @@
 #include "com_signal.h"
 
 
+// デコード出力先 ////////////////////////////////////////////////////////////
+
+// 組み込み出力先(JSON/CSV)の書き込みバッファサイズ
+//   出力中は使い続けるので、ヒュージページ1つ分を大容量領域として捕捉する。
+enum { SINK_BUF_SIZE = COM_LARGE_HUGESIZE };
+
+// 組み込み出力先の管理データ
+typedef struct {
+    FILE*    fp;
+    char*    buf;
+    size_t   used;
+    BOOL     isCsv;
+    BOOL     writeNG;       // 書き込み失敗 (com_closeDecodeSink()で通知)
+    BOOL     layerOpen;     // JSON: レイヤー出力中
+    BOOL     firstField;    // JSON: レイヤー内の最初のフィールド
+    long     frameNo;
+    long     layerNo;
+    char     protocol[COM_WORDBUF_SIZE];    // CSV: 出力中のレイヤー
+} sinkFile_t;
+
+static sinkFile_t  gSinkFile;
+static const com_decodeSink_t*  gDecSink = NULL;
+static __thread BOOL  gSinkFrame = false;    // フレームのデコード中
+
+// com_printf()の出力を取り込む行バッファ
+static char  gSinkLine[COM_DATABUF_SIZE];
+static size_t  gSinkLineLen = 0;
+
+// 値を文字列化するバッファ
+static char  gSinkValue[COM_DATABUF_SIZE];
+
+static BOOL isSinkActive( void )
+{
+    return (gDecSink && gSinkFrame);
+}
+
+// 組み込み出力先は com_printf()のフック内からも書き込むので、
+// ここでは com_error()を使わずにエラーを記録するだけにする。
+static void flushSinkFile( sinkFile_t *ioSink )
+{
+    if( !ioSink->used ) {return;}
+    if( ioSink->used != fwrite( ioSink->buf, 1, ioSink->used, ioSink->fp ) ) {
+        ioSink->writeNG = true;
+    }
+    ioSink->used = 0;
+}
+
+static void putSink( sinkFile_t *ioSink, const char *iText, size_t iLen )
+{
+    if( ioSink->used + iLen > SINK_BUF_SIZE ) {
+        flushSinkFile( ioSink );
+        if( iLen > SINK_BUF_SIZE ) {
+            if( iLen != fwrite( iText, 1, iLen, ioSink->fp ) ) {
+                ioSink->writeNG = true;
+            }
+            return;
+        }
+    }
+    memcpy( ioSink->buf + ioSink->used, iText, iLen );
+    ioSink->used += iLen;
+}
+
+#define PUTSINK( SINK, TEXT )  putSink( (SINK), (TEXT), strlen(TEXT) )
+
+static void putSinkf( sinkFile_t *ioSink, const char *iFormat, ... )
+{
+    char  buf[COM_LINEBUF_SIZE] = {0};
+    COM_SET_FORMAT( buf );
+    PUTSINK( ioSink, buf );
+}
+
+// JSON文字列として出力 (", \ と制御文字はエスケープ)
+static void putJsonString( sinkFile_t *ioSink, const char *iText )
+{
+    PUTSINK( ioSink, "\"" );
+    const char*  top = iText;
+    for( ;  *iText;  iText++ ) {
+        uchar  c = (uchar)*iText;
+        if( c >= ' ' && c != '"' && c != '\\' ) {continue;}
+        putSink( ioSink, top, (size_t)(iText - top) );
+        if( c == '"' || c == '\\' ) {putSinkf( ioSink, "\\%c", c );}
+        else {putSinkf( ioSink, "\\u%04x", c );}
+        top = iText + 1;
+    }
+    putSink( ioSink, top, (size_t)(iText - top) );
+    PUTSINK( ioSink, "\"" );
+}
+
+// CSVの値として出力 (, " 改行を含む場合のみ "で囲む)
+static void putCsvString( sinkFile_t *ioSink, const char *iText )
+{
+    if( !strpbrk( iText, ",\"\r\n" ) ) {PUTSINK( ioSink, iText );  return;}
+    PUTSINK( ioSink, "\"" );
+    for( const char* quote = NULL;  (quote = strchr( iText, '"' ));  ) {
+        putSink( ioSink, iText, (size_t)(quote - iText) + 1 );
+        PUTSINK( ioSink, "\"" );
+        iText = quote + 1;
+    }
+    PUTSINK( ioSink, iText );
+    PUTSINK( ioSink, "\"" );
+}
+
+static void putCsvRow(
+        sinkFile_t *ioSink, const char *iName, const char *iValue )
+{
+    putSinkf( ioSink, "%ld,%ld,", ioSink->frameNo, ioSink->layerNo );
+    putCsvString( ioSink, ioSink->protocol );
+    PUTSINK( ioSink, "," );
+    putCsvString( ioSink, iName );
+    PUTSINK( ioSink, "," );
+    putCsvString( ioSink, iValue );
+    PUTSINK( ioSink, "\n" );
+}
+
+static void closeJsonLayer( sinkFile_t *ioSink )
+{
+    if( ioSink->layerOpen ) {PUTSINK( ioSink, "]}" );}
+    ioSink->layerOpen = false;
+}
+
+static void sinkFileFrame( BOOL iBegin, void *ioUser )
+{
+    sinkFile_t*  sink = ioUser;
+    if( iBegin ) {
+        sink->frameNo++;
+        sink->layerNo = 0;
+        *sink->protocol = '\0';
+        if( !sink->isCsv ) {
+            putSinkf( sink, "{\"frame\":%ld,\"layers\":[", sink->frameNo );
+        }
+        return;
+    }
+    if( sink->isCsv ) {return;}
+    closeJsonLayer( sink );
+    PUTSINK( sink, "]}\n" );
+}
+
+static void sinkFileLayer(
+        const char *iName, long iType, com_off iLen, void *ioUser )
+{
+    sinkFile_t*  sink = ioUser;
+    sink->layerNo++;
+    (void)com_strcpy( sink->protocol, iName );
+    if( sink->isCsv ) {
+        char  len[COM_WORDBUF_SIZE];
+        snprintf( len, sizeof(len), "%zu", iLen );
+        putCsvRow( sink, "length", len );
+        return;
+    }
+    if( sink->layerOpen ) {PUTSINK( sink, "]}," );}
+    PUTSINK( sink, "{\"protocol\":" );
+    putJsonString( sink, iName );
+    putSinkf( sink, ",\"type\":%ld,\"length\":%zu,\"fields\":[", iType, iLen );
+    sink->layerOpen = true;
+    sink->firstField = true;
+}
+
+static void sinkFileField(
+        const char *iName, const char *iValue, BOOL iNumber, void *ioUser )
+{
+    sinkFile_t*  sink = ioUser;
+    if( sink->isCsv ) {putCsvRow( sink, iName, iValue );  return;}
+    // 最初のプロトコルより前の出力は名前なしのレイヤーに入れる
+    if( !sink->layerOpen ) {sinkFileLayer( "", COM_NO_PTYPE, 0, sink );}
+    if( !sink->firstField ) {PUTSINK( sink, "," );}
+    sink->firstField = false;
+    PUTSINK( sink, "[" );
+    putJsonString( sink, iName );
+    PUTSINK( sink, "," );
+    if( iNumber ) {PUTSINK( sink, iValue );}
+    else {putJsonString( sink, iValue );}
+    PUTSINK( sink, "]" );
+}
+
+static const com_decodeSink_t  gSinkFileFunc = {
+    sinkFileFrame, sinkFileLayer, sinkFileField, &gSinkFile
+};
+
+static void closeSinkFile( void )
+{
+    sinkFile_t*  sink = &gSinkFile;
+    if( !sink->fp ) {return;}
+    flushSinkFile( sink );
+    if( sink->writeNG ) {
+        com_error( COM_ERR_FILEDIRNG, "fail to write decode output" );
+    }
+    if( sink->fp != stdout ) {(void)com_fclose( sink->fp );}
+    com_freeLarge( sink->buf );
+    memset( sink, 0, sizeof(*sink) );
+}
+
+void com_setDecodeSink( const com_decodeSink_t *iSink )
+{
+    closeSinkFile();
+    gDecSink = iSink;
+}
+
+void com_closeDecodeSink( void )
+{
+    com_setDecodeSink( NULL );
+}
+
+BOOL com_openDecodeSink( COM_DECSINK_t iType, const char *iPath )
+{
+    if( COM_UNLIKELY(iType < COM_DECSINK_TEXT || iType > COM_DECSINK_CSV) ) {
+        COM_PRMNG(false);
+    }
+    com_closeDecodeSink();
+    if( iType == COM_DECSINK_TEXT ) {return true;}
+    sinkFile_t*  sink = &gSinkFile;
+    sink->buf = com_allocLarge( SINK_BUF_SIZE, true, COM_LARGE_LOCALNODE,
+                                "decode sink buffer" );
+    if( !sink->buf ) {return false;}
+    sink->fp = stdout;
+    if( iPath ) {sink->fp = com_fopen( iPath, "w" );}
+    if( !sink->fp ) {com_freeLarge( sink->buf );  return false;}
+    sink->isCsv = (iType == COM_DECSINK_CSV);
+    if( sink->isCsv ) {PUTSINK( sink, "frame,layer,protocol,name,value\n" );}
+    gDecSink = &gSinkFileFunc;
+    return true;
+}
+
+// 前後の空白と行頭の # を除いた範囲を返す
+static char *trimSinkText( char *ioText )
+{
+    while( *ioText == '#' || *ioText == ' ' ) {ioText++;}
+    char*  tail = ioText + strlen( ioText );
+    while( tail > ioText && isspace( (uchar)tail[-1] ) ) {*(--tail) = '\0';}
+    return ioText;
+}
+
+static void sinkField( const char *iName, const char *iValue, BOOL iNumber )
+{
+    if( !gDecSink->field ) {return;}
+    char  name[COM_LINEBUF_SIZE];
+    (void)com_strcpy( name, iName );
+    gDecSink->field( trimSinkText( name ), iValue, iNumber, gDecSink->user );
+}
+
+static void sinkLayer( const char *iName, long iType, com_off iLen )
+{
+    if( !gDecSink->layer ) {return;}
+    char  label[COM_WORDBUF_SIZE];
+    (void)com_strcpy( label, iName );
+    gDecSink->layer( trimSinkText( label ), iType, iLen, gDecSink->user );
+}
+
+// バイナリ列を gSinkValueに文字列化する (収まらない分は省略)
+static char *formatSinkBin(
+        const com_bin *iTop, com_off iLen, const char *iSep, BOOL iHex )
+{
+    size_t  used = 0;
+    *gSinkValue = '\0';
+    for( com_off i = 0;  i < iLen;  i++ ) {
+        if( used + COM_WORDBUF_SIZE > sizeof(gSinkValue) ) {
+            (void)com_strcat( gSinkValue, "..." );
+            break;
+        }
+        char*  ptr = gSinkValue + used;
+        size_t  rest = sizeof(gSinkValue) - used;
+        const char*  sep = (i != iLen - 1) ? iSep : "";
+        int  ret;
+        if( iHex ) {ret = snprintf( ptr, rest, "%02x%s", iTop[i], sep );}
+        else {ret = snprintf( ptr, rest, "%d%s", iTop[i], sep );}
+        used += (size_t)ret;
+    }
+    return gSinkValue;
+}
+
+static void sinkNumber( const char *iName, long iValue )
+{
+    char  buf[COM_WORDBUF_SIZE];
+    snprintf( buf, sizeof(buf), "%ld", iValue );
+    sinkField( iName, buf, true );
+}
+
+// "名前 [種別]  <length=長さ>" の行はプロトコルのデコード開始とみなす
+static BOOL sinkLayerLine( char *ioLine )
+{
+    char*  code = strstr( ioLine, " [" );
+    if( !code ) {return false;}
+    long  type = 0;
+    com_off  len = 0;
+    // <length=>は省略されていることもある
+    if( 1 > sscanf( code, " [%ld]  <length=%zu>", &type, &len ) ) {
+        return false;
+    }
+    *code = '\0';
+    sinkLayer( ioLine, type, len );
+    return true;
+}
+
+// デコード出力の1行を "名前 = 値" なら名前と値に分けて渡す
+static void sinkTextLine( char *ioLine )
+{
+    char*  line = trimSinkText( ioLine );
+    if( !*line ) {return;}
+    if( sinkLayerLine( line ) ) {return;}
+    char*  sep = strstr( line, " = " );
+    if( !sep ) {sinkField( "text", line, false );  return;}
+    *sep = '\0';
+    sinkField( trimSinkText( line ), trimSinkText( sep + 3 ), false );
+}
+
+static void flushSinkLine( void )
+{
+    if( !gSinkLineLen ) {return;}
+    gSinkLine[gSinkLineLen] = '\0';
+    sinkTextLine( gSinkLine );
+    gSinkLineLen = 0;
+}
+
+static void hookSinkText( const char *iText, void *ioUserData )
+{
+    COM_UNUSED( ioUserData );
+    for( ;  *iText;  iText++ ) {
+        if( *iText == '\n' ) {flushSinkLine();  continue;}
+        if( gSinkLineLen < sizeof(gSinkLine) - 1 ) {
+            gSinkLine[gSinkLineLen++] = *iText;
+        }
+    }
+}
+
+static BOOL beginSinkFrame( void )
+{
+    if( !gDecSink ) {return false;}
+    gSinkFrame = true;
+    gSinkLineLen = 0;
+    com_hookPrint( hookSinkText, NULL );
+    if( gDecSink->frame ) {gDecSink->frame( true, gDecSink->user );}
+    return true;
+}
+
+static void endSinkFrame( void )
+{
+    flushSinkLine();
+    com_hookPrint( NULL, NULL );
+    if( gDecSink->frame ) {gDecSink->frame( false, gDecSink->user );}
+    gSinkFrame = false;
+}
+
+
+
 // 信号解析起点 //////////////////////////////////////////////////////////////
 
 BOOL com_analyzeSignal( COM_ANALYZER_PRM )
@@ -55,7 +398,10 @@ static BOOL analyzeStacks( com_sigStk_t *iStack, BOOL iDecode )
 
 BOOL com_analyzeSignalToLast( COM_ANALYZER_PRM )
 {
-    return analyzeStacks( &(com_sigStk_t){ 1, ioHead }, iDecode );
+    BOOL  useSink = (iDecode && beginSinkFrame());
+    BOOL  result = analyzeStacks( &(com_sigStk_t){ 1, ioHead, 0 }, iDecode );
+    if( useSink ) {endSinkFrame();}
+    return result;
 }
 
 static BOOL failRollback(
@@ -287,8 +633,9 @@ static com_sigInf_t *getStack( com_sigStk_t *oNext )
     com_sigInf_t*  tmp = oNext->stack;
     size_t  sizeSig = sizeof(com_sigInf_t);
     if( tmp ) {
-        tmp = com_reallocAddr( &oNext->stack, sizeSig, COM_TABLEEND,
-                               count, 1, "add next[%ld]", *count );
+        tmp = com_reallocAddrCap( &oNext->stack, sizeSig, COM_TABLEEND,
+                                  count, &oNext->capa, 1,
+                                  "add next[%ld]", *count );
         if( COM_UNLIKELY(!tmp) ) {return NULL;}
     }
     else {
@@ -297,6 +644,7 @@ static com_sigInf_t *getStack( com_sigStk_t *oNext )
                           "get next[%ld]", *count + 1 );
         if( COM_UNLIKELY(!tmp) ) {return NULL;}
         oNext->stack = tmp;
+        oNext->capa = *count;
     }
     return tmp;
 }
@@ -407,8 +755,9 @@ static com_sigInf_t *stackSigInf(
         com_sigInf_t *iSource )
 {
     com_sigInf_t*  newStack =
-        com_reallocAddr( &(oTarget->stack), sizeof(*iSource), COM_TABLEEND,
-                         &(oTarget->cnt), 1, "%s[%ld]", iLabel, oTarget->cnt );
+        com_reallocAddrCap( &(oTarget->stack), sizeof(*iSource), COM_TABLEEND,
+                            &(oTarget->cnt), &(oTarget->capa), 1,
+                            "%s[%ld]", iLabel, oTarget->cnt );
     if( COM_UNLIKELY(!newStack) ) {return NULL;}
     *newStack = *iSource;
     newStack->prev = iHead;
@@ -445,8 +794,9 @@ BOOL com_addPrmTlv( com_sigPrm_t *oTarget, com_sigTlv_t *oPrm )
 {
     if( COM_UNLIKELY(!oTarget || !oPrm) ) {COM_PRMNG(false);}
     com_sigTlv_t*  newTlv =
-        com_reallocAddr( &oTarget->list, sizeof(*oTarget->list), COM_TABLEEND,
-                         &oTarget->cnt, 1, "add prm[%ld]", oTarget->cnt );
+        com_reallocAddrCap( &oTarget->list, sizeof(*oTarget->list),
+                            COM_TABLEEND, &oTarget->cnt, &oTarget->capa, 1,
+                            "add prm[%ld]", oTarget->cnt );
     if( COM_UNLIKELY(!newTlv) ) {return false;}
     *newTlv = *oPrm;
     return true;
@@ -1201,6 +1551,7 @@ void com_dispDec( const char *iFormat, ... )
 {
     char  buf[COM_TERMBUF_SIZE] = {0};
     COM_SET_FORMAT( buf );
+    if( isSinkActive() ) {sinkTextLine( buf );  return;}
     com_printf( "#%s\n", buf );
 }
 
@@ -1209,6 +1560,11 @@ void com_dispDec( const char *iFormat, ... )
 void com_dispSig( const char *iName, long iCode, const com_sigBin_t *iSig )
 {
     if( COM_UNLIKELY(!iSig->top || !iSig->len) ) {return;}
+    if( isSinkActive() ) {
+        if( iCode > COM_NO_PTYPE ) {sinkLayer( iName, iCode, iSig->len );}
+        else {sinkNumber( iName, (long)iSig->len );}
+        return;
+    }
     if( iCode > COM_NO_PTYPE ) {
         com_dispDec( " %s[%ld]  <length=%zu>", iName, iCode, iSig->len );
     }
@@ -1227,6 +1583,7 @@ static void dispName( const char *iName )
 
 void com_dispVal( const char *iName, ulong iValue )
 {
+    if( isSinkActive() ) {sinkNumber( iName, (long)iValue );  return;}
     dispName( iName );
     com_printf( "%ld\n", iValue );
 }
@@ -1249,8 +1606,21 @@ static ulong dispValue( const void *iValue, com_off iSize )
     return result;
 }
 
+static ulong sinkPrm( const char *iName, const void *iValue, com_off iSize )
+{
+    if( !iSize ) {sinkField( iName, iValue, false );  return 0;}
+    if( iSize <= COM_32BIT_SIZE ) {
+        ulong  result = com_calcValue( iValue, iSize );
+        sinkNumber( iName, (long)result );
+        return result;
+    }
+    sinkField( iName, formatSinkBin( iValue, iSize, " ", true ), false );
+    return 0;
+}
+
 ulong com_dispPrm( const char *iName, const void *iValue, com_off iSize )
 {
+    if( isSinkActive() ) {return sinkPrm( iName, iValue, iSize );}
     dispName( iName );
     if( !iSize ) {com_printf( "%s\n", (char*)iValue );  return 0;}
     if( iSize <= COM_32BIT_SIZE ) {return dispValue( iValue, iSize );}
@@ -1262,6 +1632,10 @@ void com_dispBin(
         const char *iName, const void *iTop, com_off iLen,
         const char *iSep, BOOL iHex )
 {
+    if( isSinkActive() ) {
+        sinkField( iName, formatSinkBin( iTop, iLen, iSep, iHex ), false );
+        return;
+    }
     dispName( iName );
     dispBin( iTop, iLen, iSep, iHex );
 }
@@ -1295,10 +1669,25 @@ static void dispPrmListVal( com_off iValue, long iHexSize )
                                  (int)getDecSize( iHexSize ), iValue );
 }
 
+static void sinkPrmList( com_sigPrm_t *iPrm, com_judgeDispPrm_t iFunc )
+{
+    for( long i = 0;  i < iPrm->cnt;  i++ ) {
+        com_sigTlv_t*  tlv = &(iPrm->list[i]);
+        char  name[COM_WORDBUF_SIZE];
+        snprintf( name, sizeof(name), "tag 0x%lx", tlv->tag );
+        const char*  value = "<payload data>";
+        if( !iFunc || iFunc( (com_bin)(tlv->tag) ) ) {
+            value = formatSinkBin( tlv->value, tlv->len, "", true );
+        }
+        sinkField( name, value, false );
+    }
+}
+
 void com_dispPrmList(
         com_sigPrm_t *iPrm, long iTagSize, long iLenSize,
         com_judgeDispPrm_t iFunc )
 {
+    if( isSinkActive() ) {sinkPrmList( iPrm, iFunc );  return;}
     dispColRuler( iTagSize, iLenSize );
     for( long i = 0;  i < iPrm->cnt;  i++ ) {
         com_sigTlv_t*  tlv = &(iPrm->list[i]);
@@ -1316,20 +1705,28 @@ void com_dispPrmList(
     }
 }
 
+static const char *getNextLabel( long iType )
+{
+    if( iType > COM_SIG_UNKNOWN ) {return com_searchSigProtocol( iType );}
+    if( iType == COM_SIG_UNKNOWN ) {return "UNKNOWN";}
+    if( iType == COM_SIG_FRAGMENT ) {return "FRAGMENTED";}
+    if( iType == COM_SIG_END ) {return "ANALYZE END";}
+    if( iType == COM_SIG_EXTENSION ) {return "EXTENSION";}
+    return "NOT SUPPORTED PROTOCOL";
+}
+
 void com_dispNext( ulong iProtocol, size_t iSize, long iType )
 {
+    if( isSinkActive() ) {
+        sinkField( "next protocol", getNextLabel( iType ), false );
+        return;
+    }
     dispName( "next protocol" );
     com_printf( "0x%0*lx(%lu) -> ", (int)iSize * 2, iProtocol, iProtocol );
     if( iType > COM_SIG_UNKNOWN ) {
-        com_printf( "%s [%ld]\n", com_searchSigProtocol( iType ), iType );
-    }
-    else {
-        if( iType == COM_SIG_UNKNOWN ) {com_printf( "UNKNOWN\n" );}
-        else if( iType == COM_SIG_FRAGMENT ) {com_printf( "FRAGMENTED\n" );}
-        else if( iType == COM_SIG_END ) {com_printf( "ANALYZE END\n" );}
-        else if( iType == COM_SIG_EXTENSION ) {com_printf( "EXTENSION\n" );}
-        else {com_printf( "NOT SUPPORTED PROTOCOL\n" );}
+        com_printf( "%s [%ld]\n", getNextLabel( iType ), iType );
     }
+    else {com_printf( "%s\n", getNextLabel( iType ) );}
 }
 
 long com_getSigType( com_sigInf_t *iInf )
@@ -1476,8 +1873,51 @@ void com_dispAsnPrm( const com_sigPrm_t *iPrm, const char *iLabel, long iStart )
 
 // フラグメント処理 //////////////////////////////////////////////////////////
 
+// 管理データは gFrgInf[]の添字で繋ぐ。使用中は古い順の双方向リスト、
+// 未使用は .olderを使った単方向リストとする(添字なので再捕捉の影響は無い)。
+#define FRG_NOLINK  (-1)
+
 static long  gFrgInfCnt = 0;
+static long  gFrgInfCapa = 0;
 static com_sigFrgManage_t*  gFrgInf = NULL;
+static com_hashId_t  gFrgHash = COM_HASHID_NOTREG;
+static long  gFrgOldest = FRG_NOLINK;   // 使用中で最も古い管理データ
+static long  gFrgNewest = FRG_NOLINK;   // 使用中で最も新しい管理データ
+static long  gFrgEmpty  = FRG_NOLINK;   // 未使用の管理データ
+static long  gFrgTimeout = COM_FRG_TIMEOUT;
+static size_t  gFrgMemMax = COM_FRG_MEMMAX;
+static com_sigFrgStat_t  gFrgStat;
+
+enum {
+    FRGHASH_SIZE = 1021,    // ハッシュテーブルサイズ
+    FRGKEY_SIZE  = 96       // ハッシュキー最大サイズ
+};
+
+// ハッシュキーデータ構造 (type・id・送信元/送信先を連結したもの)
+typedef struct {
+    com_bin   key[FRGKEY_SIZE];
+    size_t    size;
+} frgKey_t;
+
+static BOOL makeFrgKey( frgKey_t *oKey, const com_sigFrgCond_t *iCond )
+{
+    ulong  head[] = {
+        iCond->type, iCond->id, (ulong)iCond->src.len, (ulong)iCond->dst.len
+    };
+    oKey->size = sizeof(head) + iCond->src.len + iCond->dst.len;
+    if( COM_UNLIKELY(oKey->size > sizeof(oKey->key)) ) {
+        com_error( COM_ERR_ILLSIZE, "fragment address too long (%zu/%zu)",
+                   iCond->src.len, iCond->dst.len );
+        return false;
+    }
+    com_bin*  ptr = oKey->key;
+    memcpy( ptr, head, sizeof(head) );
+    ptr += sizeof(head);
+    if( iCond->src.len ) {memcpy( ptr, iCond->src.top, iCond->src.len );}
+    ptr += iCond->src.len;
+    if( iCond->dst.len ) {memcpy( ptr, iCond->dst.top, iCond->dst.len );}
+    return true;
+}
 
 void com_freeSigFrgCond( com_sigFrgCond_t *oTarget )
 {
@@ -1486,10 +1926,30 @@ void com_freeSigFrgCond( com_sigFrgCond_t *oTarget )
     com_free( oTarget->dst.top );
 }
 
+static void unlinkFrgInf( long iIdx )
+{
+    com_sigFrgManage_t*  inf = &(gFrgInf[iIdx]);
+    if( inf->older != FRG_NOLINK ) {gFrgInf[inf->older].newer = inf->newer;}
+    else {gFrgOldest = inf->newer;}
+    if( inf->newer != FRG_NOLINK ) {gFrgInf[inf->newer].older = inf->older;}
+    else {gFrgNewest = inf->older;}
+    inf->older = gFrgEmpty;
+    inf->newer = FRG_NOLINK;
+    gFrgEmpty = iIdx;
+}
+
 static void freeFragMng( com_sigFrgManage_t *oTarget )
 {
     if( !oTarget->isUse ) {return;}
+    frgKey_t  key;
+    if( makeFrgKey( &key, &oTarget->cond ) ) {
+        (void)com_deleteHash( gFrgHash, key.key, key.size );
+    }
     oTarget->isUse = false;
+    unlinkFrgInf( oTarget - gFrgInf );
+    gFrgStat.count--;
+    gFrgStat.size -= oTarget->size;
+    oTarget->size = 0;
     com_freeSigFrgCond( &oTarget->cond );
     com_freeSigFrg( &oTarget->data );
 } 
@@ -1505,38 +1965,79 @@ static void freeAllFragInf( void )
 {
     for( long i = 0;  i < gFrgInfCnt;  i++ ) {freeFragMng( &gFrgInf[i] );}
     com_free( gFrgInf );
+    gFrgInfCnt = gFrgInfCapa = 0;
+    if( gFrgHash != COM_HASHID_NOTREG ) {com_cancelHash( gFrgHash );}
 }
 
-static BOOL matchFrgCond(
-        com_sigFrgCond_t *iCond1, const com_sigFrgCond_t *iCond2 )
+com_sigFrgManage_t *com_searchFragment( const com_sigFrgCond_t *iCond )
 {
-    if( iCond1->type != iCond2->type || iCond1->id != iCond2->id ) {
-        return false;
+    if( COM_UNLIKELY(!iCond) ) {COM_PRMNG(NULL);}
+    if( gFrgHash == COM_HASHID_NOTREG ) {return NULL;}
+    frgKey_t  key;
+    if( !makeFrgKey( &key, iCond ) ) {return NULL;}
+    const void*  data = NULL;
+    if( !com_searchHash( gFrgHash, key.key, key.size, &data, NULL ) ) {
+        return NULL;
     }
-    if( !com_matchSigBin( &iCond1->src, &iCond2->src ) ) {return false;}
-    if( !com_matchSigBin( &iCond1->dst, &iCond2->dst ) ) {return false;}
-    return true;
+    long  idx;
+    memcpy( &idx, data, sizeof(idx) );
+    return &(gFrgInf[idx]);
 }
 
-com_sigFrgManage_t *com_searchFragment( const com_sigFrgCond_t *iCond )
+static BOOL isFrgTimeout( com_sigFrgManage_t *iInf )
 {
-    if( COM_UNLIKELY(!iCond) ) {COM_PRMNG(NULL);}
-    for( long i = 0;  i < gFrgInfCnt;  i++ ) {
-        if( !gFrgInf[i].isUse ) {continue;}
-        if( matchFrgCond( &gFrgInf[i].cond, iCond ) ) {return &(gFrgInf[i]);}
+    if( gFrgTimeout <= 0 ) {return false;}
+    struct timeval  now;
+    if( !com_getSignalTime( &now ) ) {return false;}
+    return ( now.tv_sec - iInf->stamp.tv_sec >= gFrgTimeout );
+}
+
+static BOOL isFrgOverflow( size_t iAddSize )
+{
+    if( !gFrgMemMax ) {return false;}
+    return ( gFrgStat.size + iAddSize > gFrgMemMax );
+}
+
+// iKeepで指定した管理データは解放対象にしない
+static void expireFragments( com_sigFrgManage_t *iKeep, size_t iAddSize )
+{
+    while( gFrgOldest != FRG_NOLINK ) {
+        com_sigFrgManage_t*  old = &(gFrgInf[gFrgOldest]);
+        if( old == iKeep ) {break;}
+        if( isFrgTimeout( old ) ) {gFrgStat.timeout++;}
+        else if( isFrgOverflow( iAddSize ) ) {gFrgStat.overflow++;}
+        else {break;}
+        DEBUGSIG( "#  <<expire fragment type=%lu id=%lu cnt=%ld>>\n",
+                  old->cond.type, old->cond.id, old->data.cnt );
+        freeFragMng( old );
     }
-    return NULL;
 }
 
 static com_sigFrgManage_t *getEmptyFrgInf( void )
 {
-    for( long i = 0;  i < gFrgInfCnt;  i++ ) {
-        if( !gFrgInf[i].isUse ) {return &(gFrgInf[i]);}
-    }
-    return NULL;
+    if( gFrgEmpty == FRG_NOLINK ) {return NULL;}
+    com_sigFrgManage_t*  result = &(gFrgInf[gFrgEmpty]);
+    gFrgEmpty = result->older;
+    return result;
+}
+
+static BOOL registerFrgInf(
+        com_sigFrgManage_t *oInf, const com_sigFrgCond_t *iCond )
+{
+    frgKey_t  key;
+    if( !makeFrgKey( &key, iCond ) ) {return false;}
+    long  idx = oInf - gFrgInf;
+    if( COM_HASH_OK != com_addHash( gFrgHash, true, key.key, key.size,
+                                    &idx, sizeof(idx) ) ) {return false;}
+    oInf->older = gFrgNewest;
+    oInf->newer = FRG_NOLINK;
+    if( gFrgNewest != FRG_NOLINK ) {gFrgInf[gFrgNewest].newer = idx;}
+    else {gFrgOldest = idx;}
+    gFrgNewest = idx;
+    return true;
 }
 
-static void initFrgInf(
+static BOOL initFrgInf(
         com_sigFrgManage_t *oInf, const com_sigFrgCond_t *iCond,
         com_sigBin_t *iSrc, com_sigBin_t *iDst )
 {
@@ -1545,11 +2046,22 @@ static void initFrgInf(
     };
     com_copySigBin( &oInf->cond.src, &iCond->src );
     com_copySigBin( &oInf->cond.dst, &iCond->dst );
+    com_initSigFrg( &oInf->data );
+    (void)com_getSignalTime( &oInf->stamp );
+    oInf->size = 0;
+    if( !registerFrgInf( oInf, iCond ) ) {return false;}
     oInf->isUse = true;
+    gFrgStat.count++;
+    return true;
 }
 
-static com_sigFrgManage_t *failGetFrg( com_sigBin_t *iSrc, com_sigBin_t *iDst )
+static com_sigFrgManage_t *failGetFrg(
+        com_sigFrgManage_t *iInf, com_sigBin_t *iSrc, com_sigBin_t *iDst )
 {
+    if( iInf ) {  // 取得した未使用データは空きリストに戻す
+        iInf->older = gFrgEmpty;
+        gFrgEmpty = iInf - gFrgInf;
+    }
     com_free( iSrc->top );
     com_free( iDst->top );
     return NULL;
@@ -1562,22 +2074,37 @@ static void createAddrInf(
     oTarget->top = com_malloc( iSource->len, iLabel );
 }
 
+static com_sigFrgManage_t *addFrgInf( const com_sigFrgCond_t *iCond )
+{
+    com_sigFrgManage_t*  result =
+        com_reallocAddrCap( &gFrgInf, sizeof(*gFrgInf), COM_TABLEEND,
+                            &gFrgInfCnt, &gFrgInfCapa, 1,
+                            "Fragment Inf[%ld] type=%ld id=%ld",
+                            gFrgInfCnt, iCond->type, iCond->id );
+    if( result ) {result->older = result->newer = FRG_NOLINK;}
+    return result;
+}
+
 static com_sigFrgManage_t *getFrgInf( const com_sigFrgCond_t *iCond )
 {
     com_sigFrgManage_t*  result = com_searchFragment( iCond );
     if( result ) {return result;}
+    if( gFrgHash == COM_HASHID_NOTREG ) {
+        gFrgHash = com_registerHash( FRGHASH_SIZE, NULL );
+    }
+    expireFragments( NULL, 0 );
     com_sigBin_t  src, dst;
     createAddrInf( &src, &iCond->src, "Fragment src address" );
     createAddrInf( &dst, &iCond->dst, "Fragment dst address" );
-    if( !src.top || !dst.top ) {return failGetFrg( &src, &dst );}
-    if( !(result = getEmptyFrgInf() ) ) {
-        result = com_reallocAddr( &gFrgInf, sizeof(*gFrgInf),
-                                  COM_TABLEEND, &gFrgInfCnt, 1,
-                                  "Fragment Inf[%ld] type=%ld id=%ld",
-                                  gFrgInfCnt, iCond->type, iCond->id );
-        if( !result ) {return failGetFrg( &src, &dst );}
-    }
-    initFrgInf( result, iCond, &src, &dst );
+    if( !src.top || !dst.top ) {return failGetFrg( NULL, &src, &dst );}
+    if( !(result = getEmptyFrgInf()) ) {
+        if( !(result = addFrgInf( iCond )) ) {
+            return failGetFrg( NULL, &src, &dst );
+        }
+    }
+    if( !initFrgInf( result, iCond, &src, &dst ) ) {
+        return failGetFrg( result, &src, &dst );
+    }
     return result;
 }
 
@@ -1593,18 +2120,33 @@ com_sigFrg_t *com_stockFragments(
     if( COM_UNLIKELY(!iCond || !iFrag) ) {COM_PRMNG(NULL);}
     com_sigFrgManage_t*  mng = getFrgInf( iCond );
     if( !mng ) {return NULL;}
+    expireFragments( mng, iFrag->len );
     com_sigFrg_t*  frg = &(mng->data);
     com_sigSeg_t*  inf =
-        com_reallocAddr( &(frg->inf), sizeof(*frg->inf),
-                         COM_TABLEEND, &(frg->cnt), 1,
-                         "Fragment segment[%ld] type=%ld id=%ld seg=%ld",
-                         frg->cnt, iCond->type, iCond->id, iSeg );
+        com_reallocAddrCap( &(frg->inf), sizeof(*frg->inf),
+                            COM_TABLEEND, &(frg->cnt), &(frg->capa), 1,
+                            "Fragment segment[%ld] type=%ld id=%ld seg=%ld",
+                            frg->cnt, iCond->type, iCond->id, iSeg );
     if( COM_UNLIKELY(!inf) ) {return stockNG( iCond );}
     if( !com_copySigBin( &inf->bin, iFrag ) ) {return stockNG( iCond );}
     inf->seg = iSeg;
+    mng->size += iFrag->len;
+    gFrgStat.size += iFrag->len;
     return frg;
 }
 
+void com_setFragmentLimit( long iTimeout, size_t iMemMax )
+{
+    gFrgTimeout = iTimeout;
+    gFrgMemMax = iMemMax;
+}
+
+void com_getFragmentStat( com_sigFrgStat_t *oStat )
+{
+    if( COM_UNLIKELY(!oStat) ) {COM_PRMNG();}
+    *oStat = gFrgStat;
+}
+
 
 
 // 初期化処理 ////////////////////////////////////////////////////////////////
@@ -1612,6 +2154,7 @@ com_sigFrg_t *com_stockFragments(
 static void finalizeAnalyzer( void )
 {
     COM_DEBUG_AVOID_START( COM_PROC_ALL );
+    com_closeDecodeSink();
     freeAllFragInf();
     COM_DEBUG_AVOID_END( COM_PROC_ALL );
 }
@@ -1497,6 +1497,80 @@ void com_dispBin(
 
 void com_dispNext( ulong iProtocol, size_t iSize, long iType );
 
+/*
+ * デコード出力先設定  com_openDecodeSink()・com_setDecodeSink()
+ *   com_openDecodeSink()は処理成否を true/false で返す。
+ * ---------------------------------------------------------------------------
+ *   com_openDecodeSink():
+ *     COM_ERR_DEBUG: [com_prmNG] iTypeが範囲外
+ *     com_fopen()・com_malloc()によるエラー
+ *   com_closeDecodeSink():
+ *     COM_ERR_FILEDIRNG: 書き込み失敗
+ *     com_fclose()によるエラー
+ * ===========================================================================
+ *   マルチスレッドで動くことは想定していない。
+ * ===========================================================================
+ * com_analyzeSignalToLast()で iDecodeを trueにした時のデコード出力先を
+ * 切り替える。デフォルトは COM_DECSINK_TEXT で、従来通り com_printf()による
+ * テキスト出力となる。
+ *
+ * com_openDecodeSink()で COM_DECSINK_JSON か COM_DECSINK_CSV を指定すると、
+ * デコード結果を iPathのファイルに構造化データとして出力する。iPathが NULLなら
+ * 標準出力に出す。どちらも大きな書き込みバッファに貯めてから書き込むので、
+ * 1行ごとの排他やタイムスタンプ付与・fflush()は発生しない。
+ *   COM_DECSINK_JSON: 1フレームを 1行の JSONとする (JSON Lines)。
+ *     {"frame":1,"layers":[{"protocol":"IPv4 HEADER","type":101,
+ *      "length":20,"fields":[["version",4],...]},...]}
+ *   COM_DECSINK_CSV: 1フィールドを 1行とする。先頭行は見出し。
+ *     frame,layer,protocol,name,value
+ * COM_DECSINK_TEXTを指定すると、設定中の出力先を閉じてテキスト出力に戻る。
+ *
+ * com_setDecodeSink()では出力処理を iSinkで独自に指定できる。iSinkの内容は
+ * コピーせずにアドレスを保持するので、静的変数などで用意すること。
+ * NULLを指定するとテキスト出力に戻る。
+ *   .frame   フレームのデコード開始時に iBegin=true、終了時に falseで呼ばれる。
+ *   .layer   プロトコルのデコード開始時に呼ばれる。
+ *            iNameはプロトコルのラベル、iTypeは COM_SIG_～ の値、
+ *            iLenはその信号長となる。
+ *   .field   デコードした値ごとに呼ばれる。iValueは文字列化した値で、
+ *            iNumberが trueなら 10進数値の文字列となる。
+ *   .user    各関数に ioUserとしてそのまま渡される。
+ *
+ * デコード出力は com_dispDec()など「デコード用共通出力I/F」を経由して
+ * 出力先に渡す。デコーダーが直接 com_printf()で出力した行も com_hookPrint()で
+ * 取り込み、"名前 = 値" の形なら名前と値、それ以外は "text" という名前の値と
+ * して渡す。ただし、これはフレームのデコード中のスレッドに限られる。
+ *
+ * com_closeDecodeSink()は出力を書き出してファイルを閉じ、テキスト出力に戻す。
+ * プログラム終了時にも自動で実行される。
+ */
+typedef enum {
+    COM_DECSINK_TEXT = 0,    // テキスト出力 (com_printf)
+    COM_DECSINK_JSON,        // JSON Lines
+    COM_DECSINK_CSV          // CSV
+} COM_DECSINK_t;
+
+BOOL com_openDecodeSink( COM_DECSINK_t iType, const char *iPath );
+
+// デコード出力先 関数プロトタイプ
+typedef void(*com_decSinkFrame_t)( BOOL iBegin, void *ioUser );
+typedef void(*com_decSinkLayer_t)(
+        const char *iName, long iType, com_off iLen, void *ioUser );
+typedef void(*com_decSinkField_t)(
+        const char *iName, const char *iValue, BOOL iNumber, void *ioUser );
+
+// デコード出力先 データ構造
+typedef struct {
+    com_decSinkFrame_t   frame;
+    com_decSinkLayer_t   layer;
+    com_decSinkField_t   field;
+    void*                user;
+} com_decodeSink_t;
+
+void com_setDecodeSink( const com_decodeSink_t *iSink );
+
+void com_closeDecodeSink( void );
+
 /*
  * フラグメント判定付き種別取得  com_getSigType()
  *   フラグメントデータではない場合(iInf->isFragmentが false)、
@@ -1626,6 +1700,11 @@ void com_dispAsnPrm(
  * 保持した分割データの取得は com_searchFragment()で行う。
  *
  * 結合が終わったら、com_freeFragments()で保持したデータをメモリ解放すること。
+ *
+ * 分割データは分割条件データをキーにしたハッシュテーブルで管理しているため、
+ * 保持中の分割データが多数あっても検索コストはほぼ一定となる。
+ * また最後まで揃わない分割データが溜まり続けないように、保持期限と
+ * 総サイズ上限を設けている。詳細は com_setFragmentLimit()を参照。
  */
 
 // フラグメント処理結果
@@ -1723,6 +1802,11 @@ typedef struct {
     ulong              isUse;
     com_sigFrgCond_t   cond;
     com_sigFrg_t       data;
+    // 以下は内部管理用 (参照は問題ないが変更はしないこと)
+    struct timeval     stamp;    // 最初の分割データ保持時の信号時刻
+    com_off            size;     // 保持している分割データの総サイズ
+    long               older;    // 一つ古い管理データ(未使用時は次の空き)
+    long               newer;    // 一つ新しい管理データ
 } com_sigFrgManage_t;
 
 com_sigFrgManage_t *com_searchFragment( const com_sigFrgCond_t *iCond );
@@ -1743,6 +1827,55 @@ com_sigFrgManage_t *com_searchFragment( const com_sigFrgCond_t *iCond );
  */
 void com_freeFragments( const com_sigFrgCond_t *iCond );
 
+/*
+ * 分割データ保持制限設定  com_setFragmentLimit()
+ * ---------------------------------------------------------------------------
+ *   エラーは発生しない。
+ * ===========================================================================
+ *   マルチスレッドで動作することは想定していない。
+ * ===========================================================================
+ * com_stockFragments()で保持する分割データの保持期限と総サイズ上限を設定する。
+ * キャプチャの欠落などで最後まで揃わない分割データは、そのままだと解放されずに
+ * 残り続けるため、以下の条件で古いものから自動解放する。
+ *
+ * iTimeoutは保持期限(秒)で、最初の分割データを保持した時の信号時刻から
+ * この時間を経過したら解放する。0以下を指定すると保持期限での解放はしない。
+ * 信号時刻は com_getSignalTime()で取得する値を使用するため、信号時刻が
+ * 未設定の場合(テキストログ読込時など)は保持期限での解放はしない。
+ * デフォルトは COM_FRG_TIMEOUT で、RFC8200(IPv6)が規定する 60秒としている。
+ * (RFC791(IPv4)は具体値を規定せず、RFC1122で 60～120秒が推奨されている)
+ *
+ * iMemMaxは保持する分割データの総サイズ上限(byte)で、これを超えそうな時は
+ * 古い分割データから解放して空きを作る。0を指定すると上限無しとなる。
+ * デフォルトは COM_FRG_MEMMAX とする。
+ *
+ * 解放した分割データの数は com_getFragmentStat()で確認できる。
+ */
+#define COM_FRG_TIMEOUT   60                  // 分割データ保持期限(秒)
+#define COM_FRG_MEMMAX   (4 * 1024 * 1024)    // 分割データ総サイズ上限
+
+void com_setFragmentLimit( long iTimeout, size_t iMemMax );
+
+/*
+ * 分割データ保持状況取得  com_getFragmentStat()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUGNG: [com_prmNG] !oStat
+ * ===========================================================================
+ *   マルチスレッドで動作することは想定していない。
+ * ===========================================================================
+ * 現在の分割データの保持状況と、自動解放した数を *oStatに格納する。
+ */
+
+// 分割データ保持状況データ構造
+typedef struct {
+    long      count;       // 保持中の分割条件数
+    com_off   size;        // 保持中の分割データ総サイズ
+    ulong     timeout;     // 保持期限超過で解放した数
+    ulong     overflow;    // 総サイズ上限超過で解放した数
+} com_sigFrgStat_t;
+
+void com_getFragmentStat( com_sigFrgStat_t *oStat );
+
 
 
 
@@ -294,10 +294,11 @@ static COM_SIG_FRG_t procIpv4Fragment(
     getIpv4Fragment( &ipBody, ioHead, iIpv4 );
     com_sigFrgCond_t  cond;
     setIpv4FragCond( &cond, iIpv4 );
+    // 分割されていない信号は蓄積せずに済ませる (同じIDの残骸は解放する)
+    if( !mf && !fragOff ) {com_freeFragments( &cond );  return COM_FRG_OK;}
     com_sigFrg_t*  frg = com_stockFragments( &cond, fragOff, &ipBody );
     if( COM_UNLIKELY(!frg) ) {return COM_FRG_ERROR;}
     if( !mf ) {
-        if( !fragOff ) {com_freeFragments( &cond );  return COM_FRG_OK;}
         if( existRas( ioHead,oRas,&cond,COM_SIG_IPV4 ) ) {return COM_FRG_REASM;}
         frg->segMax = fragOff + (size_t)com_getVal16( iIpv4->ip_len, COM_ORDER )
                       - IPV4_HDRSIZE( iIpv4 );
@@ -1364,6 +1365,266 @@ static BOOL getChunkHead(
                            &(com_sigBin_t){ iTop, *oChunkLen, COM_SIG_SCTP } );
 }
 
+///// SCTP TSN監視 /////
+//
+// 方向(アドレス/ポート + Verification Tag)ごとに 最大TSNと、それ以前の
+// SCTP_TSNWIN_BITS個分の受信有無をビット列で保持し、既に見た TSNの DATA chunkを
+// 再送と判断する。監視する方向は SCTP_DIR_MAXまでとし、メモリ使用量を抑える。
+
+enum {
+    SCTP_DIR_MAX = 4096,         // TSN監視する方向の最大数
+    SCTP_DIR_BLOCK = 64,         // TSN監視テーブル拡張単位
+    SCTP_DIRHASH_SIZE = 1021,    // TSN監視テーブル検索用ハッシュサイズ
+    SCTP_TSNWIN_WORD = 2,
+    SCTP_TSNWIN_BITS = 128       // = SCTP_TSNWIN_WORD * ulongのビット数
+};
+
+enum { ULONG_BITS = sizeof(ulong) * 8 };
+
+typedef struct {
+    com_nodeInf_t  node;
+    ulong          vtag;      // Verification Tag
+} sctpDirKey_t;
+
+typedef struct {
+    ulong   maxTsn;                      // 受信した最大TSN
+    ulong   window[SCTP_TSNWIN_WORD];    // bit i: maxTsn - i を受信済み
+} sctpTsnInf_t;
+
+static sctpTsnInf_t*  gSctpTsn = NULL;
+static long  gSctpTsnCnt = 0;     // 使用中の監視数
+static long  gSctpTsnMax = 0;     // 確保済みの監視数
+static com_hashId_t  gHashSctp = COM_HASHID_NOTREG;
+static com_sigSctpStat_t  gSctpStat;
+
+static void freeSctpInf( void )
+{
+    com_free( gSctpTsn );
+    gSctpTsnCnt = gSctpTsnMax = 0;
+    if( gHashSctp == COM_HASHID_NOTREG ) {return;}
+    com_cancelHash( gHashSctp );
+    gHashSctp = COM_HASHID_NOTREG;
+}
+
+void com_getSctpStat( com_sigSctpStat_t *oStat, BOOL iClear )
+{
+    if( COM_UNLIKELY(!oStat) ) {COM_PRMNG();}
+    *oStat = gSctpStat;
+    if( iClear ) {memset( &gSctpStat, 0, sizeof(gSctpStat) );}
+}
+
+static sctpTsnInf_t *addSctpTsnInf( sctpDirKey_t *iKey, ulong iTsn )
+{
+    if( gSctpTsnCnt == SCTP_DIR_MAX ) {return NULL;}
+    if( gSctpTsnCnt == gSctpTsnMax ) {
+        if( !com_realloct( &gSctpTsn, sizeof(*gSctpTsn), &gSctpTsnMax,
+                           SCTP_DIR_BLOCK, "sctp tsn inf(%ld)",
+                           gSctpTsnMax ) ) {return NULL;}
+    }
+    long  idx = gSctpTsnCnt;
+    if( COM_HASH_OK != com_addHash( gHashSctp, false, iKey, sizeof(*iKey),
+                                    &idx, sizeof(idx) ) ) {return NULL;}
+    sctpTsnInf_t*  inf = &(gSctpTsn[gSctpTsnCnt++]);
+    *inf = (sctpTsnInf_t){ .maxTsn = iTsn, .window = {1, 0} };
+    return inf;
+}
+
+static sctpTsnInf_t *getSctpTsnInf(
+        com_sigInf_t *iSctp, ulong iTsn, BOOL *oIsNew )
+{
+    sctpDirKey_t  key;
+    memset( &key, 0, sizeof(key) );
+    if( !com_getNodeInf( iSctp, &key.node ) ) {return NULL;}
+    COM_CAST_HEAD( com_sigSctpCommonHdr_t, cmnHdr, iSctp->sig.top );
+    key.vtag = com_getVal32( cmnHdr->verifTag, iSctp->order );
+    if( gHashSctp == COM_HASHID_NOTREG ) {
+        gHashSctp = com_registerHash( SCTP_DIRHASH_SIZE, NULL );
+    }
+    const void*  data = NULL;
+    if( com_searchHash( gHashSctp, &key, sizeof(key), &data, NULL ) ) {
+        return &(gSctpTsn[*(const long*)data]);
+    }
+    *oIsNew = true;
+    return addSctpTsnInf( &key, iTsn );
+}
+
+static void shiftTsnWindow( sctpTsnInf_t *ioInf, ulong iShift )
+{
+    ulong*  win = ioInf->window;
+    if( iShift >= SCTP_TSNWIN_BITS ) {win[0] = win[1] = 0;}
+    else if( iShift >= ULONG_BITS ) {
+        win[1] = win[0] << (iShift - ULONG_BITS);
+        win[0] = 0;
+    }
+    else {
+        win[1] = (win[1] << iShift) | (win[0] >> (ULONG_BITS - iShift));
+        win[0] <<= iShift;
+    }
+}
+
+// 既に見た TSNなら trueを返す
+static BOOL checkSctpTsn( com_sigInf_t *iSctp, ulong iTsn )
+{
+    BOOL  isNew = false;
+    sctpTsnInf_t*  inf = getSctpTsnInf( iSctp, iTsn, &isNew );
+    if( !inf ) {gSctpStat.untracked++;  return false;}
+    if( isNew ) {return false;}
+    int32_t  diff = (int32_t)(uint32_t)(iTsn - inf->maxTsn);
+    if( diff > 0 ) {
+        shiftTsnWindow( inf, (ulong)diff );
+        inf->maxTsn = iTsn;
+        inf->window[0] |= 1;
+        return false;
+    }
+    ulong  pos = (ulong)(-(long)diff);
+    if( pos < SCTP_TSNWIN_BITS ) {
+        ulong  bit = 1UL << (pos % ULONG_BITS);
+        ulong*  word = &(inf->window[pos / ULONG_BITS]);
+        if( !(*word & bit) ) {*word |= bit;  return false;}
+    }
+    // ウィンドウより古い TSNも再送とみなす
+    gSctpStat.retransTsn++;
+    return true;
+}
+
+static void countSackDup( com_bin *iTop, BOOL iOrder )
+{
+    COM_CAST_HEAD( com_sigSctpSackHdr_t, sack, iTop );
+    gSctpStat.dupTsn += com_getVal16( sack->noDupTsns, iOrder );
+}
+
+///// SCTP DATA chunk結合 /////
+//
+// B/Eビットで分割されたユーザーメッセージは、(送信元/送信先のアドレス/ポート,
+// Stream ID, Stream Sequence Number, Uビット) を分割条件にして保持し、
+// Bから Eまでの TSNが全て揃ったら TSN順に結合して次プロトコルに渡す。
+// 分割データの保持は com_stockFragments()によるので、保持期限と総サイズ上限は
+// com_setFragmentLimit()の設定に従う。
+
+// 分割データの両端 (com_sigFrg_t.extに保持)
+typedef struct {
+    ulong   beginTsn;    // Bビットの TSN
+    ulong   endTsn;      // Eビットの TSN
+    ulong   flags;       // 受信済みの COM_CAP_SCTP_FLAG_B/E
+} sctpFrgEdge_t;
+
+// 分割条件の送信元/送信先
+// Stream IDと SSNで .idを使い切るため、Uビットはこちらに含めてキーにする
+typedef struct {
+    com_bin   addr[COM_NODEADDR_SIZE];
+    com_bin   port[COM_NODEPORT_SIZE];
+    com_bin   unordered;
+} sctpFrgEnd_t;
+
+static BOOL makeSctpFrgCond(
+        com_sigFrgCond_t *oCond, sctpFrgEnd_t *oSrc, sctpFrgEnd_t *oDst,
+        com_sigInf_t *iSctp, com_sigSctpDataHdr_t *iData )
+{
+    com_nodeInf_t  node;
+    if( !com_getNodeInf( iSctp, &node ) ) {return false;}
+    memcpy( oSrc->addr, node.srcAddr, sizeof(oSrc->addr) );
+    memcpy( oSrc->port, node.srcPort, sizeof(oSrc->port) );
+    memcpy( oDst->addr, node.dstAddr, sizeof(oDst->addr) );
+    memcpy( oDst->port, node.dstPort, sizeof(oDst->port) );
+    BOOL  unordered = !!(iData->chunkHdr.flags & COM_CAP_SCTP_FLAG_U);
+    oSrc->unordered = oDst->unordered = (com_bin)unordered;
+    ulong  id = (com_getVal16( iData->streamId, iSctp->order ) << 16);
+    // 順序保証なしのメッセージは SSNが意味を持たない
+    if( !unordered ) {id += com_getVal16( iData->streamSeqno, iSctp->order );}
+    *oCond = (com_sigFrgCond_t){
+        COM_SIG_SCTP, id,
+        {(com_bin*)oSrc, sizeof(*oSrc), 0},
+        {(com_bin*)oDst, sizeof(*oDst), 0},
+        0, 0
+    };
+    return true;
+}
+
+static BOOL setSctpFrgEdge( com_sigFrg_t *ioFrg, ulong iFlags, ulong iTsn )
+{
+    if( !ioFrg->ext ) {
+        ioFrg->ext = com_malloc( sizeof(sctpFrgEdge_t), "SCTP fragment edge" );
+        if( COM_UNLIKELY(!ioFrg->ext) ) {return false;}
+    }
+    sctpFrgEdge_t*  edge = ioFrg->ext;
+    if( COM_CHECKBIT( iFlags, COM_CAP_SCTP_FLAG_B ) ) {edge->beginTsn = iTsn;}
+    if( COM_CHECKBIT( iFlags, COM_CAP_SCTP_FLAG_E ) ) {edge->endTsn = iTsn;}
+    edge->flags |= iFlags & (COM_CAP_SCTP_FLAG_B | COM_CAP_SCTP_FLAG_E);
+    return true;
+}
+
+static BOOL isSctpFrgComplete( com_sigFrg_t *iFrg )
+{
+    sctpFrgEdge_t*  edge = iFrg->ext;
+    if( !COM_CHECKBIT( edge->flags, COM_CAP_SCTP_FLAG_BE ) ) {return false;}
+    ulong  cnt = (uint32_t)(edge->endTsn - edge->beginTsn) + 1;
+    return ( cnt == (ulong)iFrg->cnt );
+}
+
+static com_sigSeg_t *searchSctpSeg( com_sigFrg_t *iFrg, ulong iTsn )
+{
+    for( long i = 0;  i < iFrg->cnt;  i++ ) {
+        if( iFrg->inf[i].seg == iTsn ) {return &(iFrg->inf[i]);}
+    }
+    return NULL;
+}
+
+static BOOL combineSctpFrg( com_sigFrg_t *iFrg, com_sigBin_t *oRas )
+{
+    com_off  total = 0;
+    for( long i = 0;  i < iFrg->cnt;  i++ ) {total += iFrg->inf[i].bin.len;}
+    com_bin*  top = com_malloc( total, "SCTP reassemble" );
+    if( COM_UNLIKELY(!top) ) {return false;}
+    sctpFrgEdge_t*  edge = iFrg->ext;
+    com_bin*  ptr = top;
+    for( long i = 0;  i < iFrg->cnt;  i++ ) {
+        ulong  tsn = (uint32_t)(edge->beginTsn + (ulong)i);
+        com_sigSeg_t*  seg = searchSctpSeg( iFrg, tsn );
+        if( !seg ) {com_free( top );  return false;}
+        memcpy( ptr, seg->bin.top, seg->bin.len );
+        ptr += seg->bin.len;
+    }
+    *oRas = (com_sigBin_t){ top, total, 0 };
+    return true;
+}
+
+static BOOL sctpFrgSeg( com_sigInf_t *oBody )
+{
+    oBody->isFragment = true;
+    return true;
+}
+
+static BOOL procSctpFragment(
+        com_sigInf_t *iSctp, com_sigSctpDataHdr_t *iData, BOOL iRetrans,
+        com_sigInf_t *oBody )
+{
+    ulong  flags = iData->chunkHdr.flags;
+    if( COM_CHECKBIT( flags, COM_CAP_SCTP_FLAG_BE ) ) {return true;}
+    gSctpStat.fragments++;
+    // 再送された断片は保持済みか結合済みなので、二重に保持しない
+    if( iRetrans ) {return sctpFrgSeg( oBody );}
+    com_sigFrgCond_t  cond;
+    sctpFrgEnd_t  src, dst;
+    if( !makeSctpFrgCond( &cond, &src, &dst, iSctp, iData ) ) {
+        return sctpFrgSeg( oBody );
+    }
+    ulong  tsn = com_getVal32( iData->tsn, iSctp->order );
+    com_sigFrg_t*  frg = com_stockFragments( &cond, tsn, &oBody->sig );
+    if( COM_UNLIKELY(!frg) ) {return false;}
+    if( !setSctpFrgEdge( frg, flags, tsn ) ) {
+        com_freeFragments( &cond );
+        return false;
+    }
+    if( !isSctpFrgComplete( frg ) ) {return sctpFrgSeg( oBody );}
+    BOOL  result = combineSctpFrg( frg, &oBody->ras );
+    com_freeFragments( &cond );
+    if( !result ) {return false;}
+    oBody->sig.top = oBody->ras.top;
+    oBody->sig.len = oBody->ras.len;
+    gSctpStat.reassembled++;
+    return true;
+}
+
 static BOOL getDataPayload( com_bin *iTop, com_sigInf_t *oHead )
 {
     COM_CAST_HEAD( com_sigSctpDataHdr_t, data, iTop );
@@ -1376,8 +1637,16 @@ static BOOL getDataPayload( com_bin *iTop, com_sigInf_t *oHead )
             com_getVal16( data->chunkHdr.length, order ) - sizeof(*data),
             com_getPrtclType( COM_SCTPNEXT,com_getVal32(data->protocol, order) )
         };
+        gSctpStat.dataChunks++;
+        BOOL  retrans = checkSctpTsn( oHead, com_getVal32( data->tsn, order ) );
+        if( !procSctpFragment( oHead, data, retrans, &body ) ) {return false;}
+    }
+    else {
+        if( data->chunkHdr.type == COM_CAP_SCTP_SACK ) {
+            countSackDup( iTop, order );
+        }
+        body.sig.ptype = COM_SIG_END;
     }
-    else {body.sig.ptype = COM_SIG_END;}
     com_sigInf_t*  newStack = com_stackSigNext( oHead, &body );
     if( newStack && body.sig.ptype == COM_SIG_CONTINUE ) {
         newStack->ext = com_malloc( sizeof(long), "sctp port" );
@@ -1421,6 +1690,7 @@ static void dispChunkData( void *iTop )
     DISPBIN( "stream ID",    dataHdr->streamId,    COM_16BIT_SIZE );
     DISPBIN( "stream seqno", dataHdr->streamSeqno, COM_16BIT_SIZE );
     DISPBIN( "payload protocol ID", dataHdr->protocol, COM_32BIT_SIZE );
+    DISPBIN( "flags (U/B/E)", dataHdr->chunkHdr.flags, 1 );
 }
 
 static void dispChunkInit( void *iTop )
@@ -1461,6 +1731,9 @@ static void dispChunk(
 {
     com_dispPrm( "type", com_getSctpChunkName( iSctp ), 0 );
     if( dispChunkInf( iSctp->chunkHdr.type, &iChunk->sig ) ) {
+        if( iPayload->ras.top ) {
+            com_dispDec( "   <reassembled (size=%zu)>", iPayload->ras.len );
+        }
         if( iPayload->ext ) {
             ulong*  port = iPayload->ext;
             com_dispNext( *port, sizeof(short), iPayload->sig.ptype );
@@ -1587,6 +1860,7 @@ typedef struct {
 } sdpSessionInf_t;
 
 static long  gSdpSesCnt = 0;
+static long  gSdpSesCapa = 0;
 static sdpSessionInf_t*  gSdpSesInf = NULL;
 
 static void freeSdpSesInf( void )
@@ -1595,6 +1869,7 @@ static void freeSdpSesInf( void )
         com_free( gSdpSesInf[i].callId );
     }
     com_free( gSdpSesInf );
+    gSdpSesCnt = gSdpSesCapa = 0;
 }
 
 static sdpSessionInf_t *checkSdpSesInf( long iCnt, char *iCallId )
@@ -1637,8 +1912,9 @@ static sdpSessionInf_t *getSdpSesInf(
         if( !inf->isUse ) {tmp = clearSdpSesInf( inf );  *oId = i;  break;}
     }
     if( !tmp ) {  // 再利用できるものがないときは新規追加
-        tmp = com_reallocAddr( &gSdpSesInf, sizeof(*gSdpSesInf), COM_TABLEEND,
-                               &gSdpSesCnt, 1, "new sdp session inf" );
+        tmp = com_reallocAddrCap( &gSdpSesInf, sizeof(*gSdpSesInf),
+                                  COM_TABLEEND, &gSdpSesCnt, &gSdpSesCapa, 1,
+                                  "new sdp session inf" );
     }
     if( COM_LIKELY(tmp) ) {
         if( !setSdpSesInf( tmp, iInf, iCallId ) ) {return NULL;}
@@ -2378,9 +2654,9 @@ static com_sigDnsRecord_t *getNewRd( com_sigInf_t *ioHead )
 {
     com_sigDnsData_t*  tmpDns = ioHead->ext;
     com_sigDnsRecord_t*  newRec =
-        com_reallocAddr( &(tmpDns->rd), sizeof(*(tmpDns->rd)),
-                         COM_TABLEEND, &(tmpDns->rcnt), 1,
-                         "DNS RD%ld", tmpDns->rcnt );
+        com_reallocAddrCap( &(tmpDns->rd), sizeof(*(tmpDns->rd)),
+                            COM_TABLEEND, &(tmpDns->rcnt), &(tmpDns->rcapa), 1,
+                            "DNS RD%ld", tmpDns->rcnt );
     return newRec;
 }
 
@@ -2818,6 +3094,7 @@ static void finalizeSigSet1( void )
 {
     COM_DEBUG_AVOID_START( COM_PROC_ALL );
     freeTcpNodeInf();
+    freeSctpInf();
     freeSdpSesInf();
     COM_DEBUG_AVOID_END( COM_PROC_ALL );
 }
@@ -1144,6 +1144,14 @@ typedef enum {
     COM_CAP_SCTP_CWR      = 0x0d
 } COM_CAP_SCTP_TYPE_t;
 
+// DATA chunkフラグ
+enum {
+    COM_CAP_SCTP_FLAG_E   = 0x01,    // Ending fragment
+    COM_CAP_SCTP_FLAG_B   = 0x02,    // Beginning fragment
+    COM_CAP_SCTP_FLAG_BE  = 0x03,    // 分割なし
+    COM_CAP_SCTP_FLAG_U   = 0x04     // Unordered
+};
+
 // DATAヘッダ構造
 typedef struct {
     com_sigSctpChunkHdr_t  chunkHdr;
@@ -1220,6 +1228,20 @@ typedef struct {
  * プロトコルが特定できなかったら 次プロトコル種別は COM_SIG_CONTINUE になる。
  * いずれにせよ ioHead->next.stack[].sig.ptype に設定される。
  *
+ * B/Eビットで分割された DATA chunkは (送信元/送信先のアドレス/ポート,
+ * Stream ID, Stream Sequence Number, Uビット) ごとに com_stockFragments()で
+ * 保持し、Bから Eまでの TSNが全て揃った時点で TSN順に結合する。
+ * 結合できたら ioHead->next.stack[].ras に結合データを設定し、.sigも同じ
+ * データを指すようにするので、次プロトコルは結合済みのメッセージを解析する。
+ * まだ揃っていない場合は ioHead->next.stack[].isFragment が trueになり、
+ * com_getSigType()は COM_SIG_FRAGMENTを返す。
+ * 分割データの保持期限と総サイズ上限は com_setFragmentLimit()に従う。
+ * メッセージは揃った時点で渡し、SSN順の並べ替えは行わない。
+ *
+ * 方向(アドレス/ポート + Verification Tag)ごとに直近の TSNを記録しており、
+ * 既に見た TSNの DATA chunkは再送とみなして com_getSctpStat()で計上する。
+ * 再送された分割データは二重に保持しない。
+ *
  *
  * com_decodeSctp()で解析した iHeadの内容をデコード出力する。
  * ・SCTP共通ヘッダ内容をダンプ
@@ -1232,6 +1254,30 @@ typedef struct {
 BOOL com_analyzeSctp( COM_ANALYZER_PRM );
 void com_decodeSctp( COM_DECODER_PRM );
 
+// SCTP統計データ構造
+typedef struct {
+    ulong   dataChunks;     // DATA chunk数
+    ulong   fragments;      // 分割された DATA chunk数
+    ulong   reassembled;    // 結合できたメッセージ数
+    ulong   retransTsn;     // 再送された(既に見た) TSNの DATA chunk数
+    ulong   dupTsn;         // SACKで通知された Duplicate TSN数の合計
+    ulong   untracked;      // 監視上限を超えて TSN監視できなかった chunk数
+} com_sigSctpStat_t;
+
+/*
+ * SCTP統計取得  com_getSctpStat()
+ * ---------------------------------------------------------------------------
+ *   COM_ERR_DEBUG: [com_prmNG] !oStat
+ * ===========================================================================
+ *   マルチスレッドで動くことは想定していない。
+ * ===========================================================================
+ * com_analyzeSctp()で計上した統計を oStatに格納する。
+ * iClearが trueなら取得後に統計をクリアする。
+ * TSN監視は最大 4096方向までで、それを超えた方向の DATA chunkは
+ * .untrackedに計上し、再送判定をしない。
+ */
+void com_getSctpStat( com_sigSctpStat_t *oStat, BOOL iClear );
+
 /*
  * SCTPチャンク名取得  com_getSctpChunkName()
  *   チャンク名文字列を返す。
@@ -2072,6 +2118,7 @@ typedef struct {
     ulong                rcode;    // DNSヘッダの rcpde値
     com_sigDnsRecord_t*  rd;       // resource record
     long                 rcnt;     // resource record数
+    long                 rcapa;    // rdの容量
 } com_sigDnsData_t;
 
 // DNS header section: flags要素
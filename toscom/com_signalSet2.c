@@ -417,6 +417,7 @@ typedef struct {
 } sccpConnInf_t;
 
 static long gSccpConnCnt = 0;
+static long gSccpConnCapa = 0;
 static sccpConnInf_t*  gSccpConnInf = NULL;
 
 static void clearSccpConnInf( sccpConnInf_t *oInf )
@@ -434,7 +435,7 @@ static void freeSccpConnInf( void )
     for( long i = 0;  i < gSccpConnCnt;  i++ ) {
         clearSccpConnInf( &(gSccpConnInf[i]) );
     }
-    gSccpConnCnt = 0;
+    gSccpConnCnt = gSccpConnCapa = 0;
     com_free( gSccpConnInf );
 }
 
@@ -482,8 +483,9 @@ static sccpConnInf_t *getUsableInf( long *oId )
         }
     }
     sccpConnInf_t*  inf =
-        com_reallocAddr( &gSccpConnInf, sizeof(*gSccpConnInf), COM_TABLEEND,
-                         &gSccpConnCnt, 1, "sccp connection inf" );
+        com_reallocAddrCap( &gSccpConnInf, sizeof(*gSccpConnInf),
+                            COM_TABLEEND, &gSccpConnCnt, &gSccpConnCapa, 1,
+                            "sccp connection inf" );
     *oId = gSccpConnCnt - 1;
     return inf;
 }
@@ -1045,7 +1047,7 @@ void com_decodeTcap( COM_DECODER_PRM )
     COM_DECODER_START;
     com_dispDec( " TCAP MESSAGE [%d]", COM_SIG_TCAP );
     com_dispDec( "  -Transaction Portion-" );
-    com_dispPrm( "message type", com_getTcapTranName( COM_IPRMLST[0].tag ), 9 );
+    com_dispPrm( "message type", com_getTcapTranName( COM_IPRMLST[0].tag ), 0 );
     for( long prmId = 1;  prmId < COM_IPRMCNT;  prmId++ ) {
         com_sigTlv_t*  tlv = &(COM_IPRMLST[prmId]);
         if( tlv->tag == COM_CAP_TCAP_DIALOGUE ) {
@@ -1212,7 +1214,9 @@ static com_bin *checkSignal( com_sigInf_t *ioHead, sigTcapComp_t **oConf )
     com_bin*  signal = COM_SGTOP;
     if( !com_getTcapCompName( *signal ) ) {return NULL;}
     if( !(*oConf = getCompConf( *signal )) ) {return NULL;}
-    signal += com_getTagLength( signal + 1, NULL );
+    // コンポーネントのタグとレングスを飛ばして、中身の先頭を返す
+    signal++;
+    signal += com_getTagLength( signal, NULL );
     return signal;
 }
 
@@ -1290,7 +1294,9 @@ static void decodeTcapComponents( com_sigInf_t *iHead, getOpName_t iFunc )
     for( ulong i = 0;  i < COM_SIG_TCAP_MAX;  i++ ) {
         com_sigTlv_t*  tlv = &(compPrm->prm[i]);
         if( i == COM_SIG_TCAP_OPCODE ) {
-            com_dispPrm( com_getTcapCompPrm(i), iFunc( *tlv->value ), 0 );
+            if( tlv->value ) {
+                com_dispPrm( com_getTcapCompPrm(i), iFunc( *tlv->value ), 0 );
+            }
         }
         else if( i != COM_SIG_TCAP_PARAM && tlv->tag ) {
             com_dispBin( com_getTcapCompPrm(i),tlv->value,tlv->len,"",true );
@@ -1324,9 +1330,19 @@ static ulong getTcapCompOpcode( com_sigInf_t *iHead )
     COM_CAST_HEAD( com_sigTcapCompHead_t, compPrm, iHead->ext );
     if( !compPrm ) {return NO_TCAPCOMP_PRM;}
     com_sigTlv_t*  tlv = &(compPrm->prm[COM_SIG_TCAP_OPCODE]);
+    if( !tlv->value ) {return NO_TCAPCOMP_PRM;}
     return *tlv->value;
 }
 
+// オペレーションコードを持たないコンポーネント(Return Error/Rejectなど)は
+// コード名の確認をせずに解析成功とする
+static BOOL checkTcapCompOpcode( com_sigInf_t *iHead, getOpName_t iFunc )
+{
+    ulong  opcode = getTcapCompOpcode( iHead );
+    if( opcode == NO_TCAPCOMP_PRM ) {return true;}
+    return (iFunc( opcode ) != NULL);
+}
+
 
 
 // INAP //////////////////////////////////////////////////////////////////////
@@ -1336,8 +1352,7 @@ BOOL com_analyzeInap( COM_ANALYZER_PRM )
     COM_ANALYZER_START( COM_NO_MIN_LEN );
     if( (result = com_getTcapCompInf( ioHead )) ) {
         COM_SGTYPE = COM_SIG_INAP;
-        result = (com_getInapOpName( (ulong)getTcapCompOpcode( ioHead ) )
-                  != NULL);
+        result = checkTcapCompOpcode( ioHead, com_getInapOpName );
     }
     COM_ANALYZER_END;
 }
@@ -1382,7 +1397,7 @@ BOOL com_analyzeGsmmap( COM_ANALYZER_PRM )
     COM_ANALYZER_START( COM_NO_MIN_LEN );
     if( (result = com_getTcapCompInf( ioHead )) ) {
         COM_SGTYPE = COM_SIG_GSMMAP;
-        result = (com_getGsmmapOpName( getTcapCompOpcode( ioHead ) ) != NULL);
+        result = checkTcapCompOpcode( ioHead, com_getGsmmapOpName );
     }
     COM_ANALYZER_END;
 }